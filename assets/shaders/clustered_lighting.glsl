@@ -0,0 +1,99 @@
+//Clustered forward lighting shared by light_cluster.comp, which bins the lights, and the fragment shaders that shade
+//with them. The view frustum is split into grid.x*grid.y screen tiles and grid.z depth slices that grow exponentially
+//between the near and far plane. Every cluster holds a count followed by the indices of the lights touching it.
+//Define LIGHTING_SET before including to move the descriptor set, LIGHTING_COMPUTE for the binning shader.
+
+#ifndef LIGHTING_SET
+#define LIGHTING_SET 1
+#endif
+
+//fragment shaders may only read storage buffers without the fragmentStoresAndAtomics feature
+#ifdef LIGHTING_COMPUTE
+#define LIGHTING_ACCESS
+#else
+#define LIGHTING_ACCESS readonly
+#endif
+
+const uint clusterStride = 256; //matches ClusteredLighting::clusterStride
+
+struct Light {
+    vec4 positionRange;     //world space position, range
+    vec4 colorIntensity;
+    vec4 directionCosOuter; //world space direction, cosine of the outer cone angle (below -1 for point lights)
+    vec4 cosInner;          //x cosine of the inner cone angle
+};
+
+struct ViewLight {
+    vec4 positionRange;     //view space
+    vec4 directionCosOuter;
+};
+
+layout(std430, set = LIGHTING_SET, binding = 0) readonly buffer LightingFrame {
+    mat4 view;
+    mat4 projection;
+    vec4 screen; //width, height of the render target, near, far
+    uvec4 grid;  //clusters in x, y, z, light count
+    Light lights[];
+} lighting;
+
+layout(std430, set = LIGHTING_SET, binding = 1) LIGHTING_ACCESS buffer ClusterLights {
+    uint clusterLights[];
+};
+
+layout(std430, set = LIGHTING_SET, binding = 2) LIGHTING_ACCESS buffer ViewLights {
+    ViewLight viewLights[];
+};
+
+//View space distance where the given slice starts.
+float sliceDepth(uint slice) {
+    return lighting.screen.z * pow(lighting.screen.w / lighting.screen.z, float(slice) / float(lighting.grid.z));
+}
+
+uint depthSlice(float depth) {
+    float slice = log(max(depth, lighting.screen.z) / lighting.screen.z) / log(lighting.screen.w / lighting.screen.z) * float(lighting.grid.z);
+    return min(uint(slice), lighting.grid.z - 1);
+}
+
+#ifndef LIGHTING_COMPUTE
+
+//Diffuse lighting from the lights of the fragment's cluster plus some ambient. Without lights the albedo is returned
+//unchanged, so the scene looks like it did before lighting existed.
+vec3 clusteredLighting(vec3 viewPosition, vec3 normal, vec3 albedo) {
+    if (lighting.grid.w == 0) {
+        return albedo;
+    }
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / lighting.screen.xy * vec2(lighting.grid.xy)), lighting.grid.xy - 1);
+    uint slice = depthSlice(-viewPosition.z);
+    uint base = ((slice * lighting.grid.y + tile.y) * lighting.grid.x + tile.x) * clusterStride;
+    uint count = clusterLights[base];
+
+    vec3 color = albedo * 0.1;
+    for (uint i = 0; i < count; ++i) {
+        uint index = clusterLights[base + 1 + i];
+        ViewLight light = viewLights[index];
+        vec3 toLight = light.positionRange.xyz - viewPosition;
+        float lightDistance = length(toLight);
+        if (lightDistance >= light.positionRange.w) {
+            continue;
+        }
+        vec3 direction = toLight / max(lightDistance, 1e-4);
+        //smooth falloff reaching zero at the range
+        float falloff = clamp(1.0 - pow(lightDistance / light.positionRange.w, 4.0), 0.0, 1.0);
+        falloff = falloff * falloff / (lightDistance * lightDistance + 1.0);
+        if (light.directionCosOuter.w >= -1.0) {
+            float cosInner = lighting.lights[index].cosInner.x;
+            falloff *= smoothstep(light.directionCosOuter.w, cosInner, dot(-direction, light.directionCosOuter.xyz));
+        }
+        vec4 colorIntensity = lighting.lights[index].colorIntensity;
+        color += albedo * colorIntensity.rgb * colorIntensity.w * max(dot(normal, direction), 0.0) * falloff;
+    }
+    return color;
+}
+
+//Face normal from the screen space derivatives, for geometry without normals. Points towards the camera.
+vec3 viewFaceNormal(vec3 viewPosition) {
+    vec3 normal = normalize(cross(dFdx(viewPosition), dFdy(viewPosition)));
+    return dot(normal, viewPosition) > 0.0 ? -normal : normal;
+}
+
+#endif
@@ -15,6 +15,90 @@ chmod +x "$0"
     exit 1
 }
 
+# Compile meshlet culling compute shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc meshlet_cull.comp -o meshlet_cull.spv || {
+    echo "Error: Failed to compile meshlet culling shader"
+    exit 1
+}
+
+# Compile depth pyramid compute shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc depth_pyramid.comp -o depth_pyramid.spv || {
+    echo "Error: Failed to compile depth pyramid shader"
+    exit 1
+}
+
+# Compile particle emit compute shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc particle_emit.comp -o particle_emit.spv || {
+    echo "Error: Failed to compile particle emit shader"
+    exit 1
+}
+
+# Compile particle simulation compute shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc particle_simulate.comp -o particle_simulate.spv || {
+    echo "Error: Failed to compile particle simulation shader"
+    exit 1
+}
+
+# Compile particle compaction compute shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc particle_compact.comp -o particle_compact.spv || {
+    echo "Error: Failed to compile particle compaction shader"
+    exit 1
+}
+
+# Compile particle vertex shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc particle.vert -o particle_vert.spv || {
+    echo "Error: Failed to compile particle vertex shader"
+    exit 1
+}
+
+# Compile particle fragment shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc particle.frag -o particle_frag.spv || {
+    echo "Error: Failed to compile particle fragment shader"
+    exit 1
+}
+
+# Compile upscale vertex shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc upscale.vert -o upscale_vert.spv || {
+    echo "Error: Failed to compile upscale vertex shader"
+    exit 1
+}
+
+# Compile upscale fragment shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc upscale.frag -o upscale_frag.spv || {
+    echo "Error: Failed to compile upscale fragment shader"
+    exit 1
+}
+
+# Compile light clustering compute shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc light_cluster.comp -o light_cluster.spv || {
+    echo "Error: Failed to compile light clustering shader"
+    exit 1
+}
+
+# Compile debug line vertex shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc debug_line.vert -o debug_line_vert.spv || {
+    echo "Error: Failed to compile debug line vertex shader"
+    exit 1
+}
+
+# Compile debug line fragment shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc debug_line.frag -o debug_line_frag.spv || {
+    echo "Error: Failed to compile debug line fragment shader"
+    exit 1
+}
+
+# Compile debug overlay vertex shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc debug_overlay.vert -o debug_overlay_vert.spv || {
+    echo "Error: Failed to compile debug overlay vertex shader"
+    exit 1
+}
+
+# Compile debug overlay fragment shader
+/Users/umutercan/VulkanSDK/1.3.239.0/macOS/bin/glslc debug_overlay.frag -o debug_overlay_frag.spv || {
+    echo "Error: Failed to compile debug overlay fragment shader"
+    exit 1
+}
+
 # Print directory of compiled shader program binary
 echo "Compiled shader program binary located in $(pwd)"
 
@@ -1,3 +1,17 @@
 C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe shader.vert -o vert.spv
 C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe shader.frag -o frag.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe meshlet_cull.comp -o meshlet_cull.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe depth_pyramid.comp -o depth_pyramid.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe particle_emit.comp -o particle_emit.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe particle_simulate.comp -o particle_simulate.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe particle_compact.comp -o particle_compact.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe particle.vert -o particle_vert.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe particle.frag -o particle_frag.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe upscale.vert -o upscale_vert.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe upscale.frag -o upscale_frag.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe light_cluster.comp -o light_cluster.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe debug_line.vert -o debug_line_vert.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe debug_line.frag -o debug_line_frag.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe debug_overlay.vert -o debug_overlay_vert.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe debug_overlay.frag -o debug_overlay_frag.spv
 pause
\ No newline at end of file
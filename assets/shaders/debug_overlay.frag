@@ -0,0 +1,54 @@
+#version 450
+
+//Glyphs come from a 5x7 bitmap font of the printable ASCII characters kept right here, so text needs no texture.
+//Every glyph is five columns of seven bits with the top row in the lowest bit, columns 0-3 in the first word and
+//column 4 in the second. fragGlyph.x is the glyph index times 8 plus the column, fragGlyph.y the row; a negative
+//row fills the quad, which is how rectangles are drawn.
+const uint font[190] = uint[](
+    0x00000000u, 0x00000000u, 0x005f0000u, 0x00000000u, 0x07000700u, 0x00000000u, 0x7f147f14u, 0x00000014u,
+    0x2a7f2a24u, 0x00000012u, 0x64081323u, 0x00000062u, 0x22554936u, 0x00000050u, 0x00030500u, 0x00000000u,
+    0x41221c00u, 0x00000000u, 0x1c224100u, 0x00000000u, 0x2a1c2a08u, 0x00000008u, 0x083e0808u, 0x00000008u,
+    0x00305000u, 0x00000000u, 0x08080808u, 0x00000008u, 0x00606000u, 0x00000000u, 0x04081020u, 0x00000002u,
+    0x4549513eu, 0x0000003eu, 0x407f4200u, 0x00000000u, 0x49516142u, 0x00000046u, 0x4b454121u, 0x00000031u,
+    0x7f121418u, 0x00000010u, 0x45454527u, 0x00000039u, 0x49494a3cu, 0x00000030u, 0x05097101u, 0x00000003u,
+    0x49494936u, 0x00000036u, 0x29494906u, 0x0000001eu, 0x00363600u, 0x00000000u, 0x00365600u, 0x00000000u,
+    0x41221408u, 0x00000000u, 0x14141414u, 0x00000014u, 0x14224100u, 0x00000008u, 0x09510102u, 0x00000006u,
+    0x41794932u, 0x0000003eu, 0x1111117eu, 0x0000007eu, 0x4949497fu, 0x00000036u, 0x4141413eu, 0x00000022u,
+    0x2241417fu, 0x0000001cu, 0x4949497fu, 0x00000041u, 0x0109097fu, 0x00000001u, 0x5141413eu, 0x00000032u,
+    0x0808087fu, 0x0000007fu, 0x417f4100u, 0x00000000u, 0x3f414020u, 0x00000001u, 0x2214087fu, 0x00000041u,
+    0x4040407fu, 0x00000040u, 0x0204027fu, 0x0000007fu, 0x1008047fu, 0x0000007fu, 0x4141413eu, 0x0000003eu,
+    0x0909097fu, 0x00000006u, 0x2151413eu, 0x0000005eu, 0x2919097fu, 0x00000046u, 0x49494946u, 0x00000031u,
+    0x017f0101u, 0x00000001u, 0x4040403fu, 0x0000003fu, 0x2040201fu, 0x0000001fu, 0x2018207fu, 0x0000007fu,
+    0x14081463u, 0x00000063u, 0x04780403u, 0x00000003u, 0x45495161u, 0x00000043u, 0x41417f00u, 0x00000000u,
+    0x10080402u, 0x00000020u, 0x7f414100u, 0x00000000u, 0x02010204u, 0x00000004u, 0x40404040u, 0x00000040u,
+    0x04020100u, 0x00000000u, 0x54545420u, 0x00000078u, 0x4444487fu, 0x00000038u, 0x44444438u, 0x00000020u,
+    0x48444438u, 0x0000007fu, 0x54545438u, 0x00000018u, 0x01097e08u, 0x00000002u, 0x54545408u, 0x0000003cu,
+    0x0404087fu, 0x00000078u, 0x407d4400u, 0x00000000u, 0x3d444020u, 0x00000000u, 0x4428107fu, 0x00000000u,
+    0x407f4100u, 0x00000000u, 0x0418047cu, 0x00000078u, 0x0404087cu, 0x00000078u, 0x44444438u, 0x00000038u,
+    0x1414147cu, 0x00000008u, 0x18141408u, 0x0000007cu, 0x0404087cu, 0x00000008u, 0x54545448u, 0x00000020u,
+    0x40443f04u, 0x00000020u, 0x2040403cu, 0x0000007cu, 0x2040201cu, 0x0000001cu, 0x4030403cu, 0x0000003cu,
+    0x28102844u, 0x00000044u, 0x5050500cu, 0x0000003cu, 0x4c546444u, 0x00000044u, 0x41360800u, 0x00000000u,
+    0x007f0000u, 0x00000000u, 0x08364100u, 0x00000000u, 0x10080810u, 0x00000008u
+);
+
+layout(location = 0) in vec2 fragGlyph;
+layout(location = 1) in vec4 fragColor;
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    if (fragGlyph.y < 0.0) {
+        outColor = fragColor;
+        return;
+    }
+    uint glyph = uint(fragGlyph.x) / 8u;
+    uint column = uint(fragGlyph.x) % 8u;
+    uint row = min(uint(fragGlyph.y), 6u);
+    if (column > 4u) {
+        discard;
+    }
+    uint bits = column < 4u ? font[glyph * 2u] >> (column * 8u) : font[glyph * 2u + 1u];
+    if ((bits & (1u << row)) == 0u) {
+        discard;
+    }
+    outColor = fragColor;
+}
@@ -0,0 +1,19 @@
+#version 450
+
+//Screen space text and rectangles, positions are in pixels from the top left corner of the target.
+layout(push_constant) uniform Overlay {
+    vec2 pixelToNdc; //2 / target extent
+} overlay;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inGlyph;
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec2 fragGlyph;
+layout(location = 1) out vec4 fragColor;
+
+void main() {
+    gl_Position = vec4(inPosition * overlay.pixelToNdc - 1.0, 0.0, 1.0);
+    fragGlyph = inGlyph;
+    fragColor = inColor;
+}
@@ -0,0 +1,53 @@
+#version 450
+
+//One camera facing quad per alive particle, gl_InstanceIndex walks the compacted alive list.
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+struct Particle {
+    vec4 position;
+    vec4 velocity;
+    vec4 color;
+};
+
+layout(std430, binding = 1) readonly buffer Particles {
+    Particle particles[];
+};
+
+layout(std430, binding = 2) readonly buffer Lists {
+    uint indices[];
+};
+
+layout(push_constant) uniform Frame {
+    vec4 emitter;
+    uint current;
+    uint emitCount;
+    uint capacity;
+    uint seed;
+    float deltaTime;
+    float time;
+    float size;
+} frame;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragCorner;
+
+const vec2 corners[6] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0), vec2(-1.0, -1.0));
+
+void main() {
+    uint index = indices[frame.capacity * (2 - frame.current) + gl_InstanceIndex];
+    Particle particle = particles[index];
+
+    //the camera's right and up axes are the first two rows of the view rotation
+    vec3 right = vec3(ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]);
+    vec3 up = vec3(ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]);
+    vec2 corner = corners[gl_VertexIndex];
+    vec3 position = particle.position.xyz + (right * corner.x + up * corner.y) * frame.size;
+
+    gl_Position = ubo.proj * ubo.view * vec4(position, 1.0);
+    fragColor = particle.color;
+    fragCorner = corner;
+}
@@ -1,9 +1,18 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "clustered_lighting.glsl"
+
+layout (binding=1) uniform sampler2D texSampler;
 
 layout (location=0) in vec3 fragColor;
+layout (location=1) in vec2 fragTexCoord;
+layout (location=2) in vec3 fragViewPosition;
 layout (location=0) out vec4 outColor;
 
 
 void main(){
-    outColor=vec4(fragColor,1.0);
+    vec4 albedo=vec4(fragColor,1.0)*texture(texSampler,fragTexCoord);
+    //the vertices carry no normals, the lighting uses the face normal
+    outColor=vec4(clusteredLighting(fragViewPosition,viewFaceNormal(fragViewPosition),albedo.rgb),albedo.a);
 }
\ No newline at end of file
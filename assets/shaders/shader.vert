@@ -8,10 +8,17 @@ layout(binding = 0) uniform UniformBufferObject {
 
 layout(location=0) in vec3 inPositions;
 layout(location=1) in vec3 inColors;
+layout(location=2) in vec2 inTexCoord;
+layout(location=3) in mat4 inInstanceModel; //world matrix of the scene node, occupies locations 3-6
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragViewPosition; //for the clustered lighting
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPositions, 1.0);
+    vec4 viewPosition = ubo.view * ubo.model * inInstanceModel * vec4(inPositions, 1.0);
+    gl_Position = ubo.proj * viewPosition;
+    fragViewPosition = viewPosition.xyz;
     fragColor = inColors;
-}
\ No newline at end of file
+    fragTexCoord = inTexCoord;
+}
@@ -0,0 +1,36 @@
+#version 450
+
+//Bilinear upscale of the scene color target to the swapchain. With a sharpness above 0 the result is sharpened with
+//the four neighbours and clamped to their range, so the sharpening can not ring.
+layout(binding = 0) uniform sampler2D sceneColor;
+
+layout(push_constant) uniform Upscale {
+    vec2 uvScale;
+    vec2 uvMax;
+    vec2 texelSize;
+    float sharpness;
+} upscale;
+
+layout(location = 0) in vec2 fragUv;
+
+layout(location = 0) out vec4 outColor;
+
+vec3 fetch(vec2 uv) {
+    //nothing outside of the render extent was drawn this frame
+    return texture(sceneColor, clamp(uv, upscale.texelSize * 0.5, upscale.uvMax)).rgb;
+}
+
+void main() {
+    vec3 color = fetch(fragUv);
+    if (upscale.sharpness > 0.0) {
+        vec3 north = fetch(fragUv - vec2(0.0, upscale.texelSize.y));
+        vec3 south = fetch(fragUv + vec2(0.0, upscale.texelSize.y));
+        vec3 west = fetch(fragUv - vec2(upscale.texelSize.x, 0.0));
+        vec3 east = fetch(fragUv + vec2(upscale.texelSize.x, 0.0));
+        vec3 low = min(color, min(min(north, south), min(west, east)));
+        vec3 high = max(color, max(max(north, south), max(west, east)));
+        vec3 sharpened = color + (4.0 * color - (north + south + west + east)) * upscale.sharpness * 0.25;
+        color = clamp(sharpened, low, high);
+    }
+    outColor = vec4(color, 1.0);
+}
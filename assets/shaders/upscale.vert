@@ -0,0 +1,17 @@
+#version 450
+
+//Fullscreen triangle, the uvs cover the part of the scene color target the frame was rendered into.
+layout(push_constant) uniform Upscale {
+    vec2 uvScale;   //render extent / target extent
+    vec2 uvMax;     //last texel center inside the render extent
+    vec2 texelSize;
+    float sharpness;
+} upscale;
+
+layout(location = 0) out vec2 fragUv;
+
+void main() {
+    vec2 corner = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    fragUv = corner * upscale.uvScale;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
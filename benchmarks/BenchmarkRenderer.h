@@ -0,0 +1,849 @@
+#pragma once
+
+#include "ClusteredLighting.h"
+#include "DeletionQueue.h"
+#include "VulkanUtils.h"
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstring>
+#include<fstream>
+#include<random>
+#include<stdexcept>
+#include<string>
+#include<vector>
+
+enum class VertexFormat{
+    Float32, //position, normal and uv as floats, 32 bytes
+    Packed   //snorm16 position, snorm8 normal, unorm16 uv, 16 bytes
+};
+
+inline const char* vertexFormatName(VertexFormat format){
+    return format==VertexFormat::Float32 ? "float32" : "packed";
+}
+
+struct BenchmarkConfig{
+    std::string name;
+    uint32_t triangles=100000;  //in the whole scene, split evenly over the objects
+    uint32_t objects=100;       //one draw each
+    VertexFormat vertexFormat=VertexFormat::Float32;
+    uint32_t framesInFlight=2;
+    uint32_t lights=0;          //point and spot lights shaded through clustered lighting, 0 draws unlit
+};
+
+struct BenchmarkResult{
+    BenchmarkConfig config;
+    double startupMs=0.0;       //instance creation up to the first frame finishing on the GPU
+    double uploadMBps=0.0;      //staging memcpy plus the copy into device local memory, median of the runs
+    double cpuFrameMs=0.0;      //average time between frame starts, includes waiting on the frame fence
+    double p95FrameMs=0.0;
+    bool skipped=false;
+    std::string skipReason;
+};
+
+class NoDeviceError: public std::runtime_error{
+    public:
+        using std::runtime_error::runtime_error;
+};
+
+//Renders a synthetic scene into an offscreen target without a window, so it runs on headless machines and
+//software drivers like lavapipe. Every run() builds its own instance and device, which is what startup time measures.
+class BenchmarkRenderer{
+
+    public:
+        BenchmarkRenderer(std::string shaderDirectory, std::string preferredDevice)
+            : shaderDirectory(std::move(shaderDirectory)), preferredDevice(std::move(preferredDevice)){}
+
+        BenchmarkResult run(const BenchmarkConfig& config, uint32_t frames){
+            BenchmarkResult result;
+            result.config=config;
+
+            auto start=std::chrono::steady_clock::now();
+            createContext();
+            if(!supportsVertexFormat(config.vertexFormat)){
+                destroy();
+                result.skipped=true;
+                result.skipReason=std::string(vertexFormatName(config.vertexFormat))+" vertex formats are not supported";
+                return result;
+            }
+            createTargets();
+            if(config.lights>0){
+                createLighting(config);
+            }
+            createPipeline(config.vertexFormat,config.lights>0);
+            createFrames(config.framesInFlight);
+
+            std::vector<uint8_t> vertexData;
+            std::vector<uint32_t> indexData;
+            buildMesh(config,vertexData,indexData);
+            std::vector<double> uploadSeconds(1,upload(vertexData,indexData,true));
+
+            renderFrame(config,0);
+            waitIdle();
+            result.startupMs=milliseconds(start,std::chrono::steady_clock::now());
+
+            //more uploads into the same buffers for a stable throughput figure
+            for(int i=0;i<4;++i){
+                uploadSeconds.push_back(upload(vertexData,indexData,false));
+            }
+            std::sort(uploadSeconds.begin(),uploadSeconds.end());
+            double uploadBytes=static_cast<double>(vertexData.size()+indexData.size()*sizeof(uint32_t));
+            result.uploadMBps=uploadBytes/(1024.0*1024.0)/uploadSeconds[uploadSeconds.size()/2];
+
+            const uint32_t warmup=10;
+            for(uint32_t i=0;i<warmup;++i){
+                renderFrame(config,i+1);
+            }
+            std::vector<double> frameTimes;
+            auto previous=std::chrono::steady_clock::now();
+            for(uint32_t i=0;i<frames;++i){
+                renderFrame(config,warmup+1+i);
+                auto now=std::chrono::steady_clock::now();
+                frameTimes.push_back(milliseconds(previous,now));
+                previous=now;
+            }
+            waitIdle();
+
+            double total=0.0;
+            for(double time: frameTimes){
+                total+=time;
+            }
+            result.cpuFrameMs=total/frameTimes.size();
+            std::sort(frameTimes.begin(),frameTimes.end());
+            result.p95FrameMs=frameTimes[std::min(frameTimes.size()-1,static_cast<size_t>(0.95*frameTimes.size()))];
+
+            destroy();
+            return result;
+        }
+
+        const std::string& getDeviceName() const{ return deviceName; }
+
+    private:
+        struct Frame{
+            VkCommandBuffer commandBuffer=VK_NULL_HANDLE;
+            VkFence fence=VK_NULL_HANDLE;
+        };
+
+        static double milliseconds(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end){
+            return std::chrono::duration<double,std::milli>(end-begin).count();
+        }
+
+        void createContext(){
+
+            uint32_t extensionCount=0;
+            vkEnumerateInstanceExtensionProperties(nullptr,&extensionCount,nullptr);
+            std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+            vkEnumerateInstanceExtensionProperties(nullptr,&extensionCount,availableExtensions.data());
+
+            std::vector<const char*> extensions;
+            VkInstanceCreateFlags flags=0;
+            for(const auto& extension: availableExtensions){
+                if(strcmp(extension.extensionName,VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME)==0){
+                    extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+                    flags|=VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+                }
+            }
+
+            VkApplicationInfo appInfo{};
+            {
+                appInfo.sType=VK_STRUCTURE_TYPE_APPLICATION_INFO;
+                appInfo.pApplicationName="VulkanProject benchmarks";
+                appInfo.applicationVersion=VK_MAKE_VERSION(1,0,0);
+                appInfo.pEngineName="No Engine??";
+                appInfo.engineVersion=VK_MAKE_VERSION(1,0,0);
+                appInfo.apiVersion=VK_API_VERSION_1_0;
+            }
+            VkInstanceCreateInfo createInfo{};
+            {
+                createInfo.sType=VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+                createInfo.flags=flags;
+                createInfo.pApplicationInfo=&appInfo;
+                createInfo.enabledExtensionCount=static_cast<uint32_t>(extensions.size());
+                createInfo.ppEnabledExtensionNames=extensions.data();
+            }
+            if(vkCreateInstance(&createInfo,nullptr,&instance)!=VK_SUCCESS){
+                throw NoDeviceError("failed to create instance!");
+            }
+
+            uint32_t deviceCount=0;
+            vkEnumeratePhysicalDevices(instance,&deviceCount,nullptr);
+            std::vector<VkPhysicalDevice> devices(deviceCount);
+            vkEnumeratePhysicalDevices(instance,&deviceCount,devices.data());
+
+            //the first device with a graphics queue, or the one whose name contains preferredDevice
+            for(VkPhysicalDevice candidate: devices){
+                VkPhysicalDeviceProperties properties;
+                vkGetPhysicalDeviceProperties(candidate,&properties);
+                if(!preferredDevice.empty() && std::string(properties.deviceName).find(preferredDevice)==std::string::npos){
+                    continue;
+                }
+                uint32_t familyCount=0;
+                vkGetPhysicalDeviceQueueFamilyProperties(candidate,&familyCount,nullptr);
+                std::vector<VkQueueFamilyProperties> families(familyCount);
+                vkGetPhysicalDeviceQueueFamilyProperties(candidate,&familyCount,families.data());
+                for(uint32_t i=0;i<familyCount;++i){
+                    if(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT){
+                        physicalDevice=candidate;
+                        queueFamily=i;
+                        deviceName=properties.deviceName;
+                        break;
+                    }
+                }
+                if(physicalDevice!=VK_NULL_HANDLE){
+                    break;
+                }
+            }
+            if(physicalDevice==VK_NULL_HANDLE){
+                destroy();
+                throw NoDeviceError("no Vulkan device with a graphics queue"+(preferredDevice.empty() ? std::string() : " matching "+preferredDevice)+"!");
+            }
+
+            uint32_t deviceExtensionCount=0;
+            vkEnumerateDeviceExtensionProperties(physicalDevice,nullptr,&deviceExtensionCount,nullptr);
+            std::vector<VkExtensionProperties> deviceExtensions(deviceExtensionCount);
+            vkEnumerateDeviceExtensionProperties(physicalDevice,nullptr,&deviceExtensionCount,deviceExtensions.data());
+            std::vector<const char*> enabledExtensions;
+            for(const auto& extension: deviceExtensions){
+                if(strcmp(extension.extensionName,"VK_KHR_portability_subset")==0){
+                    enabledExtensions.push_back("VK_KHR_portability_subset");
+                }
+            }
+
+            float priority=1.0f;
+            VkDeviceQueueCreateInfo queueInfo{};
+            {
+                queueInfo.sType=VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+                queueInfo.queueFamilyIndex=queueFamily;
+                queueInfo.queueCount=1;
+                queueInfo.pQueuePriorities=&priority;
+            }
+            VkDeviceCreateInfo deviceInfo{};
+            {
+                deviceInfo.sType=VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+                deviceInfo.queueCreateInfoCount=1;
+                deviceInfo.pQueueCreateInfos=&queueInfo;
+                deviceInfo.enabledExtensionCount=static_cast<uint32_t>(enabledExtensions.size());
+                deviceInfo.ppEnabledExtensionNames=enabledExtensions.data();
+            }
+            if(vkCreateDevice(physicalDevice,&deviceInfo,nullptr,&device)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create logical device!");
+            }
+            vkGetDeviceQueue(device,queueFamily,0,&queue);
+            deletionQueue.init(device);
+
+            VkCommandPoolCreateInfo poolInfo{};
+            {
+                poolInfo.sType=VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags=VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+                poolInfo.queueFamilyIndex=queueFamily;
+            }
+            if(vkCreateCommandPool(device,&poolInfo,nullptr,&commandPool)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create command pool!");
+            }
+        }
+
+        bool supportsVertexFormat(VertexFormat format) const{
+            for(const auto& attribute: vertexAttributes(format)){
+                VkFormatProperties properties;
+                vkGetPhysicalDeviceFormatProperties(physicalDevice,attribute.format,&properties);
+                if(!(properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT)){
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static std::vector<VkVertexInputAttributeDescription> vertexAttributes(VertexFormat format){
+            if(format==VertexFormat::Float32){
+                return {{0,0,VK_FORMAT_R32G32B32_SFLOAT,0},{1,0,VK_FORMAT_R32G32B32_SFLOAT,12},{2,0,VK_FORMAT_R32G32_SFLOAT,24}};
+            }
+            return {{0,0,VK_FORMAT_R16G16B16A16_SNORM,0},{1,0,VK_FORMAT_R8G8B8A8_SNORM,8},{2,0,VK_FORMAT_R16G16_UNORM,12}};
+        }
+
+        static uint32_t vertexStride(VertexFormat format){
+            return format==VertexFormat::Float32 ? 32 : 16;
+        }
+
+        void createTargets(){
+
+            const VkFormat depthCandidates[]={VK_FORMAT_D32_SFLOAT,VK_FORMAT_D24_UNORM_S8_UINT,VK_FORMAT_D16_UNORM};
+            depthFormat=VK_FORMAT_UNDEFINED;
+            for(VkFormat candidate: depthCandidates){
+                VkFormatProperties properties;
+                vkGetPhysicalDeviceFormatProperties(physicalDevice,candidate,&properties);
+                if(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT){
+                    depthFormat=candidate;
+                    break;
+                }
+            }
+            if(depthFormat==VK_FORMAT_UNDEFINED){
+                throw std::runtime_error("failed to find supported format!");
+            }
+
+            VkImageCreateInfo imageInfo{};
+            {
+                imageInfo.sType=VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType=VK_IMAGE_TYPE_2D;
+                imageInfo.extent={extent.width,extent.height,1};
+                imageInfo.mipLevels=1;
+                imageInfo.arrayLayers=1;
+                imageInfo.format=colorFormat;
+                imageInfo.tiling=VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.initialLayout=VK_IMAGE_LAYOUT_UNDEFINED;
+                imageInfo.usage=VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+                imageInfo.samples=VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.sharingMode=VK_SHARING_MODE_EXCLUSIVE;
+            }
+            vkutil::createImage(physicalDevice,device,imageInfo,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Attachments,colorImage,colorMemory);
+            colorView=vkutil::createImageView(device,colorImage,colorFormat,VK_IMAGE_ASPECT_COLOR_BIT,1);
+
+            imageInfo.format=depthFormat;
+            imageInfo.usage=VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            vkutil::createImage(physicalDevice,device,imageInfo,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Attachments,depthImage,depthMemory);
+            depthView=vkutil::createImageView(device,depthImage,depthFormat,VK_IMAGE_ASPECT_DEPTH_BIT,1);
+
+            VkAttachmentDescription attachments[2]{};
+            {
+                attachments[0].format=colorFormat;
+                attachments[0].samples=VK_SAMPLE_COUNT_1_BIT;
+                attachments[0].loadOp=VK_ATTACHMENT_LOAD_OP_CLEAR;
+                attachments[0].storeOp=VK_ATTACHMENT_STORE_OP_STORE;
+                attachments[0].stencilLoadOp=VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                attachments[0].stencilStoreOp=VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                attachments[0].initialLayout=VK_IMAGE_LAYOUT_UNDEFINED;
+                attachments[0].finalLayout=VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                attachments[1].format=depthFormat;
+                attachments[1].samples=VK_SAMPLE_COUNT_1_BIT;
+                attachments[1].loadOp=VK_ATTACHMENT_LOAD_OP_CLEAR;
+                attachments[1].storeOp=VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                attachments[1].stencilLoadOp=VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                attachments[1].stencilStoreOp=VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                attachments[1].initialLayout=VK_IMAGE_LAYOUT_UNDEFINED;
+                attachments[1].finalLayout=VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            }
+            VkAttachmentReference colorReference{0,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+            VkAttachmentReference depthReference{1,VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+            VkSubpassDescription subpass{};
+            {
+                subpass.pipelineBindPoint=VK_PIPELINE_BIND_POINT_GRAPHICS;
+                subpass.colorAttachmentCount=1;
+                subpass.pColorAttachments=&colorReference;
+                subpass.pDepthStencilAttachment=&depthReference;
+            }
+            //all frames in flight share the attachments, the previous frame's writes have to finish first
+            VkSubpassDependency dependency{};
+            {
+                dependency.srcSubpass=VK_SUBPASS_EXTERNAL;
+                dependency.dstSubpass=0;
+                dependency.srcStageMask=VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+                dependency.srcAccessMask=VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                dependency.dstStageMask=VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+                dependency.dstAccessMask=VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            }
+            VkRenderPassCreateInfo renderPassInfo{};
+            {
+                renderPassInfo.sType=VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+                renderPassInfo.attachmentCount=2;
+                renderPassInfo.pAttachments=attachments;
+                renderPassInfo.subpassCount=1;
+                renderPassInfo.pSubpasses=&subpass;
+                renderPassInfo.dependencyCount=1;
+                renderPassInfo.pDependencies=&dependency;
+            }
+            if(vkCreateRenderPass(device,&renderPassInfo,nullptr,&renderPass)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create render pass!");
+            }
+
+            VkImageView views[]={colorView,depthView};
+            VkFramebufferCreateInfo framebufferInfo{};
+            {
+                framebufferInfo.sType=VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+                framebufferInfo.renderPass=renderPass;
+                framebufferInfo.attachmentCount=2;
+                framebufferInfo.pAttachments=views;
+                framebufferInfo.width=extent.width;
+                framebufferInfo.height=extent.height;
+                framebufferInfo.layers=1;
+            }
+            if(vkCreateFramebuffer(device,&framebufferInfo,nullptr,&framebuffer)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create framebuffer!");
+            }
+        }
+
+        VkShaderModule loadShader(const std::string& fileName){
+            std::ifstream file(shaderDirectory+"/"+fileName,std::ios::ate | std::ios::binary);
+            if(!file.is_open()){
+                throw std::runtime_error("failed to open file "+shaderDirectory+"/"+fileName+"!");
+            }
+            std::vector<char> code(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(code.data(),code.size());
+
+            VkShaderModuleCreateInfo createInfo{};
+            {
+                createInfo.sType=VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+                createInfo.codeSize=code.size();
+                createInfo.pCode=reinterpret_cast<const uint32_t*>(code.data());
+            }
+            VkShaderModule module;
+            if(vkCreateShaderModule(device,&createInfo,nullptr,&module)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create shader module!");
+            }
+            return module;
+        }
+
+        //The lit variant draws the same grid through a perspective camera and shades it with the clustered lights.
+        void createPipeline(VertexFormat format, bool lit){
+
+            VkShaderModule vertModule=loadShader(lit ? "bench_lit.vert.spv" : "bench.vert.spv");
+            VkShaderModule fragModule=loadShader(lit ? "bench_lit.frag.spv" : "bench.frag.spv");
+
+            VkPipelineShaderStageCreateInfo stages[2]{};
+            {
+                stages[0].sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                stages[0].stage=VK_SHADER_STAGE_VERTEX_BIT;
+                stages[0].module=vertModule;
+                stages[0].pName="main";
+                stages[1].sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                stages[1].stage=VK_SHADER_STAGE_FRAGMENT_BIT;
+                stages[1].module=fragModule;
+                stages[1].pName="main";
+            }
+
+            VkVertexInputBindingDescription binding{0,vertexStride(format),VK_VERTEX_INPUT_RATE_VERTEX};
+            std::vector<VkVertexInputAttributeDescription> attributes=vertexAttributes(format);
+            VkPipelineVertexInputStateCreateInfo vertexInput{};
+            {
+                vertexInput.sType=VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+                vertexInput.vertexBindingDescriptionCount=1;
+                vertexInput.pVertexBindingDescriptions=&binding;
+                vertexInput.vertexAttributeDescriptionCount=static_cast<uint32_t>(attributes.size());
+                vertexInput.pVertexAttributeDescriptions=attributes.data();
+            }
+            VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+            {
+                inputAssembly.sType=VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+                inputAssembly.topology=VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+            }
+            VkViewport viewport{0.0f,0.0f,static_cast<float>(extent.width),static_cast<float>(extent.height),0.0f,1.0f};
+            VkRect2D scissor{{0,0},extent};
+            VkPipelineViewportStateCreateInfo viewportState{};
+            {
+                viewportState.sType=VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+                viewportState.viewportCount=1;
+                viewportState.pViewports=&viewport;
+                viewportState.scissorCount=1;
+                viewportState.pScissors=&scissor;
+            }
+            VkPipelineRasterizationStateCreateInfo rasterizer{};
+            {
+                rasterizer.sType=VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+                rasterizer.polygonMode=VK_POLYGON_MODE_FILL;
+                rasterizer.cullMode=VK_CULL_MODE_NONE;
+                rasterizer.frontFace=VK_FRONT_FACE_COUNTER_CLOCKWISE;
+                rasterizer.lineWidth=1.0f;
+            }
+            VkPipelineMultisampleStateCreateInfo multisampling{};
+            {
+                multisampling.sType=VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+                multisampling.rasterizationSamples=VK_SAMPLE_COUNT_1_BIT;
+            }
+            VkPipelineDepthStencilStateCreateInfo depthStencil{};
+            {
+                depthStencil.sType=VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+                depthStencil.depthTestEnable=VK_TRUE;
+                depthStencil.depthWriteEnable=VK_TRUE;
+                depthStencil.depthCompareOp=VK_COMPARE_OP_LESS;
+            }
+            VkPipelineColorBlendAttachmentState blendAttachment{};
+            {
+                blendAttachment.colorWriteMask=VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+            }
+            VkPipelineColorBlendStateCreateInfo colorBlend{};
+            {
+                colorBlend.sType=VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+                colorBlend.attachmentCount=1;
+                colorBlend.pAttachments=&blendAttachment;
+            }
+
+            VkPushConstantRange pushConstant{VK_SHADER_STAGE_VERTEX_BIT,0,sizeof(float)*4};
+            VkDescriptorSetLayout lightingLayout=lighting.getDescriptorSetLayout();
+            VkPipelineLayoutCreateInfo layoutInfo{};
+            {
+                layoutInfo.sType=VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                layoutInfo.setLayoutCount= lit ? 1 : 0;
+                layoutInfo.pSetLayouts= lit ? &lightingLayout : nullptr;
+                layoutInfo.pushConstantRangeCount=1;
+                layoutInfo.pPushConstantRanges=&pushConstant;
+            }
+            if(vkCreatePipelineLayout(device,&layoutInfo,nullptr,&pipelineLayout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create pipeline layout!");
+            }
+
+            VkGraphicsPipelineCreateInfo pipelineInfo{};
+            {
+                pipelineInfo.sType=VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+                pipelineInfo.stageCount=2;
+                pipelineInfo.pStages=stages;
+                pipelineInfo.pVertexInputState=&vertexInput;
+                pipelineInfo.pInputAssemblyState=&inputAssembly;
+                pipelineInfo.pViewportState=&viewportState;
+                pipelineInfo.pRasterizationState=&rasterizer;
+                pipelineInfo.pMultisampleState=&multisampling;
+                pipelineInfo.pDepthStencilState=&depthStencil;
+                pipelineInfo.pColorBlendState=&colorBlend;
+                pipelineInfo.layout=pipelineLayout;
+                pipelineInfo.renderPass=renderPass;
+                pipelineInfo.subpass=0;
+            }
+            VkResult result=vkCreateGraphicsPipelines(device,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&pipeline);
+            vkDestroyShaderModule(device,vertModule,nullptr);
+            vkDestroyShaderModule(device,fragModule,nullptr);
+            if(result!=VK_SUCCESS){
+                throw std::runtime_error("failed to create graphics pipeline!");
+            }
+        }
+
+        void createFrames(uint32_t count){
+            frames.resize(count);
+            for(Frame& frame: frames){
+                VkCommandBufferAllocateInfo allocateInfo{};
+                {
+                    allocateInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                    allocateInfo.commandPool=commandPool;
+                    allocateInfo.level=VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                    allocateInfo.commandBufferCount=1;
+                }
+                if(vkAllocateCommandBuffers(device,&allocateInfo,&frame.commandBuffer)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to allocate command buffers!");
+                }
+                VkFenceCreateInfo fenceInfo{};
+                {
+                    fenceInfo.sType=VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+                    fenceInfo.flags=VK_FENCE_CREATE_SIGNALED_BIT;
+                }
+                if(vkCreateFence(device,&fenceInfo,nullptr,&frame.fence)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to create fence!");
+                }
+            }
+        }
+
+        //Lights in a box around the plane the lit pipeline draws the objects on, with ranges shrinking with the count
+        //so every point is reached by a few of them like in the app. The camera looks down -z from the origin.
+        void createLighting(const BenchmarkConfig& config){
+            std::ifstream file(shaderDirectory+"/light_cluster.comp.spv",std::ios::ate | std::ios::binary);
+            if(!file.is_open()){
+                throw std::runtime_error("failed to open file "+shaderDirectory+"/light_cluster.comp.spv!");
+            }
+            std::vector<char> code(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(code.data(),code.size());
+            lighting.init(physicalDevice,device,deletionQueue,config.lights,config.framesInFlight,code);
+
+            const float halfWidth=2.0f, halfDepth=0.6f, planeDepth=3.0f;
+            const float volume=(2.0f*halfWidth)*(2.0f*halfWidth)*(2.0f*halfDepth);
+            const float lightsPerPoint=4.0f;
+            float range=std::cbrt(3.0f*lightsPerPoint*volume/(4.0f*3.14159265f*config.lights));
+            std::mt19937 random(7);
+            std::uniform_real_distribution<float> unit(0.0f,1.0f);
+            const float cosOuter=std::cos(35.0f*3.14159265f/180.0f), cosInner=std::cos(25.0f*3.14159265f/180.0f);
+            lights.resize(config.lights);
+            for(uint32_t i=0;i<config.lights;++i){
+                bool spot=i%4==3;
+                ClusteredLighting::Light light{
+                    {halfWidth*(unit(random)*2.0f-1.0f),halfWidth*(unit(random)*2.0f-1.0f),-planeDepth+halfDepth*(unit(random)*2.0f-1.0f),spot ? range*1.5f : range},
+                    {unit(random),unit(random),unit(random),2.0f},
+                    {0.0f,0.0f,-1.0f,spot ? cosOuter : ClusteredLighting::pointLight},
+                    {cosInner,0.0f,0.0f,0.0f}
+                };
+                lights[i]=light;
+            }
+
+            //identity view, perspective projection seeing +-2 at the plane's depth
+            const float nearPlane=0.1f, farPlane=10.0f, focal=planeDepth/halfWidth;
+            std::fill(view,view+16,0.0f);
+            std::fill(projection,projection+16,0.0f);
+            view[0]=view[5]=view[10]=view[15]=1.0f;
+            projection[0]=focal;
+            projection[5]=focal;
+            projection[10]=farPlane/(nearPlane-farPlane);
+            projection[11]=-1.0f;
+            projection[14]=nearPlane*farPlane/(nearPlane-farPlane);
+            this->nearPlane=nearPlane;
+            this->farPlane=farPlane;
+        }
+
+        //One grid mesh shared by all objects, with triangles/objects triangles each.
+        void buildMesh(const BenchmarkConfig& config, std::vector<uint8_t>& vertexData, std::vector<uint32_t>& indexData){
+            uint32_t trianglesPerObject=std::max(1u,config.triangles/std::max(1u,config.objects));
+            uint32_t cells=(trianglesPerObject+1)/2;
+            uint32_t side=static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(cells))));
+            uint32_t stride=vertexStride(config.vertexFormat);
+
+            vertexData.assign(static_cast<size_t>(side+1)*(side+1)*stride,0);
+            for(uint32_t y=0;y<=side;++y){
+                for(uint32_t x=0;x<=side;++x){
+                    float u=static_cast<float>(x)/side;
+                    float v=static_cast<float>(y)/side;
+                    float position[3]={u*2.0f-1.0f,v*2.0f-1.0f,0.5f*std::sin(u*6.28f)*std::cos(v*6.28f)};
+                    uint8_t* vertex=&vertexData[(static_cast<size_t>(y)*(side+1)+x)*stride];
+                    if(config.vertexFormat==VertexFormat::Float32){
+                        float attributes[8]={position[0],position[1],position[2],0.0f,0.0f,1.0f,u,v};
+                        memcpy(vertex,attributes,sizeof(attributes));
+                    }
+                    else{
+                        int16_t packedPosition[4]={snorm16(position[0]),snorm16(position[1]),snorm16(position[2]),32767};
+                        int8_t packedNormal[4]={0,0,127,0};
+                        uint16_t packedUv[2]={static_cast<uint16_t>(u*65535.0f),static_cast<uint16_t>(v*65535.0f)};
+                        memcpy(vertex,packedPosition,8);
+                        memcpy(vertex+8,packedNormal,4);
+                        memcpy(vertex+12,packedUv,4);
+                    }
+                }
+            }
+
+            indexData.clear();
+            for(uint32_t cell=0;cell<side*side && indexData.size()<static_cast<size_t>(trianglesPerObject)*3;++cell){
+                uint32_t x=cell%side, y=cell/side;
+                uint32_t i0=y*(side+1)+x, i1=i0+1, i2=i0+side+1, i3=i2+1;
+                uint32_t quad[6]={i0,i1,i2,i2,i1,i3};
+                indexData.insert(indexData.end(),quad,quad+6);
+            }
+            indexData.resize(static_cast<size_t>(trianglesPerObject)*3,0);
+            indexCount=static_cast<uint32_t>(indexData.size());
+        }
+
+        static int16_t snorm16(float value){
+            return static_cast<int16_t>(std::round(std::max(-1.0f,std::min(1.0f,value))*32767.0f));
+        }
+
+        //Copies the mesh into device local buffers through a staging buffer, returns the seconds it took.
+        double upload(const std::vector<uint8_t>& vertexData, const std::vector<uint32_t>& indexData, bool create){
+            VkDeviceSize vertexSize=vertexData.size();
+            VkDeviceSize indexSize=indexData.size()*sizeof(uint32_t);
+            if(create){
+                vkutil::createBuffer(physicalDevice,device,vertexSize,VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Geometry,vertexBuffer,vertexMemory);
+                vkutil::createBuffer(physicalDevice,device,indexSize,VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Geometry,indexBuffer,indexMemory);
+            }
+
+            auto start=std::chrono::steady_clock::now();
+            VkBuffer staging;
+            VkDeviceMemory stagingMemory;
+            vkutil::createBuffer(physicalDevice,device,vertexSize+indexSize,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,MemoryCategory::Staging,staging,stagingMemory);
+            void* mapped;
+            vkMapMemory(device,stagingMemory,0,VK_WHOLE_SIZE,0,&mapped);
+            memcpy(mapped,vertexData.data(),vertexSize);
+            memcpy(static_cast<uint8_t*>(mapped)+vertexSize,indexData.data(),indexSize);
+            vkUnmapMemory(device,stagingMemory);
+
+            VkCommandBuffer commandBuffer=beginSingleTimeCommands();
+            VkBufferCopy vertexCopy{0,0,vertexSize};
+            VkBufferCopy indexCopy{vertexSize,0,indexSize};
+            vkCmdCopyBuffer(commandBuffer,staging,vertexBuffer,1,&vertexCopy);
+            vkCmdCopyBuffer(commandBuffer,staging,indexBuffer,1,&indexCopy);
+            endSingleTimeCommands(commandBuffer);
+            double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+            vkDestroyBuffer(device,staging,nullptr);
+            vkutil::freeMemory(device,stagingMemory,nullptr);
+            return seconds;
+        }
+
+        VkCommandBuffer beginSingleTimeCommands(){
+            VkCommandBufferAllocateInfo allocateInfo{};
+            {
+                allocateInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocateInfo.commandPool=commandPool;
+                allocateInfo.level=VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocateInfo.commandBufferCount=1;
+            }
+            VkCommandBuffer commandBuffer;
+            vkAllocateCommandBuffers(device,&allocateInfo,&commandBuffer);
+            VkCommandBufferBeginInfo beginInfo{};
+            {
+                beginInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            }
+            vkBeginCommandBuffer(commandBuffer,&beginInfo);
+            return commandBuffer;
+        }
+
+        void endSingleTimeCommands(VkCommandBuffer commandBuffer){
+            vkEndCommandBuffer(commandBuffer);
+            VkSubmitInfo submitInfo{};
+            {
+                submitInfo.sType=VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount=1;
+                submitInfo.pCommandBuffers=&commandBuffer;
+            }
+            vkQueueSubmit(queue,1,&submitInfo,VK_NULL_HANDLE);
+            vkQueueWaitIdle(queue);
+            vkFreeCommandBuffers(device,commandPool,1,&commandBuffer);
+        }
+
+        void renderFrame(const BenchmarkConfig& config, uint32_t frameIndex){
+            uint32_t slot=frameIndex%frames.size();
+            Frame& frame=frames[slot];
+            vkWaitForFences(device,1,&frame.fence,VK_TRUE,UINT64_MAX);
+            vkResetFences(device,1,&frame.fence);
+            if(config.lights>0){
+                lighting.collect(slot);
+                ClusteredLighting::Light* frameLights=lighting.update(slot,view,projection,nearPlane,farPlane,extent,config.lights);
+                memcpy(frameLights,lights.data(),sizeof(ClusteredLighting::Light)*lights.size());
+            }
+            vkResetCommandBuffer(frame.commandBuffer,0);
+
+            VkCommandBufferBeginInfo beginInfo{};
+            {
+                beginInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            }
+            if(vkBeginCommandBuffer(frame.commandBuffer,&beginInfo)!=VK_SUCCESS){
+                throw std::runtime_error("failed to begin recording command buffer!");
+            }
+
+            if(config.lights>0){
+                //the binning's cluster lists and view space lights are read by the fragment shader
+                lighting.bin(frame.commandBuffer,slot);
+                VkMemoryBarrier memoryBarrier{};
+                {
+                    memoryBarrier.sType=VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                    memoryBarrier.srcAccessMask=VK_ACCESS_SHADER_WRITE_BIT;
+                    memoryBarrier.dstAccessMask=VK_ACCESS_SHADER_READ_BIT;
+                }
+                vkCmdPipelineBarrier(frame.commandBuffer,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,0,1,&memoryBarrier,0,nullptr,0,nullptr);
+            }
+
+            VkClearValue clearValues[2]{};
+            clearValues[0].color={{0.0f,0.0f,0.0f,1.0f}};
+            clearValues[1].depthStencil={1.0f,0};
+            VkRenderPassBeginInfo renderPassInfo{};
+            {
+                renderPassInfo.sType=VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                renderPassInfo.renderPass=renderPass;
+                renderPassInfo.framebuffer=framebuffer;
+                renderPassInfo.renderArea.offset={0,0};
+                renderPassInfo.renderArea.extent=extent;
+                renderPassInfo.clearValueCount=2;
+                renderPassInfo.pClearValues=clearValues;
+            }
+            vkCmdBeginRenderPass(frame.commandBuffer,&renderPassInfo,VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBindPipeline(frame.commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,pipeline);
+            if(config.lights>0){
+                VkDescriptorSet descriptorSet=lighting.getDescriptorSet(slot);
+                vkCmdBindDescriptorSets(frame.commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,pipelineLayout,0,1,&descriptorSet,0,nullptr);
+            }
+            VkDeviceSize offset=0;
+            vkCmdBindVertexBuffers(frame.commandBuffer,0,1,&vertexBuffer,&offset);
+            vkCmdBindIndexBuffer(frame.commandBuffer,indexBuffer,0,VK_INDEX_TYPE_UINT32);
+
+            //objects on a square grid covering the target, slowly drifting so no frame is identical
+            uint32_t columns=static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(config.objects))));
+            float cell=2.0f/columns;
+            float drift=0.001f*static_cast<float>(frameIndex%100);
+            for(uint32_t i=0;i<config.objects;++i){
+                float offsetScale[4]={-1.0f+cell*(i%columns+0.5f)+drift,-1.0f+cell*(i/columns+0.5f),cell*0.45f,0.0f};
+                vkCmdPushConstants(frame.commandBuffer,pipelineLayout,VK_SHADER_STAGE_VERTEX_BIT,0,sizeof(offsetScale),offsetScale);
+                vkCmdDrawIndexed(frame.commandBuffer,indexCount,1,0,0,0);
+            }
+            vkCmdEndRenderPass(frame.commandBuffer);
+
+            if(vkEndCommandBuffer(frame.commandBuffer)!=VK_SUCCESS){
+                throw std::runtime_error("failed to record command buffer!");
+            }
+            VkSubmitInfo submitInfo{};
+            {
+                submitInfo.sType=VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount=1;
+                submitInfo.pCommandBuffers=&frame.commandBuffer;
+            }
+            if(vkQueueSubmit(queue,1,&submitInfo,frame.fence)!=VK_SUCCESS){
+                throw std::runtime_error("failed to submit draw command buffer!");
+            }
+        }
+
+        void waitIdle(){
+            vkDeviceWaitIdle(device);
+        }
+
+        void destroy(){
+            if(device!=VK_NULL_HANDLE){
+                vkDeviceWaitIdle(device);
+                for(Frame& frame: frames){
+                    vkDestroyFence(device,frame.fence,nullptr);
+                }
+                frames.clear();
+                lighting.cleanup();
+                deletionQueue.flushAll();
+                vkDestroyBuffer(device,vertexBuffer,nullptr);
+                vkDestroyBuffer(device,indexBuffer,nullptr);
+                vkutil::freeMemory(device,vertexMemory,nullptr);
+                vkutil::freeMemory(device,indexMemory,nullptr);
+                vkDestroyPipeline(device,pipeline,nullptr);
+                vkDestroyPipelineLayout(device,pipelineLayout,nullptr);
+                vkDestroyFramebuffer(device,framebuffer,nullptr);
+                vkDestroyRenderPass(device,renderPass,nullptr);
+                vkDestroyImageView(device,colorView,nullptr);
+                vkDestroyImageView(device,depthView,nullptr);
+                vkDestroyImage(device,colorImage,nullptr);
+                vkDestroyImage(device,depthImage,nullptr);
+                vkutil::freeMemory(device,colorMemory,nullptr);
+                vkutil::freeMemory(device,depthMemory,nullptr);
+                vkDestroyCommandPool(device,commandPool,nullptr);
+                vkDestroyDevice(device,nullptr);
+            }
+            if(instance!=VK_NULL_HANDLE){
+                vkDestroyInstance(instance,nullptr);
+            }
+            std::string name=deviceName;
+            *this=BenchmarkRenderer(shaderDirectory,preferredDevice);
+            deviceName=name;
+        }
+
+        std::string shaderDirectory;
+        std::string preferredDevice;
+        std::string deviceName;
+
+        VkInstance instance=VK_NULL_HANDLE;
+        VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+        VkDevice device=VK_NULL_HANDLE;
+        uint32_t queueFamily=0;
+        VkQueue queue=VK_NULL_HANDLE;
+        VkCommandPool commandPool=VK_NULL_HANDLE;
+
+        static constexpr VkExtent2D extent{512,512};
+        static constexpr VkFormat colorFormat=VK_FORMAT_R8G8B8A8_UNORM;
+        VkFormat depthFormat=VK_FORMAT_UNDEFINED;
+        VkImage colorImage=VK_NULL_HANDLE;
+        VkDeviceMemory colorMemory=VK_NULL_HANDLE;
+        VkImageView colorView=VK_NULL_HANDLE;
+        VkImage depthImage=VK_NULL_HANDLE;
+        VkDeviceMemory depthMemory=VK_NULL_HANDLE;
+        VkImageView depthView=VK_NULL_HANDLE;
+        VkRenderPass renderPass=VK_NULL_HANDLE;
+        VkFramebuffer framebuffer=VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout=VK_NULL_HANDLE;
+        VkPipeline pipeline=VK_NULL_HANDLE;
+        std::vector<Frame> frames;
+
+        DeletionQueue deletionQueue;
+        ClusteredLighting lighting;
+        std::vector<ClusteredLighting::Light> lights;
+        float view[16]={};
+        float projection[16]={};
+        float nearPlane=0.0f;
+        float farPlane=0.0f;
+
+        VkBuffer vertexBuffer=VK_NULL_HANDLE;
+        VkDeviceMemory vertexMemory=VK_NULL_HANDLE;
+        VkBuffer indexBuffer=VK_NULL_HANDLE;
+        VkDeviceMemory indexMemory=VK_NULL_HANDLE;
+        uint32_t indexCount=0;
+};
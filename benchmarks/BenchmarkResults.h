@@ -0,0 +1,176 @@
+#pragma once
+
+#include "BenchmarkRenderer.h"
+
+#include<fstream>
+#include<iostream>
+#include<map>
+#include<regex>
+#include<sstream>
+#include<string>
+#include<vector>
+
+//Result files are JSON with one result object per line, which keeps them diffable and lets the baseline be read
+//back without a JSON library:
+//  {"device": "llvmpipe (LLVM 15.0.7, 256 bits)", "results": [
+//    {"name": "objects_1000", "triangles": 100000, ..., "cpuFrameMs": 4.2, "p95FrameMs": 4.9, "uploadMBps": 812, "startupMs": 61}
+//  ]}
+struct BaselineEntry{
+    std::map<std::string,double> metrics;
+};
+
+struct Baseline{
+    std::string device;
+    std::map<std::string,BaselineEntry> entries;
+};
+
+namespace benchmark{
+
+    inline std::string resultLine(const BenchmarkResult& result){
+        std::ostringstream line;
+        line<<"    {\"name\": \""<<result.config.name<<"\", \"triangles\": "<<result.config.triangles<<", \"objects\": "<<result.config.objects
+            <<", \"vertexFormat\": \""<<vertexFormatName(result.config.vertexFormat)<<"\", \"framesInFlight\": "<<result.config.framesInFlight
+            <<", \"lights\": "<<result.config.lights;
+        if(result.skipped){
+            line<<", \"skipped\": \""<<result.skipReason<<"\"}";
+            return line.str();
+        }
+        line<<", \"cpuFrameMs\": "<<result.cpuFrameMs<<", \"p95FrameMs\": "<<result.p95FrameMs<<", \"uploadMBps\": "<<result.uploadMBps
+            <<", \"startupMs\": "<<result.startupMs<<"}";
+        return line.str();
+    }
+
+    inline bool writeResults(const std::string& path, const std::string& device, const std::vector<std::string>& lines){
+        std::ofstream file(path);
+        if(!file.is_open()){
+            std::cerr<<"failed to write "<<path<<std::endl;
+            return false;
+        }
+        file<<"{\"device\": \""<<device<<"\", \"results\": [\n";
+        for(size_t i=0;i<lines.size();++i){
+            file<<lines[i]<<(i+1<lines.size() ? ",\n" : "\n");
+        }
+        file<<"]}\n";
+        return true;
+    }
+
+    inline Baseline readBaseline(const std::string& path){
+        Baseline baseline;
+        std::ifstream file(path);
+        if(!file.is_open()){
+            return baseline;
+        }
+        const std::regex field("\"(\\w+)\":\\s*(\"([^\"]*)\"|[-+0-9.eE]+)");
+        std::string line;
+        while(std::getline(file,line)){
+            std::string name;
+            BaselineEntry entry;
+            for(auto match=std::sregex_iterator(line.begin(),line.end(),field);match!=std::sregex_iterator();++match){
+                const std::string key=(*match)[1];
+                if((*match)[3].matched){
+                    if(key=="name"){
+                        name=(*match)[3];
+                    }
+                    else if(key=="device"){
+                        baseline.device=(*match)[3];
+                    }
+                }
+                else{
+                    entry.metrics[key]=std::stod((*match)[2]);
+                }
+            }
+            if(!name.empty()){
+                baseline.entries[name]=entry;
+            }
+        }
+        return baseline;
+    }
+
+    //Replaces the entries of the given results in the baseline file, entries of other sweeps are kept.
+    inline bool updateBaseline(const std::string& path, const std::string& device, const std::vector<BenchmarkResult>& results){
+        std::map<std::string,std::string> lines;
+        {
+            std::ifstream file(path);
+            std::string line;
+            const std::regex name("\"name\":\\s*\"([^\"]*)\"");
+            std::smatch match;
+            while(std::getline(file,line)){
+                if(std::regex_search(line,match,name)){
+                    if(!line.empty() && line.back()==','){
+                        line.pop_back();
+                    }
+                    lines[match[1]]=line;
+                }
+            }
+        }
+        for(const BenchmarkResult& result: results){
+            if(!result.skipped){
+                lines[result.config.name]=resultLine(result);
+            }
+        }
+        std::vector<std::string> sorted;
+        for(const auto& [name,line]: lines){
+            sorted.push_back(line);
+        }
+        return writeResults(path,device,sorted);
+    }
+
+    //Numbers from another device say nothing about this one, so a missing baseline or one recorded elsewhere is not
+    //compared against at all.
+    inline bool comparable(const Baseline& baseline, const std::string& device){
+        if(baseline.entries.empty()){
+            std::cout<<"no baseline to compare against, record one with --update-baseline"<<std::endl;
+            return false;
+        }
+        if(baseline.device!=device){
+            std::cout<<"baseline recorded on "<<(baseline.device.empty() ? "an unknown device" : baseline.device)
+                     <<", not on "<<device<<", record one with --update-baseline"<<std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    //A metric regresses when it is worse than the baseline by more than tolerance (0.25 = 25%). Returns the number of
+    //regressions, results without a baseline entry only get reported.
+    inline int compare(const Baseline& baseline, const std::vector<BenchmarkResult>& results, double tolerance){
+
+        struct Metric{
+            const char* name;
+            bool higherIsWorse;
+            double (*value)(const BenchmarkResult&);
+        };
+        const Metric metrics[]={
+            {"cpuFrameMs",true,[](const BenchmarkResult& r){ return r.cpuFrameMs; }},
+            {"p95FrameMs",true,[](const BenchmarkResult& r){ return r.p95FrameMs; }},
+            {"startupMs",true,[](const BenchmarkResult& r){ return r.startupMs; }},
+            {"uploadMBps",false,[](const BenchmarkResult& r){ return r.uploadMBps; }}
+        };
+
+        int regressions=0;
+        for(const BenchmarkResult& result: results){
+            if(result.skipped){
+                continue;
+            }
+            auto entry=baseline.entries.find(result.config.name);
+            if(entry==baseline.entries.end()){
+                std::cout<<result.config.name<<": no baseline entry"<<std::endl;
+                continue;
+            }
+            for(const Metric& metric: metrics){
+                auto expected=entry->second.metrics.find(metric.name);
+                if(expected==entry->second.metrics.end() || expected->second<=0.0){
+                    continue;
+                }
+                double value=metric.value(result);
+                double change=value/expected->second-1.0;
+                bool regressed= metric.higherIsWorse ? change>tolerance : -change>tolerance;
+                if(regressed){
+                    ++regressions;
+                    std::cout<<"REGRESSION "<<result.config.name<<" "<<metric.name<<": "<<value<<" vs baseline "<<expected->second
+                             <<" ("<<(change>0 ? "+" : "")<<change*100.0<<"%)"<<std::endl;
+                }
+            }
+        }
+        return regressions;
+    }
+}
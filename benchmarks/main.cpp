@@ -0,0 +1,174 @@
+#include "BenchmarkRenderer.h"
+#include "BenchmarkResults.h"
+
+#include<cstdlib>
+#include<cstring>
+#include<iomanip>
+#include<iostream>
+#include<string>
+#include<vector>
+
+#ifndef BENCHMARK_SHADER_DIR
+#define BENCHMARK_SHADER_DIR "shaders"
+#endif
+
+//ctest skips a test that exits with this code, used when there is no Vulkan device to run on
+static const int skipReturnCode=77;
+
+//Every sweep varies one parameter of the default scene: 100k triangles in 100 objects, float vertices, 2 frames in
+//flight and no lights.
+static std::vector<BenchmarkConfig> makeSweep(const std::string& sweep){
+    std::vector<BenchmarkConfig> configs;
+    if(sweep=="triangles" || sweep=="all"){
+        for(uint32_t triangles: {10000u,100000u,1000000u}){
+            BenchmarkConfig config;
+            config.name="triangles_"+std::to_string(triangles);
+            config.triangles=triangles;
+            configs.push_back(config);
+        }
+    }
+    if(sweep=="objects" || sweep=="all"){
+        for(uint32_t objects: {1u,100u,1000u,10000u}){
+            BenchmarkConfig config;
+            config.name="objects_"+std::to_string(objects);
+            config.objects=objects;
+            configs.push_back(config);
+        }
+    }
+    if(sweep=="vertex-format" || sweep=="all"){
+        for(VertexFormat format: {VertexFormat::Float32,VertexFormat::Packed}){
+            BenchmarkConfig config;
+            config.name=std::string("format_")+vertexFormatName(format);
+            config.vertexFormat=format;
+            configs.push_back(config);
+        }
+    }
+    if(sweep=="frames-in-flight" || sweep=="all"){
+        for(uint32_t framesInFlight: {1u,2u,3u}){
+            BenchmarkConfig config;
+            config.name="frames_in_flight_"+std::to_string(framesInFlight);
+            config.framesInFlight=framesInFlight;
+            configs.push_back(config);
+        }
+    }
+    if(sweep=="lights" || sweep=="all"){
+        for(uint32_t lights: {10u,100u,1000u,10000u}){
+            BenchmarkConfig config;
+            config.name="lights_"+std::to_string(lights);
+            config.lights=lights;
+            configs.push_back(config);
+        }
+    }
+    return configs;
+}
+
+static void printUsage(){
+    std::cout<<"usage: VulkanBenchmarks [--sweep triangles|objects|vertex-format|frames-in-flight|lights|all] [--frames n]\n"
+               "                        [--out results.json] [--baseline baseline.json] [--tolerance 0.25]\n"
+               "                        [--update-baseline] [--gpu name] [--shaders dir]"<<std::endl;
+}
+
+int main(int argc, char** argv){
+
+    std::string sweep="all";
+    std::string outPath;
+    std::string baselinePath;
+    std::string preferredDevice;
+    std::string shaderDirectory=BENCHMARK_SHADER_DIR;
+    uint32_t frames=200;
+    double tolerance=0.25;
+    bool update=false;
+
+    for(int i=1;i<argc;++i){
+        if(strcmp(argv[i],"--sweep")==0 && i+1<argc){
+            sweep=argv[++i];
+        }
+        else if(strcmp(argv[i],"--frames")==0 && i+1<argc){
+            frames=static_cast<uint32_t>(std::max(1,std::atoi(argv[++i])));
+        }
+        else if(strcmp(argv[i],"--out")==0 && i+1<argc){
+            outPath=argv[++i];
+        }
+        else if(strcmp(argv[i],"--baseline")==0 && i+1<argc){
+            baselinePath=argv[++i];
+        }
+        else if(strcmp(argv[i],"--tolerance")==0 && i+1<argc){
+            tolerance=std::atof(argv[++i]);
+        }
+        else if(strcmp(argv[i],"--update-baseline")==0){
+            update=true;
+        }
+        else if(strcmp(argv[i],"--gpu")==0 && i+1<argc){
+            preferredDevice=argv[++i];
+        }
+        else if(strcmp(argv[i],"--shaders")==0 && i+1<argc){
+            shaderDirectory=argv[++i];
+        }
+        else{
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<BenchmarkConfig> configs=makeSweep(sweep);
+    if(configs.empty()){
+        std::cerr<<"unknown sweep "<<sweep<<std::endl;
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    BenchmarkRenderer renderer(shaderDirectory,preferredDevice);
+    std::vector<BenchmarkResult> results;
+    std::vector<std::string> lines;
+    try{
+        std::cout<<std::left<<std::setw(24)<<"benchmark"<<std::right<<std::setw(12)<<"frame ms"<<std::setw(12)<<"p95 ms"
+                 <<std::setw(14)<<"upload MB/s"<<std::setw(12)<<"startup ms"<<std::endl;
+        for(const BenchmarkConfig& config: configs){
+            BenchmarkResult result=renderer.run(config,frames);
+            std::cout<<std::left<<std::setw(24)<<config.name<<std::right<<std::fixed<<std::setprecision(3);
+            if(result.skipped){
+                std::cout<<"  skipped: "<<result.skipReason<<std::endl;
+            }
+            else{
+                std::cout<<std::setw(12)<<result.cpuFrameMs<<std::setw(12)<<result.p95FrameMs<<std::setprecision(1)
+                         <<std::setw(14)<<result.uploadMBps<<std::setw(12)<<result.startupMs<<std::endl;
+            }
+            results.push_back(result);
+            lines.push_back(benchmark::resultLine(result));
+        }
+    }catch(const NoDeviceError& e){
+        std::cerr<<e.what()<<std::endl;
+        return skipReturnCode;
+    }catch(const std::exception& e){
+        std::cerr<<e.what()<<std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout<<"device: "<<renderer.getDeviceName()<<std::endl;
+
+    if(!outPath.empty() && benchmark::writeResults(outPath,renderer.getDeviceName(),lines)){
+        std::cout<<"results written to "<<outPath<<std::endl;
+    }
+
+    if(baselinePath.empty()){
+        return EXIT_SUCCESS;
+    }
+    if(update){
+        if(!benchmark::updateBaseline(baselinePath,renderer.getDeviceName(),results)){
+            return EXIT_FAILURE;
+        }
+        std::cout<<"baseline updated: "<<baselinePath<<std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    Baseline baseline=benchmark::readBaseline(baselinePath);
+    if(!benchmark::comparable(baseline,renderer.getDeviceName())){
+        return skipReturnCode;
+    }
+    int regressions=benchmark::compare(baseline,results,tolerance);
+    if(regressions>0){
+        std::cout<<regressions<<" metrics regressed by more than "<<tolerance*100.0<<"%"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout<<"no regressions against "<<baselinePath<<std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,17 @@
+#version 450
+
+layout(push_constant) uniform Object {
+    vec4 offsetScale; //xy offset, z scale of the object in clip space
+} object;
+
+//the packed vertex format feeds the same inputs through normalized integer formats
+layout(location=0) in vec3 inPosition;
+layout(location=1) in vec3 inNormal;
+layout(location=2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = vec4(inPosition.xy * object.offsetScale.z + object.offsetScale.xy, inPosition.z * 0.5 + 0.5, 1.0);
+    fragColor = vec3(inTexCoord, inNormal.z * 0.5 + 0.5);
+}
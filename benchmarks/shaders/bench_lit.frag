@@ -0,0 +1,15 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define LIGHTING_SET 0
+#include "clustered_lighting.glsl"
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragViewPosition;
+layout(location = 2) in vec3 fragNormal;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(clusteredLighting(fragViewPosition, normalize(fragNormal), fragColor), 1.0);
+}
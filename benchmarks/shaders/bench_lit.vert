@@ -0,0 +1,29 @@
+#version 450
+
+layout(push_constant) uniform Object {
+    vec4 offsetScale; //xy offset, z scale of the object on the plane
+} object;
+
+//only the camera at the start of the frame buffer of clustered_lighting.glsl
+layout(std430, set = 0, binding = 0) readonly buffer LightingFrame {
+    mat4 view;
+    mat4 projection;
+} lighting;
+
+layout(location=0) in vec3 inPosition;
+layout(location=1) in vec3 inNormal;
+layout(location=2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragViewPosition;
+layout(location = 2) out vec3 fragNormal;
+
+void main() {
+    //the grid of bench.vert on a plane three units in front of the camera
+    vec3 position = vec3((inPosition.xy * object.offsetScale.z + object.offsetScale.xy) * 2.0, inPosition.z * 0.25 - 3.0);
+    vec4 viewPosition = lighting.view * vec4(position, 1.0);
+    gl_Position = lighting.projection * viewPosition;
+    fragViewPosition = viewPosition.xyz;
+    fragNormal = mat3(lighting.view) * inNormal;
+    fragColor = vec3(inTexCoord, 0.5);
+}
@@ -0,0 +1,376 @@
+#pragma once
+
+#include "Lz4.h"
+
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<cstdint>
+#include<cstring>
+#include<map>
+#include<stdexcept>
+#include<string>
+#include<thread>
+#include<vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include<windows.h>
+#else
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#endif
+
+//Asset packs are written offline by the cook tool (tools/cook) and mapped into memory at runtime, so loading a mesh is
+//a lookup in the table of contents and a pointer into the mapping. Layout (native little endian):
+//  header   pack::Header, the checksum covers every byte after it
+//  entries  data regions, each starting at a multiple of pack::alignment
+//  toc      entryCount pack::Entry records
+//Entry data is stored exactly as it is uploaded: vertices in the Vertex layout of the renderer and 16 bit indices.
+//Compressed entries are split into chunks of chunkSize bytes that are LZ4 compressed on their own and listed in a
+//table of pack::Chunk records at chunkTableOffset, so they can be decompressed in parallel.
+namespace pack{
+
+    constexpr char magic[4]={'V','K','P','K'};
+    constexpr uint32_t version=1;
+    constexpr uint64_t alignment=256; //covers the copy and offset alignments the Vulkan spec allows devices to ask for
+
+    enum class EntryType: uint32_t{
+        Vertices=1,
+        Indices=2
+    };
+
+    enum class Compression: uint32_t{
+        None=0,
+        LZ4=1
+    };
+
+    struct Header{
+        char magic[4];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t flags;
+        uint64_t tocOffset;
+        uint64_t fileSize;
+        uint64_t checksum;
+        uint8_t reserved[24];
+    };
+    static_assert(sizeof(Header)==64,"the pack header is part of the file format");
+
+    struct Entry{
+        char name[64]; //zero terminated
+        EntryType type;
+        Compression compression;
+        uint32_t elementSize;
+        uint32_t chunkSize;
+        uint64_t elementCount;
+        uint64_t offset;     //of the data, or of the first chunk when compressed
+        uint64_t storedSize; //bytes in the file
+        uint64_t size;       //bytes after decompression
+        uint64_t chunkTableOffset;
+        uint32_t chunkCount;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(Entry)==128,"the pack table of contents is part of the file format");
+
+    struct Chunk{
+        uint64_t offset; //of the compressed bytes
+        uint32_t storedSize;
+        uint32_t size;
+    };
+    static_assert(sizeof(Chunk)==16,"the pack chunk table is part of the file format");
+
+    //Matches the Vertex of the renderer (position, color, texture coordinate), main.cpp checks that they agree.
+    struct Vertex{
+        float position[3];
+        float color[3];
+        float texCoord[2];
+    };
+    static_assert(sizeof(Vertex)==32,"the pack vertex layout is part of the file format");
+
+    //FNV-1a over 64 bit words with an extra shift to fold the high bits back in. Eight bytes per step keeps the
+    //check at memory speed for packs of a few hundred megabytes.
+    inline uint64_t checksum(const void* data, size_t size){
+        const uint8_t* bytes=static_cast<const uint8_t*>(data);
+        uint64_t value=14695981039346656037ull;
+        size_t i=0;
+        for(;i+sizeof(uint64_t)<=size;i+=sizeof(uint64_t)){
+            uint64_t word;
+            memcpy(&word,bytes+i,sizeof(word));
+            value=(value^word)*1099511628211ull;
+            value^=value>>29;
+        }
+        for(;i<size;++i){
+            value=(value^bytes[i])*1099511628211ull;
+        }
+        return value;
+    }
+
+    inline uint64_t alignUp(uint64_t value){
+        return (value+alignment-1) & ~(alignment-1);
+    }
+}
+
+//Read only mapping of a whole file.
+class MappedFile{
+
+    public:
+        MappedFile()=default;
+        MappedFile(const MappedFile&)=delete;
+        MappedFile& operator=(const MappedFile&)=delete;
+
+        ~MappedFile(){
+            close();
+        }
+
+        void open(const std::string& path){
+            close();
+#ifdef _WIN32
+            file=CreateFileA(path.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+            if(file==INVALID_HANDLE_VALUE){
+                throw std::runtime_error("failed to open "+path+"!");
+            }
+            LARGE_INTEGER fileSize;
+            GetFileSizeEx(file,&fileSize);
+            size=static_cast<size_t>(fileSize.QuadPart);
+            if(size>0){
+                mapping=CreateFileMappingA(file,nullptr,PAGE_READONLY,0,0,nullptr);
+                bytes=mapping ? static_cast<const uint8_t*>(MapViewOfFile(mapping,FILE_MAP_READ,0,0,0)) : nullptr;
+                if(!bytes){
+                    close();
+                    throw std::runtime_error("failed to map "+path+"!");
+                }
+            }
+#else
+            descriptor=::open(path.c_str(),O_RDONLY);
+            if(descriptor<0){
+                throw std::runtime_error("failed to open "+path+"!");
+            }
+            struct stat status;
+            if(fstat(descriptor,&status)!=0){
+                close();
+                throw std::runtime_error("failed to stat "+path+"!");
+            }
+            size=static_cast<size_t>(status.st_size);
+            if(size>0){
+                void* mapped=mmap(nullptr,size,PROT_READ,MAP_PRIVATE,descriptor,0);
+                if(mapped==MAP_FAILED){
+                    close();
+                    throw std::runtime_error("failed to map "+path+"!");
+                }
+                bytes=static_cast<const uint8_t*>(mapped);
+            }
+#endif
+        }
+
+        void close(){
+#ifdef _WIN32
+            if(bytes){
+                UnmapViewOfFile(bytes);
+            }
+            if(mapping){
+                CloseHandle(mapping);
+            }
+            if(file!=INVALID_HANDLE_VALUE){
+                CloseHandle(file);
+            }
+            mapping=nullptr;
+            file=INVALID_HANDLE_VALUE;
+#else
+            if(bytes){
+                munmap(const_cast<uint8_t*>(bytes),size);
+            }
+            if(descriptor>=0){
+                ::close(descriptor);
+            }
+            descriptor=-1;
+#endif
+            bytes=nullptr;
+            size=0;
+        }
+
+        const uint8_t* data() const{
+            return bytes;
+        }
+
+        size_t getSize() const{
+            return size;
+        }
+
+    private:
+        const uint8_t* bytes=nullptr;
+        size_t size=0;
+#ifdef _WIN32
+        HANDLE file=INVALID_HANDLE_VALUE;
+        HANDLE mapping=nullptr;
+#else
+        int descriptor=-1;
+#endif
+};
+
+//Opens a cooked pack and hands out its entries. Uncompressed entries point straight into the mapping, compressed
+//ones are decompressed on first use with one thread per chunk up to the core count and kept until close().
+class AssetPack{
+
+    public:
+        struct Stats{
+            double openMs=0.0;        //mapping and checksum
+            double decompressMs=0.0;
+            uint64_t mappedBytes=0;
+            uint64_t decompressedBytes=0;
+        };
+
+        AssetPack()=default;
+        AssetPack(const AssetPack&)=delete;
+        AssetPack& operator=(const AssetPack&)=delete;
+
+        void open(const std::string& path){
+            close();
+            auto start=std::chrono::steady_clock::now();
+            file.open(path);
+
+            const uint8_t* bytes=file.data();
+            size_t size=file.getSize();
+            if(size<sizeof(pack::Header)){
+                throw std::runtime_error("not an asset pack: "+path+"!");
+            }
+            memcpy(&header,bytes,sizeof(header));
+            if(std::memcmp(header.magic,pack::magic,sizeof(header.magic))!=0 || header.version!=pack::version){
+                throw std::runtime_error("not an asset pack or wrong version: "+path+"!");
+            }
+            if(header.fileSize!=size || header.tocOffset>size || (size-header.tocOffset)/sizeof(pack::Entry)<header.entryCount){
+                throw std::runtime_error("asset pack is truncated: "+path+"!");
+            }
+            if(pack::checksum(bytes+sizeof(pack::Header),size-sizeof(pack::Header))!=header.checksum){
+                throw std::runtime_error("asset pack checksum mismatch: "+path+"!");
+            }
+
+            entries.resize(header.entryCount);
+            memcpy(entries.data(),bytes+header.tocOffset,entries.size()*sizeof(pack::Entry));
+            for(pack::Entry& entry: entries){
+                entry.name[sizeof(entry.name)-1]='\0';
+                bool fits=entry.offset<=size && entry.storedSize<=size-entry.offset;
+                if(entry.compression==pack::Compression::LZ4){
+                    fits=fits && entry.chunkTableOffset<=size && (size-entry.chunkTableOffset)/sizeof(pack::Chunk)>=entry.chunkCount;
+                }
+                else{
+                    fits=fits && entry.storedSize==entry.size;
+                }
+                if(!fits || entry.elementSize==0 || entry.size!=entry.elementCount*entry.elementSize){
+                    throw std::runtime_error("asset pack entry "+std::string(entry.name)+" is damaged: "+path+"!");
+                }
+            }
+
+            packPath=path;
+            stats.mappedBytes=size;
+            stats.openMs=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+        }
+
+        void close(){
+            file.close();
+            entries.clear();
+            decompressed.clear();
+            packPath.clear();
+            stats=Stats{};
+        }
+
+        bool isOpen() const{
+            return file.data()!=nullptr;
+        }
+
+        const std::vector<pack::Entry>& getEntries() const{
+            return entries;
+        }
+
+        const pack::Entry* find(const std::string& name) const{
+            for(const pack::Entry& entry: entries){
+                if(name==entry.name){
+                    return &entry;
+                }
+            }
+            return nullptr;
+        }
+
+        //The entry's bytes in the layout they are uploaded in, entry.size of them.
+        const void* data(const pack::Entry& entry){
+            if(entry.compression==pack::Compression::None){
+                return file.data()+entry.offset;
+            }
+            auto cached=decompressed.find(&entry);
+            if(cached!=decompressed.end()){
+                return cached->second.data();
+            }
+            //only cached once it decompressed, a corrupt entry throws again on the next call
+            std::vector<uint8_t> output;
+            decompress(entry,output);
+            return decompressed.emplace(&entry,std::move(output)).first->second.data();
+        }
+
+        //Typed access to an entry, throws when it is missing or its elements are not T.
+        template<typename T>
+        const T* get(const std::string& name, pack::EntryType type, size_t& count){
+            const pack::Entry* entry=find(name);
+            if(!entry || entry->type!=type || entry->elementSize!=sizeof(T)){
+                throw std::runtime_error("asset pack "+packPath+" has no entry "+name+" of the expected type!");
+            }
+            count=static_cast<size_t>(entry->elementCount);
+            return static_cast<const T*>(data(*entry));
+        }
+
+        const Stats& getStats() const{
+            return stats;
+        }
+
+    private:
+        void decompress(const pack::Entry& entry, std::vector<uint8_t>& output){
+            auto start=std::chrono::steady_clock::now();
+            output.resize(static_cast<size_t>(entry.size));
+
+            std::vector<pack::Chunk> chunks(entry.chunkCount);
+            memcpy(chunks.data(),file.data()+entry.chunkTableOffset,chunks.size()*sizeof(pack::Chunk));
+
+            //chunks are independent, workers take the next one until all are done
+            std::atomic<uint32_t> next{0};
+            std::atomic<bool> damaged{false};
+            auto work=[&](){
+                for(uint32_t i=next++; i<chunks.size(); i=next++){
+                    const pack::Chunk& chunk=chunks[i];
+                    uint64_t target=static_cast<uint64_t>(i)*entry.chunkSize;
+                    bool inside=chunk.offset>=entry.offset && chunk.offset+chunk.storedSize<=entry.offset+entry.storedSize &&
+                                target+chunk.size<=entry.size && (i+1==chunks.size() || chunk.size==entry.chunkSize);
+                    if(!inside || !lz4::decompress(file.data()+chunk.offset,chunk.storedSize,output.data()+target,chunk.size)){
+                        damaged=true;
+                    }
+                }
+            };
+            uint32_t threadCount=std::min<uint32_t>(std::max(std::thread::hardware_concurrency(),1u),entry.chunkCount);
+            std::vector<std::thread> workers;
+            for(uint32_t i=1; i<threadCount; ++i){
+                workers.emplace_back(work);
+            }
+            work();
+            for(std::thread& worker: workers){
+                worker.join();
+            }
+
+            uint64_t covered=0;
+            for(const pack::Chunk& chunk: chunks){
+                covered+=chunk.size;
+            }
+            if(damaged || covered!=entry.size){
+                throw std::runtime_error("failed to decompress asset pack entry "+std::string(entry.name)+"!");
+            }
+            stats.decompressedBytes+=entry.size;
+            stats.decompressMs+=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+        }
+
+        MappedFile file;
+        pack::Header header{};
+        std::vector<pack::Entry> entries;
+        std::map<const pack::Entry*,std::vector<uint8_t>> decompressed;
+        std::string packPath;
+        Stats stats;
+};
@@ -0,0 +1,243 @@
+#pragma once
+
+#include<vulkan/vulkan.h>
+
+#include<stdexcept>
+#include<vector>
+
+//Records and submits compute work on its own queue so it can overlap the graphics work of the previous frame.
+//Every frame slot has one compute command buffer and one semaphore the graphics submission waits on. When the compute
+//queue comes from a different family, resources written by compute are released here and acquired again at the start
+//of the graphics command buffer (queue family ownership transfer). Resources only read back on the next frame's compute
+//pass, or rewritten from scratch, need no transfer.
+class AsyncCompute{
+
+    public:
+        void init(VkDevice device, VkQueue computeQueue, uint32_t computeFamily, uint32_t graphicsFamily, uint32_t framesInFlight){
+            this->device=device;
+            this->computeQueue=computeQueue;
+            this->computeFamily=computeFamily;
+            this->graphicsFamily=graphicsFamily;
+
+            VkCommandPoolCreateInfo poolInfo{};
+            {
+                poolInfo.sType=VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags=VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+                poolInfo.queueFamilyIndex=computeFamily;
+            }
+            if(vkCreateCommandPool(device,&poolInfo,nullptr,&commandPool)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create compute command pool!");
+            }
+
+            frames.resize(framesInFlight);
+            std::vector<VkCommandBuffer> commandBuffers(framesInFlight);
+            VkCommandBufferAllocateInfo allocInfo{};
+            {
+                allocInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool=commandPool;
+                allocInfo.level=VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandBufferCount=framesInFlight;
+            }
+            if(vkAllocateCommandBuffers(device,&allocInfo,commandBuffers.data())!=VK_SUCCESS){
+                throw std::runtime_error("failed to allocate compute command buffers!");
+            }
+
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            {
+                semaphoreInfo.sType=VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            }
+            for(uint32_t i=0;i<framesInFlight;++i){
+                frames[i].commandBuffer=commandBuffers[i];
+                if(vkCreateSemaphore(device,&semaphoreInfo,nullptr,&frames[i].finished)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to create compute semaphore!");
+                }
+            }
+        }
+
+        void cleanup(){
+            for(auto& frame: frames){
+                vkDestroySemaphore(device,frame.finished,nullptr);
+            }
+            frames.clear();
+            if(commandPool!=VK_NULL_HANDLE){
+                vkDestroyCommandPool(device,commandPool,nullptr);
+                commandPool=VK_NULL_HANDLE;
+            }
+        }
+
+        //False if the device has no separate compute family, the work then still goes through this path
+        //but runs on the graphics queue and needs no ownership transfers.
+        bool isDedicated() const{ return computeFamily!=graphicsFamily; }
+        //Whether the frame has transfers for recordAcquires() to record. Buffers need none on a single family.
+        bool hasTransfers(uint32_t frame) const{
+            return !frames[frame].imageTransfers.empty() || (isDedicated() && !frames[frame].bufferTransfers.empty());
+        }
+        uint32_t getFamily() const{ return computeFamily; }
+
+        //Compute command buffer of the frame slot, begun on the first call of the frame. Only valid once the
+        //slot's graphics fence was waited on, the graphics submission that waited on it is then finished too.
+        VkCommandBuffer record(uint32_t frame){
+            Frame& slot=frames[frame];
+            if(!slot.recording){
+                vkResetCommandBuffer(slot.commandBuffer,0);
+
+                VkCommandBufferBeginInfo beginInfo{};
+                {
+                    beginInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                    beginInfo.flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                }
+                if(vkBeginCommandBuffer(slot.commandBuffer,&beginInfo)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to begin recording compute command buffer!");
+                }
+                slot.recording=true;
+            }
+            return slot.commandBuffer;
+        }
+
+        //Hands a buffer written by this frame's compute work over to the graphics queue. dstStage/dstAccess describe
+        //the first graphics use, the matching acquire is recorded by recordAcquires().
+        void releaseBuffer(uint32_t frame, VkBuffer buffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                           VkPipelineStageFlags dstStage, VkAccessFlags dstAccess){
+            VkBufferMemoryBarrier barrier{};
+            {
+                barrier.sType=VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcQueueFamilyIndex=isDedicated() ? computeFamily : VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex=isDedicated() ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+                barrier.buffer=buffer;
+                barrier.offset=0;
+                barrier.size=VK_WHOLE_SIZE;
+                barrier.srcAccessMask=srcAccess;
+                barrier.dstAccessMask=dstAccess;
+            }
+            Frame& slot=frames[frame];
+            slot.bufferTransfers.push_back(barrier);
+            slot.srcStages|=srcStage;
+            slot.dstStages|=dstStage;
+        }
+
+        //Same for an image, the layout transition is part of the transfer and happens once on both queues.
+        void releaseImage(uint32_t frame, VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldLayout, VkImageLayout newLayout,
+                          VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess){
+            VkImageMemoryBarrier barrier{};
+            {
+                barrier.sType=VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.oldLayout=oldLayout;
+                barrier.newLayout=newLayout;
+                barrier.srcQueueFamilyIndex=isDedicated() ? computeFamily : VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex=isDedicated() ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+                barrier.image=image;
+                barrier.subresourceRange={aspectMask,0,VK_REMAINING_MIP_LEVELS,0,VK_REMAINING_ARRAY_LAYERS};
+                barrier.srcAccessMask=srcAccess;
+                barrier.dstAccessMask=dstAccess;
+            }
+            Frame& slot=frames[frame];
+            slot.imageTransfers.push_back(barrier);
+            slot.srcStages|=srcStage;
+            slot.dstStages|=dstStage;
+        }
+
+        //Ends and submits the frame's compute work. Returns the semaphore the graphics submission has to wait on
+        //at getWaitStages(), or VK_NULL_HANDLE if nothing was recorded this frame.
+        VkSemaphore submit(uint32_t frame){
+            Frame& slot=frames[frame];
+            if(!slot.recording){
+                return VK_NULL_HANDLE;
+            }
+
+            if(isDedicated() && (!slot.bufferTransfers.empty() || !slot.imageTransfers.empty())){
+                //release half, the destination access happens on the graphics queue
+                std::vector<VkBufferMemoryBarrier> buffers=slot.bufferTransfers;
+                std::vector<VkImageMemoryBarrier> images=slot.imageTransfers;
+                for(auto& barrier: buffers){
+                    barrier.dstAccessMask=0;
+                }
+                for(auto& barrier: images){
+                    barrier.dstAccessMask=0;
+                }
+                vkCmdPipelineBarrier(slot.commandBuffer,slot.srcStages,VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,0,0,nullptr,
+                                     static_cast<uint32_t>(buffers.size()),buffers.data(),static_cast<uint32_t>(images.size()),images.data());
+            }
+
+            if(vkEndCommandBuffer(slot.commandBuffer)!=VK_SUCCESS){
+                throw std::runtime_error("failed to record compute command buffer!");
+            }
+            slot.recording=false;
+
+            VkSubmitInfo submitInfo{};
+            {
+                submitInfo.sType=VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount=1;
+                submitInfo.pCommandBuffers=&slot.commandBuffer;
+                submitInfo.signalSemaphoreCount=1;
+                submitInfo.pSignalSemaphores=&slot.finished;
+            }
+            if(vkQueueSubmit(computeQueue,1,&submitInfo,VK_NULL_HANDLE)!=VK_SUCCESS){
+                throw std::runtime_error("failed to submit compute command buffer!");
+            }
+            slot.submitted=true;
+            return slot.finished;
+        }
+
+        //Records the acquire half of this frame's transfers at the start of the graphics command buffer.
+        void recordAcquires(VkCommandBuffer commandBuffer, uint32_t frame){
+            Frame& slot=frames[frame];
+            if(isDedicated() && (!slot.bufferTransfers.empty() || !slot.imageTransfers.empty())){
+                for(auto& barrier: slot.bufferTransfers){
+                    barrier.srcAccessMask=0;
+                }
+                for(auto& barrier: slot.imageTransfers){
+                    barrier.srcAccessMask=0;
+                }
+                //the source stages are the ones the semaphore is waited on at, so the acquire chains after the wait
+                vkCmdPipelineBarrier(commandBuffer,slot.dstStages,slot.dstStages,0,0,nullptr,
+                                     static_cast<uint32_t>(slot.bufferTransfers.size()),slot.bufferTransfers.data(),
+                                     static_cast<uint32_t>(slot.imageTransfers.size()),slot.imageTransfers.data());
+            }
+            else if(!slot.imageTransfers.empty()){
+                //same family, the semaphore orders the work but the layout transition still has to happen
+                for(auto& barrier: slot.imageTransfers){
+                    barrier.srcAccessMask=0;
+                }
+                vkCmdPipelineBarrier(commandBuffer,slot.dstStages,slot.dstStages,0,0,nullptr,0,nullptr,
+                                     static_cast<uint32_t>(slot.imageTransfers.size()),slot.imageTransfers.data());
+            }
+        }
+
+        //Stages of the graphics submission that have to wait for the compute work, 0 if there was none this frame.
+        VkPipelineStageFlags getWaitStages(uint32_t frame) const{
+            const Frame& slot=frames[frame];
+            if(!slot.submitted){
+                return 0;
+            }
+            return slot.dstStages ? slot.dstStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+        }
+
+        //Called once the graphics work of the frame has been submitted.
+        void endFrame(uint32_t frame){
+            Frame& slot=frames[frame];
+            slot.bufferTransfers.clear();
+            slot.imageTransfers.clear();
+            slot.srcStages=0;
+            slot.dstStages=0;
+            slot.submitted=false;
+        }
+
+    private:
+        struct Frame{
+            VkCommandBuffer commandBuffer=VK_NULL_HANDLE;
+            VkSemaphore finished=VK_NULL_HANDLE;
+            bool recording=false;
+            bool submitted=false;
+            std::vector<VkBufferMemoryBarrier> bufferTransfers;
+            std::vector<VkImageMemoryBarrier> imageTransfers;
+            VkPipelineStageFlags srcStages=0;
+            VkPipelineStageFlags dstStages=0;
+        };
+
+        VkDevice device=VK_NULL_HANDLE;
+        VkQueue computeQueue=VK_NULL_HANDLE;
+        uint32_t computeFamily=0;
+        uint32_t graphicsFamily=0;
+        VkCommandPool commandPool=VK_NULL_HANDLE;
+        std::vector<Frame> frames;
+};
@@ -0,0 +1,598 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "DeviceInfo.h"
+#include "ImageWriter.h"
+#include "Profiler.h"
+#include "VulkanUtils.h"
+
+#include<vulkan/vulkan.h>
+#include<glm/glm.hpp>
+
+#include<algorithm>
+#include<array>
+#include<chrono>
+#include<condition_variable>
+#include<deque>
+#include<functional>
+#include<iostream>
+#include<mutex>
+#include<stdexcept>
+#include<string>
+#include<thread>
+#include<vector>
+
+//One offline render: which moment of the scene to render from where, and where the image goes.
+struct BatchJob{
+    uint64_t id=0;
+    glm::vec3 eye{2.0f,2.0f,2.0f};
+    glm::vec3 target{0.0f,0.0f,0.0f};
+    float time=0.0f;
+    std::string output; //empty: the image is rendered and read back but not written
+};
+
+//Fixed capacity queue between the thread producing jobs and the renderer. push() blocks while the queue is full
+//so a fast producer can not run ahead of the GPU.
+template<typename T>
+class BoundedQueue{
+
+    public:
+        explicit BoundedQueue(size_t capacity): capacity(capacity){}
+
+        //False if the queue was closed.
+        bool push(T item){
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock,[this]{ return closed || items.size()<capacity; });
+            if(closed){
+                return false;
+            }
+            items.push_back(std::move(item));
+            notEmpty.notify_one();
+            return true;
+        }
+
+        //Waits up to timeout for an item, false if there was none.
+        bool pop(T& item, std::chrono::microseconds timeout=std::chrono::microseconds(0)){
+            std::unique_lock<std::mutex> lock(mutex);
+            if(!notEmpty.wait_for(lock,timeout,[this]{ return closed || !items.empty(); }) || items.empty()){
+                return false;
+            }
+            item=std::move(items.front());
+            items.pop_front();
+            notFull.notify_one();
+            return true;
+        }
+
+        //No more items will be pushed, the remaining ones can still be popped.
+        void close(){
+            std::lock_guard<std::mutex> lock(mutex);
+            closed=true;
+            notEmpty.notify_all();
+            notFull.notify_all();
+        }
+
+        bool drained() const{
+            std::lock_guard<std::mutex> lock(mutex);
+            return closed && items.empty();
+        }
+
+        size_t getCapacity() const{ return capacity; }
+
+    private:
+        const size_t capacity;
+        mutable std::mutex mutex;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
+        std::deque<T> items;
+        bool closed=false;
+};
+
+//Offline renderer on the application's device. Keeps several offscreen targets in flight: while the GPU renders one
+//job the next ones are recorded and submitted, and finished images are read back and written on a separate thread.
+//Every target has its own color and depth image, readback buffer, command buffer and fence. The render pass only
+//matches the formats of the interactive scene pass, so the same pipelines draw into both.
+class BatchRenderer{
+
+    public:
+        struct Settings{
+            uint32_t targets=4;
+            VkExtent2D extent{1280,720};
+            uint32_t queueCapacity=16;
+        };
+
+        struct Report{
+            uint64_t jobs=0;
+            double seconds=0.0;
+            double jobsPerSecond=0.0;
+            double averageLatency=0.0; //milliseconds from a target taking the job off the queue to its image being written
+            double medianLatency=0.0;
+            double p95Latency=0.0;
+            double maxLatency=0.0;
+        };
+
+        //Called for every job with the target's render pass already begun. target indexes whatever per target
+        //resources the caller keeps (uniform buffers, descriptor sets), they are not in use by the GPU anymore.
+        using RecordFunction=std::function<void(VkCommandBuffer,uint32_t,const BatchJob&)>;
+
+        void init(const DeviceInfo& deviceInfo, VkDevice device, VkQueue queue, uint32_t queueFamily, VkFormat colorFormat,
+                  VkFormat depthFormat, const Settings& settings, DeletionQueue& deletionQueue){
+            this->physicalDevice=deviceInfo.physicalDevice;
+            this->device=device;
+            this->queue=queue;
+            this->colorFormat=colorFormat;
+            this->settings=settings;
+            this->deletionQueue=&deletionQueue;
+
+            readbackFlags=VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            for(uint32_t i=0;i<deviceInfo.memoryProperties.memoryTypeCount;++i){
+                VkMemoryPropertyFlags flags=deviceInfo.memoryProperties.memoryTypes[i].propertyFlags;
+                if((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)){
+                    readbackFlags=VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+                    break;
+                }
+            }
+
+            createRenderPass(depthFormat);
+
+            VkCommandPoolCreateInfo poolInfo{};
+            {
+                poolInfo.sType=VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags=VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+                poolInfo.queueFamilyIndex=queueFamily;
+            }
+            if(vkCreateCommandPool(device,&poolInfo,nullptr,&commandPool)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create batch command pool!");
+            }
+
+            targets.resize(settings.targets);
+            for(auto& target: targets){
+                createTarget(target,depthFormat);
+            }
+
+            writer=std::thread(&BatchRenderer::writerLoop,this);
+        }
+
+        void cleanup(){
+            if(writer.joinable()){
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopWriter=true;
+                }
+                writeCondition.notify_all();
+                writer.join();
+            }
+
+            for(auto& target: targets){
+                vkWaitForFences(device,1,&target.fence,VK_TRUE,UINT64_MAX);
+                vkDestroyFence(device,target.fence,nullptr);
+                vkUnmapMemory(device,target.readbackMemory);
+            }
+            //images, views, framebuffers and buffers go through the deletion queue
+            targets.clear();
+            renderPass.reset();
+            if(commandPool!=VK_NULL_HANDLE){
+                vkDestroyCommandPool(device,commandPool,nullptr);
+                commandPool=VK_NULL_HANDLE;
+            }
+        }
+
+        VkRenderPass getRenderPass() const{ return renderPass; }
+        VkExtent2D getExtent() const{ return settings.extent; }
+        uint32_t getTargetCount() const{ return static_cast<uint32_t>(targets.size()); }
+
+        //Numbered submissions, every one up to getCompletedCount() has finished on the GPU (one queue, so they finish in order).
+        uint64_t getSubmittedCount() const{ return submitted; }
+        uint64_t getCompletedCount() const{ return completed; }
+
+        //Renders jobs until the queue is closed and empty, returns once every image has been written.
+        Report run(BoundedQueue<BatchJob>& jobs, const RecordFunction& record){
+
+            PROFILE_ZONE("batch run");
+
+            std::vector<double> latencies;
+            int64_t start=Profiler::now();
+            std::vector<VkFence> busyFences;
+
+            while(true){
+                bool progress=false;
+
+                //finished renders go to the writer, or straight back to the free list without output
+                for(auto& target: targets){
+                    if(targetState(target)==TargetState::Rendering && vkGetFenceStatus(device,target.fence)==VK_SUCCESS){
+                        retire(target,latencies);
+                        progress=true;
+                    }
+                }
+
+                for(uint32_t t=0;t<targets.size();++t){
+                    if(targetState(targets[t])!=TargetState::Free){
+                        continue;
+                    }
+                    BatchJob job;
+                    if(!jobs.pop(job)){
+                        break;
+                    }
+                    submit(t,job,record);
+                    progress=true;
+                }
+
+                bool idle=std::all_of(targets.begin(),targets.end(),[this](const Target& target){ return targetState(target)==TargetState::Free; });
+                if(idle && jobs.drained()){
+                    break;
+                }
+                if(progress){
+                    continue;
+                }
+
+                //nothing to do: wait for whichever comes first, a GPU job, the writer or the producer
+                busyFences.clear();
+                for(const auto& target: targets){
+                    if(targetState(target)==TargetState::Rendering){
+                        busyFences.push_back(target.fence);
+                    }
+                }
+                if(!busyFences.empty()){
+                    vkWaitForFences(device,static_cast<uint32_t>(busyFences.size()),busyFences.data(),VK_FALSE,1000000);
+                }
+                else if(!idle){
+                    std::unique_lock<std::mutex> lock(mutex);
+                    writtenCondition.wait_for(lock,std::chrono::milliseconds(1));
+                }
+                else{
+                    BatchJob job;
+                    if(jobs.pop(job,std::chrono::milliseconds(1))){
+                        submit(0,job,record);
+                    }
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            latencies.insert(latencies.end(),writtenLatencies.begin(),writtenLatencies.end());
+            writtenLatencies.clear();
+
+            Report report;
+            report.jobs=latencies.size();
+            report.seconds=(Profiler::now()-start)/1e9;
+            report.jobsPerSecond= report.seconds>0.0 ? report.jobs/report.seconds : 0.0;
+            if(!latencies.empty()){
+                std::sort(latencies.begin(),latencies.end());
+                double sum=0.0;
+                for(double latency: latencies){
+                    sum+=latency;
+                }
+                report.averageLatency=sum/latencies.size();
+                report.medianLatency=latencies[latencies.size()/2];
+                report.p95Latency=latencies[std::min(latencies.size()-1,latencies.size()*95/100)];
+                report.maxLatency=latencies.back();
+            }
+            return report;
+        }
+
+    private:
+        enum class TargetState{
+            Free,
+            Rendering,
+            Writing //the writer thread reads the readback buffer
+        };
+
+        struct Target{
+            vkutil::UniqueImage color;
+            vkutil::UniqueDeviceMemory colorMemory;
+            vkutil::UniqueImageView colorView;
+            vkutil::UniqueImage depth;
+            vkutil::UniqueDeviceMemory depthMemory;
+            vkutil::UniqueImageView depthView;
+            vkutil::UniqueFramebuffer framebuffer;
+            vkutil::UniqueBuffer readback;
+            vkutil::UniqueDeviceMemory readbackMemory;
+            void* mapped=nullptr;
+            VkCommandBuffer commandBuffer=VK_NULL_HANDLE;
+            VkFence fence=VK_NULL_HANDLE;
+            TargetState state=TargetState::Free;
+            uint64_t submission=0;
+            int64_t startTime=0;
+            BatchJob job;
+        };
+
+        void createRenderPass(VkFormat depthFormat){
+
+            std::array<VkAttachmentDescription,2> attachments{};
+            {
+                attachments[0].format=colorFormat;
+                attachments[0].samples=VK_SAMPLE_COUNT_1_BIT;
+                attachments[0].loadOp=VK_ATTACHMENT_LOAD_OP_CLEAR;
+                attachments[0].storeOp=VK_ATTACHMENT_STORE_OP_STORE;
+                attachments[0].stencilLoadOp=VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                attachments[0].stencilStoreOp=VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                attachments[0].initialLayout=VK_IMAGE_LAYOUT_UNDEFINED;
+                attachments[0].finalLayout=VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; //copied to the readback buffer right after
+
+                attachments[1].format=depthFormat;
+                attachments[1].samples=VK_SAMPLE_COUNT_1_BIT;
+                attachments[1].loadOp=VK_ATTACHMENT_LOAD_OP_CLEAR;
+                attachments[1].storeOp=VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                attachments[1].stencilLoadOp=VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                attachments[1].stencilStoreOp=VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                attachments[1].initialLayout=VK_IMAGE_LAYOUT_UNDEFINED;
+                attachments[1].finalLayout=VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            }
+
+            VkAttachmentReference colorReference{0,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+            VkAttachmentReference depthReference{1,VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+            VkSubpassDescription subpass{};
+            {
+                subpass.pipelineBindPoint=VK_PIPELINE_BIND_POINT_GRAPHICS;
+                subpass.colorAttachmentCount=1;
+                subpass.pColorAttachments=&colorReference;
+                subpass.pDepthStencilAttachment=&depthReference;
+            }
+
+            //the copy after the pass reads what the subpass wrote
+            VkSubpassDependency dependency{};
+            {
+                dependency.srcSubpass=0;
+                dependency.dstSubpass=VK_SUBPASS_EXTERNAL;
+                dependency.srcStageMask=VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+                dependency.srcAccessMask=VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                dependency.dstStageMask=VK_PIPELINE_STAGE_TRANSFER_BIT;
+                dependency.dstAccessMask=VK_ACCESS_TRANSFER_READ_BIT;
+            }
+
+            VkRenderPassCreateInfo renderPassInfo{};
+            {
+                renderPassInfo.sType=VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+                renderPassInfo.attachmentCount=static_cast<uint32_t>(attachments.size());
+                renderPassInfo.pAttachments=attachments.data();
+                renderPassInfo.subpassCount=1;
+                renderPassInfo.pSubpasses=&subpass;
+                renderPassInfo.dependencyCount=1;
+                renderPassInfo.pDependencies=&dependency;
+            }
+
+            VkRenderPass pass;
+            if(vkCreateRenderPass(device,&renderPassInfo,nullptr,&pass)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create batch render pass!");
+            }
+            renderPass=vkutil::UniqueRenderPass(*deletionQueue,pass);
+        }
+
+        void createTarget(Target& target, VkFormat depthFormat){
+
+            VkExtent2D extent=settings.extent;
+            auto createAttachment=[&](VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+                                      vkutil::UniqueImage& image, vkutil::UniqueDeviceMemory& memory, vkutil::UniqueImageView& view){
+                VkImageCreateInfo imageInfo{};
+                {
+                    imageInfo.sType=VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                    imageInfo.imageType=VK_IMAGE_TYPE_2D;
+                    imageInfo.format=format;
+                    imageInfo.extent={extent.width,extent.height,1};
+                    imageInfo.mipLevels=1;
+                    imageInfo.arrayLayers=1;
+                    imageInfo.samples=VK_SAMPLE_COUNT_1_BIT;
+                    imageInfo.tiling=VK_IMAGE_TILING_OPTIMAL;
+                    imageInfo.usage=usage;
+                    imageInfo.sharingMode=VK_SHARING_MODE_EXCLUSIVE;
+                    imageInfo.initialLayout=VK_IMAGE_LAYOUT_UNDEFINED;
+                }
+                VkImage rawImage;
+                VkDeviceMemory rawMemory;
+                vkutil::createImage(physicalDevice,device,imageInfo,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Attachments,rawImage,rawMemory);
+                image=vkutil::UniqueImage(*deletionQueue,rawImage);
+                memory=vkutil::UniqueDeviceMemory(*deletionQueue,rawMemory);
+                view=vkutil::UniqueImageView(*deletionQueue,vkutil::createImageView(device,image,format,aspect,1));
+            };
+            createAttachment(colorFormat,VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,VK_IMAGE_ASPECT_COLOR_BIT,
+                             target.color,target.colorMemory,target.colorView);
+            createAttachment(depthFormat,VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,VK_IMAGE_ASPECT_DEPTH_BIT,
+                             target.depth,target.depthMemory,target.depthView);
+
+            std::array<VkImageView,2> views={target.colorView,target.depthView};
+            VkFramebufferCreateInfo framebufferInfo{};
+            {
+                framebufferInfo.sType=VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+                framebufferInfo.renderPass=renderPass;
+                framebufferInfo.attachmentCount=static_cast<uint32_t>(views.size());
+                framebufferInfo.pAttachments=views.data();
+                framebufferInfo.width=extent.width;
+                framebufferInfo.height=extent.height;
+                framebufferInfo.layers=1;
+            }
+            VkFramebuffer framebuffer;
+            if(vkCreateFramebuffer(device,&framebufferInfo,nullptr,&framebuffer)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create batch framebuffer!");
+            }
+            target.framebuffer=vkutil::UniqueFramebuffer(*deletionQueue,framebuffer);
+
+            VkBuffer buffer;
+            VkDeviceMemory memory;
+            vkutil::createBuffer(physicalDevice,device,static_cast<VkDeviceSize>(extent.width)*extent.height*4,VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 readbackFlags,MemoryCategory::Readback,buffer,memory);
+            target.readback=vkutil::UniqueBuffer(*deletionQueue,buffer);
+            target.readbackMemory=vkutil::UniqueDeviceMemory(*deletionQueue,memory);
+            vkMapMemory(device,target.readbackMemory,0,VK_WHOLE_SIZE,0,&target.mapped);
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            {
+                allocInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool=commandPool;
+                allocInfo.level=VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandBufferCount=1;
+            }
+            if(vkAllocateCommandBuffers(device,&allocInfo,&target.commandBuffer)!=VK_SUCCESS){
+                throw std::runtime_error("failed to allocate batch command buffer!");
+            }
+
+            VkFenceCreateInfo fenceInfo{};
+            {
+                fenceInfo.sType=VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+                fenceInfo.flags=VK_FENCE_CREATE_SIGNALED_BIT;
+            }
+            if(vkCreateFence(device,&fenceInfo,nullptr,&target.fence)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create batch fence!");
+            }
+        }
+
+        void submit(uint32_t index, const BatchJob& job, const RecordFunction& record){
+
+            PROFILE_ZONE("batch submit");
+
+            Target& target=targets[index];
+            target.job=job;
+            target.startTime=Profiler::now();
+            target.submission=++submitted;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                target.state=TargetState::Rendering;
+            }
+
+            VkCommandBuffer commandBuffer=target.commandBuffer;
+            vkResetCommandBuffer(commandBuffer,0);
+            VkCommandBufferBeginInfo beginInfo{};
+            {
+                beginInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            }
+            if(vkBeginCommandBuffer(commandBuffer,&beginInfo)!=VK_SUCCESS){
+                throw std::runtime_error("failed to begin recording batch command buffer!");
+            }
+
+            std::array<VkClearValue,2> clearValues{};
+            clearValues[0].color={{0.0f,0.0f,0.0f,1.0f}};
+            clearValues[1].depthStencil={1.0f,0};
+
+            VkRenderPassBeginInfo renderPassInfo{};
+            {
+                renderPassInfo.sType=VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                renderPassInfo.renderPass=renderPass;
+                renderPassInfo.framebuffer=target.framebuffer;
+                renderPassInfo.renderArea.offset={0,0};
+                renderPassInfo.renderArea.extent=settings.extent;
+                renderPassInfo.clearValueCount=static_cast<uint32_t>(clearValues.size());
+                renderPassInfo.pClearValues=clearValues.data();
+            }
+            vkCmdBeginRenderPass(commandBuffer,&renderPassInfo,VK_SUBPASS_CONTENTS_INLINE);
+                record(commandBuffer,index,job);
+            vkCmdEndRenderPass(commandBuffer);
+
+            VkBufferImageCopy region{};
+            {
+                region.imageSubresource.aspectMask=VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.layerCount=1;
+                region.imageExtent={settings.extent.width,settings.extent.height,1};
+            }
+            vkCmdCopyImageToBuffer(commandBuffer,target.color,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,target.readback,1,&region);
+
+            VkBufferMemoryBarrier barrier{};
+            {
+                barrier.sType=VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask=VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask=VK_ACCESS_HOST_READ_BIT;
+                barrier.srcQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED;
+                barrier.buffer=target.readback;
+                barrier.offset=0;
+                barrier.size=VK_WHOLE_SIZE;
+            }
+            vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_HOST_BIT,0,0,nullptr,1,&barrier,0,nullptr);
+
+            if(vkEndCommandBuffer(commandBuffer)!=VK_SUCCESS){
+                throw std::runtime_error("failed to record batch command buffer!");
+            }
+
+            vkResetFences(device,1,&target.fence);
+            VkSubmitInfo submitInfo{};
+            {
+                submitInfo.sType=VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount=1;
+                submitInfo.pCommandBuffers=&commandBuffer;
+            }
+            if(vkQueueSubmit(queue,1,&submitInfo,target.fence)!=VK_SUCCESS){
+                throw std::runtime_error("failed to submit batch command buffer!");
+            }
+        }
+
+        void retire(Target& target, std::vector<double>& latencies){
+            completed=std::max(completed,target.submission);
+
+            if(!(readbackFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)){
+                VkMappedMemoryRange range{};
+                {
+                    range.sType=VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+                    range.memory=target.readbackMemory;
+                    range.offset=0;
+                    range.size=VK_WHOLE_SIZE;
+                }
+                vkInvalidateMappedMemoryRanges(device,1,&range);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if(target.job.output.empty()){
+                latencies.push_back((Profiler::now()-target.startTime)/1e6);
+                target.state=TargetState::Free;
+                return;
+            }
+            target.state=TargetState::Writing;
+            writeQueue.push_back(static_cast<uint32_t>(&target-targets.data()));
+            writeCondition.notify_one();
+        }
+
+        //The writer thread hands targets back, so their state is only read and written under the mutex.
+        TargetState targetState(const Target& target){
+            std::lock_guard<std::mutex> lock(mutex);
+            return target.state;
+        }
+
+        void writerLoop(){
+
+            Profiler::get().setThreadName("batch writer");
+            std::vector<uint8_t> pixels;
+            while(true){
+                uint32_t index;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    writeCondition.wait(lock,[this]{ return stopWriter || !writeQueue.empty(); });
+                    if(writeQueue.empty()){
+                        return;
+                    }
+                    index=writeQueue.front();
+                    writeQueue.pop_front();
+                }
+
+                PROFILE_ZONE("write batch image");
+                Target& target=targets[index];
+                imageio::toRgba(target.mapped,settings.extent,colorFormat,pixels);
+                imageio::writePng(target.job.output,settings.extent,pixels);
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    writtenLatencies.push_back((Profiler::now()-target.startTime)/1e6);
+                    target.state=TargetState::Free;
+                }
+                writtenCondition.notify_all();
+            }
+        }
+
+        VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+        VkDevice device=VK_NULL_HANDLE;
+        VkQueue queue=VK_NULL_HANDLE;
+        VkFormat colorFormat=VK_FORMAT_UNDEFINED;
+        VkMemoryPropertyFlags readbackFlags=0;
+        Settings settings;
+        DeletionQueue* deletionQueue=nullptr;
+
+        vkutil::UniqueRenderPass renderPass;
+        VkCommandPool commandPool=VK_NULL_HANDLE;
+        std::vector<Target> targets;
+        uint64_t submitted=0;
+        uint64_t completed=0;
+
+        std::mutex mutex;
+        std::condition_variable writeCondition;
+        std::condition_variable writtenCondition;
+        std::deque<uint32_t> writeQueue;
+        std::vector<double> writtenLatencies;
+        std::thread writer;
+        bool stopWriter=false;
+};
@@ -0,0 +1,341 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "Profiler.h"
+#include "VulkanUtils.h"
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+#include<stdexcept>
+#include<vector>
+
+//Clustered forward shading for many dynamic point and spot lights. The view frustum is split into froxels, screen tiles
+//times depth slices that grow exponentially with the distance. Every frame the CPU writes the camera and the lights
+//into the slot's host visible frame buffer and one compute dispatch (light_cluster.comp) moves the lights to view space
+//and gives every cluster the list of lights touching it. The dispatch may run on another queue family than the shading,
+//the caller hands the cluster and view light buffers over; the frame buffer both read is shared by the families. The
+//fragment shader picks its cluster from the pixel position and view depth and only loops over that list, so the cost of
+//a pixel depends on the lights reaching it, not on how many there are. The layout is shared: the binning uses it as
+//set 0, the scene pipelines as the set after their own.
+class ClusteredLighting{
+
+    public:
+        //Matches clustered_lighting.glsl.
+        static constexpr uint32_t gridX=16;
+        static constexpr uint32_t gridY=9;
+        static constexpr uint32_t gridZ=24;
+        static constexpr uint32_t clusterCount=gridX*gridY*gridZ;
+        static constexpr uint32_t clusterStride=256; //count followed by up to 255 light indices
+
+        //World space, laid out like the Light struct of the shaders (std430).
+        struct Light{
+            float positionRange[4];
+            float colorIntensity[4];
+            float directionCosOuter[4]; //cosine of the outer cone angle, pointLight for point lights
+            float cosInner[4];
+        };
+
+        static constexpr float pointLight=-2.0f;
+
+        struct Stats{
+            uint64_t frames=0;
+            uint64_t entries=0;     //light indices written to the clusters, summed over the frames
+            uint64_t occupied=0;    //clusters with at least one light, summed over the frames
+            uint32_t maxLights=0;   //most lights touching a single cluster
+            uint64_t overflows=0;   //clusters that had more than clusterStride-1 lights and dropped some
+        };
+
+        //Without lights only the layout and the empty frame buffers are created, the shading then leaves the scene unlit.
+        //queueFamilies: the families of the binning and the shading when they differ, the frame buffer is then shared.
+        void init(VkPhysicalDevice physicalDevice, VkDevice device, DeletionQueue& deletionQueue, uint32_t maxLights, uint32_t slotCount,
+                  const std::vector<char>& shaderCode, std::vector<uint32_t> queueFamilies={}){
+
+            PROFILE_ZONE("ClusteredLighting::init");
+
+            this->physicalDevice=physicalDevice;
+            this->device=device;
+            this->deletionQueue=&deletionQueue;
+            this->maxLights=maxLights;
+            std::sort(queueFamilies.begin(),queueFamilies.end());
+            queueFamilies.erase(std::unique(queueFamilies.begin(),queueFamilies.end()),queueFamilies.end());
+            sharedFamilies=queueFamilies;
+
+            createLayout();
+            if(maxLights>0){
+                pipeline=createComputePipeline(shaderCode);
+            }
+            createSlots(slotCount);
+
+            if(maxLights>0){
+                std::cout<<"lighting: "<<maxLights<<" lights in "<<gridX<<"x"<<gridY<<"x"<<gridZ<<" clusters ("
+                         <<static_cast<VkDeviceSize>(clusterCount)*clusterStride*sizeof(uint32_t)*slotCount/(1024*1024)<<" MiB of lists)"<<std::endl;
+            }
+        }
+
+        //Only valid once the device is idle.
+        void cleanup(){
+            if(device==VK_NULL_HANDLE){
+                return;
+            }
+            if(stats.frames>0 && stats.occupied>0){
+                std::cout<<"lighting: "<<static_cast<double>(stats.entries)/stats.occupied<<" lights per lit cluster on average, "
+                         <<100.0*stats.occupied/(static_cast<double>(stats.frames)*clusterCount)<<"% of the clusters lit, at most "
+                         <<stats.maxLights<<" in one cluster";
+                if(stats.overflows>0){
+                    std::cout<<", "<<stats.overflows<<" cluster lists overflowed";
+                }
+                std::cout<<std::endl;
+            }
+            for(Slot& slot: slots){
+                vkUnmapMemory(device,slot.frameMemory);
+                vkUnmapMemory(device,slot.statisticsMemory);
+            }
+            slots.clear();
+            pipeline.reset();
+            pipelineLayout.reset();
+            vkDestroyDescriptorPool(device,descriptorPool,nullptr);
+            vkDestroyDescriptorSetLayout(device,descriptorSetLayout,nullptr);
+            device=VK_NULL_HANDLE;
+        }
+
+        //After the slot's fence wait, adds the cluster statistics of its last frame.
+        void collect(uint32_t slot){
+            Slot& state=slots[slot];
+            if(!state.pending){
+                return;
+            }
+            state.pending=false;
+            ++stats.frames;
+            stats.entries+=state.statistics->entries;
+            stats.occupied+=state.statistics->occupied;
+            stats.maxLights=std::max(stats.maxLights,state.statistics->maxLights);
+            stats.overflows+=state.statistics->overflows;
+        }
+
+        //Writes the camera of the slot's frame and returns its light array, lightCount lights are filled in by the caller
+        //before the frame is submitted. view and projection are column major 4x4 matrices, extent is the rendered size.
+        Light* update(uint32_t slot, const float* view, const float* projection, float nearPlane, float farPlane, VkExtent2D extent, uint32_t lightCount){
+            Slot& state=slots[slot];
+            FrameHeader* header=state.frame;
+            memcpy(header->view,view,sizeof(header->view));
+            memcpy(header->projection,projection,sizeof(header->projection));
+            header->screen[0]=static_cast<float>(extent.width);
+            header->screen[1]=static_cast<float>(extent.height);
+            header->screen[2]=nearPlane;
+            header->screen[3]=farPlane;
+            header->grid[0]=gridX;
+            header->grid[1]=gridY;
+            header->grid[2]=gridZ;
+            header->grid[3]=std::min(lightCount,maxLights);
+            if(maxLights>0){
+                *state.statistics=Statistics{};
+                state.pending=true;
+            }
+            return reinterpret_cast<Light*>(header+1);
+        }
+
+        //Bins the lights of the slot's frame. The caller orders it against the shading, which reads the cluster and view
+        //light buffers.
+        void bin(VkCommandBuffer commandBuffer, uint32_t slot){
+            vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,pipeline);
+            vkCmdBindDescriptorSets(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,pipelineLayout,0,1,&slots[slot].descriptorSet,0,nullptr);
+            vkCmdDispatch(commandBuffer,(clusterCount+63)/64,1,1);
+
+            //statistics for collect(), read once the slot's fence has signaled
+            VkMemoryBarrier memoryBarrier{};
+            {
+                memoryBarrier.sType=VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                memoryBarrier.srcAccessMask=VK_ACCESS_SHADER_WRITE_BIT;
+                memoryBarrier.dstAccessMask=VK_ACCESS_HOST_READ_BIT;
+            }
+            vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_PIPELINE_STAGE_HOST_BIT,0,1,&memoryBarrier,0,nullptr,0,nullptr);
+        }
+
+        VkDescriptorSetLayout getDescriptorSetLayout() const{ return descriptorSetLayout; }
+        VkDescriptorSet getDescriptorSet(uint32_t slot) const{ return slots[slot].descriptorSet; }
+        VkBuffer getClusterBuffer(uint32_t slot) const{ return slots[slot].clusterBuffer; }
+        VkBuffer getViewLightBuffer(uint32_t slot) const{ return slots[slot].viewLightBuffer; }
+        uint32_t getMaxLights() const{ return maxLights; }
+        Stats getStats() const{ return stats; }
+
+    private:
+        //Laid out like LightingFrame in clustered_lighting.glsl, the lights follow.
+        struct FrameHeader{
+            float view[16];
+            float projection[16];
+            float screen[4];
+            uint32_t grid[4];
+        };
+
+        struct Statistics{
+            uint32_t maxLights;
+            uint32_t entries;
+            uint32_t occupied;
+            uint32_t overflows;
+        };
+
+        struct Slot{
+            VkDescriptorSet descriptorSet=VK_NULL_HANDLE;
+            vkutil::UniqueBuffer frameBuffer;
+            vkutil::UniqueDeviceMemory frameMemory;
+            vkutil::UniqueBuffer clusterBuffer;
+            vkutil::UniqueDeviceMemory clusterMemory;
+            vkutil::UniqueBuffer viewLightBuffer;
+            vkutil::UniqueDeviceMemory viewLightMemory;
+            vkutil::UniqueBuffer statisticsBuffer;
+            vkutil::UniqueDeviceMemory statisticsMemory;
+            FrameHeader* frame=nullptr;
+            Statistics* statistics=nullptr;
+            bool pending=false;
+        };
+
+        void createLayout(){
+
+            VkDescriptorSetLayoutBinding bindings[4]{};
+            for(uint32_t i=0;i<4;++i){
+                bindings[i].binding=i;
+                bindings[i].descriptorType=VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                bindings[i].descriptorCount=1;
+                bindings[i].stageFlags= i==0 ? VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT
+                                      : i==3 ? VK_SHADER_STAGE_COMPUTE_BIT : VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+            }
+            VkDescriptorSetLayoutCreateInfo layoutInfo{};
+            {
+                layoutInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+                layoutInfo.bindingCount=4;
+                layoutInfo.pBindings=bindings;
+            }
+            if(vkCreateDescriptorSetLayout(device,&layoutInfo,nullptr,&descriptorSetLayout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create lighting descriptor set layout!");
+            }
+
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            {
+                pipelineLayoutInfo.sType=VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                pipelineLayoutInfo.setLayoutCount=1;
+                pipelineLayoutInfo.pSetLayouts=&descriptorSetLayout;
+            }
+            VkPipelineLayout layout;
+            if(vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,&layout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create lighting pipeline layout!");
+            }
+            pipelineLayout=vkutil::UniquePipelineLayout(*deletionQueue,layout);
+        }
+
+        vkutil::UniquePipeline createComputePipeline(const std::vector<char>& code){
+            VkShaderModuleCreateInfo moduleInfo{};
+            {
+                moduleInfo.sType=VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+                moduleInfo.codeSize=code.size();
+                moduleInfo.pCode=reinterpret_cast<const uint32_t*>(code.data());
+            }
+            VkShaderModule shaderModule;
+            if(vkCreateShaderModule(device,&moduleInfo,nullptr,&shaderModule)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create shader module!");
+            }
+            VkComputePipelineCreateInfo pipelineInfo{};
+            {
+                pipelineInfo.sType=VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+                pipelineInfo.stage.sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                pipelineInfo.stage.stage=VK_SHADER_STAGE_COMPUTE_BIT;
+                pipelineInfo.stage.module=shaderModule;
+                pipelineInfo.stage.pName="main";
+                pipelineInfo.layout=pipelineLayout;
+            }
+            VkPipeline computePipeline;
+            VkResult result=vkCreateComputePipelines(device,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&computePipeline);
+            vkDestroyShaderModule(device,shaderModule,nullptr);
+            if(result!=VK_SUCCESS){
+                throw std::runtime_error("failed to create lighting compute pipeline!");
+            }
+            return vkutil::UniquePipeline(*deletionQueue,computePipeline);
+        }
+
+        void createBuffer(VkDeviceSize size, VkMemoryPropertyFlags properties, MemoryCategory category, vkutil::UniqueBuffer& buffer, vkutil::UniqueDeviceMemory& memory,
+                          const std::vector<uint32_t>& families={}){
+            VkBuffer rawBuffer;
+            VkDeviceMemory rawMemory;
+            vkutil::createBuffer(physicalDevice,device,size,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,properties,category,rawBuffer,rawMemory,families);
+            buffer=vkutil::UniqueBuffer(*deletionQueue,rawBuffer);
+            memory=vkutil::UniqueDeviceMemory(*deletionQueue,rawMemory);
+        }
+
+        void createSlots(uint32_t slotCount){
+
+            VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,slotCount*4};
+            VkDescriptorPoolCreateInfo poolInfo{};
+            {
+                poolInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+                poolInfo.poolSizeCount=1;
+                poolInfo.pPoolSizes=&poolSize;
+                poolInfo.maxSets=slotCount;
+            }
+            if(vkCreateDescriptorPool(device,&poolInfo,nullptr,&descriptorPool)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create lighting descriptor pool!");
+            }
+
+            //without lights nothing reads past the header, the lists only need to exist
+            VkDeviceSize frameSize=sizeof(FrameHeader)+sizeof(Light)*std::max(maxLights,1u);
+            VkDeviceSize clusterSize= maxLights>0 ? sizeof(uint32_t)*clusterCount*clusterStride : 16;
+            VkDeviceSize viewLightSize=sizeof(float)*8*std::max(maxLights,1u);
+            const VkMemoryPropertyFlags hostVisible=VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+            slots.resize(slotCount);
+            for(Slot& slot: slots){
+                VkDescriptorSetAllocateInfo allocateInfo{};
+                {
+                    allocateInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                    allocateInfo.descriptorPool=descriptorPool;
+                    allocateInfo.descriptorSetCount=1;
+                    allocateInfo.pSetLayouts=&descriptorSetLayout;
+                }
+                if(vkAllocateDescriptorSets(device,&allocateInfo,&slot.descriptorSet)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to allocate lighting descriptor set!");
+                }
+
+                createBuffer(frameSize,hostVisible,MemoryCategory::Uniforms,slot.frameBuffer,slot.frameMemory,sharedFamilies);
+                createBuffer(clusterSize,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Other,slot.clusterBuffer,slot.clusterMemory);
+                createBuffer(viewLightSize,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Other,slot.viewLightBuffer,slot.viewLightMemory);
+                createBuffer(sizeof(Statistics),hostVisible,MemoryCategory::Readback,slot.statisticsBuffer,slot.statisticsMemory);
+                vkMapMemory(device,slot.frameMemory,0,frameSize,0,reinterpret_cast<void**>(&slot.frame));
+                vkMapMemory(device,slot.statisticsMemory,0,sizeof(Statistics),0,reinterpret_cast<void**>(&slot.statistics));
+                //slots that never get a camera (batch targets) stay unlit
+                memset(slot.frame,0,static_cast<size_t>(frameSize));
+                *slot.statistics=Statistics{};
+
+                VkDescriptorBufferInfo bufferInfos[4]={
+                    {slot.frameBuffer,0,VK_WHOLE_SIZE},
+                    {slot.clusterBuffer,0,VK_WHOLE_SIZE},
+                    {slot.viewLightBuffer,0,VK_WHOLE_SIZE},
+                    {slot.statisticsBuffer,0,VK_WHOLE_SIZE}
+                };
+                VkWriteDescriptorSet writes[4]{};
+                for(uint32_t i=0;i<4;++i){
+                    writes[i].sType=VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    writes[i].dstSet=slot.descriptorSet;
+                    writes[i].dstBinding=i;
+                    writes[i].dstArrayElement=0;
+                    writes[i].descriptorType=VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                    writes[i].descriptorCount=1;
+                    writes[i].pBufferInfo=&bufferInfos[i];
+                }
+                vkUpdateDescriptorSets(device,4,writes,0,nullptr);
+            }
+        }
+
+        VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+        VkDevice device=VK_NULL_HANDLE;
+        DeletionQueue* deletionQueue=nullptr;
+        uint32_t maxLights=0;
+        std::vector<uint32_t> sharedFamilies;
+
+        VkDescriptorSetLayout descriptorSetLayout=VK_NULL_HANDLE;
+        VkDescriptorPool descriptorPool=VK_NULL_HANDLE;
+        vkutil::UniquePipelineLayout pipelineLayout;
+        vkutil::UniquePipeline pipeline;
+        std::vector<Slot> slots;
+        Stats stats;
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "DeletionQueue.h"
+
+#include<vulkan/vulkan.h>
+
+#include<cstddef>
+#include<cstdint>
+#include<iostream>
+#include<stdexcept>
+#include<vector>
+
+//Keeps the graphics command buffer of every frame slot and swapchain image pair, so a frame that would record exactly
+//what the pair recorded last time submits that recording again. Everything that changes per frame (uniforms, instance
+//matrices, culling results) lives in buffers the recording only points at, so a static scene re-records only when the
+//key changes: the render graph or a pipeline was rebuilt, descriptors were rewritten, the draw list changed. A slot's
+//buffers are only reused after its fence was waited on, so none of them is ever pending when it is reset or resubmitted.
+class CommandBufferCache{
+
+    public:
+        struct Stats{
+            uint64_t hits=0;
+            uint64_t recorded=0;    //keyed recordings, because the key changed or the pair had none yet
+            uint64_t uncacheable=0; //frames that had to record because they write something new every frame
+        };
+
+        //FNV-1a over everything the recording depends on besides the slot and the image.
+        class Key{
+            public:
+                Key& add(const void* data, size_t size){
+                    const uint8_t* bytes=static_cast<const uint8_t*>(data);
+                    for(size_t i=0;i<size;++i){
+                        value=(value^bytes[i])*1099511628211ull;
+                    }
+                    return *this;
+                }
+
+                template<typename T>
+                Key& add(const T& value){
+                    return add(&value,sizeof(T));
+                }
+
+                uint64_t get() const{ return value; }
+
+            private:
+                uint64_t value=14695981039346656037ull;
+        };
+
+        void init(VkDevice device, VkCommandPool commandPool, DeletionQueue& deletionQueue, uint32_t slotCount){
+            this->device=device;
+            this->commandPool=commandPool;
+            this->deletionQueue=&deletionQueue;
+            this->slotCount=slotCount;
+        }
+
+        //Allocates a buffer per slot and image. The old ones may still be pending, they are freed once their frames are done.
+        void resize(uint32_t imageCount){
+            release();
+            this->imageCount=imageCount;
+            entries.resize(static_cast<size_t>(slotCount)*imageCount);
+
+            std::vector<VkCommandBuffer> commandBuffers(entries.size());
+            VkCommandBufferAllocateInfo allocInfo{};
+            {
+                allocInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool=commandPool;
+                allocInfo.level=VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandBufferCount=static_cast<uint32_t>(commandBuffers.size());
+            }
+            if(vkAllocateCommandBuffers(device,&allocInfo,commandBuffers.data())!=VK_SUCCESS){
+                throw std::runtime_error("failed to allocate command buffer!");
+            }
+            for(size_t i=0;i<entries.size();++i){
+                entries[i]={commandBuffers[i],0,false};
+            }
+        }
+
+        //Returns true when the pair's buffer already holds a recording with this key, it can be submitted as it is.
+        //Otherwise the buffer is reset and the caller records into it. Recordings that are not cacheable are never reused.
+        bool acquire(uint32_t slot, uint32_t image, uint64_t key, bool cacheable, VkCommandBuffer& commandBuffer){
+            Entry& entry=entries[static_cast<size_t>(slot)*imageCount+image];
+            commandBuffer=entry.commandBuffer;
+            if(cacheable && entry.valid && entry.key==key){
+                ++stats.hits;
+                return true;
+            }
+            vkResetCommandBuffer(commandBuffer,0);
+            entry.key=key;
+            entry.valid=cacheable;
+            ++(cacheable ? stats.recorded : stats.uncacheable);
+            return false;
+        }
+
+        //Drops every recording, for changes the key does not see.
+        void invalidate(){
+            for(Entry& entry: entries){
+                entry.valid=false;
+            }
+        }
+
+        Stats getStats() const{ return stats; }
+
+        void printReport() const{
+            uint64_t frames=stats.hits+stats.recorded+stats.uncacheable;
+            if(frames==0){
+                return;
+            }
+            std::cout<<"command buffers: "<<stats.hits<<" of "<<frames<<" frames reused a recording ("
+                     <<100.0*stats.hits/frames<<"%), "<<stats.recorded<<" recorded, "<<stats.uncacheable<<" not cacheable"<<std::endl;
+        }
+
+    private:
+        struct Entry{
+            VkCommandBuffer commandBuffer=VK_NULL_HANDLE;
+            uint64_t key=0;
+            bool valid=false;
+        };
+
+        void release(){
+            if(entries.empty()){
+                return;
+            }
+            std::vector<VkCommandBuffer> commandBuffers;
+            for(const Entry& entry: entries){
+                commandBuffers.push_back(entry.commandBuffer);
+            }
+            entries.clear();
+            VkDevice device=this->device;
+            VkCommandPool commandPool=this->commandPool;
+            deletionQueue->push([device,commandPool,commandBuffers]{
+                vkFreeCommandBuffers(device,commandPool,static_cast<uint32_t>(commandBuffers.size()),commandBuffers.data());
+            });
+        }
+
+        VkDevice device=VK_NULL_HANDLE;
+        VkCommandPool commandPool=VK_NULL_HANDLE;
+        DeletionQueue* deletionQueue=nullptr;
+        uint32_t slotCount=0;
+        uint32_t imageCount=0;
+        std::vector<Entry> entries;
+        Stats stats;
+};
@@ -0,0 +1,666 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "Profiler.h"
+#include "VulkanUtils.h"
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstddef>
+#include<cstring>
+#include<iostream>
+#include<stdexcept>
+#include<string>
+#include<vector>
+
+//Immediate mode debug drawing: line(), aabb(), sphere(), frustum() and text() can be called anywhere during a frame and
+//only append vertices to two CPU arrays, world space lines and screen space triangles for text and rectangles. upload()
+//copies both into the slot's host visible vertex buffers and writes their vertex counts into the slot's indirect buffer,
+//so the whole lot is two draws however many primitives there are: drawLines() depth tested inside the scene, drawOverlay()
+//on top of the finished image. Because the counts are read from a buffer, a recording stays valid until a vertex buffer
+//has to grow, which getVersion() tells. The font is a 5x7 bitmap inside debug_overlay.frag, there is no texture.
+class DebugDraw{
+
+    public:
+        //Laid out like the vertex inputs of debug_line.vert and debug_overlay.vert.
+        struct LineVertex{
+            float position[3];
+            uint32_t color;
+        };
+
+        struct OverlayVertex{
+            float position[2]; //pixels from the top left corner
+            float glyph[2];    //glyph index*8 + column, row; a negative row fills the quad
+            uint32_t color;
+        };
+
+        struct Stats{
+            uint64_t frames=0;
+            uint64_t lines=0;       //summed over the frames
+            uint64_t triangles=0;
+            uint32_t peakLines=0;
+            uint32_t peakTriangles=0;
+            double uploadMs=0.0;
+        };
+
+        //Glyphs are glyphWidth x glyphHeight pixels at scale 1, text advances by a cell one pixel larger on each side.
+        static constexpr float glyphWidth=5.0f;
+        static constexpr float glyphHeight=7.0f;
+        static constexpr float cellWidth=6.0f;
+        static constexpr float cellHeight=9.0f;
+
+        //R8G8B8A8_UNORM, the byte order of the vertex color.
+        static uint32_t rgba(float r, float g, float b, float a=1.0f){
+            auto channel=[](float value){ return static_cast<uint32_t>(std::clamp(value,0.0f,1.0f)*255.0f+0.5f); };
+            return channel(r) | channel(g)<<8 | channel(b)<<16 | channel(a)<<24;
+        }
+
+        //shaderCode holds the line vertex and fragment and the overlay vertex and fragment shader in that order.
+        void init(VkPhysicalDevice physicalDevice, VkDevice device, DeletionQueue& deletionQueue, uint32_t slotCount,
+                  const std::vector<std::vector<char>>& shaderCode){
+
+            PROFILE_ZONE("DebugDraw::init");
+
+            this->physicalDevice=physicalDevice;
+            this->device=device;
+            this->deletionQueue=&deletionQueue;
+            lineVertexCode=shaderCode.at(0);
+            lineFragmentCode=shaderCode.at(1);
+            overlayVertexCode=shaderCode.at(2);
+            overlayFragmentCode=shaderCode.at(3);
+
+            createLayouts();
+            createSlots(slotCount);
+        }
+
+        //Only valid once the device is idle.
+        void cleanup(){
+            if(device==VK_NULL_HANDLE){
+                return;
+            }
+            if(stats.frames>0){
+                std::cout<<"debug draw: "<<stats.lines/stats.frames<<" lines and "<<stats.triangles/stats.frames<<" triangles per frame on average, "
+                         <<stats.peakLines<<" and "<<stats.peakTriangles<<" at most, upload "<<stats.uploadMs/stats.frames<<" ms per frame"<<std::endl;
+            }
+            slots.clear();
+            linePipeline.reset();
+            overlayPipeline.reset();
+            linePipelineLayout.reset();
+            overlayPipelineLayout.reset();
+            vkDestroyDescriptorPool(device,descriptorPool,nullptr);
+            vkDestroyDescriptorSetLayout(device,descriptorSetLayout,nullptr);
+            device=VK_NULL_HANDLE;
+        }
+
+        //Points the slot's descriptor set at the camera uniforms of that frame slot.
+        void bindSlot(uint32_t slot, VkBuffer uniformBuffer, VkDeviceSize uniformSize){
+            VkDescriptorBufferInfo bufferInfo{uniformBuffer,0,uniformSize};
+            VkWriteDescriptorSet write{};
+            {
+                write.sType=VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.dstSet=slots[slot].descriptorSet;
+                write.dstBinding=0;
+                write.dstArrayElement=0;
+                write.descriptorType=VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                write.descriptorCount=1;
+                write.pBufferInfo=&bufferInfo;
+            }
+            vkUpdateDescriptorSets(device,1,&write,0,nullptr);
+        }
+
+        //Recreate the pipelines when the render passes of their graph passes changed.
+        void setLineRenderPass(VkRenderPass renderPass){
+            if(renderPass==currentLineRenderPass && linePipeline.get()!=VK_NULL_HANDLE){
+                return;
+            }
+            linePipeline=createPipeline(renderPass,lineVertexCode,lineFragmentCode,linePipelineLayout,true);
+            currentLineRenderPass=renderPass;
+        }
+
+        void setOverlayRenderPass(VkRenderPass renderPass){
+            if(renderPass==currentOverlayRenderPass && overlayPipeline.get()!=VK_NULL_HANDLE){
+                return;
+            }
+            overlayPipeline=createPipeline(renderPass,overlayVertexCode,overlayFragmentCode,overlayPipelineLayout,false);
+            currentOverlayRenderPass=renderPass;
+        }
+
+        //Camera that text() projects world positions with, a column major view projection matrix, and the extent of the
+        //target the overlay is drawn into.
+        void setCamera(const float* viewProjection, VkExtent2D extent){
+            std::copy(viewProjection,viewProjection+16,camera);
+            overlayExtent=extent;
+        }
+
+        void line(const float* a, const float* b, uint32_t color){
+            LineVertex* out=appendLines(1);
+            out[0]={{a[0],a[1],a[2]},color};
+            out[1]={{b[0],b[1],b[2]},color};
+        }
+
+        //Twelve edges of an axis aligned box.
+        void aabb(const float* min, const float* max, uint32_t color){
+            LineVertex* out=appendLines(12);
+            for(int axis=0;axis<3;++axis){
+                int u=(axis+1)%3, v=(axis+2)%3;
+                for(int corner=0;corner<4;++corner){
+                    float start[3], end[3];
+                    start[axis]=min[axis];
+                    end[axis]=max[axis];
+                    start[u]=end[u]= (corner & 1) ? max[u] : min[u];
+                    start[v]=end[v]= (corner & 2) ? max[v] : min[v];
+                    *out++={{start[0],start[1],start[2]},color};
+                    *out++={{end[0],end[1],end[2]},color};
+                }
+            }
+        }
+
+        //Three circles around the axes.
+        void sphere(const float* center, float radius, uint32_t color){
+            static const std::vector<float> circle=circleTable();
+            LineVertex* out=appendLines(3*circleSegments);
+            for(int axis=0;axis<3;++axis){
+                int u=(axis+1)%3, v=(axis+2)%3;
+                for(uint32_t i=0;i<circleSegments;++i){
+                    for(uint32_t end=0;end<2;++end){
+                        float point[3]={center[0],center[1],center[2]};
+                        point[u]+=radius*circle[(i+end)*2];
+                        point[v]+=radius*circle[(i+end)*2+1];
+                        *out++={{point[0],point[1],point[2]},color};
+                    }
+                }
+            }
+        }
+
+        //Edges of the volume a camera sees, from the inverse of its view projection (depth from 0 to 1 like Vulkan's).
+        void frustum(const float* inverseViewProjection, uint32_t color){
+            float corners[8][3];
+            for(int i=0;i<8;++i){
+                float ndc[4]={(i & 1) ? 1.0f : -1.0f,(i & 2) ? 1.0f : -1.0f,(i & 4) ? 1.0f : 0.0f,1.0f};
+                float world[4];
+                transform(inverseViewProjection,ndc,world);
+                for(int c=0;c<3;++c){
+                    corners[i][c]=world[c]/world[3];
+                }
+            }
+            //corner indices differ in one bit along every edge
+            LineVertex* out=appendLines(12);
+            for(int i=0;i<8;++i){
+                for(int bit=1;bit<8;bit<<=1){
+                    if(i & bit){
+                        continue;
+                    }
+                    *out++={{corners[i][0],corners[i][1],corners[i][2]},color};
+                    *out++={{corners[i|bit][0],corners[i|bit][1],corners[i|bit][2]},color};
+                }
+            }
+        }
+
+        //Screen aligned text starting at the projection of a world position, nothing when that is behind the camera.
+        void text(const float* position, const std::string& string, uint32_t color, float scale=1.0f){
+            float world[4]={position[0],position[1],position[2],1.0f};
+            float clip[4];
+            transform(camera,world,clip);
+            if(clip[3]<=0.0f){
+                return;
+            }
+            float x=(clip[0]/clip[3]*0.5f+0.5f)*overlayExtent.width;
+            float y=(clip[1]/clip[3]*0.5f+0.5f)*overlayExtent.height;
+            screenText(std::floor(x),std::floor(y),string,color,scale);
+        }
+
+        //Text with its top left corner at x, y pixels, '\n' starts a new line. Characters outside ASCII 32-126 show as '?'.
+        void screenText(float x, float y, const std::string& string, uint32_t color, float scale=1.0f){
+            OverlayVertex* out=appendTriangles(2*static_cast<uint32_t>(string.size()));
+            float left=x;
+            uint32_t written=0;
+            for(char character: string){
+                if(character=='\n'){
+                    x=left;
+                    y+=cellHeight*scale;
+                    continue;
+                }
+                if(character!=' '){
+                    int index= character>=32 && character<=126 ? character-32 : '?'-32;
+                    out=quad(out,x,y,glyphWidth*scale,glyphHeight*scale,static_cast<float>(index*8),0.0f,color);
+                    ++written;
+                }
+                x+=cellWidth*scale;
+            }
+            //spaces and line breaks took no quad
+            overlayVertexCount-=(static_cast<uint32_t>(string.size())-written)*6;
+        }
+
+        //Filled rectangle in pixels, for backgrounds behind text.
+        void rect(float x, float y, float width, float height, uint32_t color){
+            quad(appendTriangles(2),x,y,width,height,0.0f,-1.0f,color);
+        }
+
+        //Copies what was drawn since the last upload into the slot's buffers and starts over. The slot's fence must have
+        //been waited on, its buffers are not read by the GPU anymore.
+        void upload(uint32_t slot){
+
+            PROFILE_ZONE("DebugDraw::upload");
+
+            auto start=std::chrono::steady_clock::now();
+            Slot& state=slots[slot];
+            reserve(state.lines,lineVertexCount*sizeof(LineVertex));
+            reserve(state.overlay,overlayVertexCount*sizeof(OverlayVertex));
+            memcpy(state.lines.mapped,lineVertices.data(),lineVertexCount*sizeof(LineVertex));
+            memcpy(state.overlay.mapped,overlayVertices.data(),overlayVertexCount*sizeof(OverlayVertex));
+            state.draws[0].vertexCount=lineVertexCount;
+            state.draws[1].vertexCount=overlayVertexCount;
+
+            uint32_t lines=lineVertexCount/2, triangles=overlayVertexCount/3;
+            ++stats.frames;
+            stats.lines+=lines;
+            stats.triangles+=triangles;
+            stats.peakLines=std::max(stats.peakLines,lines);
+            stats.peakTriangles=std::max(stats.peakTriangles,triangles);
+            lineVertexCount=0;
+            overlayVertexCount=0;
+            stats.uploadMs+=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+        }
+
+        //Inside a render pass compatible with the one given to setLineRenderPass(), with the scene's depth attached.
+        void drawLines(VkCommandBuffer commandBuffer, uint32_t slot, VkExtent2D extent){
+            Slot& state=slots[slot];
+            VkViewport viewport{0.0f,0.0f,static_cast<float>(extent.width),static_cast<float>(extent.height),0.0f,1.0f};
+            VkRect2D scissor{{0,0},extent};
+            VkDeviceSize offset=0;
+            VkBuffer vertexBuffer=state.lines.buffer;
+            vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,linePipeline);
+            vkCmdSetViewport(commandBuffer,0,1,&viewport);
+            vkCmdSetScissor(commandBuffer,0,1,&scissor);
+            vkCmdBindDescriptorSets(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,linePipelineLayout,0,1,&state.descriptorSet,0,nullptr);
+            vkCmdBindVertexBuffers(commandBuffer,0,1,&vertexBuffer,&offset);
+            vkCmdDrawIndirect(commandBuffer,state.drawBuffer,0,1,sizeof(VkDrawIndirectCommand));
+        }
+
+        //Inside a render pass compatible with the one given to setOverlayRenderPass(), extent is its target's.
+        void drawOverlay(VkCommandBuffer commandBuffer, uint32_t slot, VkExtent2D extent){
+            Slot& state=slots[slot];
+            VkViewport viewport{0.0f,0.0f,static_cast<float>(extent.width),static_cast<float>(extent.height),0.0f,1.0f};
+            VkRect2D scissor{{0,0},extent};
+            float pixelToNdc[2]={2.0f/extent.width,2.0f/extent.height};
+            VkDeviceSize offset=0;
+            VkBuffer vertexBuffer=state.overlay.buffer;
+            vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,overlayPipeline);
+            vkCmdSetViewport(commandBuffer,0,1,&viewport);
+            vkCmdSetScissor(commandBuffer,0,1,&scissor);
+            vkCmdPushConstants(commandBuffer,overlayPipelineLayout,VK_SHADER_STAGE_VERTEX_BIT,0,sizeof(pixelToNdc),pixelToNdc);
+            vkCmdBindVertexBuffers(commandBuffer,0,1,&vertexBuffer,&offset);
+            vkCmdDrawIndirect(commandBuffer,state.drawBuffer,sizeof(VkDrawIndirectCommand),1,sizeof(VkDrawIndirectCommand));
+        }
+
+        //Changes whenever a vertex buffer was replaced by a larger one, recordings made before point at the old one.
+        uint64_t getVersion() const{ return version; }
+        Stats getStats() const{ return stats; }
+
+    private:
+        static constexpr uint32_t circleSegments=16;
+        static constexpr VkDeviceSize initialBufferSize=1u<<20;
+
+        struct VertexBuffer{
+            vkutil::UniqueBuffer buffer;
+            vkutil::UniqueDeviceMemory memory;
+            VkDeviceSize size=0;
+            void* mapped=nullptr;
+        };
+
+        struct Slot{
+            VkDescriptorSet descriptorSet=VK_NULL_HANDLE;
+            VertexBuffer lines;
+            VertexBuffer overlay;
+            vkutil::UniqueBuffer drawBuffer;
+            vkutil::UniqueDeviceMemory drawMemory;
+            VkDrawIndirectCommand* draws=nullptr; //lines, overlay
+        };
+
+        static std::vector<float> circleTable(){
+            std::vector<float> table;
+            for(uint32_t i=0;i<=circleSegments;++i){
+                float angle=6.2831853f*i/circleSegments;
+                table.push_back(std::cos(angle));
+                table.push_back(std::sin(angle));
+            }
+            return table;
+        }
+
+        //Column major matrix times vector.
+        static void transform(const float* matrix, const float* vector, float* result){
+            for(int row=0;row<4;++row){
+                result[row]=matrix[row]*vector[0]+matrix[4+row]*vector[1]+matrix[8+row]*vector[2]+matrix[12+row]*vector[3];
+            }
+        }
+
+        //The arrays only grow and are never cleared, appending is a size check and plain stores.
+        LineVertex* appendLines(uint32_t count){
+            uint32_t needed=lineVertexCount+count*2;
+            if(needed>lineVertices.size()){
+                lineVertices.resize(std::max<size_t>(needed,lineVertices.size()*2));
+            }
+            LineVertex* out=lineVertices.data()+lineVertexCount;
+            lineVertexCount=needed;
+            return out;
+        }
+
+        OverlayVertex* appendTriangles(uint32_t count){
+            uint32_t needed=overlayVertexCount+count*3;
+            if(needed>overlayVertices.size()){
+                overlayVertices.resize(std::max<size_t>(needed,overlayVertices.size()*2));
+            }
+            OverlayVertex* out=overlayVertices.data()+overlayVertexCount;
+            overlayVertexCount=needed;
+            return out;
+        }
+
+        static OverlayVertex* quad(OverlayVertex* out, float x, float y, float width, float height, float glyphX, float glyphY, uint32_t color){
+            //a fill has a constant negative row, a glyph spans its five columns and seven rows
+            float glyphRight= glyphY<0.0f ? glyphX : glyphX+glyphWidth;
+            float glyphBottom= glyphY<0.0f ? glyphY : glyphHeight;
+            OverlayVertex topLeft{{x,y},{glyphX,glyphY},color};
+            OverlayVertex topRight{{x+width,y},{glyphRight,glyphY},color};
+            OverlayVertex bottomLeft{{x,y+height},{glyphX,glyphBottom},color};
+            OverlayVertex bottomRight{{x+width,y+height},{glyphRight,glyphBottom},color};
+            *out++=topLeft;
+            *out++=bottomLeft;
+            *out++=topRight;
+            *out++=topRight;
+            *out++=bottomLeft;
+            *out++=bottomRight;
+            return out;
+        }
+
+        //Replaces the buffer by one at least twice as large when size does not fit. The version change drops the
+        //recordings that point at the old one, the deletion queue frees it.
+        void reserve(VertexBuffer& vertexBuffer, VkDeviceSize size){
+            if(size<=vertexBuffer.size){
+                return;
+            }
+            createVertexBuffer(vertexBuffer,std::max(size,vertexBuffer.size*2));
+            ++version;
+        }
+
+        void createVertexBuffer(VertexBuffer& vertexBuffer, VkDeviceSize size){
+            VkBuffer buffer;
+            VkDeviceMemory memory;
+            vkutil::createBuffer(physicalDevice,device,size,VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,MemoryCategory::Geometry,buffer,memory);
+            vertexBuffer.buffer=vkutil::UniqueBuffer(*deletionQueue,buffer);
+            vertexBuffer.memory=vkutil::UniqueDeviceMemory(*deletionQueue,memory);
+            vertexBuffer.size=size;
+            vkMapMemory(device,memory,0,size,0,&vertexBuffer.mapped);
+        }
+
+        void createLayouts(){
+
+            VkDescriptorSetLayoutBinding binding{};
+            {
+                binding.binding=0;
+                binding.descriptorType=VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                binding.descriptorCount=1;
+                binding.stageFlags=VK_SHADER_STAGE_VERTEX_BIT;
+            }
+            VkDescriptorSetLayoutCreateInfo layoutInfo{};
+            {
+                layoutInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+                layoutInfo.bindingCount=1;
+                layoutInfo.pBindings=&binding;
+            }
+            if(vkCreateDescriptorSetLayout(device,&layoutInfo,nullptr,&descriptorSetLayout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create debug draw descriptor set layout!");
+            }
+
+            VkPipelineLayoutCreateInfo lineLayoutInfo{};
+            {
+                lineLayoutInfo.sType=VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                lineLayoutInfo.setLayoutCount=1;
+                lineLayoutInfo.pSetLayouts=&descriptorSetLayout;
+            }
+            VkPipelineLayout layout;
+            if(vkCreatePipelineLayout(device,&lineLayoutInfo,nullptr,&layout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create debug line pipeline layout!");
+            }
+            linePipelineLayout=vkutil::UniquePipelineLayout(*deletionQueue,layout);
+
+            VkPushConstantRange pushConstant{VK_SHADER_STAGE_VERTEX_BIT,0,sizeof(float)*2};
+            VkPipelineLayoutCreateInfo overlayLayoutInfo{};
+            {
+                overlayLayoutInfo.sType=VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                overlayLayoutInfo.pushConstantRangeCount=1;
+                overlayLayoutInfo.pPushConstantRanges=&pushConstant;
+            }
+            if(vkCreatePipelineLayout(device,&overlayLayoutInfo,nullptr,&layout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create debug overlay pipeline layout!");
+            }
+            overlayPipelineLayout=vkutil::UniquePipelineLayout(*deletionQueue,layout);
+        }
+
+        void createSlots(uint32_t slotCount){
+
+            VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,slotCount};
+            VkDescriptorPoolCreateInfo poolInfo{};
+            {
+                poolInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+                poolInfo.poolSizeCount=1;
+                poolInfo.pPoolSizes=&poolSize;
+                poolInfo.maxSets=slotCount;
+            }
+            if(vkCreateDescriptorPool(device,&poolInfo,nullptr,&descriptorPool)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create debug draw descriptor pool!");
+            }
+
+            slots.resize(slotCount);
+            for(Slot& slot: slots){
+                VkDescriptorSetAllocateInfo allocateInfo{};
+                {
+                    allocateInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                    allocateInfo.descriptorPool=descriptorPool;
+                    allocateInfo.descriptorSetCount=1;
+                    allocateInfo.pSetLayouts=&descriptorSetLayout;
+                }
+                if(vkAllocateDescriptorSets(device,&allocateInfo,&slot.descriptorSet)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to allocate debug draw descriptor set!");
+                }
+
+                createVertexBuffer(slot.lines,initialBufferSize);
+                createVertexBuffer(slot.overlay,initialBufferSize/4);
+
+                //both draws start out empty, slots that never upload (batch targets) draw nothing
+                VkBuffer buffer;
+                VkDeviceMemory memory;
+                vkutil::createBuffer(physicalDevice,device,sizeof(VkDrawIndirectCommand)*2,VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,MemoryCategory::Other,buffer,memory);
+                slot.drawBuffer=vkutil::UniqueBuffer(*deletionQueue,buffer);
+                slot.drawMemory=vkutil::UniqueDeviceMemory(*deletionQueue,memory);
+                vkMapMemory(device,memory,0,sizeof(VkDrawIndirectCommand)*2,0,reinterpret_cast<void**>(&slot.draws));
+                for(int i=0;i<2;++i){
+                    slot.draws[i]={0,1,0,0};
+                }
+            }
+        }
+
+        VkShaderModule createShaderModule(const std::vector<char>& code){
+            VkShaderModuleCreateInfo moduleInfo{};
+            {
+                moduleInfo.sType=VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+                moduleInfo.codeSize=code.size();
+                moduleInfo.pCode=reinterpret_cast<const uint32_t*>(code.data());
+            }
+            VkShaderModule shaderModule;
+            if(vkCreateShaderModule(device,&moduleInfo,nullptr,&shaderModule)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create shader module!");
+            }
+            return shaderModule;
+        }
+
+        //Alpha blended in both cases. Lines are tested against the scene's depth without writing it, the overlay ignores depth.
+        vkutil::UniquePipeline createPipeline(VkRenderPass renderPass, const std::vector<char>& vertexCode, const std::vector<char>& fragmentCode,
+                                              VkPipelineLayout layout, bool lines){
+
+            VkShaderModule vertShaderModule=createShaderModule(vertexCode);
+            VkShaderModule fragShaderModule=createShaderModule(fragmentCode);
+
+            VkPipelineShaderStageCreateInfo shaderStages[2]{};
+            {
+                shaderStages[0].sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                shaderStages[0].stage=VK_SHADER_STAGE_VERTEX_BIT;
+                shaderStages[0].module=vertShaderModule;
+                shaderStages[0].pName="main";
+                shaderStages[1].sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                shaderStages[1].stage=VK_SHADER_STAGE_FRAGMENT_BIT;
+                shaderStages[1].module=fragShaderModule;
+                shaderStages[1].pName="main";
+            }
+
+            VkDynamicState dynamicStates[2]={VK_DYNAMIC_STATE_VIEWPORT,VK_DYNAMIC_STATE_SCISSOR};
+            VkPipelineDynamicStateCreateInfo dynamicState{};
+            {
+                dynamicState.sType=VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+                dynamicState.dynamicStateCount=2;
+                dynamicState.pDynamicStates=dynamicStates;
+            }
+
+            VkVertexInputBindingDescription bindingDescription{};
+            {
+                bindingDescription.binding=0;
+                bindingDescription.stride= lines ? sizeof(LineVertex) : sizeof(OverlayVertex);
+                bindingDescription.inputRate=VK_VERTEX_INPUT_RATE_VERTEX;
+            }
+            std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+            if(lines){
+                attributeDescriptions={
+                    {0,0,VK_FORMAT_R32G32B32_SFLOAT,offsetof(LineVertex,position)},
+                    {1,0,VK_FORMAT_R8G8B8A8_UNORM,offsetof(LineVertex,color)}
+                };
+            }
+            else{
+                attributeDescriptions={
+                    {0,0,VK_FORMAT_R32G32_SFLOAT,offsetof(OverlayVertex,position)},
+                    {1,0,VK_FORMAT_R32G32_SFLOAT,offsetof(OverlayVertex,glyph)},
+                    {2,0,VK_FORMAT_R8G8B8A8_UNORM,offsetof(OverlayVertex,color)}
+                };
+            }
+            VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+            {
+                vertexInputInfo.sType=VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+                vertexInputInfo.vertexBindingDescriptionCount=1;
+                vertexInputInfo.pVertexBindingDescriptions=&bindingDescription;
+                vertexInputInfo.vertexAttributeDescriptionCount=static_cast<uint32_t>(attributeDescriptions.size());
+                vertexInputInfo.pVertexAttributeDescriptions=attributeDescriptions.data();
+            }
+
+            VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+            {
+                inputAssembly.sType=VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+                inputAssembly.topology= lines ? VK_PRIMITIVE_TOPOLOGY_LINE_LIST : VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+                inputAssembly.primitiveRestartEnable=VK_FALSE;
+            }
+
+            VkPipelineViewportStateCreateInfo viewportState{};
+            {
+                viewportState.sType=VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+                viewportState.viewportCount=1;
+                viewportState.scissorCount=1;
+            }
+
+            VkPipelineRasterizationStateCreateInfo rasterizer{};
+            {
+                rasterizer.sType=VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+                rasterizer.polygonMode=VK_POLYGON_MODE_FILL;
+                rasterizer.lineWidth=1.0f;
+                rasterizer.cullMode=VK_CULL_MODE_NONE;
+                rasterizer.frontFace=VK_FRONT_FACE_COUNTER_CLOCKWISE;
+            }
+
+            VkPipelineMultisampleStateCreateInfo multisampling{};
+            {
+                multisampling.sType=VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+                multisampling.rasterizationSamples=VK_SAMPLE_COUNT_1_BIT;
+            }
+
+            VkPipelineDepthStencilStateCreateInfo depthStencil{};
+            {
+                depthStencil.sType=VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+                depthStencil.depthTestEnable= lines ? VK_TRUE : VK_FALSE;
+                depthStencil.depthWriteEnable=VK_FALSE;
+                depthStencil.depthCompareOp=VK_COMPARE_OP_LESS_OR_EQUAL;
+            }
+
+            VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+            {
+                colorBlendAttachment.colorWriteMask=VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+                colorBlendAttachment.blendEnable=VK_TRUE;
+                colorBlendAttachment.srcColorBlendFactor=VK_BLEND_FACTOR_SRC_ALPHA;
+                colorBlendAttachment.dstColorBlendFactor=VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+                colorBlendAttachment.colorBlendOp=VK_BLEND_OP_ADD;
+                colorBlendAttachment.srcAlphaBlendFactor=VK_BLEND_FACTOR_ZERO;
+                colorBlendAttachment.dstAlphaBlendFactor=VK_BLEND_FACTOR_ONE;
+                colorBlendAttachment.alphaBlendOp=VK_BLEND_OP_ADD;
+            }
+
+            VkPipelineColorBlendStateCreateInfo colorBlending{};
+            {
+                colorBlending.sType=VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+                colorBlending.attachmentCount=1;
+                colorBlending.pAttachments=&colorBlendAttachment;
+            }
+
+            VkGraphicsPipelineCreateInfo pipelineInfo{};
+            {
+                pipelineInfo.sType=VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+                pipelineInfo.stageCount=2;
+                pipelineInfo.pStages=shaderStages;
+                pipelineInfo.pVertexInputState=&vertexInputInfo;
+                pipelineInfo.pInputAssemblyState=&inputAssembly;
+                pipelineInfo.pViewportState=&viewportState;
+                pipelineInfo.pRasterizationState=&rasterizer;
+                pipelineInfo.pMultisampleState=&multisampling;
+                pipelineInfo.pDepthStencilState=&depthStencil;
+                pipelineInfo.pColorBlendState=&colorBlending;
+                pipelineInfo.pDynamicState=&dynamicState;
+                pipelineInfo.layout=layout;
+                pipelineInfo.renderPass=renderPass;
+                pipelineInfo.subpass=0;
+            }
+            VkPipeline pipeline;
+            VkResult result=vkCreateGraphicsPipelines(device,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&pipeline);
+            vkDestroyShaderModule(device,vertShaderModule,nullptr);
+            vkDestroyShaderModule(device,fragShaderModule,nullptr);
+            if(result!=VK_SUCCESS){
+                throw std::runtime_error("failed to create debug draw pipeline!");
+            }
+            return vkutil::UniquePipeline(*deletionQueue,pipeline);
+        }
+
+        VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+        VkDevice device=VK_NULL_HANDLE;
+        DeletionQueue* deletionQueue=nullptr;
+
+        VkDescriptorSetLayout descriptorSetLayout=VK_NULL_HANDLE;
+        VkDescriptorPool descriptorPool=VK_NULL_HANDLE;
+        vkutil::UniquePipelineLayout linePipelineLayout;
+        vkutil::UniquePipelineLayout overlayPipelineLayout;
+        vkutil::UniquePipeline linePipeline;
+        vkutil::UniquePipeline overlayPipeline;
+        VkRenderPass currentLineRenderPass=VK_NULL_HANDLE;
+        VkRenderPass currentOverlayRenderPass=VK_NULL_HANDLE;
+        std::vector<char> lineVertexCode;
+        std::vector<char> lineFragmentCode;
+        std::vector<char> overlayVertexCode;
+        std::vector<char> overlayFragmentCode;
+        std::vector<Slot> slots;
+
+        std::vector<LineVertex> lineVertices;
+        std::vector<OverlayVertex> overlayVertices;
+        uint32_t lineVertexCount=0;
+        uint32_t overlayVertexCount=0;
+        float camera[16]={};
+        VkExtent2D overlayExtent{};
+        uint64_t version=0;
+        Stats stats;
+};
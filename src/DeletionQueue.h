@@ -0,0 +1,124 @@
+#pragma once
+
+#include "MemoryTracker.h"
+
+#include<vulkan/vulkan.h>
+
+#include<deque>
+#include<functional>
+#include<utility>
+
+//Destroys Vulkan objects once the GPU is done with them. Everything queued while a frame is being recorded waits
+//until that frame's fence has signaled, so resources can be released at runtime without waiting for the device to idle.
+//Only used from the render thread.
+class DeletionQueue{
+
+    public:
+        void init(VkDevice device){
+            this->device=device;
+        }
+
+        VkDevice getDevice() const{ return device; }
+
+        //Number of the frame that is recorded next, objects queued from now on may be used by it.
+        void beginFrame(uint64_t frame){
+            currentFrame=frame;
+        }
+
+        void push(std::function<void()> destroy){
+            entries.push_back({currentFrame,std::move(destroy)});
+        }
+
+        //Frames up to and including completedFrame have finished on the GPU.
+        void flush(uint64_t completedFrame){
+            while(!entries.empty() && entries.front().frame<=completedFrame){
+                entries.front().destroy();
+                entries.pop_front();
+            }
+        }
+
+        //Only valid once the device is idle.
+        void flushAll(){
+            while(!entries.empty()){
+                entries.front().destroy();
+                entries.pop_front();
+            }
+        }
+
+        size_t size() const{ return entries.size(); }
+
+    private:
+        struct Entry{
+            uint64_t frame;
+            std::function<void()> destroy;
+        };
+
+        VkDevice device=VK_NULL_HANDLE;
+        uint64_t currentFrame=0;
+        std::deque<Entry> entries; //frames are non decreasing, so the front is always the oldest
+};
+
+namespace vkutil{
+
+    //Owning Vulkan handle. Resetting, reassigning or destroying the wrapper hands the object to the deletion queue
+    //instead of destroying it right away, frames that are still in flight may reference it.
+    template<typename T, void (VKAPI_PTR *Destroy)(VkDevice,T,const VkAllocationCallbacks*)>
+    class UniqueHandle{
+
+        public:
+            UniqueHandle()=default;
+            UniqueHandle(DeletionQueue& deletionQueue, T handle): deletionQueue(&deletionQueue), handle(handle){}
+
+            UniqueHandle(const UniqueHandle&)=delete;
+            UniqueHandle& operator=(const UniqueHandle&)=delete;
+
+            UniqueHandle(UniqueHandle&& other) noexcept: deletionQueue(other.deletionQueue), handle(other.release()){}
+
+            UniqueHandle& operator=(UniqueHandle&& other) noexcept{
+                if(this!=&other){
+                    reset();
+                    deletionQueue=other.deletionQueue;
+                    handle=other.release();
+                }
+                return *this;
+            }
+
+            ~UniqueHandle(){
+                reset();
+            }
+
+            T get() const{ return handle; }
+            operator T() const{ return handle; }
+
+            T release(){
+                T released=handle;
+                handle=VK_NULL_HANDLE;
+                return released;
+            }
+
+            void reset(){
+                if(handle==VK_NULL_HANDLE){
+                    return;
+                }
+                VkDevice device=deletionQueue->getDevice();
+                T destroyed=handle;
+                deletionQueue->push([device,destroyed]{ Destroy(device,destroyed,nullptr); });
+                handle=VK_NULL_HANDLE;
+            }
+
+        private:
+            DeletionQueue* deletionQueue=nullptr;
+            T handle=VK_NULL_HANDLE;
+    };
+
+    using UniqueBuffer=UniqueHandle<VkBuffer,vkDestroyBuffer>;
+    using UniqueImage=UniqueHandle<VkImage,vkDestroyImage>;
+    using UniqueImageView=UniqueHandle<VkImageView,vkDestroyImageView>;
+    using UniqueDeviceMemory=UniqueHandle<VkDeviceMemory,freeMemory>;
+    using UniqueSampler=UniqueHandle<VkSampler,vkDestroySampler>;
+    using UniquePipeline=UniqueHandle<VkPipeline,vkDestroyPipeline>;
+    using UniquePipelineLayout=UniqueHandle<VkPipelineLayout,vkDestroyPipelineLayout>;
+    using UniqueRenderPass=UniqueHandle<VkRenderPass,vkDestroyRenderPass>;
+    using UniqueFramebuffer=UniqueHandle<VkFramebuffer,vkDestroyFramebuffer>;
+    using UniqueSwapchain=UniqueHandle<VkSwapchainKHR,vkDestroySwapchainKHR>;
+}
@@ -0,0 +1,364 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "DeviceInfo.h"
+#include "Profiler.h"
+#include "VulkanUtils.h"
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<stdexcept>
+#include<vector>
+
+//Hi-Z pyramid for occlusion culling: an R32_SFLOAT mip chain where every texel holds the farthest depth of the area it
+//covers. Level 0 is half the size of the depth buffer and every level halves again, rounding down, until 1x1.
+//The image outlives the frame that built it, the culling of the next frame tests against it before the new depth exists.
+//It stays in VK_IMAGE_LAYOUT_GENERAL, written as a storage image and read with texelFetch.
+class DepthPyramid{
+
+    public:
+        static constexpr VkFormat format=VK_FORMAT_R32_SFLOAT;
+        static constexpr uint32_t maxLevels=16;
+
+        //The depth buffer is read with a sampler, which needs a depth only format that supports sampling.
+        static bool supportsDepthFormat(VkPhysicalDevice physicalDevice, VkFormat depthFormat){
+            if(depthFormat!=VK_FORMAT_D32_SFLOAT && depthFormat!=VK_FORMAT_D16_UNORM){
+                return false;
+            }
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice,depthFormat,&properties);
+            return properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+        }
+
+        void init(const DeviceInfo& deviceInfo, VkDevice device, DeletionQueue& deletionQueue, uint32_t slotCount, const std::vector<char>& shaderCode){
+
+            PROFILE_ZONE("DepthPyramid::init");
+
+            this->physicalDevice=deviceInfo.physicalDevice;
+            this->device=device;
+            this->deletionQueue=&deletionQueue;
+
+            VkSamplerCreateInfo samplerInfo{};
+            {
+                samplerInfo.sType=VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+                samplerInfo.magFilter=VK_FILTER_NEAREST;
+                samplerInfo.minFilter=VK_FILTER_NEAREST;
+                samplerInfo.mipmapMode=VK_SAMPLER_MIPMAP_MODE_NEAREST;
+                samplerInfo.addressModeU=VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+                samplerInfo.addressModeV=VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+                samplerInfo.addressModeW=VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+                samplerInfo.minLod=0.0f;
+                samplerInfo.maxLod=VK_LOD_CLAMP_NONE;
+            }
+            VkSampler rawSampler;
+            if(vkCreateSampler(device,&samplerInfo,nullptr,&rawSampler)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create depth pyramid sampler!");
+            }
+            sampler=vkutil::UniqueSampler(deletionQueue,rawSampler);
+
+            createPipeline(shaderCode);
+            createDescriptorSets(slotCount);
+        }
+
+        //Only valid once the device is idle.
+        void cleanup(){
+            if(device==VK_NULL_HANDLE){
+                return;
+            }
+            levelViews.clear();
+            view.reset();
+            image.reset();
+            memory.reset();
+            sampler.reset();
+            pipeline.reset();
+            pipelineLayout.reset();
+            slots.clear();
+            vkDestroyDescriptorPool(device,descriptorPool,nullptr);
+            vkDestroyDescriptorSetLayout(device,descriptorSetLayout,nullptr);
+            device=VK_NULL_HANDLE;
+        }
+
+        //(Re)creates the pyramid for a depth buffer of the given size. The old image stays alive for the frames in flight,
+        //the new one holds nothing until the first build() has run.
+        void resize(VkExtent2D depthExtent){
+            if(image.get()!=VK_NULL_HANDLE && depthExtent.width==this->depthExtent.width && depthExtent.height==this->depthExtent.height){
+                return;
+            }
+
+            PROFILE_ZONE("DepthPyramid::resize");
+
+            this->depthExtent=depthExtent;
+            contentExtent=depthExtent;
+            extent={std::max(depthExtent.width/2,1u),std::max(depthExtent.height/2,1u)};
+            levelCount=1;
+            while(levelCount<maxLevels && std::max(extent.width,extent.height)>>levelCount>0){
+                ++levelCount;
+            }
+
+            levelViews.clear();
+            view.reset();
+            image.reset();
+            memory.reset();
+
+            VkImageCreateInfo imageInfo{};
+            {
+                imageInfo.sType=VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType=VK_IMAGE_TYPE_2D;
+                imageInfo.extent={extent.width,extent.height,1};
+                imageInfo.mipLevels=levelCount;
+                imageInfo.arrayLayers=1;
+                imageInfo.format=format;
+                imageInfo.tiling=VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.initialLayout=VK_IMAGE_LAYOUT_UNDEFINED;
+                imageInfo.usage=VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+                imageInfo.samples=VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.sharingMode=VK_SHARING_MODE_EXCLUSIVE;
+            }
+            VkImage rawImage;
+            VkDeviceMemory rawMemory;
+            vkutil::createImage(physicalDevice,device,imageInfo,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Attachments,rawImage,rawMemory);
+            image=vkutil::UniqueImage(*deletionQueue,rawImage);
+            memory=vkutil::UniqueDeviceMemory(*deletionQueue,rawMemory);
+
+            view=vkutil::UniqueImageView(*deletionQueue,createView(0,levelCount));
+            for(uint32_t level=0;level<levelCount;++level){
+                levelViews.emplace_back(*deletionQueue,createView(level,1));
+            }
+
+            ++generation;
+            valid=false;
+            initialized=false;
+        }
+
+        //Call before the frame's graph executes. Points the slot's descriptor sets at the current depth buffer and
+        //pyramid levels (the slot's previous frame has finished) and moves a new image out of the undefined layout.
+        void prepare(VkCommandBuffer commandBuffer, uint32_t slot, VkImageView depthView){
+            Slot& current=slots[slot];
+            if(current.generation!=generation || current.depthView!=depthView){
+                std::vector<VkDescriptorImageInfo> imageInfos(levelCount*2);
+                std::vector<VkWriteDescriptorSet> writes(levelCount*2);
+                for(uint32_t level=0;level<levelCount;++level){
+                    imageInfos[level*2]={sampler,level==0 ? depthView : levelViews[level-1].get(),
+                                         level==0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL};
+                    imageInfos[level*2+1]={VK_NULL_HANDLE,levelViews[level],VK_IMAGE_LAYOUT_GENERAL};
+                    for(uint32_t binding=0;binding<2;++binding){
+                        VkWriteDescriptorSet& write=writes[level*2+binding];
+                        write.sType=VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                        write.dstSet=current.descriptorSets[level];
+                        write.dstBinding=binding;
+                        write.dstArrayElement=0;
+                        write.descriptorType= binding==0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                        write.descriptorCount=1;
+                        write.pImageInfo=&imageInfos[level*2+binding];
+                    }
+                }
+                vkUpdateDescriptorSets(device,static_cast<uint32_t>(writes.size()),writes.data(),0,nullptr);
+                current.generation=generation;
+                current.depthView=depthView;
+            }
+
+            if(!initialized){
+                vkutil::imageBarrier(commandBuffer,image,VK_IMAGE_ASPECT_COLOR_BIT,0,levelCount,VK_IMAGE_LAYOUT_UNDEFINED,VK_IMAGE_LAYOUT_GENERAL,
+                                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,0,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+                initialized=true;
+            }
+        }
+
+        //Reduces the depth buffer level by level. The graph has put the depth buffer in the shader read layout and the
+        //pyramid behind a barrier, the levels wait on each other with a barrier per level. contentExtent is the part of
+        //the depth buffer the frame drew into when it rendered below its full size, the rest is cleared and only makes
+        //the pyramid more conservative.
+        void build(VkCommandBuffer commandBuffer, uint32_t slot, VkExtent2D contentExtent={}){
+            this->contentExtent= contentExtent.width>0 ? contentExtent : depthExtent;
+            vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,pipeline);
+            VkExtent2D sourceSize=depthExtent;
+            for(uint32_t level=0;level<levelCount;++level){
+                VkExtent2D size=levelExtent(level);
+                int32_t pushConstants[4]={static_cast<int32_t>(sourceSize.width),static_cast<int32_t>(sourceSize.height),
+                                          static_cast<int32_t>(size.width),static_cast<int32_t>(size.height)};
+                vkCmdBindDescriptorSets(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,pipelineLayout,0,1,&slots[slot].descriptorSets[level],0,nullptr);
+                vkCmdPushConstants(commandBuffer,pipelineLayout,VK_SHADER_STAGE_COMPUTE_BIT,0,sizeof(pushConstants),pushConstants);
+                vkCmdDispatch(commandBuffer,(size.width+7)/8,(size.height+7)/8,1);
+
+                if(level+1<levelCount){
+                    VkMemoryBarrier barrier{};
+                    {
+                        barrier.sType=VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                        barrier.srcAccessMask=VK_ACCESS_SHADER_WRITE_BIT;
+                        barrier.dstAccessMask=VK_ACCESS_SHADER_READ_BIT;
+                    }
+                    vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,0,1,&barrier,0,nullptr,0,nullptr);
+                }
+                sourceSize=size;
+            }
+            valid=true;
+        }
+
+        //Whether an earlier frame has built the pyramid, until then there is nothing to test against.
+        bool isValid() const{ return valid; }
+        //Whether prepare() has moved the pyramid out of its initial layout.
+        bool isInitialized() const{ return initialized; }
+        void invalidate(){ valid=false; }
+
+        VkImage getImage() const{ return image; }
+        VkImageView getView() const{ return view; }
+        VkSampler getSampler() const{ return sampler; }
+        VkExtent2D getExtent() const{ return extent; }
+        VkExtent2D getDepthExtent() const{ return depthExtent; }
+        VkExtent2D getContentExtent() const{ return contentExtent; }
+        uint32_t getLevelCount() const{ return levelCount; }
+
+        //Changes whenever resize() replaces the image, so holders of descriptors know when to rewrite them.
+        uint64_t getGeneration() const{ return generation; }
+
+    private:
+        struct Slot{
+            std::vector<VkDescriptorSet> descriptorSets; //one per level
+            uint64_t generation=0;
+            VkImageView depthView=VK_NULL_HANDLE;
+        };
+
+        VkExtent2D levelExtent(uint32_t level) const{
+            return {std::max(extent.width>>level,1u),std::max(extent.height>>level,1u)};
+        }
+
+        VkImageView createView(uint32_t baseLevel, uint32_t count){
+            VkImageViewCreateInfo createInfo{};
+            {
+                createInfo.sType=VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                createInfo.image=image;
+                createInfo.viewType=VK_IMAGE_VIEW_TYPE_2D;
+                createInfo.format=format;
+                createInfo.components={VK_COMPONENT_SWIZZLE_IDENTITY,VK_COMPONENT_SWIZZLE_IDENTITY,VK_COMPONENT_SWIZZLE_IDENTITY,VK_COMPONENT_SWIZZLE_IDENTITY};
+                createInfo.subresourceRange={VK_IMAGE_ASPECT_COLOR_BIT,baseLevel,count,0,1};
+            }
+            VkImageView imageView;
+            if(vkCreateImageView(device,&createInfo,nullptr,&imageView)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create depth pyramid view!");
+            }
+            return imageView;
+        }
+
+        void createPipeline(const std::vector<char>& shaderCode){
+
+            VkDescriptorSetLayoutBinding bindings[2]{};
+            for(uint32_t i=0;i<2;++i){
+                bindings[i].binding=i;
+                bindings[i].descriptorType= i==0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                bindings[i].descriptorCount=1;
+                bindings[i].stageFlags=VK_SHADER_STAGE_COMPUTE_BIT;
+            }
+            VkDescriptorSetLayoutCreateInfo layoutInfo{};
+            {
+                layoutInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+                layoutInfo.bindingCount=2;
+                layoutInfo.pBindings=bindings;
+            }
+            if(vkCreateDescriptorSetLayout(device,&layoutInfo,nullptr,&descriptorSetLayout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create depth pyramid descriptor set layout!");
+            }
+
+            VkPushConstantRange pushConstant{VK_SHADER_STAGE_COMPUTE_BIT,0,sizeof(int32_t)*4};
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            {
+                pipelineLayoutInfo.sType=VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                pipelineLayoutInfo.setLayoutCount=1;
+                pipelineLayoutInfo.pSetLayouts=&descriptorSetLayout;
+                pipelineLayoutInfo.pushConstantRangeCount=1;
+                pipelineLayoutInfo.pPushConstantRanges=&pushConstant;
+            }
+            VkPipelineLayout layout;
+            if(vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,&layout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+            }
+            pipelineLayout=vkutil::UniquePipelineLayout(*deletionQueue,layout);
+
+            VkShaderModuleCreateInfo moduleInfo{};
+            {
+                moduleInfo.sType=VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+                moduleInfo.codeSize=shaderCode.size();
+                moduleInfo.pCode=reinterpret_cast<const uint32_t*>(shaderCode.data());
+            }
+            VkShaderModule shaderModule;
+            if(vkCreateShaderModule(device,&moduleInfo,nullptr,&shaderModule)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create shader module!");
+            }
+
+            VkComputePipelineCreateInfo pipelineInfo{};
+            {
+                pipelineInfo.sType=VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+                pipelineInfo.stage.sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                pipelineInfo.stage.stage=VK_SHADER_STAGE_COMPUTE_BIT;
+                pipelineInfo.stage.module=shaderModule;
+                pipelineInfo.stage.pName="main";
+                pipelineInfo.layout=pipelineLayout;
+            }
+            VkPipeline computePipeline;
+            VkResult result=vkCreateComputePipelines(device,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&computePipeline);
+            vkDestroyShaderModule(device,shaderModule,nullptr);
+            if(result!=VK_SUCCESS){
+                throw std::runtime_error("failed to create depth pyramid pipeline!");
+            }
+            pipeline=vkutil::UniquePipeline(*deletionQueue,computePipeline);
+        }
+
+        //A set per level and frame slot, the sets of a slot are only rewritten once its previous frame has finished.
+        void createDescriptorSets(uint32_t slotCount){
+            uint32_t setCount=slotCount*maxLevels;
+            VkDescriptorPoolSize poolSizes[2]={
+                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,setCount},
+                {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,setCount}
+            };
+            VkDescriptorPoolCreateInfo poolInfo{};
+            {
+                poolInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+                poolInfo.poolSizeCount=2;
+                poolInfo.pPoolSizes=poolSizes;
+                poolInfo.maxSets=setCount;
+            }
+            if(vkCreateDescriptorPool(device,&poolInfo,nullptr,&descriptorPool)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create depth pyramid descriptor pool!");
+            }
+
+            std::vector<VkDescriptorSetLayout> layouts(maxLevels,descriptorSetLayout);
+            slots.resize(slotCount);
+            for(Slot& slot: slots){
+                slot.descriptorSets.resize(maxLevels);
+                VkDescriptorSetAllocateInfo allocateInfo{};
+                {
+                    allocateInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                    allocateInfo.descriptorPool=descriptorPool;
+                    allocateInfo.descriptorSetCount=maxLevels;
+                    allocateInfo.pSetLayouts=layouts.data();
+                }
+                if(vkAllocateDescriptorSets(device,&allocateInfo,slot.descriptorSets.data())!=VK_SUCCESS){
+                    throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
+                }
+            }
+        }
+
+        VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+        VkDevice device=VK_NULL_HANDLE;
+        DeletionQueue* deletionQueue=nullptr;
+
+        VkExtent2D depthExtent{};
+        VkExtent2D contentExtent{}; //of the last build, what the culling maps screen positions to
+        VkExtent2D extent{};
+        uint32_t levelCount=0;
+        vkutil::UniqueImage image;
+        vkutil::UniqueDeviceMemory memory;
+        vkutil::UniqueImageView view;                   //all levels, read by the culling
+        std::vector<vkutil::UniqueImageView> levelViews; //one per level, written by the build
+        vkutil::UniqueSampler sampler;
+
+        VkDescriptorSetLayout descriptorSetLayout=VK_NULL_HANDLE;
+        VkDescriptorPool descriptorPool=VK_NULL_HANDLE;
+        vkutil::UniquePipelineLayout pipelineLayout;
+        vkutil::UniquePipeline pipeline;
+        std::vector<Slot> slots;
+
+        uint64_t generation=0;
+        bool valid=false;
+        bool initialized=false;
+};
@@ -0,0 +1,304 @@
+#pragma once
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<cctype>
+#include<cstring>
+#include<iostream>
+#include<optional>
+#include<set>
+#include<stdexcept>
+#include<string>
+#include<vector>
+
+struct QueueFamilyIndices{
+    std::optional<uint32_t> graphicsFamily;
+    std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> computeFamily; //a compute only family if the device has one, so compute can run next to graphics
+
+    bool isComplete() const{
+        return graphicsFamily.has_value()&& presentFamily.has_value();
+    }
+};
+
+struct SwapChainSupportDetails{
+    VkSurfaceCapabilitiesKHR capabilities;
+    std::vector<VkSurfaceFormatKHR> formats;
+    std::vector<VkPresentModeKHR> presentModes;
+};
+
+//Everything the init functions want to know about a physical device, queried once when the device is picked
+//instead of asking the driver again from every create function.
+struct DeviceInfo{
+    VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+    uint32_t index=0; //position in vkEnumeratePhysicalDevices, what --gpu <index> refers to
+    VkPhysicalDeviceProperties properties{};
+    VkPhysicalDeviceFeatures features{};
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties;
+    std::set<std::string> extensions;
+    QueueFamilyIndices queueFamilies;
+    SwapChainSupportDetails swapChainSupport;
+
+    int64_t score=-1;       //-1 when the device can not run the app
+    std::string rejectReason;
+
+    bool hasExtension(const char* name) const{
+        return extensions.count(name)!=0;
+    }
+
+    //Largest device local heap, the dedicated VRAM on discrete GPUs.
+    VkDeviceSize deviceLocalMemory() const{
+        VkDeviceSize largest=0;
+        for(uint32_t i=0;i<memoryProperties.memoryHeapCount;++i){
+            if(memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT){
+                largest=std::max(largest,memoryProperties.memoryHeaps[i].size);
+            }
+        }
+        return largest;
+    }
+
+    //A family with transfer but neither graphics nor compute, the DMA engines on discrete GPUs.
+    bool hasDedicatedTransferFamily() const{
+        for(const auto& family: queueFamilyProperties){
+            if((family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(family.queueFlags & (VK_QUEUE_GRAPHICS_BIT|VK_QUEUE_COMPUTE_BIT))){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags flags) const{
+        for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++){
+            if(typeFilter & (1<<i) && (memoryProperties.memoryTypes[i].propertyFlags & flags)== flags){
+                return i;
+            }
+        }
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    //The surface formats and present modes stay the same, but the current extent changes with the window.
+    void refreshSurfaceCapabilities(VkSurfaceKHR surface){
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice,surface,&swapChainSupport.capabilities);
+    }
+};
+
+namespace vkutil{
+
+    inline const char* deviceTypeName(VkPhysicalDeviceType type){
+        switch(type){
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+            case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+            default: return "other";
+        }
+    }
+
+    inline QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface, const std::vector<VkQueueFamilyProperties>& queueFamilies){
+
+        QueueFamilyIndices indices;
+
+        for(uint32_t i=0;i<queueFamilies.size();++i){
+            const auto& queueFamily=queueFamilies[i];
+
+            if(!indices.isComplete()){
+                VkBool32 presentSupport=false;
+                vkGetPhysicalDeviceSurfaceSupportKHR(device,i,surface,&presentSupport);
+
+                if(presentSupport){
+                    indices.presentFamily=i;
+                }
+
+                if(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT){
+                    indices.graphicsFamily=i;
+                }
+            }
+
+            //keep looking for a family that has compute but no graphics, those map to the async compute engines
+            if(!indices.computeFamily.has_value() && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)){
+                indices.computeFamily=i;
+            }
+        }
+
+        //no dedicated family, compute goes to the graphics queue (or any family that can do compute)
+        if(!indices.computeFamily.has_value() && indices.graphicsFamily.has_value()){
+            if(queueFamilies[indices.graphicsFamily.value()].queueFlags & VK_QUEUE_COMPUTE_BIT){
+                indices.computeFamily=indices.graphicsFamily;
+            }
+            else{
+                for(uint32_t family=0;family<queueFamilies.size();++family){
+                    if(queueFamilies[family].queueFlags & VK_QUEUE_COMPUTE_BIT){
+                        indices.computeFamily=family;
+                        break;
+                    }
+                }
+            }
+        }
+        return indices;
+    }
+
+    inline DeviceInfo queryDeviceInfo(VkPhysicalDevice device, uint32_t index, VkSurfaceKHR surface){
+
+        DeviceInfo info;
+        info.physicalDevice=device;
+        info.index=index;
+        vkGetPhysicalDeviceProperties(device,&info.properties);
+        vkGetPhysicalDeviceFeatures(device,&info.features);
+        vkGetPhysicalDeviceMemoryProperties(device,&info.memoryProperties);
+
+        uint32_t familyCount=0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device,&familyCount,nullptr);
+        info.queueFamilyProperties.resize(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device,&familyCount,info.queueFamilyProperties.data());
+        info.queueFamilies=findQueueFamilies(device,surface,info.queueFamilyProperties);
+
+        uint32_t extensionCount=0;
+        vkEnumerateDeviceExtensionProperties(device,nullptr,&extensionCount,nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device,nullptr,&extensionCount,availableExtensions.data());
+        for(const auto& extension: availableExtensions){
+            info.extensions.insert(extension.extensionName);
+        }
+
+        SwapChainSupportDetails& details=info.swapChainSupport;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device,surface,&details.capabilities);
+
+        uint32_t formatCount=0;
+        vkGetPhysicalDeviceSurfaceFormatsKHR(device,surface,&formatCount,nullptr);
+        if(formatCount!=0){
+            details.formats.resize(formatCount);
+            vkGetPhysicalDeviceSurfaceFormatsKHR(device,surface,&formatCount,details.formats.data());
+        }
+
+        uint32_t presentModeCount=0;
+        vkGetPhysicalDeviceSurfacePresentModesKHR(device,surface,&presentModeCount,nullptr);
+        if(presentModeCount!=0){
+            details.presentModes.resize(presentModeCount);
+            vkGetPhysicalDeviceSurfacePresentModesKHR(device,surface,&presentModeCount,details.presentModes.data());
+        }
+        return info;
+    }
+
+    //Sets info.score, -1 with a reason if the device lacks something the app needs. The device type dominates so a
+    //discrete GPU always beats an integrated one, memory, limits and queue layout break ties between devices of one type.
+    inline void scoreDevice(DeviceInfo& info, const std::vector<const char*>& requiredExtensions){
+
+        info.score=-1;
+        if(!info.queueFamilies.isComplete() || !info.queueFamilies.computeFamily.has_value()){
+            info.rejectReason="no graphics, present or compute queue";
+            return;
+        }
+        for(const char* extension: requiredExtensions){
+            if(!info.hasExtension(extension)){
+                info.rejectReason=std::string("missing ")+extension;
+                return;
+            }
+        }
+        if(info.swapChainSupport.formats.empty() || info.swapChainSupport.presentModes.empty()){
+            info.rejectReason="surface has no formats or present modes";
+            return;
+        }
+
+        int64_t score=0;
+        switch(info.properties.deviceType){
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score+=100000; break;
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score+=50000; break;
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score+=20000; break;
+            case VK_PHYSICAL_DEVICE_TYPE_CPU: score+=1000; break;
+            default: break;
+        }
+
+        //one point per 16 MiB of local memory, capped so it can not outweigh the device type
+        score+=std::min<int64_t>(static_cast<int64_t>(info.deviceLocalMemory()/(16*1024*1024)),20000);
+
+        const VkPhysicalDeviceLimits& limits=info.properties.limits;
+        score+=limits.maxImageDimension2D/256;
+        score+=limits.maxComputeSharedMemorySize/1024;
+        score+=static_cast<int64_t>(limits.maxSamplerAnisotropy);
+
+        //async compute and copy engines, and no concurrent sharing when graphics can present
+        const QueueFamilyIndices& families=info.queueFamilies;
+        if(families.computeFamily!=families.graphicsFamily){
+            score+=500;
+        }
+        if(info.hasDedicatedTransferFamily()){
+            score+=200;
+        }
+        if(families.graphicsFamily==families.presentFamily){
+            score+=100;
+        }
+        info.score=score;
+        info.rejectReason.clear();
+    }
+
+    //Queries and scores every device and returns the best one. preferred overrides the score, it is either an index
+    //into the device list or a case insensitive part of the device name.
+    inline DeviceInfo selectPhysicalDevice(VkInstance instance, VkSurfaceKHR surface, const std::vector<const char*>& requiredExtensions,
+                                           const std::string& preferred){
+
+        uint32_t deviceCount=0;
+        vkEnumeratePhysicalDevices(instance,&deviceCount,nullptr);
+
+        if(deviceCount==0){
+            throw std::runtime_error("No GPU found with Vulkan support!");
+        }
+
+        std::vector<VkPhysicalDevice> devices(deviceCount);
+        vkEnumeratePhysicalDevices(instance,&deviceCount,devices.data());
+
+        std::vector<DeviceInfo> candidates;
+        for(uint32_t i=0;i<deviceCount;++i){
+            candidates.push_back(queryDeviceInfo(devices[i],i,surface));
+            scoreDevice(candidates.back(),requiredExtensions);
+        }
+
+        auto lower=[](std::string text){
+            std::transform(text.begin(),text.end(),text.begin(),[](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+            return text;
+        };
+        bool preferredIsIndex=!preferred.empty() && std::all_of(preferred.begin(),preferred.end(),[](unsigned char c){ return std::isdigit(c); });
+
+        int best=-1;
+        int match=-1;
+        for(int i=0;i<static_cast<int>(candidates.size());++i){
+            const DeviceInfo& info=candidates[i];
+            std::cout<<"GPU "<<i<<": "<<info.properties.deviceName<<" ("<<deviceTypeName(info.properties.deviceType)<<", "
+                     <<info.deviceLocalMemory()/(1024*1024)<<" MiB) ";
+            if(info.score<0){
+                std::cout<<"unsuitable, "<<info.rejectReason<<std::endl;
+            }
+            else{
+                std::cout<<"score "<<info.score<<std::endl;
+            }
+
+            if(info.score>=0 && (best<0 || info.score>candidates[best].score)){
+                best=i;
+            }
+            if(!preferred.empty() && match<0){
+                bool matches= preferredIsIndex ? std::stoul(preferred)==info.index
+                                               : lower(info.properties.deviceName).find(lower(preferred))!=std::string::npos;
+                if(matches){
+                    match=i;
+                }
+            }
+        }
+
+        if(!preferred.empty()){
+            if(match<0){
+                throw std::runtime_error("no GPU matches "+preferred+"!");
+            }
+            if(candidates[match].score<0){
+                throw std::runtime_error(std::string("requested GPU ")+candidates[match].properties.deviceName+" is not suitable!");
+            }
+            best=match;
+        }
+        if(best<0){
+            throw std::runtime_error("failed to find suitable GPU!");
+        }
+
+        std::cout<<"using GPU "<<best<<": "<<candidates[best].properties.deviceName<<std::endl;
+        return std::move(candidates[best]);
+    }
+}
@@ -0,0 +1,465 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "DeviceInfo.h"
+#include "Profiler.h"
+#include "VulkanUtils.h"
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<cmath>
+#include<iostream>
+#include<stdexcept>
+#include<vector>
+
+//Renders the scene below the output resolution when the GPU can not keep up. The scene color target is allocated once
+//at the output size and the frame only renders into its top left render extent, so the scale can move every frame
+//without reallocating anything. Every frame is timed with two timestamps; once a slot's fence was waited on the
+//controller moves the scale towards the one that would hit the budget, assuming the cost follows the pixel count.
+//A fullscreen pass then upscales the render extent to the swapchain, bilinear or sharpened.
+class DynamicResolution{
+
+    public:
+        struct Settings{
+            float budgetMs=16.0f;  //GPU time per frame the controller aims for
+            float minScale=0.5f;
+            float maxScale=1.0f;
+            float sharpness=0.0f;  //0 is plain bilinear
+        };
+
+        struct Stats{
+            uint64_t frames=0;
+            uint64_t overBudget=0;
+            uint64_t changes=0;
+            double gpuMs=0.0;
+            double scale=0.0;
+        };
+
+        void init(const DeviceInfo& deviceInfo, VkDevice device, DeletionQueue& deletionQueue, const Settings& settings, uint32_t slotCount,
+                  const std::vector<char>& vertexCode, const std::vector<char>& fragmentCode){
+
+            PROFILE_ZONE("DynamicResolution::init");
+
+            this->device=device;
+            this->deletionQueue=&deletionQueue;
+            this->settings=settings;
+            this->vertexCode=vertexCode;
+            this->fragmentCode=fragmentCode;
+            scale=settings.maxScale;
+
+            //without timestamps there is nothing to steer by, the scale stays at its maximum
+            uint32_t graphicsFamily=deviceInfo.queueFamilies.graphicsFamily.value();
+            uint32_t validBits=deviceInfo.queueFamilyProperties[graphicsFamily].timestampValidBits;
+            if(validBits>0){
+                timestampPeriod=deviceInfo.properties.limits.timestampPeriod;
+                timestampMask= validBits>=64 ? ~0ull : (1ull<<validBits)-1;
+            }
+            else{
+                std::cerr<<"queue has no timestamp support, dynamic resolution keeps a fixed scale"<<std::endl;
+            }
+
+            VkSamplerCreateInfo samplerInfo{};
+            {
+                samplerInfo.sType=VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+                samplerInfo.magFilter=VK_FILTER_LINEAR;
+                samplerInfo.minFilter=VK_FILTER_LINEAR;
+                samplerInfo.mipmapMode=VK_SAMPLER_MIPMAP_MODE_NEAREST;
+                samplerInfo.addressModeU=VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+                samplerInfo.addressModeV=VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+                samplerInfo.addressModeW=VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+                samplerInfo.maxLod=0.0f;
+            }
+            VkSampler rawSampler;
+            if(vkCreateSampler(device,&samplerInfo,nullptr,&rawSampler)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create upscale sampler!");
+            }
+            sampler=vkutil::UniqueSampler(deletionQueue,rawSampler);
+
+            createLayout();
+            createSlots(slotCount);
+        }
+
+        //Only valid once the device is idle.
+        void cleanup(){
+            if(device==VK_NULL_HANDLE){
+                return;
+            }
+            if(stats.frames>0){
+                std::cout<<"dynamic resolution: "<<stats.gpuMs/stats.frames<<" ms GPU per frame for a "<<settings.budgetMs<<" ms budget, "
+                         <<100.0*stats.overBudget/stats.frames<<"% of frames over it, average scale "<<stats.scale/stats.frames<<", "
+                         <<stats.changes<<" resolution changes"<<std::endl;
+            }
+            for(Slot& slot: slots){
+                vkDestroyQueryPool(device,slot.queryPool,nullptr);
+            }
+            slots.clear();
+            pipeline.reset();
+            pipelineLayout.reset();
+            sampler.reset();
+            vkDestroyDescriptorPool(device,descriptorPool,nullptr);
+            vkDestroyDescriptorSetLayout(device,descriptorSetLayout,nullptr);
+            device=VK_NULL_HANDLE;
+        }
+
+        //Size of the swapchain and of the scene color target, the render extent is a part of it.
+        void setOutputExtent(VkExtent2D extent){
+            outputExtent=extent;
+        }
+
+        //Recreates the upscale pipeline when the render pass of its graph pass changed.
+        void setRenderPass(VkRenderPass renderPass){
+            if(renderPass==currentRenderPass && pipeline.get()!=VK_NULL_HANDLE){
+                return;
+            }
+            createPipeline(renderPass);
+            currentRenderPass=renderPass;
+        }
+
+        //Part of the scene color target this frame renders into.
+        VkExtent2D getRenderExtent() const{
+            return {std::max(static_cast<uint32_t>(std::lround(outputExtent.width*scale)),1u),
+                    std::max(static_cast<uint32_t>(std::lround(outputExtent.height*scale)),1u)};
+        }
+
+        float getScale() const{ return scale; }
+        Stats getStats() const{ return stats; }
+
+        //Around everything the frame records, outside of render passes.
+        void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot){
+            if(timestampPeriod==0.0f){
+                return;
+            }
+            vkCmdResetQueryPool(commandBuffer,slots[slot].queryPool,0,2);
+            vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,slots[slot].queryPool,0);
+        }
+
+        void endFrame(VkCommandBuffer commandBuffer, uint32_t slot){
+            if(timestampPeriod==0.0f){
+                return;
+            }
+            vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,slots[slot].queryPool,1);
+            slots[slot].pending=true;
+        }
+
+        //The slot submitted an earlier recording again, its timestamps are written as if endFrame() was recorded.
+        void resubmitted(uint32_t slot){
+            if(timestampPeriod!=0.0f){
+                slots[slot].pending=true;
+            }
+        }
+
+        //After the slot's fence wait, feeds its GPU time to the controller.
+        void collect(uint32_t slot){
+            Slot& state=slots[slot];
+            if(!state.pending){
+                return;
+            }
+            state.pending=false;
+            uint64_t timestamps[2];
+            if(vkGetQueryPoolResults(device,state.queryPool,0,2,sizeof(timestamps),timestamps,sizeof(uint64_t),VK_QUERY_RESULT_64_BIT)!=VK_SUCCESS){
+                return;
+            }
+            uint64_t ticks=((timestamps[1]&timestampMask)-(timestamps[0]&timestampMask))&timestampMask;
+            float gpuMs=static_cast<float>(static_cast<double>(ticks)*timestampPeriod/1.0e6);
+            ++stats.frames;
+            stats.gpuMs+=gpuMs;
+            stats.scale+=scale;
+            if(gpuMs>settings.budgetMs){
+                ++stats.overBudget;
+            }
+            adjust(gpuMs);
+        }
+
+        //Fullscreen triangle inside the upscale pass, sceneColor is the graph's view of the scene color target.
+        void upscale(VkCommandBuffer commandBuffer, uint32_t slot, VkImageView sceneColor){
+            Slot& state=slots[slot];
+            if(state.sceneColor!=sceneColor){
+                VkDescriptorImageInfo imageInfo{sampler,sceneColor,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+                VkWriteDescriptorSet write{};
+                {
+                    write.sType=VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    write.dstSet=state.descriptorSet;
+                    write.dstBinding=0;
+                    write.descriptorType=VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                    write.descriptorCount=1;
+                    write.pImageInfo=&imageInfo;
+                }
+                vkUpdateDescriptorSets(device,1,&write,0,nullptr);
+                state.sceneColor=sceneColor;
+            }
+
+            VkExtent2D renderExtent=getRenderExtent();
+            float width=static_cast<float>(outputExtent.width);
+            float height=static_cast<float>(outputExtent.height);
+            UpscaleConstants constants{};
+            constants.uvScale[0]=renderExtent.width/width;
+            constants.uvScale[1]=renderExtent.height/height;
+            constants.uvMax[0]=(renderExtent.width-0.5f)/width;
+            constants.uvMax[1]=(renderExtent.height-0.5f)/height;
+            constants.texelSize[0]=1.0f/width;
+            constants.texelSize[1]=1.0f/height;
+            constants.sharpness=settings.sharpness;
+
+            VkViewport viewport{0.0f,0.0f,width,height,0.0f,1.0f};
+            VkRect2D scissor{{0,0},outputExtent};
+            vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,pipeline);
+            vkCmdSetViewport(commandBuffer,0,1,&viewport);
+            vkCmdSetScissor(commandBuffer,0,1,&scissor);
+            vkCmdBindDescriptorSets(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,pipelineLayout,0,1,&state.descriptorSet,0,nullptr);
+            vkCmdPushConstants(commandBuffer,pipelineLayout,VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,0,sizeof(UpscaleConstants),&constants);
+            vkCmdDraw(commandBuffer,3,1,0,0);
+        }
+
+    private:
+        //Laid out like the push constants of upscale.vert and upscale.frag.
+        struct UpscaleConstants{
+            float uvScale[2];
+            float uvMax[2];
+            float texelSize[2];
+            float sharpness;
+            float pad;
+        };
+
+        struct Slot{
+            VkDescriptorSet descriptorSet=VK_NULL_HANDLE;
+            VkImageView sceneColor=VK_NULL_HANDLE;
+            VkQueryPool queryPool=VK_NULL_HANDLE;
+            bool pending=false;
+        };
+
+        //Scale changes are quantized, so a frame time hovering around the budget does not change the resolution every frame.
+        static constexpr float scaleStep=1.0f/64.0f;
+        static constexpr float maxChange=0.1f;
+
+        void adjust(float gpuMs){
+            //smoothed, single frames spike
+            averageMs= averageMs==0.0f ? gpuMs : averageMs*0.8f+gpuMs*0.2f;
+            //the timings that come back are slotCount frames old, the first one that shows a change arrives after that
+            if(cooldown>0){
+                --cooldown;
+                return;
+            }
+            //the cost is taken to follow the pixel count, which goes with the square of the scale. Some headroom
+            //below the budget keeps the spikes from going over it
+            float target=scale*std::sqrt(settings.budgetMs*0.9f/std::max(averageMs,0.01f));
+            target=std::clamp(target,scale-maxChange,scale+maxChange);
+            target=std::clamp(std::round(target/scaleStep)*scaleStep,settings.minScale,settings.maxScale);
+            //going down reacts to a single step, going up waits for two so the scale does not oscillate
+            if(target<scale || target>=scale+2.0f*scaleStep){
+                scale=target;
+                averageMs=0.0f;
+                cooldown=static_cast<uint32_t>(slots.size())+1;
+                ++stats.changes;
+            }
+        }
+
+        void createLayout(){
+
+            VkDescriptorSetLayoutBinding binding{};
+            {
+                binding.binding=0;
+                binding.descriptorType=VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                binding.descriptorCount=1;
+                binding.stageFlags=VK_SHADER_STAGE_FRAGMENT_BIT;
+            }
+            VkDescriptorSetLayoutCreateInfo layoutInfo{};
+            {
+                layoutInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+                layoutInfo.bindingCount=1;
+                layoutInfo.pBindings=&binding;
+            }
+            if(vkCreateDescriptorSetLayout(device,&layoutInfo,nullptr,&descriptorSetLayout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create upscale descriptor set layout!");
+            }
+
+            VkPushConstantRange pushConstant{VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,0,sizeof(UpscaleConstants)};
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            {
+                pipelineLayoutInfo.sType=VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                pipelineLayoutInfo.setLayoutCount=1;
+                pipelineLayoutInfo.pSetLayouts=&descriptorSetLayout;
+                pipelineLayoutInfo.pushConstantRangeCount=1;
+                pipelineLayoutInfo.pPushConstantRanges=&pushConstant;
+            }
+            VkPipelineLayout layout;
+            if(vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,&layout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create upscale pipeline layout!");
+            }
+            pipelineLayout=vkutil::UniquePipelineLayout(*deletionQueue,layout);
+        }
+
+        void createSlots(uint32_t slotCount){
+
+            VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,slotCount};
+            VkDescriptorPoolCreateInfo poolInfo{};
+            {
+                poolInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+                poolInfo.poolSizeCount=1;
+                poolInfo.pPoolSizes=&poolSize;
+                poolInfo.maxSets=slotCount;
+            }
+            if(vkCreateDescriptorPool(device,&poolInfo,nullptr,&descriptorPool)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create upscale descriptor pool!");
+            }
+
+            slots.resize(slotCount);
+            for(Slot& slot: slots){
+                VkDescriptorSetAllocateInfo allocateInfo{};
+                {
+                    allocateInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                    allocateInfo.descriptorPool=descriptorPool;
+                    allocateInfo.descriptorSetCount=1;
+                    allocateInfo.pSetLayouts=&descriptorSetLayout;
+                }
+                if(vkAllocateDescriptorSets(device,&allocateInfo,&slot.descriptorSet)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to allocate upscale descriptor set!");
+                }
+
+                VkQueryPoolCreateInfo queryPoolInfo{};
+                {
+                    queryPoolInfo.sType=VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                    queryPoolInfo.queryType=VK_QUERY_TYPE_TIMESTAMP;
+                    queryPoolInfo.queryCount=2;
+                }
+                if(vkCreateQueryPool(device,&queryPoolInfo,nullptr,&slot.queryPool)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to create frame time query pool!");
+                }
+            }
+        }
+
+        VkShaderModule createShaderModule(const std::vector<char>& code){
+            VkShaderModuleCreateInfo moduleInfo{};
+            {
+                moduleInfo.sType=VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+                moduleInfo.codeSize=code.size();
+                moduleInfo.pCode=reinterpret_cast<const uint32_t*>(code.data());
+            }
+            VkShaderModule shaderModule;
+            if(vkCreateShaderModule(device,&moduleInfo,nullptr,&shaderModule)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create shader module!");
+            }
+            return shaderModule;
+        }
+
+        //Fullscreen triangle without vertex input, depth or blending.
+        void createPipeline(VkRenderPass renderPass){
+
+            VkShaderModule vertShaderModule=createShaderModule(vertexCode);
+            VkShaderModule fragShaderModule=createShaderModule(fragmentCode);
+
+            VkPipelineShaderStageCreateInfo shaderStages[2]{};
+            {
+                shaderStages[0].sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                shaderStages[0].stage=VK_SHADER_STAGE_VERTEX_BIT;
+                shaderStages[0].module=vertShaderModule;
+                shaderStages[0].pName="main";
+                shaderStages[1].sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                shaderStages[1].stage=VK_SHADER_STAGE_FRAGMENT_BIT;
+                shaderStages[1].module=fragShaderModule;
+                shaderStages[1].pName="main";
+            }
+
+            VkDynamicState dynamicStates[2]={VK_DYNAMIC_STATE_VIEWPORT,VK_DYNAMIC_STATE_SCISSOR};
+            VkPipelineDynamicStateCreateInfo dynamicState{};
+            {
+                dynamicState.sType=VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+                dynamicState.dynamicStateCount=2;
+                dynamicState.pDynamicStates=dynamicStates;
+            }
+
+            VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+            {
+                vertexInputInfo.sType=VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            }
+
+            VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+            {
+                inputAssembly.sType=VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+                inputAssembly.topology=VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+                inputAssembly.primitiveRestartEnable=VK_FALSE;
+            }
+
+            VkPipelineViewportStateCreateInfo viewportState{};
+            {
+                viewportState.sType=VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+                viewportState.viewportCount=1;
+                viewportState.scissorCount=1;
+            }
+
+            VkPipelineRasterizationStateCreateInfo rasterizer{};
+            {
+                rasterizer.sType=VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+                rasterizer.polygonMode=VK_POLYGON_MODE_FILL;
+                rasterizer.lineWidth=1.0f;
+                rasterizer.cullMode=VK_CULL_MODE_NONE;
+                rasterizer.frontFace=VK_FRONT_FACE_COUNTER_CLOCKWISE;
+            }
+
+            VkPipelineMultisampleStateCreateInfo multisampling{};
+            {
+                multisampling.sType=VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+                multisampling.rasterizationSamples=VK_SAMPLE_COUNT_1_BIT;
+            }
+
+            VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+            {
+                colorBlendAttachment.colorWriteMask=VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+                colorBlendAttachment.blendEnable=VK_FALSE;
+            }
+
+            VkPipelineColorBlendStateCreateInfo colorBlending{};
+            {
+                colorBlending.sType=VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+                colorBlending.attachmentCount=1;
+                colorBlending.pAttachments=&colorBlendAttachment;
+            }
+
+            VkGraphicsPipelineCreateInfo pipelineInfo{};
+            {
+                pipelineInfo.sType=VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+                pipelineInfo.stageCount=2;
+                pipelineInfo.pStages=shaderStages;
+                pipelineInfo.pVertexInputState=&vertexInputInfo;
+                pipelineInfo.pInputAssemblyState=&inputAssembly;
+                pipelineInfo.pViewportState=&viewportState;
+                pipelineInfo.pRasterizationState=&rasterizer;
+                pipelineInfo.pMultisampleState=&multisampling;
+                pipelineInfo.pColorBlendState=&colorBlending;
+                pipelineInfo.pDynamicState=&dynamicState;
+                pipelineInfo.layout=pipelineLayout;
+                pipelineInfo.renderPass=renderPass;
+                pipelineInfo.subpass=0;
+            }
+            VkPipeline rawPipeline;
+            VkResult result=vkCreateGraphicsPipelines(device,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&rawPipeline);
+            vkDestroyShaderModule(device,vertShaderModule,nullptr);
+            vkDestroyShaderModule(device,fragShaderModule,nullptr);
+            if(result!=VK_SUCCESS){
+                throw std::runtime_error("failed to create upscale pipeline!");
+            }
+            pipeline=vkutil::UniquePipeline(*deletionQueue,rawPipeline);
+        }
+
+        VkDevice device=VK_NULL_HANDLE;
+        DeletionQueue* deletionQueue=nullptr;
+        Settings settings;
+        std::vector<char> vertexCode;
+        std::vector<char> fragmentCode;
+
+        vkutil::UniqueSampler sampler;
+        VkDescriptorSetLayout descriptorSetLayout=VK_NULL_HANDLE;
+        VkDescriptorPool descriptorPool=VK_NULL_HANDLE;
+        vkutil::UniquePipelineLayout pipelineLayout;
+        vkutil::UniquePipeline pipeline;
+        VkRenderPass currentRenderPass=VK_NULL_HANDLE;
+        std::vector<Slot> slots;
+
+        VkExtent2D outputExtent{};
+        float scale=1.0f;
+        float averageMs=0.0f;
+        uint32_t cooldown=0;
+        float timestampPeriod=0.0f;
+        uint64_t timestampMask=~0ull;
+        Stats stats;
+};
@@ -0,0 +1,324 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "DeviceInfo.h"
+#include "ImageWriter.h"
+#include "Profiler.h"
+#include "VulkanUtils.h"
+
+#include<vulkan/vulkan.h>
+
+#include<chrono>
+#include<condition_variable>
+#include<cstdio>
+#include<deque>
+#include<filesystem>
+#include<iostream>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
+
+enum class CaptureFormat{
+    Png, //uncompressed deflate, as cheap to write as raw but opens everywhere
+    Raw  //PAM files (RGBA bytes behind a short text header), ffmpeg and ImageMagick read them as an image sequence
+};
+
+//Records the rendered frames to disk without stalling the render loop. Every captured frame is copied into one slot of
+//a ring of host visible readback buffers at the end of its command buffer. Once the frame's fence has signaled the slot
+//goes to a writer thread that encodes it, and only then becomes free again. When the writer falls behind and no slot is
+//free the frame is dropped and counted instead of waiting on the disk.
+class FrameCapture{
+
+    public:
+        struct Stats{
+            uint64_t captured=0;
+            uint64_t written=0;
+            uint64_t dropped=0;
+            double writeMilliseconds=0.0; //spent encoding and writing on the writer thread
+        };
+
+        void init(const DeviceInfo& deviceInfo, VkDevice device, DeletionQueue& deletionQueue, uint32_t ringSize=4){
+            this->physicalDevice=deviceInfo.physicalDevice;
+            this->device=device;
+            this->deletionQueue=&deletionQueue;
+            slots.resize(ringSize);
+
+            //cached memory makes the reads on the writer thread fast, it is not coherent everywhere though
+            memoryFlags=VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            for(uint32_t i=0;i<deviceInfo.memoryProperties.memoryTypeCount;++i){
+                VkMemoryPropertyFlags flags=deviceInfo.memoryProperties.memoryTypes[i].propertyFlags;
+                if((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)){
+                    memoryFlags=VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+                    break;
+                }
+            }
+
+            writer=std::thread(&FrameCapture::writerLoop,this);
+        }
+
+        //Only valid once the device is idle, writes out everything still in the ring.
+        void cleanup(){
+            if(!writer.joinable()){
+                return;
+            }
+            collect(UINT64_MAX);
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                idleCondition.wait(lock,[this]{ return writeQueue.empty() && !writing; });
+                stopWriter=true;
+            }
+            writeCondition.notify_all();
+            writer.join();
+            stop();
+            if(stats.written>0){
+                std::cout<<"capture: "<<stats.written<<" frames written, "<<stats.writeMilliseconds/stats.written<<" ms per frame on the writer thread"<<std::endl;
+            }
+
+            for(auto& slot: slots){
+                if(slot.memory!=VK_NULL_HANDLE){
+                    vkUnmapMemory(device,slot.memory);
+                }
+                slot.buffer.reset();
+                slot.memory.reset();
+            }
+            slots.clear();
+        }
+
+        bool start(const std::string& directory, CaptureFormat format){
+            std::error_code error;
+            std::filesystem::create_directories(directory,error);
+            if(error){
+                std::cerr<<"failed to create capture directory "<<directory<<std::endl;
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            this->directory=directory;
+            this->format=format;
+            sequence=0;
+            stats=Stats{};
+            capturing=true;
+            std::cout<<"capturing frames to "<<directory<<std::endl;
+            return true;
+        }
+
+        //Frames already copied on the GPU are still written.
+        void stop(){
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!capturing){
+                return;
+            }
+            capturing=false;
+            std::cout<<"capture stopped: "<<stats.captured<<" frames captured, "<<stats.dropped<<" dropped"<<std::endl;
+        }
+
+        bool isCapturing() const{
+            std::lock_guard<std::mutex> lock(mutex);
+            return capturing;
+        }
+
+        Stats getStats() const{
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats;
+        }
+
+        //Called after a frame fence wait, frames up to completedFrame have finished on the GPU.
+        void collect(uint64_t completedFrame){
+            std::lock_guard<std::mutex> lock(mutex);
+            bool queued=false;
+            for(uint32_t i=0;i<slots.size();++i){
+                Slot& slot=slots[i];
+                if(slot.state!=SlotState::Copying || slot.frame>completedFrame){
+                    continue;
+                }
+                if(!(memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)){
+                    VkMappedMemoryRange range{};
+                    {
+                        range.sType=VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+                        range.memory=slot.memory;
+                        range.offset=0;
+                        range.size=VK_WHOLE_SIZE;
+                    }
+                    vkInvalidateMappedMemoryRanges(device,1,&range);
+                }
+                slot.state=SlotState::Writing;
+                writeQueue.push_back(i);
+                queued=true;
+            }
+            if(queued){
+                writeCondition.notify_one();
+            }
+        }
+
+        //Reserves a slot for the frame that is being recorded, returns the buffer the copy goes to or VK_NULL_HANDLE
+        //if the frame is dropped.
+        VkBuffer acquire(uint64_t frame, VkExtent2D extent, VkFormat imageFormat){
+            std::unique_lock<std::mutex> lock(mutex);
+            if(!capturing){
+                return VK_NULL_HANDLE;
+            }
+
+            int freeSlot=-1;
+            for(uint32_t i=0;i<slots.size();++i){
+                if(slots[i].state==SlotState::Free){
+                    freeSlot=static_cast<int>(i);
+                    break;
+                }
+            }
+            if(freeSlot<0){
+                ++stats.dropped;
+                recordingSlot=-1;
+                return VK_NULL_HANDLE;
+            }
+
+            Slot& slot=slots[freeSlot];
+            slot.state=SlotState::Copying;
+            slot.frame=frame;
+            slot.sequence=sequence++;
+            slot.extent=extent;
+            slot.format=imageFormat;
+            ++stats.captured;
+            lock.unlock();
+
+            //slots grow with the window and never shrink, a replaced buffer is no longer used by any frame
+            VkDeviceSize size=static_cast<VkDeviceSize>(extent.width)*extent.height*4;
+            if(slot.size<size){
+                if(slot.memory!=VK_NULL_HANDLE){
+                    vkUnmapMemory(device,slot.memory);
+                }
+                VkBuffer buffer;
+                VkDeviceMemory memory;
+                vkutil::createBuffer(physicalDevice,device,size,VK_BUFFER_USAGE_TRANSFER_DST_BIT,memoryFlags,MemoryCategory::Readback,buffer,memory);
+                slot.buffer=vkutil::UniqueBuffer(*deletionQueue,buffer);
+                slot.memory=vkutil::UniqueDeviceMemory(*deletionQueue,memory);
+                slot.size=size;
+                vkMapMemory(device,slot.memory,0,VK_WHOLE_SIZE,0,&slot.mapped);
+            }
+            recordingSlot=freeSlot;
+            return slot.buffer;
+        }
+
+        //Copies the rendered image into the slot acquire() reserved, the image is in TRANSFER_SRC_OPTIMAL.
+        void recordCopy(VkCommandBuffer commandBuffer, VkImage image){
+            if(recordingSlot<0){
+                return;
+            }
+            Slot& slot=slots[recordingSlot];
+            recordingSlot=-1;
+
+            VkBufferImageCopy region{};
+            {
+                region.bufferOffset=0;
+                region.bufferRowLength=0; //tightly packed
+                region.bufferImageHeight=0;
+                region.imageSubresource.aspectMask=VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.mipLevel=0;
+                region.imageSubresource.baseArrayLayer=0;
+                region.imageSubresource.layerCount=1;
+                region.imageOffset={0,0,0};
+                region.imageExtent={slot.extent.width,slot.extent.height,1};
+            }
+            vkCmdCopyImageToBuffer(commandBuffer,image,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,slot.buffer,1,&region);
+
+            //make the copy visible to the host reads after the fence wait
+            VkBufferMemoryBarrier barrier{};
+            {
+                barrier.sType=VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask=VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask=VK_ACCESS_HOST_READ_BIT;
+                barrier.srcQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED;
+                barrier.buffer=slot.buffer;
+                barrier.offset=0;
+                barrier.size=VK_WHOLE_SIZE;
+            }
+            vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_HOST_BIT,0,0,nullptr,1,&barrier,0,nullptr);
+        }
+
+    private:
+        enum class SlotState{
+            Free,
+            Copying, //recorded into a frame that has not finished on the GPU yet
+            Writing  //owned by the writer thread
+        };
+
+        struct Slot{
+            vkutil::UniqueBuffer buffer;
+            vkutil::UniqueDeviceMemory memory;
+            void* mapped=nullptr;
+            VkDeviceSize size=0;
+            SlotState state=SlotState::Free;
+            uint64_t frame=0;
+            uint64_t sequence=0;
+            VkExtent2D extent{};
+            VkFormat format=VK_FORMAT_UNDEFINED;
+        };
+
+        void writerLoop(){
+
+            Profiler::get().setThreadName("frame capture writer");
+            std::vector<uint8_t> pixels;
+            while(true){
+                uint32_t index;
+                std::string path;
+                bool png;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    writeCondition.wait(lock,[this]{ return stopWriter || !writeQueue.empty(); });
+                    if(writeQueue.empty()){
+                        return;
+                    }
+                    index=writeQueue.front();
+                    writeQueue.pop_front();
+                    writing=true;
+                    png= format==CaptureFormat::Png;
+
+                    char name[32];
+                    std::snprintf(name,sizeof(name),"frame_%06llu.%s",static_cast<unsigned long long>(slots[index].sequence),
+                                  png ? "png" : "pam");
+                    path=(std::filesystem::path(directory)/name).string();
+                }
+
+                PROFILE_ZONE("write captured frame");
+                auto begin=std::chrono::steady_clock::now();
+                const Slot& slot=slots[index];
+                imageio::toRgba(slot.mapped,slot.extent,slot.format,pixels);
+                bool written= png ? imageio::writePng(path,slot.extent,pixels) : imageio::writePam(path,slot.extent,pixels);
+                double milliseconds=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-begin).count();
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    slots[index].state=SlotState::Free;
+                    writing=false;
+                    if(written){
+                        ++stats.written;
+                        stats.writeMilliseconds+=milliseconds;
+                    }
+                }
+                idleCondition.notify_all();
+            }
+        }
+
+        VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+        VkDevice device=VK_NULL_HANDLE;
+        DeletionQueue* deletionQueue=nullptr;
+        VkMemoryPropertyFlags memoryFlags=0;
+
+        std::vector<Slot> slots;
+        int recordingSlot=-1; //slot acquired for the command buffer being recorded, render thread only
+
+        mutable std::mutex mutex;
+        std::condition_variable writeCondition;
+        std::condition_variable idleCondition;
+        std::deque<uint32_t> writeQueue;
+        std::thread writer;
+        bool stopWriter=false;
+        bool writing=false;
+
+        bool capturing=false;
+        std::string directory;
+        CaptureFormat format=CaptureFormat::Png;
+        uint64_t sequence=0;
+        Stats stats;
+};
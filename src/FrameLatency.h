@@ -0,0 +1,404 @@
+#pragma once
+
+#include "Profiler.h"
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<condition_variable>
+#include<deque>
+#include<iomanip>
+#include<iostream>
+#include<map>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+//Follows every frame from the moment its input was sampled over its submit and present call to the moment it reached
+//the screen. With VK_KHR_present_id and VK_KHR_present_wait a thread waits on every present and timestamps it as soon
+//as it completed. With VK_GOOGLE_display_timing the driver reports when each image was shown, a few frames later.
+//Without either only the CPU side is known.
+//The low latency mode starts the CPU frame as late as the display allows: a fixed offset after the next refresh, so
+//the frame is finished just before the refresh after that instead of waiting behind frames rendered ahead. The offset
+//grows while frames make their refresh and backs off when one misses it.
+class FrameLatency{
+
+    public:
+        enum class Source{
+            None,
+            PresentWait,
+            DisplayTiming
+        };
+
+        void init(VkDevice device, Source source, bool lowLatency){
+            this->device=device;
+            this->source=source;
+            origin=std::chrono::steady_clock::now();
+
+            if(source==Source::PresentWait){
+                waitForPresent=reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device,"vkWaitForPresentKHR"));
+                if(waitForPresent){
+                    stopping=false;
+                    waiter=std::thread(&FrameLatency::waitLoop,this);
+                }
+                else{
+                    this->source=Source::None;
+                }
+            }
+            else if(source==Source::DisplayTiming){
+                getPastPresentationTiming=reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>(vkGetDeviceProcAddr(device,"vkGetPastPresentationTimingGOOGLE"));
+                getRefreshCycleDuration=reinterpret_cast<PFN_vkGetRefreshCycleDurationGOOGLE>(vkGetDeviceProcAddr(device,"vkGetRefreshCycleDurationGOOGLE"));
+                if(!getPastPresentationTiming || !getRefreshCycleDuration){
+                    this->source=Source::None;
+                }
+            }
+            //without display times there is no refresh to align the frames to
+            this->lowLatency=lowLatency && this->source!=Source::None;
+        }
+
+        void cleanup(){
+            if(waiter.joinable()){
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping=true;
+                }
+                wakeWaiter.notify_all();
+                waiter.join();
+            }
+        }
+
+        //Call once the swapchain was (re)created. Frames presented to the old one are only counted if their
+        //display time is already known, the waiter lets go of the old swapchain before this returns.
+        void setSwapchain(VkSwapchainKHR swapchain){
+            if(source==Source::DisplayTiming && this->swapchain!=VK_NULL_HANDLE){
+                collect();
+            }
+            {
+                std::lock_guard<std::mutex> waiting(waitMutex);
+                std::lock_guard<std::mutex> lock(mutex);
+                this->swapchain=swapchain;
+                waitQueue.clear();
+            }
+            if(source==Source::DisplayTiming){
+                VkRefreshCycleDurationGOOGLE refreshCycle{};
+                if(getRefreshCycleDuration(device,swapchain,&refreshCycle)==VK_SUCCESS && refreshCycle.refreshDuration>0){
+                    refresh=refreshCycle.refreshDuration/1.0e6;
+                }
+            }
+        }
+
+        //Low latency mode: sleeps until offset after the next refresh. Call before the input of the frame is sampled.
+        void waitForFrameStart(){
+            if(!lowLatency){
+                return;
+            }
+            collect();
+            if(refresh<=0.0 || lastDisplay<0.0){
+                return; //nothing to align to yet
+            }
+            PROFILE_ZONE("waitForFrameStart");
+            double current=now();
+            double nextRefresh=lastDisplay+std::ceil((current-lastDisplay)/refresh)*refresh;
+            if(drain){
+                nextRefresh+=refresh;
+                drain=false;
+            }
+            double start=nextRefresh+offset;
+            if(start-refresh>current){
+                start-=refresh; //still within the offset of the refresh that just passed
+            }
+            targetRefresh=start-offset+refresh;
+            if(start>current){
+                std::this_thread::sleep_for(std::chrono::duration<double,std::milli>(start-current));
+            }
+        }
+
+        //The input the frame renders with has just been sampled.
+        void beginFrame(){
+            if(!lowLatency){
+                collect();
+            }
+            pending={};
+            pending.input=now();
+            pending.target= lowLatency ? targetRefresh : -1.0;
+        }
+
+        void markSubmit(){
+            pending.submit=now();
+        }
+
+        //Puts the id of the frame into presentInfo, storage has to live until the present call.
+        void chainPresentInfo(VkPresentInfoKHR& presentInfo){
+            ++nextId;
+            if(source==Source::PresentWait){
+                presentId={};
+                presentId.sType=VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+                presentId.pNext=presentInfo.pNext;
+                presentId.swapchainCount=1;
+                presentId.pPresentIds=&nextId;
+                presentInfo.pNext=&presentId;
+            }
+            else if(source==Source::DisplayTiming){
+                presentTime={static_cast<uint32_t>(nextId),0}; //no desired time, as soon as possible
+                presentTimes={};
+                presentTimes.sType=VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+                presentTimes.pNext=presentInfo.pNext;
+                presentTimes.swapchainCount=1;
+                presentTimes.pTimes=&presentTime;
+                presentInfo.pNext=&presentTimes;
+            }
+        }
+
+        void markPresent(VkResult result){
+            pending.present=now();
+            if(result!=VK_SUCCESS && result!=VK_SUBOPTIMAL_KHR){
+                return;
+            }
+            ++stats.presented;
+            if(source==Source::None){
+                addCpuSamples(pending);
+                return;
+            }
+            frames[nextId]=pending;
+            //frames the display never reports (replaced in mailbox mode, swapchain recreated) are dropped eventually
+            while(!frames.empty() && frames.begin()->first+maxPendingFrames<nextId){
+                frames.erase(frames.begin());
+                ++stats.lost;
+            }
+            if(source==Source::PresentWait){
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    waitQueue.push_back(nextId);
+                }
+                wakeWaiter.notify_all();
+            }
+        }
+
+        void printReport() const{
+            if(stats.presented==0){
+                return;
+            }
+            const char* names[]={"none","present wait","display timing"};
+            std::cout<<std::fixed<<std::setprecision(2);
+            std::cout<<"frame latency ("<<names[static_cast<int>(source)]<<", "<<stats.presented<<" frames presented";
+            if(source!=Source::None){
+                std::cout<<", "<<inputToDisplay.size()<<" with a display time, "<<stats.lost<<" never reported";
+            }
+            std::cout<<"), milliseconds"<<std::endl;
+            std::cout<<"                      p50      p90      p99      max"<<std::endl;
+            printPercentiles("  input to submit   ",inputToSubmit);
+            printPercentiles("  input to present  ",inputToPresent);
+            if(source!=Source::None){
+                printPercentiles("  present to display",presentToDisplay);
+                printPercentiles("  input to display  ",inputToDisplay);
+                std::cout<<"  refresh "<<refresh<<" ms";
+                if(lowLatency){
+                    std::cout<<", low latency offset "<<offset<<" ms, "<<stats.missed<<" missed refreshes";
+                }
+                std::cout<<std::endl;
+            }
+            else{
+                std::cout<<"  the device reports no display times (VK_KHR_present_wait or VK_GOOGLE_display_timing)"<<std::endl;
+            }
+            std::cout<<std::defaultfloat<<std::setprecision(6);
+        }
+
+    private:
+        struct Frame{
+            double input=0.0;   //milliseconds since init()
+            double submit=0.0;
+            double present=0.0;
+            double target=-1.0; //refresh the low latency mode started the frame for
+        };
+
+        struct Displayed{
+            uint64_t id;
+            double time;
+        };
+
+        struct Stats{
+            uint64_t presented=0;
+            uint64_t lost=0;
+            uint64_t missed=0;
+        };
+
+        static constexpr uint64_t maxPendingFrames=64;
+        static constexpr size_t maxSamples=1<<16;
+        static constexpr double waitTimeoutMs=5.0;
+
+        double now() const{
+            return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-origin).count();
+        }
+
+        //Waits on the presents one after the other. Each wait is short so a swapchain change never waits long on it.
+        void waitLoop(){
+            Profiler::get().setThreadName("present wait");
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true){
+                wakeWaiter.wait(lock,[this]{ return stopping || !waitQueue.empty(); });
+                if(stopping){
+                    return;
+                }
+                uint64_t id=waitQueue.front();
+                lock.unlock();
+                VkResult result=VK_ERROR_OUT_OF_DATE_KHR;
+                {
+                    std::lock_guard<std::mutex> waiting(waitMutex);
+                    if(swapchain!=VK_NULL_HANDLE){
+                        result=waitForPresent(device,swapchain,id,static_cast<uint64_t>(waitTimeoutMs*1.0e6));
+                    }
+                }
+                double time=now();
+                lock.lock();
+                if(waitQueue.empty() || waitQueue.front()!=id){
+                    continue; //the swapchain changed meanwhile
+                }
+                if(result==VK_TIMEOUT){
+                    continue;
+                }
+                waitQueue.pop_front();
+                if(result==VK_SUCCESS){
+                    displayed.push_back({id,time});
+                }
+            }
+        }
+
+        //Matches display times with the frames they belong to, on the render thread.
+        void collect(){
+            std::vector<Displayed> results;
+            if(source==Source::PresentWait){
+                std::lock_guard<std::mutex> lock(mutex);
+                results.assign(displayed.begin(),displayed.end());
+                displayed.clear();
+            }
+            else if(source==Source::DisplayTiming && swapchain!=VK_NULL_HANDLE){
+                uint32_t count=0;
+                getPastPresentationTiming(device,swapchain,&count,nullptr);
+                if(count>0){
+                    std::vector<VkPastPresentationTimingGOOGLE> timings(count);
+                    getPastPresentationTiming(device,swapchain,&count,timings.data());
+                    for(uint32_t i=0;i<count;++i){
+                        results.push_back({widenId(timings[i].presentID),displayTime(timings[i].actualPresentTime)});
+                    }
+                }
+            }
+            for(const Displayed& result: results){
+                auto frame=frames.find(result.id);
+                if(frame==frames.end()){
+                    continue;
+                }
+                addCpuSamples(frame->second);
+                addDisplaySample(result.id,frame->second,result.time);
+                frames.erase(frame);
+            }
+        }
+
+        //display timing ids are 32 bit, the frames in flight are always close to the latest id
+        uint64_t widenId(uint32_t id) const{
+            uint64_t wide=(nextId & ~uint64_t(0xFFFFFFFF)) | id;
+            return wide>nextId ? wide-(uint64_t(1)<<32) : wide;
+        }
+
+        //actualPresentTime is in nanoseconds of the monotonic clock, steady_clock uses the same one (CLOCK_MONOTONIC on Linux).
+        double displayTime(uint64_t nanoseconds) const{
+            std::chrono::steady_clock::time_point time{std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(nanoseconds))};
+            return std::chrono::duration<double,std::milli>(time-origin).count();
+        }
+
+        void addCpuSamples(const Frame& frame){
+            addSample(inputToSubmit,frame.submit-frame.input);
+            addSample(inputToPresent,frame.present-frame.input);
+        }
+
+        void addDisplaySample(uint64_t id, const Frame& frame, double time){
+            addSample(inputToDisplay,time-frame.input);
+            addSample(presentToDisplay,time-frame.present);
+
+            if(id==lastDisplayId+1 && lastDisplay>=0.0 && source==Source::PresentWait){
+                //intervals of frames shown on consecutive refreshes, longer ones skipped a refresh
+                intervals.push_back(time-lastDisplay);
+                if(intervals.size()>64){
+                    intervals.pop_front();
+                }
+                std::vector<double> sorted(intervals.begin(),intervals.end());
+                std::sort(sorted.begin(),sorted.end());
+                size_t consecutive=std::upper_bound(sorted.begin(),sorted.end(),sorted.front()*1.5)-sorted.begin();
+                refresh=sorted[consecutive/2];
+            }
+            if(id>lastDisplayId){
+                lastDisplay=time;
+                lastDisplayId=id;
+            }
+
+            if(!lowLatency || frame.target<0.0 || refresh<=0.0 || id<=adjustedAt){
+                return;
+            }
+            //frames started before the last adjustment do not show its effect yet
+            if(time>frame.target+refresh*0.5){
+                //every miss also slows down the growth, the offset settles just below the one that misses
+                ++stats.missed;
+                offset=std::max(offset-refresh*0.1,0.0);
+                offsetStep=std::max(offsetStep*0.5,refresh*0.001);
+                drain=true; //the frames behind it are queued a refresh late now, skip one so they catch up
+                adjustedAt=nextId;
+            }
+            else{
+                offset=std::min(offset+std::max(offsetStep,refresh*0.001),refresh*0.9);
+            }
+        }
+
+        static void addSample(std::vector<double>& samples, double value){
+            if(samples.size()<maxSamples){
+                samples.push_back(value);
+            }
+        }
+
+        static void printPercentiles(const char* name, std::vector<double> samples){
+            if(samples.empty()){
+                return;
+            }
+            std::sort(samples.begin(),samples.end());
+            auto percentile=[&](double p){ return samples[std::min(static_cast<size_t>(p*samples.size()),samples.size()-1)]; };
+            std::cout<<name<<" "<<std::setw(8)<<percentile(0.5)<<" "<<std::setw(8)<<percentile(0.9)<<" "
+                     <<std::setw(8)<<percentile(0.99)<<" "<<std::setw(8)<<samples.back()<<std::endl;
+        }
+
+        VkDevice device=VK_NULL_HANDLE;
+        Source source=Source::None;
+        bool lowLatency=false;
+        std::chrono::steady_clock::time_point origin;
+        PFN_vkWaitForPresentKHR waitForPresent=nullptr;
+        PFN_vkGetPastPresentationTimingGOOGLE getPastPresentationTiming=nullptr;
+        PFN_vkGetRefreshCycleDurationGOOGLE getRefreshCycleDuration=nullptr;
+
+        //render thread
+        uint64_t nextId=0;
+        Frame pending;
+        std::map<uint64_t,Frame> frames; //presented, display time not known yet
+        VkPresentIdKHR presentId{};
+        VkPresentTimeGOOGLE presentTime{};
+        VkPresentTimesInfoGOOGLE presentTimes{};
+        std::vector<double> inputToSubmit, inputToPresent, presentToDisplay, inputToDisplay;
+        std::deque<double> intervals;
+        double refresh=0.0;      //milliseconds
+        double lastDisplay=-1.0;
+        uint64_t lastDisplayId=0;
+        double offset=0.0;       //low latency: start of the CPU frame after a refresh
+        double offsetStep=1.0;   //growth of the offset per frame that made its refresh
+        double targetRefresh=-1.0;
+        bool drain=false;
+        uint64_t adjustedAt=0;
+        Stats stats;
+
+        //shared with the waiter, which holds waitMutex while it waits on swapchain
+        std::thread waiter;
+        std::mutex mutex;
+        std::mutex waitMutex;
+        std::condition_variable wakeWaiter;
+        bool stopping=false;
+        VkSwapchainKHR swapchain=VK_NULL_HANDLE;
+        std::deque<uint64_t> waitQueue;
+        std::vector<Displayed> displayed;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "Profiler.h"
+
+#include<GLFW/glfw3.h>
+
+#include<algorithm>
+#include<chrono>
+#include<cstdint>
+#include<ctime>
+#include<iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include<windows.h>
+#endif
+
+//Render on demand: instead of drawing as fast as the swapchain allows, the main loop only draws when something marked
+//the frame dirty and otherwise blocks in glfwWaitEventsTimeout, so a static scene costs next to nothing. Input and
+//window events request a frame from their callbacks; anything that changes on its own, running animations and streamed
+//data on its way to the GPU, has to request one every frame it is active. A change is drawn once per frame in flight,
+//so every slot's buffers hold it and whatever reads the previous frame (the depth pyramid, timings) settles.
+//Main thread only.
+class FrameScheduler{
+
+    public:
+        enum class Reason{
+            Input,
+            Window,     //resize, expose
+            Animation,
+            Streaming,
+            Count
+        };
+
+        struct Stats{
+            uint64_t frames=0;
+            uint64_t requests[static_cast<size_t>(Reason::Count)]={}; //changes drawn, by what asked for them
+            double idleMs=0.0;    //blocked waiting for events
+            double idleCpuMs=0.0; //process CPU time while blocked, all threads
+            double cpuMs=0.0;     //process CPU time since start()
+            double wallMs=0.0;
+        };
+
+        //timeout: longest block before the loop checks for work again, in seconds.
+        void init(bool enabled, uint32_t settleFrames, double timeout=0.25){
+            this->enabled=enabled;
+            this->settleFrames=settleFrames;
+            this->timeout=timeout;
+            dirty=1u<<static_cast<uint32_t>(Reason::Window); //the first frame
+        }
+
+        bool isEnabled() const{ return enabled; }
+
+        void start(){
+            startTime=std::chrono::steady_clock::now();
+            startCpu=processCpuMs();
+        }
+
+        void request(Reason reason){
+            dirty|=1u<<static_cast<uint32_t>(reason);
+        }
+
+        //True when a frame should be drawn now. Without work this blocks until an event arrives or the timeout passed and
+        //returns false, the loop then polls its sources again.
+        bool waitForFrame(){
+            if(!enabled){
+                return true;
+            }
+            if(dirty!=0){
+                for(size_t i=0;i<static_cast<size_t>(Reason::Count);++i){
+                    if(dirty & (1u<<i)){
+                        ++stats.requests[i];
+                    }
+                }
+                dirty=0;
+                remainingFrames=settleFrames;
+            }
+            if(remainingFrames>0){
+                --remainingFrames;
+                ++stats.frames;
+                return true;
+            }
+
+            PROFILE_ZONE("waitForFrame");
+            auto waitStart=std::chrono::steady_clock::now();
+            double waitCpu=processCpuMs();
+            glfwWaitEventsTimeout(timeout);
+            stats.idleMs+=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-waitStart).count();
+            stats.idleCpuMs+=processCpuMs()-waitCpu;
+            return false;
+        }
+
+        //gpuMs: GPU time of all frames drawn since start(), 0 when it was not measured.
+        void printReport(double gpuMs){
+            if(!enabled){
+                return;
+            }
+            stats.wallMs=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-startTime).count();
+            stats.cpuMs=processCpuMs()-startCpu;
+            if(stats.wallMs<=0.0){
+                return;
+            }
+            double activeMs=std::max(stats.wallMs-stats.idleMs,1e-3);
+            std::cout<<"on demand: "<<stats.frames<<" frames in "<<stats.wallMs/1000.0<<" s ("<<stats.frames/(stats.wallMs/1000.0)
+                     <<" per second), idle "<<100.0*stats.idleMs/stats.wallMs<<"% of the time"<<std::endl;
+            std::cout<<"on demand: CPU "<<(stats.idleMs>0.0 ? 100.0*stats.idleCpuMs/stats.idleMs : 0.0)<<"% of a core while idle, "
+                     <<100.0*(stats.cpuMs-stats.idleCpuMs)/activeMs<<"% while drawing, "<<100.0*stats.cpuMs/stats.wallMs<<"% overall";
+            if(gpuMs>0.0){
+                std::cout<<", GPU busy "<<100.0*gpuMs/stats.wallMs<<"% of the time";
+            }
+            std::cout<<std::endl;
+            const char* names[static_cast<size_t>(Reason::Count)]={"input","window","animation","streaming"};
+            std::cout<<"on demand: frames requested by";
+            for(size_t i=0;i<static_cast<size_t>(Reason::Count);++i){
+                std::cout<<(i ? ", " : " ")<<names[i]<<" "<<stats.requests[i];
+            }
+            std::cout<<std::endl;
+        }
+
+        Stats getStats() const{ return stats; }
+
+    private:
+        //CPU time of all threads of the process. std::clock would do on POSIX but is wall time on Windows.
+        static double processCpuMs(){
+#ifdef _WIN32
+            FILETIME creation,exit,kernel,user;
+            if(!GetProcessTimes(GetCurrentProcess(),&creation,&exit,&kernel,&user)){
+                return 0.0;
+            }
+            auto ticks=[](const FILETIME& time){ return (static_cast<uint64_t>(time.dwHighDateTime)<<32)|time.dwLowDateTime; };
+            return (ticks(kernel)+ticks(user))/10000.0; //100ns ticks
+#else
+            timespec time;
+            if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&time)!=0){
+                return 0.0;
+            }
+            return time.tv_sec*1000.0+time.tv_nsec/1000000.0;
+#endif
+        }
+
+        bool enabled=false;
+        uint32_t settleFrames=1;
+        double timeout=0.25;
+        uint32_t dirty=0;
+        uint32_t remainingFrames=0;
+        std::chrono::steady_clock::time_point startTime;
+        double startCpu=0.0;
+        Stats stats;
+};
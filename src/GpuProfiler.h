@@ -0,0 +1,315 @@
+#pragma once
+
+#include "Profiler.h"
+
+#include<vulkan/vulkan.h>
+
+#include<iostream>
+#include<stdexcept>
+#include<vector>
+
+//GPU zones from timestamp queries, one query pool per frame in flight and queue. The results of a frame slot are read
+//once its fence was waited on and converted to the CPU clock, with VK_EXT_calibrated_timestamps when the device has it
+//and a one time sync point measured at init otherwise. Every queue gets a track of its own, so work that overlaps
+//shows up side by side in the trace.
+class GpuProfiler{
+
+    public:
+        enum class Queue{
+            Graphics,
+            Compute,    //the async compute command buffer, submitted before the graphics one of the frame
+            Count
+        };
+
+        //calibrated: VK_EXT_calibrated_timestamps was enabled on the device. queue and queueFamily are the graphics ones.
+        void init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, uint32_t queueFamily,
+                  uint32_t computeFamily, VkCommandPool commandPool, uint32_t framesInFlight, bool calibrated){
+
+            if(!Profiler::isEnabled()){
+                return;
+            }
+            this->device=device;
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice,&properties);
+            timestampPeriod=properties.limits.timestampPeriod;
+
+            uint32_t familyCount=0;
+            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,&familyCount,nullptr);
+            std::vector<VkQueueFamilyProperties> families(familyCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,&familyCount,families.data());
+            uint32_t validBits[static_cast<size_t>(Queue::Count)]={families[queueFamily].timestampValidBits,families[computeFamily].timestampValidBits};
+            if(validBits[0]==0){
+                std::cerr<<"queue has no timestamp support, GPU zones are disabled"<<std::endl;
+                return;
+            }
+            if(validBits[1]==0){
+                std::cerr<<"compute queue has no timestamp support, its GPU zones are disabled"<<std::endl;
+            }
+
+            frames.resize(framesInFlight);
+            for(size_t queue=0;queue<static_cast<size_t>(Queue::Count);++queue){
+                if(validBits[queue]==0){
+                    continue;
+                }
+                timestampMasks[queue]= validBits[queue]>=64 ? ~0ull : (1ull<<validBits[queue])-1;
+                for(auto& frame: frames){
+                    VkQueryPoolCreateInfo poolInfo{};
+                    {
+                        poolInfo.sType=VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                        poolInfo.queryType=VK_QUERY_TYPE_TIMESTAMP;
+                        poolInfo.queryCount=maxQueries;
+                    }
+                    if(vkCreateQueryPool(device,&poolInfo,nullptr,&frame.timelines[queue].queryPool)!=VK_SUCCESS){
+                        throw std::runtime_error("failed to create timestamp query pool!");
+                    }
+                }
+            }
+
+            if(calibrated && hasMonotonicDomain(instance,physicalDevice)){
+                getCalibratedTimestamps=reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(device,"vkGetCalibratedTimestampsEXT"));
+            }
+            if(getCalibratedTimestamps){
+                calibrate();
+            }
+            else{
+                syncPoint(queue,commandPool);
+            }
+            tracks[0]=Profiler::get().createTrack("GPU graphics queue");
+            tracks[1]=Profiler::get().createTrack("GPU compute queue");
+            active=true;
+        }
+
+        void cleanup(){
+            for(auto& frame: frames){
+                for(Timeline& timeline: frame.timelines){
+                    vkDestroyQueryPool(device,timeline.queryPool,nullptr);
+                }
+            }
+            frames.clear();
+            active=false;
+        }
+
+        //Whether frames write timestamps, only while the CPU profiler records.
+        bool isActive() const{ return active; }
+
+        //After the frame slot's fence was waited on, turns the timestamps it wrote into zones.
+        void collect(uint32_t frame){
+            if(!active){
+                return;
+            }
+            bool calibrated=false;
+            for(size_t queue=0;queue<static_cast<size_t>(Queue::Count);++queue){
+                Timeline& timeline=frames[frame].timelines[queue];
+                if(timeline.queryCount>0){
+                    std::vector<uint64_t> timestamps(timeline.queryCount);
+                    if(vkGetQueryPoolResults(device,timeline.queryPool,0,timeline.queryCount,timestamps.size()*sizeof(uint64_t),timestamps.data(),
+                                             sizeof(uint64_t),VK_QUERY_RESULT_64_BIT)==VK_SUCCESS){
+                        if(getCalibratedTimestamps && !calibrated){
+                            calibrate(); //cheap, keeps the two clocks from drifting apart
+                            calibrated=true;
+                        }
+                        for(const auto& zone: timeline.zones){
+                            Profiler::get().addTrackZone(tracks[queue],zone.name,toCpu(timestamps[zone.beginQuery],timestampMasks[queue]),
+                                                         toCpu(timestamps[zone.endQuery],timestampMasks[queue]));
+                        }
+                    }
+                }
+                timeline.zones.clear();
+                timeline.queryCount=0;
+            }
+        }
+
+        //First thing recorded into the frame's command buffer for that queue.
+        void beginFrame(VkCommandBuffer commandBuffer, uint32_t frame, Queue queue=Queue::Graphics){
+            if(!active){
+                return;
+            }
+            currentFrames[static_cast<size_t>(queue)]=frame;
+            VkQueryPool queryPool=frames[frame].timelines[static_cast<size_t>(queue)].queryPool;
+            if(queryPool!=VK_NULL_HANDLE){
+                vkCmdResetQueryPool(commandBuffer,queryPool,0,maxQueries);
+            }
+        }
+
+        //Zones nest, name has to be a string literal or interned.
+        void begin(VkCommandBuffer commandBuffer, const char* name, Queue queue=Queue::Graphics){
+            if(!active){
+                return;
+            }
+            Timeline& timeline=frames[currentFrames[static_cast<size_t>(queue)]].timelines[static_cast<size_t>(queue)];
+            std::vector<uint32_t>& open=openZones[static_cast<size_t>(queue)];
+            if(timeline.queryPool==VK_NULL_HANDLE || timeline.queryCount+2>maxQueries){
+                open.push_back(noQuery);
+                return;
+            }
+            vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,timeline.queryPool,timeline.queryCount);
+            timeline.zones.push_back({name,timeline.queryCount,0});
+            open.push_back(static_cast<uint32_t>(timeline.zones.size()-1));
+            timeline.queryCount+=2; //the end query is reserved right away so begin/end pairs stay together
+        }
+
+        void end(VkCommandBuffer commandBuffer, Queue queue=Queue::Graphics){
+            if(!active){
+                return;
+            }
+            std::vector<uint32_t>& open=openZones[static_cast<size_t>(queue)];
+            uint32_t zone=open.back();
+            open.pop_back();
+            if(zone==noQuery){
+                return;
+            }
+            Timeline& timeline=frames[currentFrames[static_cast<size_t>(queue)]].timelines[static_cast<size_t>(queue)];
+            timeline.zones[zone].endQuery=timeline.zones[zone].beginQuery+1;
+            vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,timeline.queryPool,timeline.zones[zone].endQuery);
+        }
+
+    private:
+        struct Zone{
+            const char* name;
+            uint32_t beginQuery;
+            uint32_t endQuery;
+        };
+
+        struct Timeline{
+            VkQueryPool queryPool=VK_NULL_HANDLE; //none when the queue's family has no timestamps
+            uint32_t queryCount=0;
+            std::vector<Zone> zones;
+        };
+
+        struct Frame{
+            Timeline timelines[static_cast<size_t>(Queue::Count)];
+        };
+
+        //Only CLOCK_MONOTONIC is the clock Profiler::now() reads, and only on Linux.
+        bool hasMonotonicDomain(VkInstance instance, VkPhysicalDevice physicalDevice){
+#if defined(__linux__)
+            auto getDomains=reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+                vkGetInstanceProcAddr(instance,"vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+            if(!getDomains){
+                return false;
+            }
+            uint32_t count=0;
+            getDomains(physicalDevice,&count,nullptr);
+            std::vector<VkTimeDomainEXT> domains(count);
+            getDomains(physicalDevice,&count,domains.data());
+            bool device=false,monotonic=false;
+            for(VkTimeDomainEXT domain: domains){
+                device|=domain==VK_TIME_DOMAIN_DEVICE_EXT;
+                monotonic|=domain==VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+            }
+            return device && monotonic;
+#else
+            return false;
+#endif
+        }
+
+        void calibrate(){
+            VkCalibratedTimestampInfoEXT infos[2]{};
+            infos[0].sType=VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+            infos[0].timeDomain=VK_TIME_DOMAIN_DEVICE_EXT;
+            infos[1].sType=VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+            infos[1].timeDomain=VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+
+            uint64_t timestamps[2];
+            uint64_t maxDeviation;
+            if(getCalibratedTimestamps(device,2,infos,timestamps,&maxDeviation)==VK_SUCCESS){
+                gpuReference=timestamps[0]&timestampMasks[0];
+                cpuReference=static_cast<int64_t>(timestamps[1]);
+            }
+        }
+
+        //Writes one timestamp and takes the middle of the CPU time around the submission as its CPU time.
+        void syncPoint(VkQueue queue, VkCommandPool commandPool){
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            {
+                allocInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.level=VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandPool=commandPool;
+                allocInfo.commandBufferCount=1;
+            }
+            VkCommandBuffer commandBuffer;
+            vkAllocateCommandBuffers(device,&allocInfo,&commandBuffer);
+
+            VkCommandBufferBeginInfo beginInfo{};
+            {
+                beginInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            }
+            vkBeginCommandBuffer(commandBuffer,&beginInfo);
+                vkCmdResetQueryPool(commandBuffer,frames[0].timelines[0].queryPool,0,1);
+                vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,frames[0].timelines[0].queryPool,0);
+            vkEndCommandBuffer(commandBuffer);
+
+            VkFenceCreateInfo fenceInfo{};
+            {
+                fenceInfo.sType=VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            }
+            VkFence fence;
+            vkCreateFence(device,&fenceInfo,nullptr,&fence);
+
+            VkSubmitInfo submitInfo{};
+            {
+                submitInfo.sType=VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount=1;
+                submitInfo.pCommandBuffers=&commandBuffer;
+            }
+            int64_t before=Profiler::now();
+            vkQueueSubmit(queue,1,&submitInfo,fence);
+            vkWaitForFences(device,1,&fence,VK_TRUE,UINT64_MAX);
+            int64_t after=Profiler::now();
+
+            uint64_t timestamp=0;
+            vkGetQueryPoolResults(device,frames[0].timelines[0].queryPool,0,1,sizeof(timestamp),&timestamp,sizeof(timestamp),VK_QUERY_RESULT_64_BIT);
+            gpuReference=timestamp&timestampMasks[0];
+            cpuReference=before+(after-before)/2;
+
+            vkDestroyFence(device,fence,nullptr);
+            vkFreeCommandBuffers(device,commandPool,1,&commandBuffer);
+        }
+
+        //All queues of the device share the timestamp clock, only the valid bits differ between their families.
+        int64_t toCpu(uint64_t timestamp, uint64_t timestampMask) const{
+            int64_t ticks=static_cast<int64_t>(timestamp&timestampMask)-static_cast<int64_t>(gpuReference);
+            return cpuReference+static_cast<int64_t>(static_cast<double>(ticks)*timestampPeriod);
+        }
+
+        static constexpr uint32_t maxQueries=128;
+        static constexpr uint32_t noQuery=~0u;
+
+        VkDevice device=VK_NULL_HANDLE;
+        PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps=nullptr;
+        bool active=false;
+        uint32_t tracks[static_cast<size_t>(Queue::Count)]={};
+        float timestampPeriod=1.0f;
+        uint64_t timestampMasks[static_cast<size_t>(Queue::Count)]={~0ull,~0ull};
+        uint64_t gpuReference=0;
+        int64_t cpuReference=0;
+
+        std::vector<Frame> frames;
+        uint32_t currentFrames[static_cast<size_t>(Queue::Count)]={};
+        std::vector<uint32_t> openZones[static_cast<size_t>(Queue::Count)];
+};
+
+//Scoped GPU zone for a command buffer that is being recorded.
+class GpuProfileZone{
+
+    public:
+        GpuProfileZone(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name, GpuProfiler::Queue queue=GpuProfiler::Queue::Graphics):
+            profiler(profiler), commandBuffer(commandBuffer), queue(queue){
+            profiler.begin(commandBuffer,name,queue);
+        }
+
+        ~GpuProfileZone(){
+            profiler.end(commandBuffer,queue);
+        }
+
+        GpuProfileZone(const GpuProfileZone&)=delete;
+        GpuProfileZone& operator=(const GpuProfileZone&)=delete;
+
+    private:
+        GpuProfiler& profiler;
+        VkCommandBuffer commandBuffer;
+        GpuProfiler::Queue queue;
+};
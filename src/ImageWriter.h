@@ -0,0 +1,138 @@
+#pragma once
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<array>
+#include<fstream>
+#include<iostream>
+#include<string>
+#include<vector>
+
+//Minimal encoders for the images read back from the GPU (frame capture, batch rendering). No compression,
+//writing has to keep up with the renderer and the disk is rarely the bottleneck.
+namespace imageio{
+
+    //8 bit color formats toRgba() knows how to convert.
+    inline bool supportsFormat(VkFormat format){
+        switch(format){
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_SRGB:
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    inline void toRgba(const void* mapped, VkExtent2D extent, VkFormat format, std::vector<uint8_t>& pixels){
+        size_t size=static_cast<size_t>(extent.width)*extent.height*4;
+        pixels.resize(size);
+        const uint8_t* source=static_cast<const uint8_t*>(mapped);
+        bool bgra= format==VK_FORMAT_B8G8R8A8_UNORM || format==VK_FORMAT_B8G8R8A8_SRGB;
+        for(size_t i=0;i<size;i+=4){
+            pixels[i+0]=source[i+(bgra ? 2 : 0)];
+            pixels[i+1]=source[i+1];
+            pixels[i+2]=source[i+(bgra ? 0 : 2)];
+            pixels[i+3]=255; //the swapchain is composited opaque, alpha is whatever the pass left
+        }
+    }
+
+    inline bool writePam(const std::string& path, VkExtent2D extent, const std::vector<uint8_t>& pixels){
+        std::ofstream file(path,std::ios::binary);
+        if(!file.is_open()){
+            std::cerr<<"failed to write "<<path<<std::endl;
+            return false;
+        }
+        file<<"P7\nWIDTH "<<extent.width<<"\nHEIGHT "<<extent.height<<"\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+        file.write(reinterpret_cast<const char*>(pixels.data()),static_cast<std::streamsize>(pixels.size()));
+        return file.good();
+    }
+
+    inline uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc=0){
+        static const std::array<uint32_t,256> table=[]{
+            std::array<uint32_t,256> values{};
+            for(uint32_t n=0;n<256;++n){
+                uint32_t c=n;
+                for(int k=0;k<8;++k){
+                    c= (c & 1) ? 0xEDB88320u^(c>>1) : c>>1;
+                }
+                values[n]=c;
+            }
+            return values;
+        }();
+        crc=~crc;
+        for(size_t i=0;i<size;++i){
+            crc=table[(crc^data[i]) & 0xFF]^(crc>>8);
+        }
+        return ~crc;
+    }
+
+    //PNG with stored (uncompressed) deflate blocks. Compressing would make the writer the bottleneck long before the disk is.
+    inline bool writePng(const std::string& path, VkExtent2D extent, const std::vector<uint8_t>& pixels){
+
+        auto put32=[](std::vector<uint8_t>& out, uint32_t value){
+            out.push_back(static_cast<uint8_t>(value>>24));
+            out.push_back(static_cast<uint8_t>(value>>16));
+            out.push_back(static_cast<uint8_t>(value>>8));
+            out.push_back(static_cast<uint8_t>(value));
+        };
+
+        //zlib stream: every row starts with filter type 0, split into stored blocks of at most 65535 bytes
+        size_t rowSize=static_cast<size_t>(extent.width)*4;
+        std::vector<uint8_t> raw;
+        raw.reserve((rowSize+1)*extent.height);
+        for(uint32_t y=0;y<extent.height;++y){
+            raw.push_back(0);
+            raw.insert(raw.end(),pixels.begin()+y*rowSize,pixels.begin()+(y+1)*rowSize);
+        }
+
+        std::vector<uint8_t> data={'I','D','A','T',0x78,0x01};
+        data.reserve(raw.size()+raw.size()/65535*5+32);
+        uint32_t adlerA=1;
+        uint32_t adlerB=0;
+        for(size_t offset=0;offset<raw.size() || offset==0;){
+            size_t blockSize=std::min<size_t>(raw.size()-offset,65535);
+            bool last= offset+blockSize==raw.size();
+            data.push_back(last ? 1 : 0);
+            data.push_back(static_cast<uint8_t>(blockSize));
+            data.push_back(static_cast<uint8_t>(blockSize>>8));
+            data.push_back(static_cast<uint8_t>(~blockSize));
+            data.push_back(static_cast<uint8_t>(~blockSize>>8));
+            for(size_t i=0;i<blockSize;++i){
+                adlerA=(adlerA+raw[offset+i])%65521;
+                adlerB=(adlerB+adlerA)%65521;
+            }
+            data.insert(data.end(),raw.begin()+offset,raw.begin()+offset+blockSize);
+            offset+=blockSize;
+            if(last){
+                break;
+            }
+        }
+        put32(data,(adlerB<<16)|adlerA);
+
+        std::vector<uint8_t> header={'I','H','D','R'};
+        put32(header,extent.width);
+        put32(header,extent.height);
+        header.insert(header.end(),{8,6,0,0,0}); //8 bit RGBA, no interlacing
+
+        std::vector<uint8_t> file={0x89,'P','N','G','\r','\n',0x1A,'\n'};
+        auto putChunk=[&](const std::vector<uint8_t>& chunk){
+            put32(file,static_cast<uint32_t>(chunk.size()-4));
+            file.insert(file.end(),chunk.begin(),chunk.end());
+            put32(file,crc32(chunk.data(),chunk.size()));
+        };
+        putChunk(header);
+        putChunk(data);
+        putChunk({'I','E','N','D'});
+
+        std::ofstream out(path,std::ios::binary);
+        if(!out.is_open()){
+            std::cerr<<"failed to write "<<path<<std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(file.data()),static_cast<std::streamsize>(file.size()));
+        return out.good();
+    }
+}
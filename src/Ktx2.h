@@ -0,0 +1,159 @@
+#pragma once
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<cstdint>
+#include<cstring>
+#include<fstream>
+#include<stdexcept>
+#include<string>
+#include<vector>
+
+//Minimal KTX2 reader. Only the header and the level index are parsed up front,
+//level payloads are read on demand so the fine mips of a texture never have to sit in system memory.
+struct Ktx2File{
+
+    struct Level{
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    std::string path;
+    VkFormat format=VK_FORMAT_UNDEFINED;
+    uint32_t width=0;
+    uint32_t height=0;
+    std::vector<Level> levels; //levels[0] is the full resolution image
+    bool generateMips=false;   //only the base level is stored, the rest of the chain has to be built on the GPU
+
+    std::vector<char> memory;  //used instead of the file when the texture was created from pixels in memory
+
+    static Ktx2File open(const std::string& path){
+
+        std::ifstream file(path,std::ios::binary);
+        if(!file.is_open()){
+            throw std::runtime_error("failed to open ktx2 file!");
+        }
+
+        struct Header{
+            uint8_t identifier[12];
+            uint32_t vkFormat;
+            uint32_t typeSize;
+            uint32_t pixelWidth;
+            uint32_t pixelHeight;
+            uint32_t pixelDepth;
+            uint32_t layerCount;
+            uint32_t faceCount;
+            uint32_t levelCount;
+            uint32_t supercompressionScheme;
+            uint32_t dfdByteOffset;
+            uint32_t dfdByteLength;
+            uint32_t kvdByteOffset;
+            uint32_t kvdByteLength;
+            uint64_t sgdByteOffset;
+            uint64_t sgdByteLength;
+        };
+        static_assert(sizeof(Header)==80,"unexpected ktx2 header size");
+
+        static const uint8_t identifier[12]={0xAB,'K','T','X',' ','2','0',0xBB,'\r','\n',0x1A,'\n'};
+
+        Header header{};
+        file.read(reinterpret_cast<char*>(&header),sizeof(header));
+        if(!file || memcmp(header.identifier,identifier,sizeof(identifier))!=0){
+            throw std::runtime_error("invalid ktx2 file!");
+        }
+        if(header.supercompressionScheme!=0){
+            throw std::runtime_error("supercompressed ktx2 files are not supported!");
+        }
+        if(header.vkFormat==VK_FORMAT_UNDEFINED){
+            throw std::runtime_error("ktx2 file has no vulkan format (basis universal is not supported)!");
+        }
+        if(header.pixelDepth>1 || header.layerCount>1 || header.faceCount!=1){
+            throw std::runtime_error("only 2D ktx2 textures are supported!");
+        }
+        if(header.pixelWidth==0){
+            throw std::runtime_error("ktx2 file has no width!");
+        }
+        //a full chain ends at 1x1, more levels than that would also shift the size out of range below
+        uint32_t maxLevels=1;
+        for(uint32_t size=std::max(header.pixelWidth,header.pixelHeight);size>1;size>>=1){
+            ++maxLevels;
+        }
+        if(header.levelCount>maxLevels){
+            throw std::runtime_error("ktx2 file has more levels than its size allows!");
+        }
+
+        file.seekg(0,std::ios::end);
+        uint64_t fileSize=static_cast<uint64_t>(file.tellg());
+        file.seekg(sizeof(Header));
+
+        Ktx2File ktx;
+        ktx.path=path;
+        ktx.format=static_cast<VkFormat>(header.vkFormat);
+        ktx.width=header.pixelWidth;
+        ktx.height=std::max(header.pixelHeight,1u);
+        ktx.generateMips= header.levelCount==0;
+
+        //levelCount==0 still stores one level in the index
+        uint32_t levelCount=std::max(header.levelCount,1u);
+        ktx.levels.resize(levelCount);
+        for(uint32_t i=0;i<levelCount;++i){
+            uint64_t entry[3];
+            file.read(reinterpret_cast<char*>(entry),sizeof(entry));
+            if(!file){
+                throw std::runtime_error("truncated ktx2 level index!");
+            }
+            if(entry[0]>fileSize || entry[1]>fileSize-entry[0]){
+                throw std::runtime_error("ktx2 level is past the end of the file!");
+            }
+            ktx.levels[i].byteOffset=entry[0];
+            ktx.levels[i].byteLength=entry[1];
+            ktx.levels[i].width=std::max(ktx.width>>i,1u);
+            ktx.levels[i].height=std::max(ktx.height>>i,1u);
+        }
+        return ktx;
+    }
+
+    //Wraps tightly packed pixels of a single level, mips will be generated on the GPU.
+    static Ktx2File fromPixels(VkFormat format, uint32_t width, uint32_t height, std::vector<char> pixels){
+
+        Ktx2File ktx;
+        ktx.format=format;
+        ktx.width=width;
+        ktx.height=height;
+        ktx.generateMips=true;
+        ktx.levels.push_back({0,static_cast<uint64_t>(pixels.size()),width,height});
+        ktx.memory=std::move(pixels);
+        return ktx;
+    }
+
+    void readLevel(uint32_t level, char* dst) const{
+
+        const Level& l=levels.at(level);
+        if(!memory.empty()){
+            if(l.byteOffset>memory.size() || l.byteLength>memory.size()-l.byteOffset){
+                throw std::runtime_error("ktx2 level is past the end of the pixels!");
+            }
+            memcpy(dst,memory.data()+l.byteOffset,l.byteLength);
+            return;
+        }
+
+        std::ifstream file(path,std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(l.byteOffset));
+        file.read(dst,static_cast<std::streamsize>(l.byteLength));
+        if(!file){
+            throw std::runtime_error("failed to read ktx2 level!");
+        }
+    }
+
+    static bool isBlockCompressed(VkFormat format){
+        return (format>=VK_FORMAT_BC1_RGB_UNORM_BLOCK && format<=VK_FORMAT_BC7_SRGB_BLOCK) ||
+               (format>=VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format<=VK_FORMAT_EAC_R11G11_SNORM_BLOCK);
+    }
+
+    static bool isEtc2(VkFormat format){
+        return format>=VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format<=VK_FORMAT_EAC_R11G11_SNORM_BLOCK;
+    }
+};
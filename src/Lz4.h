@@ -0,0 +1,155 @@
+#pragma once
+
+#include<algorithm>
+#include<cstdint>
+#include<cstring>
+#include<vector>
+
+//LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), enough for the asset pack: a greedy
+//compressor with a small hash table, and a decompressor that checks every length against the buffers so a damaged
+//block fails instead of writing out of bounds. Blocks are interchangeable with the reference implementation.
+namespace lz4{
+
+    namespace detail{
+
+        constexpr size_t minMatch=4;
+        constexpr size_t lastLiterals=5;   //a block ends with at least this many literals
+        constexpr size_t matchSearchLimit=12; //the last match starts at least this far from the end
+        constexpr uint32_t hashBits=14;
+
+        inline uint32_t read32(const uint8_t* p){
+            uint32_t value;
+            memcpy(&value,p,sizeof(value));
+            return value;
+        }
+
+        inline uint32_t hash(uint32_t sequence){
+            return (sequence*2654435761u)>>(32-hashBits);
+        }
+
+        inline void writeLength(std::vector<uint8_t>& out, size_t length){
+            while(length>=255){
+                out.push_back(255);
+                length-=255;
+            }
+            out.push_back(static_cast<uint8_t>(length));
+        }
+
+        inline void writeSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength){
+            size_t matchCode= matchLength>0 ? matchLength-minMatch : 0;
+            out.push_back(static_cast<uint8_t>((std::min<size_t>(literalCount,15)<<4) | std::min<size_t>(matchCode,15)));
+            if(literalCount>=15){
+                writeLength(out,literalCount-15);
+            }
+            out.insert(out.end(),literals,literals+literalCount);
+            if(matchLength==0){
+                return; //the last sequence has no match
+            }
+            out.push_back(static_cast<uint8_t>(offset & 0xFF));
+            out.push_back(static_cast<uint8_t>(offset>>8));
+            if(matchCode>=15){
+                writeLength(out,matchCode-15);
+            }
+        }
+    }
+
+    //Upper bound of the compressed size, as LZ4_compressBound().
+    inline size_t compressBound(size_t size){
+        return size+size/255+16;
+    }
+
+    //Replaces out with the compressed block.
+    inline void compress(const void* source, size_t size, std::vector<uint8_t>& out){
+
+        using namespace detail;
+        const uint8_t* src=static_cast<const uint8_t*>(source);
+        out.clear();
+        out.reserve(compressBound(size));
+
+        size_t anchor=0;
+        if(size>matchSearchLimit){
+            std::vector<uint32_t> table(size_t(1)<<hashBits,0); //position+1, 0 is empty
+            size_t limit=size-matchSearchLimit;
+            size_t matchEnd=size-lastLiterals;
+            size_t i=0;
+            while(i<limit){
+                uint32_t sequence=read32(src+i);
+                uint32_t& slot=table[hash(sequence)];
+                size_t candidate=slot;
+                slot=static_cast<uint32_t>(i+1);
+                if(candidate==0 || i-(candidate-1)>65535 || read32(src+candidate-1)!=sequence){
+                    ++i;
+                    continue;
+                }
+                --candidate;
+                size_t length=minMatch;
+                while(i+length<matchEnd && src[candidate+length]==src[i+length]){
+                    ++length;
+                }
+                writeSequence(out,src+anchor,i-anchor,i-candidate,length);
+                i+=length;
+                anchor=i;
+            }
+        }
+        writeSequence(out,src+anchor,size-anchor,0,0);
+    }
+
+    //Decompresses a block into exactly size bytes of destination, false if the block is damaged or does not fit.
+    inline bool decompress(const void* source, size_t sourceSize, void* destination, size_t size){
+
+        const uint8_t* ip=static_cast<const uint8_t*>(source);
+        const uint8_t* end=ip+sourceSize;
+        uint8_t* out=static_cast<uint8_t*>(destination);
+        size_t op=0;
+
+        auto readLength=[&](size_t& length){
+            uint8_t byte;
+            do{
+                if(ip>=end){
+                    return false;
+                }
+                byte=*ip++;
+                length+=byte;
+            }while(byte==255);
+            return true;
+        };
+
+        while(ip<end){
+            uint8_t token=*ip++;
+            size_t literalCount=token>>4;
+            if(literalCount==15 && !readLength(literalCount)){
+                return false;
+            }
+            if(literalCount>static_cast<size_t>(end-ip) || literalCount>size-op){
+                return false;
+            }
+            memcpy(out+op,ip,literalCount);
+            ip+=literalCount;
+            op+=literalCount;
+            if(ip==end){
+                break; //the last sequence is literals only
+            }
+
+            if(end-ip<2){
+                return false;
+            }
+            size_t offset=ip[0] | (static_cast<size_t>(ip[1])<<8);
+            ip+=2;
+            size_t matchLength=token & 15;
+            if(matchLength==15 && !readLength(matchLength)){
+                return false;
+            }
+            matchLength+=detail::minMatch;
+            if(offset==0 || offset>op || matchLength>size-op){
+                return false;
+            }
+            //matches may overlap what they produce, so copy forward byte by byte
+            const uint8_t* match=out+op-offset;
+            for(size_t i=0;i<matchLength;++i){
+                out[op+i]=match[i];
+            }
+            op+=matchLength;
+        }
+        return op==size;
+    }
+}
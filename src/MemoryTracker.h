@@ -0,0 +1,278 @@
+#pragma once
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<fstream>
+#include<iostream>
+#include<mutex>
+#include<sstream>
+#include<string>
+#include<unordered_map>
+#include<vector>
+
+//What a device memory allocation is used for, every allocation is tagged with one.
+enum class MemoryCategory{
+    Geometry,
+    Uniforms,
+    Staging,
+    Textures,
+    Attachments,
+    Readback,
+    Other
+};
+
+constexpr size_t memoryCategoryCount=7;
+
+inline const char* memoryCategoryName(MemoryCategory category){
+    switch(category){
+        case MemoryCategory::Geometry: return "geometry";
+        case MemoryCategory::Uniforms: return "uniforms";
+        case MemoryCategory::Staging: return "staging";
+        case MemoryCategory::Textures: return "textures";
+        case MemoryCategory::Attachments: return "attachments";
+        case MemoryCategory::Readback: return "readback";
+        case MemoryCategory::Other: return "other";
+    }
+    return "other";
+}
+
+//Accounts every device memory allocation of the process by category and heap, and compares the heaps against the
+//budget VK_EXT_memory_budget reports (the heap size when the extension is missing). Allocations and frees go through
+//vkutil::allocateMemory()/vkutil::freeMemory(), which is why there is one tracker per process.
+class MemoryTracker{
+
+    public:
+        struct HeapStats{
+            VkDeviceSize size=0;
+            VkDeviceSize budget=0;  //how much the process can use before the driver starts evicting
+            VkDeviceSize usage=0;   //what the driver says the process uses, equals tracked without the extension
+            VkDeviceSize tracked=0; //sum of our own allocations in the heap
+            uint32_t allocations=0;
+            bool deviceLocal=false;
+        };
+
+        struct CategoryStats{
+            VkDeviceSize bytes=0;
+            VkDeviceSize peakBytes=0;
+            uint32_t allocations=0;
+        };
+
+        //budgetSupported: VK_EXT_memory_budget was enabled on the device, needs VK_KHR_get_physical_device_properties2 on the instance.
+        void init(VkInstance instance, VkPhysicalDevice physicalDevice, bool budgetSupported){
+            std::lock_guard<std::mutex> lock(mutex);
+            this->physicalDevice=physicalDevice;
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice,&memoryProperties);
+            heaps.assign(memoryProperties.memoryHeapCount,HeapStats{});
+            warned.assign(memoryProperties.memoryHeapCount,false);
+            for(uint32_t i=0;i<memoryProperties.memoryHeapCount;++i){
+                heaps[i].size=memoryProperties.memoryHeaps[i].size;
+                heaps[i].budget=heaps[i].size;
+                heaps[i].deviceLocal=(memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)!=0;
+            }
+
+            getMemoryProperties2=nullptr;
+            if(budgetSupported){
+                getMemoryProperties2=reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+                    vkGetInstanceProcAddr(instance,"vkGetPhysicalDeviceMemoryProperties2KHR"));
+            }
+            queryBudget();
+        }
+
+        bool hasBudgetExtension() const{ return getMemoryProperties2!=nullptr; }
+
+        //Fraction of the budget above which a heap is reported, warnings repeat once usage dropped below it again.
+        void setWarningThreshold(float threshold){
+            std::lock_guard<std::mutex> lock(mutex);
+            warningThreshold=threshold;
+        }
+
+        void onAllocate(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, MemoryCategory category){
+            std::lock_guard<std::mutex> lock(mutex);
+            uint32_t heap=memoryTypeIndex<memoryProperties.memoryTypeCount ? memoryProperties.memoryTypes[memoryTypeIndex].heapIndex : 0;
+            allocations[memory]={size,heap,category};
+
+            CategoryStats& stats=categories[static_cast<size_t>(category)];
+            stats.bytes+=size;
+            stats.peakBytes=std::max(stats.peakBytes,stats.bytes);
+            ++stats.allocations;
+
+            if(heap<heaps.size()){
+                heaps[heap].tracked+=size;
+                ++heaps[heap].allocations;
+                if(!hasBudgetExtension()){
+                    heaps[heap].usage=heaps[heap].tracked;
+                }
+                checkHeap(heap);
+            }
+        }
+
+        void onFree(VkDeviceMemory memory){
+            std::lock_guard<std::mutex> lock(mutex);
+            auto allocation=allocations.find(memory);
+            if(allocation==allocations.end()){
+                return; //allocated before the tracker existed
+            }
+
+            CategoryStats& stats=categories[static_cast<size_t>(allocation->second.category)];
+            stats.bytes-=allocation->second.size;
+            --stats.allocations;
+
+            uint32_t heap=allocation->second.heap;
+            if(heap<heaps.size()){
+                heaps[heap].tracked-=allocation->second.size;
+                --heaps[heap].allocations;
+                if(!hasBudgetExtension()){
+                    heaps[heap].usage=heaps[heap].tracked;
+                }
+            }
+            allocations.erase(allocation);
+        }
+
+        //Refreshes the driver's budget numbers, at most every queryInterval frames since the query is not free.
+        void update(uint64_t frame){
+            if(frame-lastQueryFrame<queryInterval){
+                return;
+            }
+            lastQueryFrame=frame;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            queryBudget();
+            for(uint32_t heap=0;heap<heaps.size();++heap){
+                checkHeap(heap);
+            }
+        }
+
+        std::vector<HeapStats> getHeapStats() const{
+            std::lock_guard<std::mutex> lock(mutex);
+            return heaps;
+        }
+
+        CategoryStats getCategoryStats(MemoryCategory category) const{
+            std::lock_guard<std::mutex> lock(mutex);
+            return categories[static_cast<size_t>(category)];
+        }
+
+        std::string toJson() const{
+            std::lock_guard<std::mutex> lock(mutex);
+
+            std::ostringstream json;
+            json<<"{\n";
+            json<<"  \"budgetExtension\": "<<(hasBudgetExtension() ? "true" : "false")<<",\n";
+            json<<"  \"allocations\": "<<allocations.size()<<",\n";
+            json<<"  \"heaps\": [\n";
+            for(size_t i=0;i<heaps.size();++i){
+                const HeapStats& heap=heaps[i];
+                json<<"    {\"index\": "<<i<<", \"deviceLocal\": "<<(heap.deviceLocal ? "true" : "false")
+                    <<", \"size\": "<<heap.size<<", \"budget\": "<<heap.budget<<", \"usage\": "<<heap.usage
+                    <<", \"tracked\": "<<heap.tracked<<", \"allocations\": "<<heap.allocations<<"}"<<(i+1<heaps.size() ? "," : "")<<"\n";
+            }
+            json<<"  ],\n";
+            json<<"  \"categories\": {\n";
+            for(size_t i=0;i<memoryCategoryCount;++i){
+                const CategoryStats& stats=categories[i];
+                json<<"    \""<<memoryCategoryName(static_cast<MemoryCategory>(i))<<"\": {\"bytes\": "<<stats.bytes
+                    <<", \"peakBytes\": "<<stats.peakBytes<<", \"allocations\": "<<stats.allocations<<"}"<<(i+1<memoryCategoryCount ? "," : "")<<"\n";
+            }
+            json<<"  }\n";
+            json<<"}\n";
+            return json.str();
+        }
+
+        bool dumpJson(const std::string& path) const{
+            std::ofstream file(path);
+            if(!file.is_open()){
+                std::cerr<<"failed to write memory snapshot "<<path<<std::endl;
+                return false;
+            }
+            file<<toJson();
+            std::cout<<"memory snapshot written to "<<path<<std::endl;
+            return true;
+        }
+
+    private:
+        struct Allocation{
+            VkDeviceSize size;
+            uint32_t heap;
+            MemoryCategory category;
+        };
+
+        void queryBudget(){
+            if(!getMemoryProperties2){
+                return;
+            }
+
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+            budgetProperties.sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+            VkPhysicalDeviceMemoryProperties2KHR properties{};
+            {
+                properties.sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+                properties.pNext=&budgetProperties;
+            }
+            getMemoryProperties2(physicalDevice,&properties);
+
+            for(uint32_t i=0;i<heaps.size();++i){
+                heaps[i].budget=budgetProperties.heapBudget[i];
+                heaps[i].usage=budgetProperties.heapUsage[i];
+            }
+        }
+
+        void checkHeap(uint32_t heap){
+            HeapStats& stats=heaps[heap];
+            if(stats.budget==0){
+                return;
+            }
+            //the driver's usage lags behind allocations made since the last query
+            VkDeviceSize usage=std::max(stats.usage,stats.tracked);
+            double fraction=static_cast<double>(usage)/static_cast<double>(stats.budget);
+            if(fraction>=warningThreshold && !warned[heap]){
+                warned[heap]=true;
+                std::cerr<<"warning: memory heap "<<heap<<(stats.deviceLocal ? " (device local)" : "")<<" at "
+                         <<static_cast<int>(fraction*100.0)<<"% of its budget, "<<usage/(1024*1024)<<" of "<<stats.budget/(1024*1024)<<" MiB"<<std::endl;
+            }
+            else if(fraction<warningThreshold-0.05 && warned[heap]){
+                warned[heap]=false;
+            }
+        }
+
+        mutable std::mutex mutex;
+        VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2=nullptr;
+
+        std::vector<HeapStats> heaps;
+        std::vector<bool> warned;
+        CategoryStats categories[memoryCategoryCount];
+        std::unordered_map<VkDeviceMemory,Allocation> allocations;
+
+        float warningThreshold=0.9f;
+        uint64_t lastQueryFrame=0;
+        const uint64_t queryInterval=60;
+};
+
+namespace vkutil{
+
+    //The process wide tracker every allocation is reported to.
+    inline MemoryTracker& memoryTracker(){
+        static MemoryTracker tracker;
+        return tracker;
+    }
+
+    inline VkResult allocateMemory(VkDevice device, const VkMemoryAllocateInfo& allocateInfo, MemoryCategory category, VkDeviceMemory& memory){
+        VkResult result=vkAllocateMemory(device,&allocateInfo,nullptr,&memory);
+        if(result==VK_SUCCESS){
+            memoryTracker().onAllocate(memory,allocateInfo.allocationSize,allocateInfo.memoryTypeIndex,category);
+        }
+        return result;
+    }
+
+    //Same signature as vkFreeMemory so it can be the deleter of UniqueDeviceMemory.
+    inline void VKAPI_PTR freeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* allocator){
+        if(memory==VK_NULL_HANDLE){
+            return;
+        }
+        memoryTracker().onFree(memory);
+        vkFreeMemory(device,memory,allocator);
+    }
+}
@@ -0,0 +1,574 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "DeviceInfo.h"
+#include "Profiler.h"
+#include "VulkanUtils.h"
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<array>
+#include<cmath>
+#include<cstddef>
+#include<cstring>
+#include<functional>
+#include<iostream>
+#include<stdexcept>
+#include<vector>
+
+//A cluster of up to 64 vertices and 124 triangles, one contiguous range of the index buffer. Laid out like the
+//Meshlet struct of meshlet_cull.comp (std430).
+struct Meshlet{
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff;   //sine of the widest angle between the axis and a triangle normal, above 1 the cone never culls
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    uint32_t pad=0;
+};
+
+namespace meshlets{
+
+    constexpr uint32_t maxVertices=64;
+    constexpr uint32_t maxTriangles=124;
+
+    //Splits an indexed triangle list into meshlets in index order, a meshlet is closed as soon as the next triangle
+    //would exceed one of the limits. positions points at the first position, stride is the vertex size in bytes.
+    template<typename Index>
+    std::vector<Meshlet> build(const Index* indices, size_t indexCount, const void* positions, size_t stride){
+
+        auto position=[&](Index index){
+            const float* p=reinterpret_cast<const float*>(static_cast<const uint8_t*>(positions)+static_cast<size_t>(index)*stride);
+            return std::array<float,3>{p[0],p[1],p[2]};
+        };
+
+        std::vector<Meshlet> result;
+        std::vector<Index> vertices;
+        vertices.reserve(maxVertices);
+
+        auto finish=[&](size_t first, size_t end){
+            Meshlet meshlet{};
+            meshlet.firstIndex=static_cast<uint32_t>(first);
+            meshlet.indexCount=static_cast<uint32_t>(end-first);
+            meshlet.vertexCount=static_cast<uint32_t>(vertices.size());
+
+            //bounding sphere around the center of the bounding box
+            float minimum[3]={INFINITY,INFINITY,INFINITY}, maximum[3]={-INFINITY,-INFINITY,-INFINITY};
+            for(Index vertex: vertices){
+                auto p=position(vertex);
+                for(int c=0;c<3;++c){
+                    minimum[c]=std::min(minimum[c],p[c]);
+                    maximum[c]=std::max(maximum[c],p[c]);
+                }
+            }
+            float radius=0.0f;
+            for(int c=0;c<3;++c){
+                meshlet.center[c]=(minimum[c]+maximum[c])*0.5f;
+            }
+            for(Index vertex: vertices){
+                auto p=position(vertex);
+                float dx=p[0]-meshlet.center[0], dy=p[1]-meshlet.center[1], dz=p[2]-meshlet.center[2];
+                radius=std::max(radius,std::sqrt(dx*dx+dy*dy+dz*dz));
+            }
+            meshlet.radius=radius;
+
+            //normal cone: the average front facing normal and how far the triangle normals spread around it
+            std::vector<std::array<float,3>> normals;
+            float axis[3]={0.0f,0.0f,0.0f};
+            for(size_t i=first;i<end;i+=3){
+                auto a=position(indices[i]), b=position(indices[i+1]), c=position(indices[i+2]);
+                float e1[3]={b[0]-a[0],b[1]-a[1],b[2]-a[2]};
+                float e2[3]={c[0]-a[0],c[1]-a[1],c[2]-a[2]};
+                float n[3]={e1[1]*e2[2]-e1[2]*e2[1],e1[2]*e2[0]-e1[0]*e2[2],e1[0]*e2[1]-e1[1]*e2[0]};
+                float length=std::sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+                if(length<1e-12f){
+                    continue; //degenerate triangles face nowhere
+                }
+                normals.push_back({n[0]/length,n[1]/length,n[2]/length});
+                for(int k=0;k<3;++k){
+                    axis[k]+=normals.back()[k];
+                }
+            }
+            float axisLength=std::sqrt(axis[0]*axis[0]+axis[1]*axis[1]+axis[2]*axis[2]);
+            meshlet.coneCutoff=2.0f;
+            if(axisLength>1e-6f){
+                float minimumDot=1.0f;
+                for(int k=0;k<3;++k){
+                    meshlet.coneAxis[k]=axis[k]/axisLength;
+                }
+                for(const auto& n: normals){
+                    minimumDot=std::min(minimumDot,n[0]*meshlet.coneAxis[0]+n[1]*meshlet.coneAxis[1]+n[2]*meshlet.coneAxis[2]);
+                }
+                //normals more than 90 degrees apart, some triangle faces the camera from every direction
+                if(minimumDot>0.0f){
+                    meshlet.coneCutoff=std::sqrt(1.0f-minimumDot*minimumDot);
+                }
+            }
+            else{
+                meshlet.coneAxis[2]=1.0f;
+            }
+            result.push_back(meshlet);
+            vertices.clear();
+        };
+
+        size_t first=0;
+        for(size_t i=0;i+2<indexCount;i+=3){
+            uint32_t newVertices=0;
+            for(size_t k=0;k<3;++k){
+                bool seen=std::find(vertices.begin(),vertices.end(),indices[i+k])!=vertices.end();
+                for(size_t j=0;j<k && !seen;++j){
+                    seen= indices[i+j]==indices[i+k];
+                }
+                newVertices+= seen ? 0 : 1;
+            }
+            if(vertices.size()+newVertices>maxVertices || (i-first)/3+1>maxTriangles){
+                finish(first,i);
+                first=i;
+            }
+            for(size_t k=0;k<3;++k){
+                if(std::find(vertices.begin(),vertices.end(),indices[i+k])==vertices.end()){
+                    vertices.push_back(indices[i+k]);
+                }
+            }
+        }
+        if(indexCount-first>=3){
+            finish(first,indexCount-(indexCount-first)%3);
+        }
+        return result;
+    }
+}
+
+//Culls meshlets on the GPU before the scene pass. A compute dispatch tests every (instance, meshlet) pair against the
+//view frustum and the meshlet's normal cone and appends the survivors to a compacted list of indirect draws, one per
+//pair with firstInstance selecting the instance. The draw count comes from the GPU when the device has
+//VK_KHR_draw_indirect_count, otherwise the list is cleared every frame and drawn at full length, where the unused
+//commands draw nothing. Needs the multiDrawIndirect and drawIndirectFirstInstance features, no mesh shaders.
+//With a DepthPyramid bound, culling is also done against depth in two phases: cull() tests against the pyramid the
+//previous frame left behind and remembers which clusters it hid, cullLate() re-tests those against the pyramid rebuilt
+//from the early draws and appends the ones that are visible after all to a second list drawn by drawLate().
+class MeshletCuller{
+
+    public:
+        struct Stats{
+            uint64_t frames=0;
+            uint64_t clusters=0;        //(instance, meshlet) pairs tested
+            uint64_t drawn=0;
+            uint64_t frustumCulled=0;
+            uint64_t backfaceCulled=0;
+            uint64_t lateDrawn=0;       //hidden by the previous frame's depth but visible in this one, included in drawn
+            uint64_t occlusionCulled=0; //hidden in both phases
+        };
+
+        static bool isSupported(const VkPhysicalDeviceFeatures& enabledFeatures){
+            return enabledFeatures.multiDrawIndirect && enabledFeatures.drawIndirectFirstInstance;
+        }
+
+        //copyBuffer uploads the meshlets from a staging buffer into device local memory, it may only record the copy.
+        void init(const DeviceInfo& deviceInfo, VkDevice device, DeletionQueue& deletionQueue, const std::vector<Meshlet>& meshletList,
+                  uint32_t slotCount, uint32_t maxInstances, const std::vector<char>& shaderCode, bool drawIndirectCount,
+                  const std::function<void(VkBuffer,VkBuffer,VkDeviceSize)>& copyBuffer){
+
+            PROFILE_ZONE("MeshletCuller::init");
+
+            this->physicalDevice=deviceInfo.physicalDevice;
+            this->device=device;
+            this->deletionQueue=&deletionQueue;
+            this->meshletCount=static_cast<uint32_t>(meshletList.size());
+            this->maxDraws=meshletCount*maxInstances;
+            if(drawIndirectCount){
+                drawIndexedIndirectCount=reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device,"vkCmdDrawIndexedIndirectCountKHR"));
+            }
+
+            {
+                VkDeviceSize size=sizeof(Meshlet)*meshletList.size();
+                VkBuffer stagingBuffer;
+                VkDeviceMemory stagingMemory;
+                vkutil::createBuffer(physicalDevice,device,size,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                     MemoryCategory::Staging,stagingBuffer,stagingMemory);
+                void* data;
+                vkMapMemory(device,stagingMemory,0,size,0,&data);
+                memcpy(data,meshletList.data(),static_cast<size_t>(size));
+                vkUnmapMemory(device,stagingMemory);
+
+                VkBuffer buffer;
+                VkDeviceMemory memory;
+                vkutil::createBuffer(physicalDevice,device,size,VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                     MemoryCategory::Geometry,buffer,memory);
+                meshletBuffer=vkutil::UniqueBuffer(deletionQueue,buffer);
+                meshletMemory=vkutil::UniqueDeviceMemory(deletionQueue,memory);
+                copyBuffer(stagingBuffer,meshletBuffer,size);
+                //through the deletion queue, the copy may still be waiting in a batch
+                vkutil::UniqueBuffer staging(deletionQueue,stagingBuffer);
+                vkutil::UniqueDeviceMemory stagingAllocation(deletionQueue,stagingMemory);
+            }
+
+            createPipeline(shaderCode);
+
+            slots.resize(slotCount);
+            for(Slot& slot: slots){
+                VkBuffer buffer;
+                VkDeviceMemory memory;
+                //early draws followed by the late ones
+                vkutil::createBuffer(physicalDevice,device,sizeof(VkDrawIndexedIndirectCommand)*std::max(maxDraws,1u)*2,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Geometry,buffer,memory);
+                slot.drawBuffer=vkutil::UniqueBuffer(deletionQueue,buffer);
+                slot.drawMemory=vkutil::UniqueDeviceMemory(deletionQueue,memory);
+
+                //which clusters the early phase hid, only ever touched by the GPU
+                vkutil::createBuffer(physicalDevice,device,sizeof(uint32_t)*std::max(maxDraws,1u),VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Geometry,buffer,memory);
+                slot.visibilityBuffer=vkutil::UniqueBuffer(deletionQueue,buffer);
+                slot.visibilityMemory=vkutil::UniqueDeviceMemory(deletionQueue,memory);
+
+                //a few counters, host visible so the statistics can be read once the frame's fence has signaled
+                vkutil::createBuffer(physicalDevice,device,sizeof(Counts),
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,MemoryCategory::Readback,buffer,memory);
+                slot.countBuffer=vkutil::UniqueBuffer(deletionQueue,buffer);
+                slot.countMemory=vkutil::UniqueDeviceMemory(deletionQueue,memory);
+                vkMapMemory(device,slot.countMemory,0,sizeof(Counts),0,reinterpret_cast<void**>(&slot.counts));
+                memset(slot.counts,0,sizeof(Counts));
+            }
+            createDescriptorSets();
+
+            std::cout<<"meshlet culling: "<<meshletCount<<" meshlets, up to "<<maxDraws<<" indirect draws, draw count "
+                     <<(drawIndexedIndirectCount ? "from the GPU" : "fixed")<<std::endl;
+        }
+
+        //Only valid once the device is idle.
+        void cleanup(){
+            if(device==VK_NULL_HANDLE){
+                return;
+            }
+            if(stats.frames>0){
+                std::cout<<"meshlet culling: "<<stats.drawn/stats.frames<<" of "<<stats.clusters/stats.frames<<" clusters drawn per frame, "
+                         <<stats.frustumCulled/stats.frames<<" outside the frustum, "<<stats.backfaceCulled/stats.frames<<" back facing"<<std::endl;
+            }
+            if(occlusionFrames>0){
+                std::cout<<"occlusion culling: "<<stats.occlusionCulled/occlusionFrames<<" clusters hidden per frame, "
+                         <<stats.lateDrawn/occlusionFrames<<" found visible by the late phase"<<std::endl;
+            }
+            for(Slot& slot: slots){
+                vkUnmapMemory(device,slot.countMemory);
+                slot.drawBuffer.reset();
+                slot.drawMemory.reset();
+                slot.countBuffer.reset();
+                slot.countMemory.reset();
+                slot.visibilityBuffer.reset();
+                slot.visibilityMemory.reset();
+            }
+            slots.clear();
+            meshletBuffer.reset();
+            meshletMemory.reset();
+            pipeline.reset();
+            pipelineLayout.reset();
+            vkDestroyDescriptorPool(device,descriptorPool,nullptr);
+            vkDestroyDescriptorSetLayout(device,descriptorSetLayout,nullptr);
+            device=VK_NULL_HANDLE;
+        }
+
+        //Points the slot's descriptor set at the camera uniforms and the world matrices of that frame slot.
+        void bindSlot(uint32_t slot, VkBuffer uniformBuffer, VkDeviceSize uniformSize, VkBuffer instanceBuffer, VkDeviceSize instanceSize){
+            VkDescriptorBufferInfo bufferInfos[6]={
+                {uniformBuffer,0,uniformSize},
+                {instanceBuffer,0,instanceSize},
+                {meshletBuffer,0,VK_WHOLE_SIZE},
+                {slots[slot].drawBuffer,0,VK_WHOLE_SIZE},
+                {slots[slot].countBuffer,0,VK_WHOLE_SIZE},
+                {slots[slot].visibilityBuffer,0,VK_WHOLE_SIZE}
+            };
+            VkWriteDescriptorSet writes[6]{};
+            for(uint32_t i=0;i<6;++i){
+                writes[i].sType=VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[i].dstSet=slots[slot].descriptorSet;
+                writes[i].dstBinding= i<5 ? i : 6; //binding 5 is the depth pyramid
+                writes[i].dstArrayElement=0;
+                writes[i].descriptorType= i==0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[i].descriptorCount=1;
+                writes[i].pBufferInfo=&bufferInfos[i];
+            }
+            vkUpdateDescriptorSets(device,6,writes,0,nullptr);
+        }
+
+        //Points the slot at the Hi-Z pyramid. The binding has to be valid even when occlusion culling is off,
+        //only rewritten when the pyramid was recreated and the slot's previous frame has finished.
+        void bindDepthPyramid(uint32_t slot, VkImageView view, VkSampler sampler){
+            Slot& current=slots[slot];
+            if(current.pyramidView==view){
+                return;
+            }
+            VkDescriptorImageInfo imageInfo{sampler,view,VK_IMAGE_LAYOUT_GENERAL};
+            VkWriteDescriptorSet write{};
+            {
+                write.sType=VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.dstSet=current.descriptorSet;
+                write.dstBinding=5;
+                write.dstArrayElement=0;
+                write.descriptorType=VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                write.descriptorCount=1;
+                write.pImageInfo=&imageInfo;
+            }
+            vkUpdateDescriptorSets(device,1,&write,0,nullptr);
+            current.pyramidView=view;
+        }
+
+        VkBuffer getDrawBuffer(uint32_t slot) const{ return slots[slot].drawBuffer; }
+        VkBuffer getCountBuffer(uint32_t slot) const{ return slots[slot].countBuffer; }
+        VkBuffer getVisibilityBuffer(uint32_t slot) const{ return slots[slot].visibilityBuffer; }
+        Stats getStats() const{ return stats; }
+
+        //Counters of the most recently collected frame, frames is 1 once there is one.
+        Stats getLastFrame() const{ return lastFrame; }
+
+        //The slot submitted an earlier recording of cull() again, its counters are written the same way.
+        void resubmitted(uint32_t slot){
+            slots[slot].pending=true;
+        }
+
+        //Adds the counters of the slot's last frame to the statistics, call after its fence wait.
+        //Returns false when the slot had nothing culled since the last call.
+        bool collect(uint32_t slot){
+            Slot& current=slots[slot];
+            if(!current.pending){
+                return false;
+            }
+            current.pending=false;
+
+            const Counts& counts=*current.counts;
+            lastFrame=Stats{};
+            lastFrame.frames=1;
+            lastFrame.clusters=current.clusters;
+            lastFrame.frustumCulled=counts.frustumCulled;
+            lastFrame.backfaceCulled=counts.backfaceCulled;
+            lastFrame.drawn=std::min(counts.drawCount,maxDraws);
+            if(current.occlusion){
+                lastFrame.lateDrawn=std::min(counts.lateDrawCount,maxDraws);
+                lastFrame.drawn+=lastFrame.lateDrawn;
+                lastFrame.occlusionCulled=counts.occludedLate;
+                ++occlusionFrames;
+            }
+
+            ++stats.frames;
+            stats.clusters+=lastFrame.clusters;
+            stats.drawn+=lastFrame.drawn;
+            stats.frustumCulled+=lastFrame.frustumCulled;
+            stats.backfaceCulled+=lastFrame.backfaceCulled;
+            stats.lateDrawn+=lastFrame.lateDrawn;
+            stats.occlusionCulled+=lastFrame.occlusionCulled;
+            return true;
+        }
+
+        //Resets the counters and records the culling dispatch, the caller makes the draws visible to the indirect stage.
+        //With a depth extent the clusters are also tested against the bound pyramid, which the previous frame has built
+        //from a depth buffer of that size; pass an empty extent when there is none yet.
+        void cull(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t instanceCount, VkExtent2D depthExtent={}){
+            Slot& current=slots[slot];
+            instanceCount=std::min(instanceCount,meshletCount>0 ? maxDraws/meshletCount : 0);
+
+            vkCmdFillBuffer(commandBuffer,current.countBuffer,0,sizeof(Counts),0);
+            if(!drawIndexedIndirectCount){
+                vkCmdFillBuffer(commandBuffer,current.drawBuffer,0,VK_WHOLE_SIZE,0); //unused commands draw zero indices
+            }
+            VkMemoryBarrier barrier{};
+            {
+                barrier.sType=VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                barrier.srcAccessMask=VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask=VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            }
+            vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,0,1,&barrier,0,nullptr,0,nullptr);
+
+            bool occlusion=depthExtent.width>0 && depthExtent.height>0;
+            dispatch(commandBuffer,current,instanceCount,0,occlusion,depthExtent);
+
+            current.clusters=meshletCount*instanceCount;
+            current.instanceCount=instanceCount;
+            current.occlusion=false;
+            current.pending=true;
+        }
+
+        //Second phase, re-tests what cull() hid against the pyramid built from this frame's early draws.
+        //The caller puts barriers between the early draws, the pyramid build and this dispatch.
+        void cullLate(VkCommandBuffer commandBuffer, uint32_t slot, VkExtent2D depthExtent){
+            Slot& current=slots[slot];
+            dispatch(commandBuffer,current,current.instanceCount,1,true,depthExtent);
+            current.occlusion=true;
+        }
+
+        //Draws what cull() kept, vertex and index buffers are bound by the caller.
+        void draw(VkCommandBuffer commandBuffer, uint32_t slot){
+            if(drawIndexedIndirectCount){
+                drawIndexedIndirectCount(commandBuffer,slots[slot].drawBuffer,0,slots[slot].countBuffer,0,maxDraws,sizeof(VkDrawIndexedIndirectCommand));
+            }
+            else{
+                vkCmdDrawIndexedIndirect(commandBuffer,slots[slot].drawBuffer,0,maxDraws,sizeof(VkDrawIndexedIndirectCommand));
+            }
+        }
+
+        //Draws what cullLate() found visible after all.
+        void drawLate(VkCommandBuffer commandBuffer, uint32_t slot){
+            VkDeviceSize offset=sizeof(VkDrawIndexedIndirectCommand)*maxDraws;
+            if(drawIndexedIndirectCount){
+                drawIndexedIndirectCount(commandBuffer,slots[slot].drawBuffer,offset,slots[slot].countBuffer,offsetof(Counts,lateDrawCount),
+                                         maxDraws,sizeof(VkDrawIndexedIndirectCommand));
+            }
+            else{
+                vkCmdDrawIndexedIndirect(commandBuffer,slots[slot].drawBuffer,offset,maxDraws,sizeof(VkDrawIndexedIndirectCommand));
+            }
+        }
+
+    private:
+        struct Counts{
+            uint32_t drawCount;
+            uint32_t frustumCulled;
+            uint32_t backfaceCulled;
+            uint32_t occludedEarly;
+            uint32_t lateDrawCount;
+            uint32_t occludedLate;
+            uint32_t pad[2];
+        };
+
+        struct Slot{
+            vkutil::UniqueBuffer drawBuffer;
+            vkutil::UniqueDeviceMemory drawMemory;
+            vkutil::UniqueBuffer countBuffer;
+            vkutil::UniqueDeviceMemory countMemory;
+            vkutil::UniqueBuffer visibilityBuffer;
+            vkutil::UniqueDeviceMemory visibilityMemory;
+            Counts* counts=nullptr;
+            VkDescriptorSet descriptorSet=VK_NULL_HANDLE;
+            VkImageView pyramidView=VK_NULL_HANDLE;
+            uint32_t clusters=0;
+            uint32_t instanceCount=0;
+            bool occlusion=false; //the late phase ran
+            bool pending=false;
+        };
+
+        void dispatch(VkCommandBuffer commandBuffer, const Slot& slot, uint32_t instanceCount, uint32_t phase, bool occlusion, VkExtent2D depthExtent){
+            uint32_t pushConstants[7]={meshletCount,instanceCount,maxDraws,phase,occlusion ? 1u : 0u,depthExtent.width,depthExtent.height};
+            vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,pipeline);
+            vkCmdBindDescriptorSets(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,pipelineLayout,0,1,&slot.descriptorSet,0,nullptr);
+            vkCmdPushConstants(commandBuffer,pipelineLayout,VK_SHADER_STAGE_COMPUTE_BIT,0,sizeof(pushConstants),pushConstants);
+            vkCmdDispatch(commandBuffer,(meshletCount*instanceCount+63)/64,1,1);
+        }
+
+        void createPipeline(const std::vector<char>& shaderCode){
+
+            VkDescriptorSetLayoutBinding bindings[7]{};
+            for(uint32_t i=0;i<7;++i){
+                bindings[i].binding=i;
+                bindings[i].descriptorType= i==0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : i==5 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                bindings[i].descriptorCount=1;
+                bindings[i].stageFlags=VK_SHADER_STAGE_COMPUTE_BIT;
+            }
+            VkDescriptorSetLayoutCreateInfo layoutInfo{};
+            {
+                layoutInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+                layoutInfo.bindingCount=7;
+                layoutInfo.pBindings=bindings;
+            }
+            if(vkCreateDescriptorSetLayout(device,&layoutInfo,nullptr,&descriptorSetLayout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create meshlet culling descriptor set layout!");
+            }
+
+            VkPushConstantRange pushConstant{VK_SHADER_STAGE_COMPUTE_BIT,0,sizeof(uint32_t)*7};
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            {
+                pipelineLayoutInfo.sType=VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                pipelineLayoutInfo.setLayoutCount=1;
+                pipelineLayoutInfo.pSetLayouts=&descriptorSetLayout;
+                pipelineLayoutInfo.pushConstantRangeCount=1;
+                pipelineLayoutInfo.pPushConstantRanges=&pushConstant;
+            }
+            VkPipelineLayout layout;
+            if(vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,&layout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create meshlet culling pipeline layout!");
+            }
+            pipelineLayout=vkutil::UniquePipelineLayout(*deletionQueue,layout);
+
+            VkShaderModuleCreateInfo moduleInfo{};
+            {
+                moduleInfo.sType=VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+                moduleInfo.codeSize=shaderCode.size();
+                moduleInfo.pCode=reinterpret_cast<const uint32_t*>(shaderCode.data());
+            }
+            VkShaderModule shaderModule;
+            if(vkCreateShaderModule(device,&moduleInfo,nullptr,&shaderModule)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create shader module!");
+            }
+
+            VkComputePipelineCreateInfo pipelineInfo{};
+            {
+                pipelineInfo.sType=VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+                pipelineInfo.stage.sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                pipelineInfo.stage.stage=VK_SHADER_STAGE_COMPUTE_BIT;
+                pipelineInfo.stage.module=shaderModule;
+                pipelineInfo.stage.pName="main";
+                pipelineInfo.layout=pipelineLayout;
+            }
+            VkPipeline computePipeline;
+            VkResult result=vkCreateComputePipelines(device,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&computePipeline);
+            vkDestroyShaderModule(device,shaderModule,nullptr);
+            if(result!=VK_SUCCESS){
+                throw std::runtime_error("failed to create meshlet culling pipeline!");
+            }
+            pipeline=vkutil::UniquePipeline(*deletionQueue,computePipeline);
+        }
+
+        void createDescriptorSets(){
+            VkDescriptorPoolSize poolSizes[3]={
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,static_cast<uint32_t>(slots.size())},
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,static_cast<uint32_t>(slots.size())*5},
+                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,static_cast<uint32_t>(slots.size())}
+            };
+            VkDescriptorPoolCreateInfo poolInfo{};
+            {
+                poolInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+                poolInfo.poolSizeCount=3;
+                poolInfo.pPoolSizes=poolSizes;
+                poolInfo.maxSets=static_cast<uint32_t>(slots.size());
+            }
+            if(vkCreateDescriptorPool(device,&poolInfo,nullptr,&descriptorPool)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create meshlet culling descriptor pool!");
+            }
+
+            std::vector<VkDescriptorSetLayout> layouts(slots.size(),descriptorSetLayout);
+            std::vector<VkDescriptorSet> sets(slots.size());
+            VkDescriptorSetAllocateInfo allocateInfo{};
+            {
+                allocateInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                allocateInfo.descriptorPool=descriptorPool;
+                allocateInfo.descriptorSetCount=static_cast<uint32_t>(slots.size());
+                allocateInfo.pSetLayouts=layouts.data();
+            }
+            if(vkAllocateDescriptorSets(device,&allocateInfo,sets.data())!=VK_SUCCESS){
+                throw std::runtime_error("failed to allocate meshlet culling descriptor sets!");
+            }
+            for(size_t i=0;i<slots.size();++i){
+                slots[i].descriptorSet=sets[i];
+            }
+        }
+
+        VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+        VkDevice device=VK_NULL_HANDLE;
+        DeletionQueue* deletionQueue=nullptr;
+        PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount=nullptr;
+
+        uint32_t meshletCount=0;
+        uint32_t maxDraws=0;
+        vkutil::UniqueBuffer meshletBuffer;
+        vkutil::UniqueDeviceMemory meshletMemory;
+
+        VkDescriptorSetLayout descriptorSetLayout=VK_NULL_HANDLE;
+        VkDescriptorPool descriptorPool=VK_NULL_HANDLE;
+        vkutil::UniquePipelineLayout pipelineLayout;
+        vkutil::UniquePipeline pipeline;
+
+        std::vector<Slot> slots;
+        Stats stats;
+        Stats lastFrame;
+        uint64_t occlusionFrames=0;
+};
@@ -0,0 +1,596 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "DeviceInfo.h"
+#include "Profiler.h"
+#include "VulkanUtils.h"
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<cstddef>
+#include<cstring>
+#include<functional>
+#include<iostream>
+#include<stdexcept>
+#include<vector>
+
+//Particles simulated and drawn without the CPU touching them. The state lives in device local storage buffers next to a
+//dead list of free particle indices and two alive lists used in turns. Every frame three compute dispatches run:
+//emit pops indices off the dead list and appends the new particles to the current alive list, simulate ages and moves
+//the alive particles and appends the survivors to the other list (which compacts it) or pushes them back on the dead
+//list, and compact turns the new alive count into the arguments of an indirect draw of one quad per particle.
+//The CPU only decides how many particles to emit; simulation time is measured with timestamps.
+class ParticleSystem{
+
+    public:
+        struct Settings{
+            uint32_t capacity=1u<<20;
+            float emitterPosition[3]={0.0f,0.0f,0.0f};
+            float emitterSpeed=3.0f;
+            float averageLifetime=3.0f; //matches particle_emit.comp, emission is set to keep the pool full
+            float size=0.01f;
+        };
+
+        struct Stats{
+            uint64_t frames=0;      //frames with a timing
+            double simulationMs=0.0;
+            double particles=0.0;   //alive particles summed over those frames
+        };
+
+        //shaderCode holds emit, simulate, compact, vertex and fragment shader in that order. copyBuffer fills the lists
+        //and counters from a staging buffer, it may only record the copy.
+        void init(const DeviceInfo& deviceInfo, VkDevice device, DeletionQueue& deletionQueue, const Settings& settings, uint32_t slotCount,
+                  const std::vector<std::vector<char>>& shaderCode, const std::function<void(VkBuffer,VkBuffer,VkDeviceSize)>& copyBuffer){
+
+            PROFILE_ZONE("ParticleSystem::init");
+
+            this->physicalDevice=deviceInfo.physicalDevice;
+            this->device=device;
+            this->deletionQueue=&deletionQueue;
+            this->settings=settings;
+            emitRate=settings.capacity/settings.averageLifetime;
+
+            VkBuffer buffer;
+            VkDeviceMemory memory;
+            vkutil::createBuffer(physicalDevice,device,sizeof(Particle)*settings.capacity,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Geometry,buffer,memory);
+            particleBuffer=vkutil::UniqueBuffer(deletionQueue,buffer);
+            particleMemory=vkutil::UniqueDeviceMemory(deletionQueue,memory);
+
+            //dead list holding every particle, the alive lists start out empty
+            std::vector<uint32_t> lists(static_cast<size_t>(settings.capacity)*3,0);
+            for(uint32_t i=0;i<settings.capacity;++i){
+                lists[i]=settings.capacity-1-i;
+            }
+            Counters counters{};
+            counters.deadCount=settings.capacity;
+            counters.emitBudget=settings.capacity;
+            counters.simulateGroups[1]=1;
+            counters.simulateGroups[2]=1;
+            counters.draw.vertexCount=6;
+
+            listBuffer=createInitializedBuffer(lists.data(),sizeof(uint32_t)*lists.size(),0,listMemory,copyBuffer);
+            counterBuffer=createInitializedBuffer(&counters,sizeof(Counters),VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                  counterMemory,copyBuffer);
+
+            createLayout();
+            emitPipeline=createComputePipeline(shaderCode.at(0));
+            simulatePipeline=createComputePipeline(shaderCode.at(1));
+            compactPipeline=createComputePipeline(shaderCode.at(2));
+            vertexCode=shaderCode.at(3);
+            fragmentCode=shaderCode.at(4);
+            createSlots(deviceInfo,slotCount);
+
+            std::cout<<"particles: up to "<<settings.capacity<<" ("<<(sizeof(Particle)+sizeof(uint32_t)*3)*settings.capacity/(1024*1024)
+                     <<" MiB), emitting "<<static_cast<uint32_t>(emitRate)<<" per second"<<std::endl;
+        }
+
+        //Only valid once the device is idle.
+        void cleanup(){
+            if(device==VK_NULL_HANDLE){
+                return;
+            }
+            if(stats.frames>0 && stats.particles>0.0){
+                std::cout<<"particles: "<<static_cast<uint64_t>(stats.particles/stats.frames)<<" alive on average, simulation "
+                         <<stats.simulationMs/stats.frames<<" ms per frame, "<<stats.simulationMs/(stats.particles/1.0e6)
+                         <<" ms per million particles"<<std::endl;
+            }
+            for(Slot& slot: slots){
+                vkUnmapMemory(device,slot.readbackMemory);
+                vkDestroyQueryPool(device,slot.queryPool,nullptr);
+            }
+            slots.clear();
+            particleBuffer.reset();
+            particleMemory.reset();
+            listBuffer.reset();
+            listMemory.reset();
+            counterBuffer.reset();
+            counterMemory.reset();
+            emitPipeline.reset();
+            simulatePipeline.reset();
+            compactPipeline.reset();
+            renderPipeline.reset();
+            pipelineLayout.reset();
+            vkDestroyDescriptorPool(device,descriptorPool,nullptr);
+            vkDestroyDescriptorSetLayout(device,descriptorSetLayout,nullptr);
+            device=VK_NULL_HANDLE;
+        }
+
+        //Points the slot's descriptor set at the camera uniforms of that frame slot.
+        void bindSlot(uint32_t slot, VkBuffer uniformBuffer, VkDeviceSize uniformSize){
+            VkDescriptorBufferInfo bufferInfos[4]={
+                {uniformBuffer,0,uniformSize},
+                {particleBuffer,0,VK_WHOLE_SIZE},
+                {listBuffer,0,VK_WHOLE_SIZE},
+                {counterBuffer,0,VK_WHOLE_SIZE}
+            };
+            VkWriteDescriptorSet writes[4]{};
+            for(uint32_t i=0;i<4;++i){
+                writes[i].sType=VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[i].dstSet=slots[slot].descriptorSet;
+                writes[i].dstBinding=i;
+                writes[i].dstArrayElement=0;
+                writes[i].descriptorType= i==0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[i].descriptorCount=1;
+                writes[i].pBufferInfo=&bufferInfos[i];
+            }
+            vkUpdateDescriptorSets(device,4,writes,0,nullptr);
+        }
+
+        //Recreates the pipeline that draws the particles when the render pass of their graph pass changed.
+        void setRenderPass(VkRenderPass renderPass){
+            if(renderPass==currentRenderPass && renderPipeline.get()!=VK_NULL_HANDLE){
+                return;
+            }
+            createRenderPipeline(renderPass);
+            currentRenderPass=renderPass;
+        }
+
+        //Emission follows the scene clock, deltaTime is the scene time since the previous frame.
+        void update(float time, float deltaTime){
+            deltaTime=std::clamp(deltaTime,0.0f,0.1f);
+            emitAccumulator+=emitRate*deltaTime;
+            frame.emitCount=static_cast<uint32_t>(std::min(emitAccumulator,static_cast<float>(settings.capacity)));
+            emitAccumulator-=frame.emitCount;
+            frame.deltaTime=deltaTime;
+            frame.time=time;
+        }
+
+        //After the slot's fence wait, adds the timing and particle count of its last frame to the statistics.
+        void collect(uint32_t slot){
+            Slot& state=slots[slot];
+            if(!state.pending){
+                return;
+            }
+            state.pending=false;
+            lastAlive=state.counters->aliveCount[state.current ^ 1u];
+            if(timestampPeriod==0.0f){
+                return;
+            }
+            uint64_t timestamps[2];
+            if(vkGetQueryPoolResults(device,state.queryPool,0,2,sizeof(timestamps),timestamps,sizeof(uint64_t),VK_QUERY_RESULT_64_BIT)==VK_SUCCESS){
+                ++stats.frames;
+                uint64_t ticks=((timestamps[1]&timestampMask)-(timestamps[0]&timestampMask))&timestampMask;
+                stats.simulationMs+=static_cast<double>(ticks)*timestampPeriod/1.0e6;
+                stats.particles+=lastAlive;
+            }
+        }
+
+        //Emit, simulate and compact, with the barriers between them. The graph synchronizes against earlier frames
+        //and makes the results visible to the draw.
+        void simulate(VkCommandBuffer commandBuffer, uint32_t slot){
+            Slot& state=slots[slot];
+            frame.current=currentList;
+            frame.capacity=settings.capacity;
+            frame.seed=seed++;
+            std::copy(settings.emitterPosition,settings.emitterPosition+3,frame.emitter);
+            frame.emitter[3]=settings.emitterSpeed;
+            frame.size=settings.size;
+
+            if(timestampPeriod>0.0f){
+                vkCmdResetQueryPool(commandBuffer,state.queryPool,0,2);
+                vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,state.queryPool,0);
+            }
+            vkCmdBindDescriptorSets(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,pipelineLayout,0,1,&state.descriptorSet,0,nullptr);
+            vkCmdPushConstants(commandBuffer,pipelineLayout,VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT,0,sizeof(FrameConstants),&frame);
+
+            //the first invocation also writes the simulation's dispatch arguments, so there is always one group
+            vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,emitPipeline);
+            vkCmdDispatch(commandBuffer,std::max((frame.emitCount+63)/64,1u),1,1);
+            barrier(commandBuffer,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+            vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,simulatePipeline);
+            vkCmdDispatchIndirect(commandBuffer,counterBuffer,offsetof(Counters,simulateGroups));
+            barrier(commandBuffer,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+            vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,compactPipeline);
+            vkCmdDispatch(commandBuffer,1,1,1);
+
+            //counters for the statistics, read once the slot's fence has signaled
+            barrier(commandBuffer,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_WRITE_BIT,VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_READ_BIT);
+            VkBufferCopy region{0,0,sizeof(Counters)};
+            vkCmdCopyBuffer(commandBuffer,counterBuffer,state.readbackBuffer,1,&region);
+            if(timestampPeriod>0.0f){
+                vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,state.queryPool,1);
+            }
+
+            state.current=currentList;
+            state.pending=true;
+            currentList^=1u;
+        }
+
+        //Draws the compacted alive list, inside a render pass compatible with the one given to setRenderPass().
+        void draw(VkCommandBuffer commandBuffer, uint32_t slot, VkExtent2D extent){
+            VkViewport viewport{0.0f,0.0f,static_cast<float>(extent.width),static_cast<float>(extent.height),0.0f,1.0f};
+            VkRect2D scissor{{0,0},extent};
+            vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,renderPipeline);
+            vkCmdSetViewport(commandBuffer,0,1,&viewport);
+            vkCmdSetScissor(commandBuffer,0,1,&scissor);
+            vkCmdBindDescriptorSets(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,pipelineLayout,0,1,&slots[slot].descriptorSet,0,nullptr);
+            //simulate() flipped the list, the draw reads the one it just filled
+            FrameConstants drawFrame=frame;
+            drawFrame.current=slots[slot].current;
+            vkCmdPushConstants(commandBuffer,pipelineLayout,VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT,0,sizeof(FrameConstants),&drawFrame);
+            vkCmdDrawIndirect(commandBuffer,counterBuffer,offsetof(Counters,draw),1,sizeof(VkDrawIndirectCommand));
+        }
+
+        VkBuffer getParticleBuffer() const{ return particleBuffer; }
+        VkBuffer getListBuffer() const{ return listBuffer; }
+        VkBuffer getCounterBuffer() const{ return counterBuffer; }
+        uint32_t getAliveCount() const{ return lastAlive; }
+        Stats getStats() const{ return stats; }
+
+    private:
+        //Laid out like the structs of the particle shaders (std430).
+        struct Particle{
+            float position[4]; //xyz, age
+            float velocity[4]; //xyz, lifetime
+            float color[4];
+        };
+
+        struct Counters{
+            uint32_t aliveCount[2];
+            uint32_t deadCount;
+            uint32_t emitBudget;
+            uint32_t simulateGroups[3];
+            uint32_t aliveBeforeEmit;
+            VkDrawIndirectCommand draw;
+            uint32_t emitted;
+            uint32_t died;
+            uint32_t pad[2];
+        };
+
+        struct FrameConstants{
+            float emitter[4]; //position, speed
+            uint32_t current;
+            uint32_t emitCount;
+            uint32_t capacity;
+            uint32_t seed;
+            float deltaTime;
+            float time;
+            float size;
+            float pad;
+        };
+
+        struct Slot{
+            VkDescriptorSet descriptorSet=VK_NULL_HANDLE;
+            VkQueryPool queryPool=VK_NULL_HANDLE;
+            vkutil::UniqueBuffer readbackBuffer;
+            vkutil::UniqueDeviceMemory readbackMemory;
+            Counters* counters=nullptr;
+            uint32_t current=0; //alive list the slot's frame read
+            bool pending=false;
+        };
+
+        static void barrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess){
+            VkMemoryBarrier memoryBarrier{};
+            {
+                memoryBarrier.sType=VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                memoryBarrier.srcAccessMask=srcAccess;
+                memoryBarrier.dstAccessMask=dstAccess;
+            }
+            vkCmdPipelineBarrier(commandBuffer,srcStage,dstStage,0,1,&memoryBarrier,0,nullptr,0,nullptr);
+        }
+
+        vkutil::UniqueBuffer createInitializedBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, vkutil::UniqueDeviceMemory& memory,
+                                                     const std::function<void(VkBuffer,VkBuffer,VkDeviceSize)>& copyBuffer){
+            VkBuffer stagingBuffer;
+            VkDeviceMemory stagingMemory;
+            vkutil::createBuffer(physicalDevice,device,size,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 MemoryCategory::Staging,stagingBuffer,stagingMemory);
+            void* mapped;
+            vkMapMemory(device,stagingMemory,0,size,0,&mapped);
+            memcpy(mapped,data,static_cast<size_t>(size));
+            vkUnmapMemory(device,stagingMemory);
+
+            VkBuffer buffer;
+            VkDeviceMemory bufferMemory;
+            vkutil::createBuffer(physicalDevice,device,size,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Geometry,buffer,bufferMemory);
+            copyBuffer(stagingBuffer,buffer,size);
+            //through the deletion queue, the copy may still be waiting in a batch
+            vkutil::UniqueBuffer staging(*deletionQueue,stagingBuffer);
+            vkutil::UniqueDeviceMemory stagingAllocation(*deletionQueue,stagingMemory);
+
+            memory=vkutil::UniqueDeviceMemory(*deletionQueue,bufferMemory);
+            return vkutil::UniqueBuffer(*deletionQueue,buffer);
+        }
+
+        void createLayout(){
+
+            VkDescriptorSetLayoutBinding bindings[4]{};
+            for(uint32_t i=0;i<4;++i){
+                bindings[i].binding=i;
+                bindings[i].descriptorType= i==0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                bindings[i].descriptorCount=1;
+                bindings[i].stageFlags= i==0 ? VK_SHADER_STAGE_VERTEX_BIT : i==3 ? VK_SHADER_STAGE_COMPUTE_BIT : VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+            }
+            VkDescriptorSetLayoutCreateInfo layoutInfo{};
+            {
+                layoutInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+                layoutInfo.bindingCount=4;
+                layoutInfo.pBindings=bindings;
+            }
+            if(vkCreateDescriptorSetLayout(device,&layoutInfo,nullptr,&descriptorSetLayout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create particle descriptor set layout!");
+            }
+
+            VkPushConstantRange pushConstant{VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT,0,sizeof(FrameConstants)};
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            {
+                pipelineLayoutInfo.sType=VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                pipelineLayoutInfo.setLayoutCount=1;
+                pipelineLayoutInfo.pSetLayouts=&descriptorSetLayout;
+                pipelineLayoutInfo.pushConstantRangeCount=1;
+                pipelineLayoutInfo.pPushConstantRanges=&pushConstant;
+            }
+            VkPipelineLayout layout;
+            if(vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,&layout)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create particle pipeline layout!");
+            }
+            pipelineLayout=vkutil::UniquePipelineLayout(*deletionQueue,layout);
+        }
+
+        VkShaderModule createShaderModule(const std::vector<char>& code){
+            VkShaderModuleCreateInfo moduleInfo{};
+            {
+                moduleInfo.sType=VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+                moduleInfo.codeSize=code.size();
+                moduleInfo.pCode=reinterpret_cast<const uint32_t*>(code.data());
+            }
+            VkShaderModule shaderModule;
+            if(vkCreateShaderModule(device,&moduleInfo,nullptr,&shaderModule)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create shader module!");
+            }
+            return shaderModule;
+        }
+
+        vkutil::UniquePipeline createComputePipeline(const std::vector<char>& code){
+            VkShaderModule shaderModule=createShaderModule(code);
+            VkComputePipelineCreateInfo pipelineInfo{};
+            {
+                pipelineInfo.sType=VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+                pipelineInfo.stage.sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                pipelineInfo.stage.stage=VK_SHADER_STAGE_COMPUTE_BIT;
+                pipelineInfo.stage.module=shaderModule;
+                pipelineInfo.stage.pName="main";
+                pipelineInfo.layout=pipelineLayout;
+            }
+            VkPipeline pipeline;
+            VkResult result=vkCreateComputePipelines(device,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&pipeline);
+            vkDestroyShaderModule(device,shaderModule,nullptr);
+            if(result!=VK_SUCCESS){
+                throw std::runtime_error("failed to create particle compute pipeline!");
+            }
+            return vkutil::UniquePipeline(*deletionQueue,pipeline);
+        }
+
+        //Additive quads without vertex input, tested against the scene's depth but not writing it.
+        void createRenderPipeline(VkRenderPass renderPass){
+
+            VkShaderModule vertShaderModule=createShaderModule(vertexCode);
+            VkShaderModule fragShaderModule=createShaderModule(fragmentCode);
+
+            VkPipelineShaderStageCreateInfo shaderStages[2]{};
+            {
+                shaderStages[0].sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                shaderStages[0].stage=VK_SHADER_STAGE_VERTEX_BIT;
+                shaderStages[0].module=vertShaderModule;
+                shaderStages[0].pName="main";
+                shaderStages[1].sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                shaderStages[1].stage=VK_SHADER_STAGE_FRAGMENT_BIT;
+                shaderStages[1].module=fragShaderModule;
+                shaderStages[1].pName="main";
+            }
+
+            VkDynamicState dynamicStates[2]={VK_DYNAMIC_STATE_VIEWPORT,VK_DYNAMIC_STATE_SCISSOR};
+            VkPipelineDynamicStateCreateInfo dynamicState{};
+            {
+                dynamicState.sType=VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+                dynamicState.dynamicStateCount=2;
+                dynamicState.pDynamicStates=dynamicStates;
+            }
+
+            VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+            {
+                vertexInputInfo.sType=VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            }
+
+            VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+            {
+                inputAssembly.sType=VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+                inputAssembly.topology=VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+                inputAssembly.primitiveRestartEnable=VK_FALSE;
+            }
+
+            VkPipelineViewportStateCreateInfo viewportState{};
+            {
+                viewportState.sType=VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+                viewportState.viewportCount=1;
+                viewportState.scissorCount=1;
+            }
+
+            VkPipelineRasterizationStateCreateInfo rasterizer{};
+            {
+                rasterizer.sType=VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+                rasterizer.polygonMode=VK_POLYGON_MODE_FILL;
+                rasterizer.lineWidth=1.0f;
+                rasterizer.cullMode=VK_CULL_MODE_NONE;
+                rasterizer.frontFace=VK_FRONT_FACE_COUNTER_CLOCKWISE;
+            }
+
+            VkPipelineMultisampleStateCreateInfo multisampling{};
+            {
+                multisampling.sType=VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+                multisampling.rasterizationSamples=VK_SAMPLE_COUNT_1_BIT;
+            }
+
+            VkPipelineDepthStencilStateCreateInfo depthStencil{};
+            {
+                depthStencil.sType=VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+                depthStencil.depthTestEnable=VK_TRUE;
+                depthStencil.depthWriteEnable=VK_FALSE;
+                depthStencil.depthCompareOp=VK_COMPARE_OP_LESS;
+            }
+
+            VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+            {
+                colorBlendAttachment.colorWriteMask=VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+                colorBlendAttachment.blendEnable=VK_TRUE;
+                colorBlendAttachment.srcColorBlendFactor=VK_BLEND_FACTOR_SRC_ALPHA;
+                colorBlendAttachment.dstColorBlendFactor=VK_BLEND_FACTOR_ONE;
+                colorBlendAttachment.colorBlendOp=VK_BLEND_OP_ADD;
+                colorBlendAttachment.srcAlphaBlendFactor=VK_BLEND_FACTOR_ZERO;
+                colorBlendAttachment.dstAlphaBlendFactor=VK_BLEND_FACTOR_ONE;
+                colorBlendAttachment.alphaBlendOp=VK_BLEND_OP_ADD;
+            }
+
+            VkPipelineColorBlendStateCreateInfo colorBlending{};
+            {
+                colorBlending.sType=VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+                colorBlending.attachmentCount=1;
+                colorBlending.pAttachments=&colorBlendAttachment;
+            }
+
+            VkGraphicsPipelineCreateInfo pipelineInfo{};
+            {
+                pipelineInfo.sType=VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+                pipelineInfo.stageCount=2;
+                pipelineInfo.pStages=shaderStages;
+                pipelineInfo.pVertexInputState=&vertexInputInfo;
+                pipelineInfo.pInputAssemblyState=&inputAssembly;
+                pipelineInfo.pViewportState=&viewportState;
+                pipelineInfo.pRasterizationState=&rasterizer;
+                pipelineInfo.pMultisampleState=&multisampling;
+                pipelineInfo.pDepthStencilState=&depthStencil;
+                pipelineInfo.pColorBlendState=&colorBlending;
+                pipelineInfo.pDynamicState=&dynamicState;
+                pipelineInfo.layout=pipelineLayout;
+                pipelineInfo.renderPass=renderPass;
+                pipelineInfo.subpass=0;
+            }
+            VkPipeline pipeline;
+            VkResult result=vkCreateGraphicsPipelines(device,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&pipeline);
+            vkDestroyShaderModule(device,vertShaderModule,nullptr);
+            vkDestroyShaderModule(device,fragShaderModule,nullptr);
+            if(result!=VK_SUCCESS){
+                throw std::runtime_error("failed to create particle graphics pipeline!");
+            }
+            renderPipeline=vkutil::UniquePipeline(*deletionQueue,pipeline);
+        }
+
+        void createSlots(const DeviceInfo& deviceInfo, uint32_t slotCount){
+
+            VkDescriptorPoolSize poolSizes[2]={
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,slotCount},
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,slotCount*3}
+            };
+            VkDescriptorPoolCreateInfo poolInfo{};
+            {
+                poolInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+                poolInfo.poolSizeCount=2;
+                poolInfo.pPoolSizes=poolSizes;
+                poolInfo.maxSets=slotCount;
+            }
+            if(vkCreateDescriptorPool(device,&poolInfo,nullptr,&descriptorPool)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create particle descriptor pool!");
+            }
+
+            //timestamps need support on the graphics queue, without them only the particle count is reported
+            uint32_t graphicsFamily=deviceInfo.queueFamilies.graphicsFamily.value();
+            uint32_t validBits=deviceInfo.queueFamilyProperties[graphicsFamily].timestampValidBits;
+            if(validBits>0){
+                timestampPeriod=deviceInfo.properties.limits.timestampPeriod;
+                timestampMask= validBits>=64 ? ~0ull : (1ull<<validBits)-1;
+            }
+
+            slots.resize(slotCount);
+            for(Slot& slot: slots){
+                VkDescriptorSetAllocateInfo allocateInfo{};
+                {
+                    allocateInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                    allocateInfo.descriptorPool=descriptorPool;
+                    allocateInfo.descriptorSetCount=1;
+                    allocateInfo.pSetLayouts=&descriptorSetLayout;
+                }
+                if(vkAllocateDescriptorSets(device,&allocateInfo,&slot.descriptorSet)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to allocate particle descriptor set!");
+                }
+
+                VkQueryPoolCreateInfo queryPoolInfo{};
+                {
+                    queryPoolInfo.sType=VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                    queryPoolInfo.queryType=VK_QUERY_TYPE_TIMESTAMP;
+                    queryPoolInfo.queryCount=2;
+                }
+                if(vkCreateQueryPool(device,&queryPoolInfo,nullptr,&slot.queryPool)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to create particle query pool!");
+                }
+
+                VkBuffer buffer;
+                VkDeviceMemory memory;
+                vkutil::createBuffer(physicalDevice,device,sizeof(Counters),VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,MemoryCategory::Readback,buffer,memory);
+                slot.readbackBuffer=vkutil::UniqueBuffer(*deletionQueue,buffer);
+                slot.readbackMemory=vkutil::UniqueDeviceMemory(*deletionQueue,memory);
+                vkMapMemory(device,slot.readbackMemory,0,sizeof(Counters),0,reinterpret_cast<void**>(&slot.counters));
+            }
+        }
+
+        VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+        VkDevice device=VK_NULL_HANDLE;
+        DeletionQueue* deletionQueue=nullptr;
+        Settings settings;
+
+        vkutil::UniqueBuffer particleBuffer;
+        vkutil::UniqueDeviceMemory particleMemory;
+        vkutil::UniqueBuffer listBuffer;
+        vkutil::UniqueDeviceMemory listMemory;
+        vkutil::UniqueBuffer counterBuffer;
+        vkutil::UniqueDeviceMemory counterMemory;
+
+        VkDescriptorSetLayout descriptorSetLayout=VK_NULL_HANDLE;
+        VkDescriptorPool descriptorPool=VK_NULL_HANDLE;
+        vkutil::UniquePipelineLayout pipelineLayout;
+        vkutil::UniquePipeline emitPipeline;
+        vkutil::UniquePipeline simulatePipeline;
+        vkutil::UniquePipeline compactPipeline;
+        vkutil::UniquePipeline renderPipeline;
+        VkRenderPass currentRenderPass=VK_NULL_HANDLE;
+        std::vector<char> vertexCode;
+        std::vector<char> fragmentCode;
+        std::vector<Slot> slots;
+
+        FrameConstants frame{};
+        float emitRate=0.0f;
+        float emitAccumulator=0.0f;
+        float timestampPeriod=0.0f;
+        uint64_t timestampMask=~0ull;
+        uint32_t currentList=0;
+        uint32_t seed=0;
+        uint32_t lastAlive=0;
+        Stats stats;
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include "DebugDraw.h"
+#include "DeviceInfo.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<chrono>
+#include<cstdio>
+#include<iostream>
+#include<stdexcept>
+#include<string>
+#include<vector>
+
+//Live performance overlay: the CPU time of the last frames split into phases, their GPU time from two timestamps around
+//everything the frame records, and the counters the app hands in every frame. It draws nothing itself; draw() turns the
+//numbers into text and bars of the debug overlay, which goes to the screen with the rest of it in one draw. The
+//timestamps are recorded the same way every frame, so the overlay does not stop recordings from being reused.
+class PerfHud{
+
+    public:
+        static constexpr uint32_t historyLength=120;
+
+        enum class Phase{
+            Wait,   //for the frame slot's fence
+            Update, //everything between the fence and recording: readbacks, acquire, uniforms, scene, lights
+            Record, //recording the command buffer or picking the cached one
+            Submit, //submit and present
+            Count
+        };
+
+        struct Counters{
+            uint32_t draws=0;
+            uint64_t triangles=0;
+            uint32_t meshletsDrawn=0;
+            uint32_t meshlets=0;        //0 without meshlet culling
+            size_t textureUploads=0;
+            size_t chunkUploads=0;
+        };
+
+        struct Stats{
+            uint64_t frames=0;
+            double drawMs=0.0;
+            double maxDrawMs=0.0;
+            uint64_t gpuFrames=0;
+            double gpuMs=0.0;   //summed over the timed frames
+        };
+
+        void init(const DeviceInfo& deviceInfo, VkDevice device, uint32_t slotCount){
+
+            PROFILE_ZONE("PerfHud::init");
+
+            this->device=device;
+            //without timestamps the GPU graph stays empty
+            uint32_t graphicsFamily=deviceInfo.queueFamilies.graphicsFamily.value();
+            uint32_t validBits=deviceInfo.queueFamilyProperties[graphicsFamily].timestampValidBits;
+            if(validBits>0){
+                timestampPeriod=deviceInfo.properties.limits.timestampPeriod;
+                timestampMask= validBits>=64 ? ~0ull : (1ull<<validBits)-1;
+            }
+            slots.resize(slotCount);
+            for(Slot& slot: slots){
+                VkQueryPoolCreateInfo queryPoolInfo{};
+                {
+                    queryPoolInfo.sType=VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                    queryPoolInfo.queryType=VK_QUERY_TYPE_TIMESTAMP;
+                    queryPoolInfo.queryCount=2;
+                }
+                if(vkCreateQueryPool(device,&queryPoolInfo,nullptr,&slot.queryPool)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to create hud query pool!");
+                }
+            }
+        }
+
+        //Only valid once the device is idle.
+        void cleanup(){
+            if(device==VK_NULL_HANDLE){
+                return;
+            }
+            if(stats.frames>0){
+                std::cout<<"hud: "<<stats.drawMs/stats.frames<<" ms CPU per frame on average, "<<stats.maxDrawMs<<" ms at most"<<std::endl;
+            }
+            for(Slot& slot: slots){
+                vkDestroyQueryPool(device,slot.queryPool,nullptr);
+            }
+            slots.clear();
+            device=VK_NULL_HANDLE;
+        }
+
+        bool isVisible() const{ return visible; }
+        void setVisible(bool visible){ this->visible=visible; }
+
+        //Around everything the frame records, outside of render passes.
+        void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot){
+            if(timestampPeriod==0.0f){
+                return;
+            }
+            vkCmdResetQueryPool(commandBuffer,slots[slot].queryPool,0,2);
+            vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,slots[slot].queryPool,0);
+        }
+
+        void endFrame(VkCommandBuffer commandBuffer, uint32_t slot){
+            if(timestampPeriod==0.0f){
+                return;
+            }
+            vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,slots[slot].queryPool,1);
+            slots[slot].pending=true;
+        }
+
+        //The slot submitted an earlier recording again, its timestamps are written as if endFrame() was recorded.
+        void resubmitted(uint32_t slot){
+            if(timestampPeriod!=0.0f){
+                slots[slot].pending=true;
+            }
+        }
+
+        //After the slot's fence wait, adds the GPU time of its last frame to the graph and the statistics.
+        void collect(uint32_t slot){
+            Slot& state=slots[slot];
+            if(!state.pending){
+                return;
+            }
+            state.pending=false;
+            uint64_t timestamps[2];
+            if(vkGetQueryPoolResults(device,state.queryPool,0,2,sizeof(timestamps),timestamps,sizeof(uint64_t),VK_QUERY_RESULT_64_BIT)==VK_SUCCESS){
+                uint64_t ticks=((timestamps[1]&timestampMask)-(timestamps[0]&timestampMask))&timestampMask;
+                double frameGpuMs=static_cast<double>(ticks)*timestampPeriod/1.0e6;
+                ++stats.gpuFrames;
+                stats.gpuMs+=frameGpuMs;
+                gpuMs[gpuNext]=static_cast<float>(frameGpuMs);
+                gpuNext=(gpuNext+1)%historyLength;
+                gpuSamples=std::min(gpuSamples+1,historyLength);
+            }
+        }
+
+        //CPU time of a finished frame per phase and from its start to the start of the next one.
+        void addFrame(const float (&phases)[static_cast<size_t>(Phase::Count)], float frameMs){
+            std::copy(phases,phases+static_cast<size_t>(Phase::Count),cpuMs[cpuNext]);
+            frameTimes[cpuNext]=frameMs;
+            cpuNext=(cpuNext+1)%historyLength;
+            cpuSamples=std::min(cpuSamples+1,historyLength);
+        }
+
+        void setCounters(const Counters& counters){
+            this->counters=counters;
+        }
+
+        //Adds the overlay to the debug overlay, in the top left corner of a target of the given extent.
+        void draw(DebugDraw& debugDraw, VkExtent2D extent){
+            if(!visible){
+                return;
+            }
+            auto start=std::chrono::steady_clock::now();
+
+            const float scale= extent.height>=1000 ? 2.0f : 1.0f;
+            const float lineHeight=DebugDraw::cellHeight*scale;
+            const float margin=8.0f;
+            const float graphHeight=40.0f*scale;
+            const float barWidth=scale;
+            const float width=std::max(historyLength*barWidth,54.0f*DebugDraw::cellWidth*scale)+2.0f*margin;
+
+            std::vector<MemoryTracker::HeapStats> heaps=vkutil::memoryTracker().getHeapStats();
+            std::string text;
+            char line[160];
+            float averageFrame=average(frameTimes,cpuSamples);
+            std::snprintf(line,sizeof(line),"frame %6.2f ms %6.1f fps   gpu %6.2f ms   hud %.3f ms\n",averageFrame,
+                          averageFrame>0.0f ? 1000.0f/averageFrame : 0.0f,average(gpuMs,gpuSamples),lastDrawMs);
+            text+=line;
+            float phases[static_cast<size_t>(Phase::Count)]={};
+            for(uint32_t i=0;i<cpuSamples;++i){
+                for(size_t phase=0;phase<static_cast<size_t>(Phase::Count);++phase){
+                    phases[phase]+=cpuMs[i][phase]/cpuSamples;
+                }
+            }
+            std::snprintf(line,sizeof(line),"wait %5.2f  update %5.2f  record %5.2f  submit %5.2f ms\n",phases[0],phases[1],phases[2],phases[3]);
+            text+=line;
+            std::snprintf(line,sizeof(line),"draws %u  triangles %llu",counters.draws,static_cast<unsigned long long>(counters.triangles));
+            text+=line;
+            if(counters.meshlets>0){
+                std::snprintf(line,sizeof(line),"  meshlets %u/%u",counters.meshletsDrawn,counters.meshlets);
+                text+=line;
+            }
+            std::snprintf(line,sizeof(line),"\nuploads: textures %zu  chunks %zu\n",counters.textureUploads,counters.chunkUploads);
+            text+=line;
+            for(size_t i=0;i<heaps.size();++i){
+                const MemoryTracker::HeapStats& heap=heaps[i];
+                std::snprintf(line,sizeof(line),"heap %zu %-6s %7.1f / %7.1f MiB\n",i,heap.deviceLocal ? "device" : "host",
+                              heap.usage/(1024.0*1024.0),heap.budget/(1024.0*1024.0));
+                text+=line;
+            }
+            uint32_t lines=static_cast<uint32_t>(std::count(text.begin(),text.end(),'\n'));
+
+            float x=margin, y=margin;
+            float textHeight=lines*lineHeight;
+            debugDraw.rect(0.0f,0.0f,width,margin*3.0f+textHeight+2.0f*graphHeight+lineHeight,DebugDraw::rgba(0.0f,0.0f,0.0f,0.6f));
+            debugDraw.screenText(x,y,text,DebugDraw::rgba(1.0f,1.0f,1.0f));
+            y+=textHeight+margin;
+
+            //stacked CPU phases and the GPU time, the line marks 60 Hz
+            const float msToPixels=graphHeight/(1000.0f/30.0f);
+            const uint32_t phaseColors[static_cast<size_t>(Phase::Count)]={
+                DebugDraw::rgba(0.5f,0.5f,0.5f),DebugDraw::rgba(0.3f,0.6f,1.0f),DebugDraw::rgba(1.0f,0.8f,0.2f),DebugDraw::rgba(0.9f,0.4f,0.9f)
+            };
+            graphFrame(debugDraw,x,y,historyLength*barWidth,graphHeight,msToPixels,"cpu");
+            for(uint32_t i=0;i<cpuSamples;++i){
+                const float* sample=cpuMs[(cpuNext+historyLength-cpuSamples+i)%historyLength];
+                float top=y+graphHeight;
+                for(size_t phase=0;phase<static_cast<size_t>(Phase::Count);++phase){
+                    float height=std::min(sample[phase]*msToPixels,top-y);
+                    top-=height;
+                    debugDraw.rect(x+i*barWidth,top,barWidth,height,phaseColors[phase]);
+                }
+            }
+            y+=graphHeight+lineHeight;
+            graphFrame(debugDraw,x,y,historyLength*barWidth,graphHeight,msToPixels,"gpu");
+            for(uint32_t i=0;i<gpuSamples;++i){
+                float height=std::min(gpuMs[(gpuNext+historyLength-gpuSamples+i)%historyLength]*msToPixels,graphHeight);
+                debugDraw.rect(x+i*barWidth,y+graphHeight-height,barWidth,height,DebugDraw::rgba(0.3f,1.0f,0.4f));
+            }
+
+            lastDrawMs=std::chrono::duration<float,std::milli>(std::chrono::steady_clock::now()-start).count();
+            ++stats.frames;
+            stats.drawMs+=lastDrawMs;
+            stats.maxDrawMs=std::max(stats.maxDrawMs,static_cast<double>(lastDrawMs));
+        }
+
+        Stats getStats() const{ return stats; }
+
+    private:
+        struct Slot{
+            VkQueryPool queryPool=VK_NULL_HANDLE;
+            bool pending=false;
+        };
+
+        static float average(const float* samples, uint32_t count){
+            float sum=0.0f;
+            for(uint32_t i=0;i<count;++i){
+                sum+=samples[i];
+            }
+            return count>0 ? sum/count : 0.0f;
+        }
+
+        //Background of a graph with its label and the 60 Hz line.
+        static void graphFrame(DebugDraw& debugDraw, float x, float y, float width, float height, float msToPixels, const char* label){
+            debugDraw.rect(x,y,width,height,DebugDraw::rgba(0.2f,0.2f,0.2f,0.6f));
+            debugDraw.rect(x,y+height-(1000.0f/60.0f)*msToPixels,width,1.0f,DebugDraw::rgba(1.0f,0.3f,0.3f,0.8f));
+            debugDraw.screenText(x+width+4.0f,y,label,DebugDraw::rgba(1.0f,1.0f,1.0f));
+        }
+
+        VkDevice device=VK_NULL_HANDLE;
+        std::vector<Slot> slots;
+        float timestampPeriod=0.0f;
+        uint64_t timestampMask=~0ull; //the counter wraps at timestampValidBits
+        bool visible=false;
+
+        //rings of the last historyLength frames
+        float cpuMs[historyLength][static_cast<size_t>(Phase::Count)]={};
+        float frameTimes[historyLength]={};
+        float gpuMs[historyLength]={};
+        uint32_t cpuNext=0;
+        uint32_t cpuSamples=0;
+        uint32_t gpuNext=0;
+        uint32_t gpuSamples=0;
+
+        Counters counters;
+        float lastDrawMs=0.0f;
+        Stats stats;
+};
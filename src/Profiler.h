@@ -0,0 +1,188 @@
+#pragma once
+
+#include<atomic>
+#include<chrono>
+#include<cstdio>
+#include<fstream>
+#include<iostream>
+#include<memory>
+#include<mutex>
+#include<set>
+#include<string>
+#include<vector>
+
+//Timeline profiler. CPU zones are recorded into per thread buffers, GPU zones (GpuProfiler.h) are converted to the same
+//clock, and write() saves everything as Chrome trace event JSON that chrome://tracing and Perfetto load.
+//Until start() is called a zone costs one relaxed atomic load, defining PROFILER_DISABLED compiles the zones out.
+class Profiler{
+
+    public:
+        static Profiler& get(){
+            static Profiler profiler;
+            return profiler;
+        }
+
+        static bool isEnabled(){
+            return enabled.load(std::memory_order_relaxed);
+        }
+
+        //Nanoseconds on the steady clock, which is CLOCK_MONOTONIC on Linux.
+        static int64_t now(){
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void start(){
+            startTime=now();
+            enabled.store(true,std::memory_order_relaxed);
+        }
+
+        //Names the calling thread's track, can be called before start().
+        void setThreadName(const std::string& name){
+            Track& track=threadTrack();
+            std::lock_guard<std::mutex> lock(track.mutex);
+            track.name=name;
+        }
+
+        //name has to outlive the profiler, zones are always given string literals.
+        void addZone(const char* name, int64_t begin, int64_t end){
+            Track& track=threadTrack();
+            std::lock_guard<std::mutex> lock(track.mutex);
+            track.events.push_back({name,begin,end});
+        }
+
+        //Zone on a track that belongs to no thread, e.g. a GPU queue. Times are already on the CPU clock.
+        void addTrackZone(uint32_t trackId, const char* name, int64_t begin, int64_t end){
+            Track& track=namedTrack(trackId);
+            std::lock_guard<std::mutex> lock(track.mutex);
+            track.events.push_back({name,begin,end});
+        }
+
+        //Stable copy of a name that is not a string literal, e.g. a render graph pass name.
+        const char* intern(const std::string& name){
+            std::lock_guard<std::mutex> lock(tracksMutex);
+            return names.insert(name).first->c_str();
+        }
+
+        //Tracks that are not threads get ids from here.
+        uint32_t createTrack(const std::string& name){
+            std::lock_guard<std::mutex> lock(tracksMutex);
+            auto track=std::make_unique<Track>();
+            track->id=firstNamedTrack+static_cast<uint32_t>(namedTracks.size());
+            track->name=name;
+            namedTracks.push_back(std::move(track));
+            return namedTracks.back()->id;
+        }
+
+        bool write(const std::string& path){
+
+            std::ofstream file(path);
+            if(!file.is_open()){
+                std::cerr<<"failed to write trace "<<path<<std::endl;
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lock(tracksMutex);
+            size_t eventCount=0;
+            bool first=true;
+            char buffer[64];
+            file<<"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+            auto writeTrack=[&](Track& track){
+                std::lock_guard<std::mutex> trackLock(track.mutex);
+                file<<(first ? "" : ",\n")<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"<<track.id
+                    <<",\"args\":{\"name\":\""<<track.name<<"\"}}";
+                first=false;
+                for(const auto& event: track.events){
+                    if(event.end<startTime){
+                        continue;
+                    }
+                    //chrome traces count in microseconds
+                    std::snprintf(buffer,sizeof(buffer),"\"ts\":%.3f,\"dur\":%.3f",(event.begin-startTime)/1000.0,(event.end-event.begin)/1000.0);
+                    file<<",\n{\"name\":\""<<event.name<<"\",\"ph\":\"X\",\"pid\":1,\"tid\":"<<track.id<<","<<buffer<<"}";
+                    ++eventCount;
+                }
+            };
+            for(auto& track: threadTracks){
+                writeTrack(*track);
+            }
+            for(auto& track: namedTracks){
+                writeTrack(*track);
+            }
+            file<<"\n]}\n";
+
+            std::cout<<"trace with "<<eventCount<<" zones written to "<<path<<std::endl;
+            return true;
+        }
+
+    private:
+        struct Event{
+            const char* name;
+            int64_t begin;
+            int64_t end;
+        };
+
+        struct Track{
+            uint32_t id=0;
+            std::string name;
+            std::vector<Event> events;
+            std::mutex mutex; //only contended while writing the trace
+        };
+
+        //Tracks outlive their threads, the profiler owns them.
+        Track& threadTrack(){
+            thread_local Track* track=nullptr;
+            if(!track){
+                std::lock_guard<std::mutex> lock(tracksMutex);
+                threadTracks.push_back(std::make_unique<Track>());
+                track=threadTracks.back().get();
+                track->id=static_cast<uint32_t>(threadTracks.size());
+                track->name="thread "+std::to_string(track->id);
+            }
+            return *track;
+        }
+
+        Track& namedTrack(uint32_t id){
+            std::lock_guard<std::mutex> lock(tracksMutex);
+            return *namedTracks[id-firstNamedTrack];
+        }
+
+        static inline std::atomic<bool> enabled{false};
+        static constexpr uint32_t firstNamedTrack=1000;
+
+        int64_t startTime=0;
+        std::mutex tracksMutex;
+        std::vector<std::unique_ptr<Track>> threadTracks;
+        std::vector<std::unique_ptr<Track>> namedTracks;
+        std::set<std::string> names;
+};
+
+class ProfileZone{
+
+    public:
+        explicit ProfileZone(const char* name): name(Profiler::isEnabled() ? name : nullptr){
+            if(this->name){
+                begin=Profiler::now();
+            }
+        }
+
+        ~ProfileZone(){
+            if(name){
+                Profiler::get().addZone(name,begin,Profiler::now());
+            }
+        }
+
+        ProfileZone(const ProfileZone&)=delete;
+        ProfileZone& operator=(const ProfileZone&)=delete;
+
+    private:
+        const char* name;
+        int64_t begin=0;
+};
+
+#define PROFILE_CONCAT_INNER(a,b) a##b
+#define PROFILE_CONCAT(a,b) PROFILE_CONCAT_INNER(a,b)
+#ifdef PROFILER_DISABLED
+    #define PROFILE_ZONE(name)
+#else
+    #define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone,__LINE__)(name)
+#endif
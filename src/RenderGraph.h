@@ -0,0 +1,901 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "GpuProfiler.h"
+#include "VulkanUtils.h"
+
+#include<algorithm>
+#include<functional>
+#include<iostream>
+#include<map>
+#include<string>
+#include<utility>
+#include<vector>
+
+using RenderResource=uint32_t;
+using RenderPassHandle=uint32_t;
+
+//How a pass touches a resource. Decides the pipeline stage, access mask and image layout the graph synchronizes against.
+enum class ResourceUsage{
+    ColorAttachment,
+    DepthAttachment,
+    DepthReadOnly,
+    SampledFragment,
+    SampledCompute,
+    StorageImageRead,
+    StorageImageWrite,
+    StorageBufferRead,
+    StorageBufferWrite,
+    StorageBufferReadGraphics,
+    VertexBuffer,
+    IndexBuffer,
+    IndirectBuffer,
+    TransferSrc,
+    TransferDst
+};
+
+//State an imported resource is in when the graph starts, or has to be left in when it ends.
+struct ResourceState{
+    VkImageLayout layout=VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags stage=0;
+    VkAccessFlags access=0;
+};
+
+//Frame graph on top of plain render passes. Passes declare the images and buffers they read and write, compile() then
+//culls passes whose results are never used, plans every layout transition and the smallest set of pipeline barriers
+//(one vkCmdPipelineBarrier per pass at most), and places transient images with disjoint lifetimes in the same memory.
+//Every pass gets its own VkRenderPass whose attachments stay in one layout, all transitions happen in the graph's barriers.
+//Declaring is cheap, compile() creates the transient images, so it is only rerun when the setup changes (e.g. resize).
+class RenderGraph{
+
+    public:
+        enum class PassType{ Graphics, Compute };
+
+        struct Stats{
+            uint32_t passCount=0;
+            uint32_t culledPasses=0;
+            uint32_t barrierBatches=0; //vkCmdPipelineBarrier calls per execution
+            uint32_t imageBarriers=0;
+            uint32_t bufferBarriers=0;
+            uint32_t transientImages=0;
+            VkDeviceSize transientBytes=0; //what the transient images would take with one allocation each
+            VkDeviceSize allocatedBytes=0; //what they take with aliasing
+        };
+
+        void init(VkPhysicalDevice physicalDevice, VkDevice device, DeletionQueue& deletionQueue){
+            this->physicalDevice=physicalDevice;
+            this->device=device;
+            this->deletionQueue=&deletionQueue;
+        }
+
+        //Drops all passes and resources so the graph can be declared again. Render passes are kept,
+        //pipelines created against them stay valid as long as the pass declares the same attachments.
+        void clear(){
+            passes.clear();
+            resources.clear();
+            memoryBlocks.clear();
+            finalBarriers=BarrierBatch{};
+            stats=Stats{};
+            compiled=false;
+        }
+
+        //Releases everything including the cached render passes and framebuffers.
+        void cleanup(){
+            clear();
+            framebuffers.clear();
+            renderPassCache.clear();
+        }
+
+        //Image that only lives inside the graph, contents are undefined before the first pass writing it.
+        RenderResource createImage(const std::string& name, VkFormat format, VkExtent2D extent){
+            Resource resource;
+            resource.name=name;
+            resource.isImage=true;
+            resource.transient=true;
+            resource.format=format;
+            resource.extent=extent;
+            resource.aspect=aspectFor(format);
+            resources.push_back(std::move(resource));
+            return static_cast<RenderResource>(resources.size()-1);
+        }
+
+        //Image owned by someone else (e.g. the swapchain). Its handles are bound with setImportedImage() before every execute().
+        RenderResource importImage(const std::string& name, VkFormat format, VkExtent2D extent, ResourceState initial, ResourceState final){
+            Resource resource;
+            resource.name=name;
+            resource.isImage=true;
+            resource.format=format;
+            resource.extent=extent;
+            resource.aspect=aspectFor(format);
+            resource.initial=initial;
+            resource.final=final;
+            resources.push_back(std::move(resource));
+            return static_cast<RenderResource>(resources.size()-1);
+        }
+
+        //Buffer owned by someone else, initial tells which earlier GPU work the first access has to wait for.
+        RenderResource importBuffer(const std::string& name, ResourceState initial={}){
+            Resource resource;
+            resource.name=name;
+            resource.initial=initial;
+            resources.push_back(std::move(resource));
+            return static_cast<RenderResource>(resources.size()-1);
+        }
+
+        RenderPassHandle addPass(const std::string& name, PassType type, std::function<void(VkCommandBuffer)> execute){
+            Pass pass;
+            pass.name=name;
+            pass.profileName=Profiler::get().intern(name);
+            pass.type=type;
+            pass.execute=std::move(execute);
+            passes.push_back(std::move(pass));
+            return static_cast<RenderPassHandle>(passes.size()-1);
+        }
+
+        //Passes with side effects outside of the graph (readbacks, queries) are never culled.
+        void setSideEffects(RenderPassHandle pass){
+            passes[pass].sideEffects=true;
+        }
+
+        void writeColor(RenderPassHandle pass, RenderResource resource, VkAttachmentLoadOp loadOp, VkClearColorValue clearColor={}){
+            VkClearValue clearValue{};
+            clearValue.color=clearColor;
+            addAccess(pass,resource,ResourceUsage::ColorAttachment,loadOp,clearValue);
+        }
+
+        void writeDepth(RenderPassHandle pass, RenderResource resource, VkAttachmentLoadOp loadOp, float clearDepth=1.0f){
+            VkClearValue clearValue{};
+            clearValue.depthStencil={clearDepth,0};
+            addAccess(pass,resource,ResourceUsage::DepthAttachment,loadOp,clearValue);
+        }
+
+        //Depth test without depth writes, the attachment is loaded and kept in the read only layout.
+        void readDepth(RenderPassHandle pass, RenderResource resource){
+            addAccess(pass,resource,ResourceUsage::DepthReadOnly,VK_ATTACHMENT_LOAD_OP_LOAD,{});
+        }
+
+        void read(RenderPassHandle pass, RenderResource resource, ResourceUsage usage){
+            addAccess(pass,resource,usage,VK_ATTACHMENT_LOAD_OP_LOAD,{});
+        }
+
+        void write(RenderPassHandle pass, RenderResource resource, ResourceUsage usage){
+            addAccess(pass,resource,usage,VK_ATTACHMENT_LOAD_OP_LOAD,{});
+        }
+
+        void compile(){
+
+            //framebuffers reference the transient views that are about to be replaced
+            framebuffers.clear();
+            stats=Stats{};
+
+            cullPasses();
+            computeLifetimes();
+            allocateTransients();
+            planBarriers();
+            createRenderPasses();
+            compiled=true;
+        }
+
+        //Every pass gets a GPU zone named after it.
+        void setProfiler(GpuProfiler* profiler){
+            this->profiler=profiler;
+        }
+
+        void setImportedImage(RenderResource resource, VkImage image, VkImageView view){
+            resources[resource].image=image;
+            resources[resource].view=view;
+        }
+
+        void setImportedBuffer(RenderResource resource, VkBuffer buffer){
+            resources[resource].buffer=buffer;
+        }
+
+        void execute(VkCommandBuffer commandBuffer){
+
+            if(!compiled){
+                throw std::runtime_error("render graph executed before it was compiled!");
+            }
+
+            for(auto& pass: passes){
+                if(pass.culled){
+                    continue;
+                }
+                if(profiler){
+                    profiler->begin(commandBuffer,pass.profileName);
+                }
+                emitBarriers(commandBuffer,pass.barriers);
+
+                if(pass.type==PassType::Graphics){
+                    VkRenderPassBeginInfo renderPassInfo{};
+                    {
+                        renderPassInfo.sType=VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                        renderPassInfo.renderPass=pass.renderPass;
+                        renderPassInfo.framebuffer=getFramebuffer(pass);
+                        renderPassInfo.renderArea.offset={0,0};
+                        renderPassInfo.renderArea.extent=pass.extent;
+                        renderPassInfo.clearValueCount=static_cast<uint32_t>(pass.clearValues.size());
+                        renderPassInfo.pClearValues=pass.clearValues.data();
+                    }
+                    vkCmdBeginRenderPass(commandBuffer,&renderPassInfo,VK_SUBPASS_CONTENTS_INLINE);
+                        pass.execute(commandBuffer);
+                    vkCmdEndRenderPass(commandBuffer);
+                }
+                else{
+                    pass.execute(commandBuffer);
+                }
+                if(profiler){
+                    profiler->end(commandBuffer);
+                }
+            }
+            emitBarriers(commandBuffer,finalBarriers);
+        }
+
+        //Render pass a graphics pass executes in, pipelines used by the pass are created against it.
+        VkRenderPass getRenderPass(RenderPassHandle pass) const{ return passes[pass].renderPass; }
+        VkExtent2D getExtent(RenderResource resource) const{ return resources[resource].extent; }
+        VkImage getImage(RenderResource resource) const{ return resources[resource].image; }
+        VkImageView getImageView(RenderResource resource) const{ return resources[resource].view; }
+        bool isCulled(RenderPassHandle pass) const{ return passes[pass].culled; }
+        const Stats& getStats() const{ return stats; }
+
+        void printReport() const{
+            std::cout<<"render graph: "<<stats.passCount-stats.culledPasses<<" of "<<stats.passCount<<" passes ("<<stats.culledPasses<<" culled), "
+                     <<stats.barrierBatches<<" barrier batches ("<<stats.imageBarriers<<" image, "<<stats.bufferBarriers<<" buffer barriers)"<<std::endl;
+            std::cout<<"render graph: "<<stats.transientImages<<" transient images in "<<memoryBlocks.size()<<" allocations, "
+                     <<stats.allocatedBytes/1024<<" KiB instead of "<<stats.transientBytes/1024<<" KiB, aliasing saves "
+                     <<(stats.transientBytes-stats.allocatedBytes)/1024<<" KiB"<<std::endl;
+            for(const auto& pass: passes){
+                std::cout<<"  "<<(pass.culled ? "culled " : "pass   ")<<pass.name<<std::endl;
+            }
+        }
+
+    private:
+        struct AccessInfo{
+            VkPipelineStageFlags stage;
+            VkAccessFlags access;
+            VkImageLayout layout;
+            bool write;
+            VkImageUsageFlags imageUsage;
+        };
+
+        struct Access{
+            RenderResource resource;
+            ResourceUsage usage;
+            VkAttachmentLoadOp loadOp;
+            VkClearValue clearValue;
+        };
+
+        struct ImageBarrier{
+            RenderResource resource;
+            VkImageLayout oldLayout;
+            VkImageLayout newLayout;
+            VkAccessFlags srcAccess;
+            VkAccessFlags dstAccess;
+        };
+
+        struct BufferBarrier{
+            RenderResource resource;
+            VkAccessFlags srcAccess;
+            VkAccessFlags dstAccess;
+        };
+
+        struct BarrierBatch{
+            VkPipelineStageFlags srcStage=0;
+            VkPipelineStageFlags dstStage=0;
+            std::vector<ImageBarrier> images;
+            std::vector<BufferBarrier> buffers;
+        };
+
+        struct Pass{
+            std::string name;
+            const char* profileName;
+            PassType type;
+            std::function<void(VkCommandBuffer)> execute;
+            std::vector<Access> accesses;
+            bool sideEffects=false;
+            bool culled=false;
+
+            BarrierBatch barriers;
+            VkRenderPass renderPass=VK_NULL_HANDLE;
+            VkExtent2D extent{};
+            std::vector<RenderResource> attachments;
+            std::vector<VkClearValue> clearValues;
+        };
+
+        struct Resource{
+            std::string name;
+            bool isImage=false;
+            bool transient=false;
+            VkFormat format=VK_FORMAT_UNDEFINED;
+            VkExtent2D extent{};
+            VkImageAspectFlags aspect=0;
+            VkImageUsageFlags usage=0;
+            ResourceState initial;
+            ResourceState final;
+
+            VkImage image=VK_NULL_HANDLE;
+            VkImageView view=VK_NULL_HANDLE;
+            VkBuffer buffer=VK_NULL_HANDLE;
+
+            //transient only
+            int firstPass=-1;
+            int lastPass=-1;
+            uint32_t memoryBlock=0;
+            VkMemoryRequirements requirements{};
+            vkutil::UniqueImageView ownedView;
+            vkutil::UniqueImage ownedImage;
+        };
+
+        struct MemoryBlock{
+            std::vector<RenderResource> occupants;
+            VkDeviceSize size=0;
+            uint32_t memoryTypeBits=~0u;
+            vkutil::UniqueDeviceMemory memory;
+        };
+
+        //What the graph knows about a resource while walking the passes in order.
+        struct Tracker{
+            VkImageLayout layout=VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags writeStages=0;
+            VkAccessFlags writeAccess=0;
+            VkPipelineStageFlags readStages=0;
+            VkPipelineStageFlags visibleStages=0; //stages the last write was already made visible to
+            VkAccessFlags visibleAccess=0;
+        };
+
+        static AccessInfo accessInfo(ResourceUsage usage){
+            switch(usage){
+                case ResourceUsage::ColorAttachment:
+                    return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,true,VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+                case ResourceUsage::DepthAttachment:
+                    return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,true,VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+                case ResourceUsage::DepthReadOnly:
+                    return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,false,VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+                case ResourceUsage::SampledFragment:
+                    return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,false,VK_IMAGE_USAGE_SAMPLED_BIT};
+                case ResourceUsage::SampledCompute:
+                    return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,false,VK_IMAGE_USAGE_SAMPLED_BIT};
+                case ResourceUsage::StorageImageRead:
+                    return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT,VK_IMAGE_LAYOUT_GENERAL,false,VK_IMAGE_USAGE_STORAGE_BIT};
+                case ResourceUsage::StorageImageWrite:
+                    return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,VK_IMAGE_LAYOUT_GENERAL,true,VK_IMAGE_USAGE_STORAGE_BIT};
+                case ResourceUsage::StorageBufferRead:
+                    return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT,VK_IMAGE_LAYOUT_UNDEFINED,false,0};
+                case ResourceUsage::StorageBufferWrite:
+                    return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,VK_IMAGE_LAYOUT_UNDEFINED,true,0};
+                case ResourceUsage::StorageBufferReadGraphics:
+                    return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT,VK_IMAGE_LAYOUT_UNDEFINED,false,0};
+                case ResourceUsage::VertexBuffer:
+                    return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,VK_IMAGE_LAYOUT_UNDEFINED,false,0};
+                case ResourceUsage::IndexBuffer:
+                    return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,VK_ACCESS_INDEX_READ_BIT,VK_IMAGE_LAYOUT_UNDEFINED,false,0};
+                case ResourceUsage::IndirectBuffer:
+                    return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,VK_ACCESS_INDIRECT_COMMAND_READ_BIT,VK_IMAGE_LAYOUT_UNDEFINED,false,0};
+                case ResourceUsage::TransferSrc:
+                    return {VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_READ_BIT,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,false,VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+                case ResourceUsage::TransferDst:
+                    return {VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_WRITE_BIT,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,true,VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+            }
+            throw std::runtime_error("unknown render graph resource usage!");
+        }
+
+        static VkAccessFlags writeAccessMask(VkAccessFlags access){
+            return access & (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                             VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+        }
+
+        static VkImageAspectFlags aspectFor(VkFormat format){
+            switch(format){
+                case VK_FORMAT_D16_UNORM:
+                case VK_FORMAT_D32_SFLOAT:
+                case VK_FORMAT_X8_D24_UNORM_PACK32:
+                    return VK_IMAGE_ASPECT_DEPTH_BIT;
+                case VK_FORMAT_D16_UNORM_S8_UINT:
+                case VK_FORMAT_D24_UNORM_S8_UINT:
+                case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+                default:
+                    return VK_IMAGE_ASPECT_COLOR_BIT;
+            }
+        }
+
+        void addAccess(RenderPassHandle pass, RenderResource resource, ResourceUsage usage, VkAttachmentLoadOp loadOp, VkClearValue clearValue){
+            AccessInfo info=accessInfo(usage);
+            if(resources[resource].isImage != (info.imageUsage!=0)){
+                throw std::runtime_error("render graph resource used with the wrong usage!");
+            }
+            resources[resource].usage|=info.imageUsage;
+            passes[pass].accesses.push_back({resource,usage,loadOp,clearValue});
+        }
+
+        //Walks the passes backwards, a pass survives if it writes something a surviving later pass reads,
+        //writes an imported resource or has side effects.
+        void cullPasses(){
+            std::vector<bool> needed(resources.size(),false);
+            for(size_t r=0;r<resources.size();++r){
+                needed[r]=!resources[r].transient;
+            }
+
+            stats.passCount=static_cast<uint32_t>(passes.size());
+            for(size_t p=passes.size();p-->0;){
+                Pass& pass=passes[p];
+                bool keep=pass.sideEffects;
+                for(const auto& access: pass.accesses){
+                    if(accessInfo(access.usage).write && needed[access.resource]){
+                        keep=true;
+                    }
+                }
+                pass.culled=!keep;
+                if(!keep){
+                    ++stats.culledPasses;
+                    continue;
+                }
+                for(const auto& access: pass.accesses){
+                    if(!accessInfo(access.usage).write || access.loadOp==VK_ATTACHMENT_LOAD_OP_LOAD){
+                        needed[access.resource]=true;
+                    }
+                }
+            }
+        }
+
+        void computeLifetimes(){
+            for(auto& resource: resources){
+                resource.firstPass=-1;
+                resource.lastPass=-1;
+            }
+            for(size_t p=0;p<passes.size();++p){
+                if(passes[p].culled){
+                    continue;
+                }
+                for(const auto& access: passes[p].accesses){
+                    Resource& resource=resources[access.resource];
+                    if(resource.firstPass<0){
+                        resource.firstPass=static_cast<int>(p);
+                    }
+                    resource.lastPass=static_cast<int>(p);
+                }
+            }
+        }
+
+        //Creates the transient images and packs them greedily, largest first, into memory blocks shared by images whose
+        //lifetimes do not overlap. Every image is bound at offset 0 of its block, so alignment is never an issue.
+        void allocateTransients(){
+
+            std::vector<RenderResource> transients;
+            for(size_t r=0;r<resources.size();++r){
+                Resource& resource=resources[r];
+                if(!resource.transient){
+                    continue;
+                }
+                resource.ownedView.reset();
+                resource.ownedImage.reset();
+                resource.image=VK_NULL_HANDLE;
+                resource.view=VK_NULL_HANDLE;
+                if(resource.firstPass<0){
+                    continue; //only used by culled passes
+                }
+
+                VkImageCreateInfo imageInfo{};
+                {
+                    imageInfo.sType=VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                    imageInfo.imageType=VK_IMAGE_TYPE_2D;
+                    imageInfo.extent={resource.extent.width,resource.extent.height,1};
+                    imageInfo.mipLevels=1;
+                    imageInfo.arrayLayers=1;
+                    imageInfo.format=resource.format;
+                    imageInfo.tiling=VK_IMAGE_TILING_OPTIMAL;
+                    imageInfo.initialLayout=VK_IMAGE_LAYOUT_UNDEFINED;
+                    imageInfo.usage=resource.usage;
+                    imageInfo.samples=VK_SAMPLE_COUNT_1_BIT;
+                    imageInfo.sharingMode=VK_SHARING_MODE_EXCLUSIVE;
+                }
+                if(vkCreateImage(device,&imageInfo,nullptr,&resource.image)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to create render graph image!");
+                }
+                resource.ownedImage=vkutil::UniqueImage(*deletionQueue,resource.image);
+                vkGetImageMemoryRequirements(device,resource.image,&resource.requirements);
+                transients.push_back(static_cast<RenderResource>(r));
+            }
+
+            std::sort(transients.begin(),transients.end(),[this](RenderResource a, RenderResource b){
+                return resources[a].requirements.size>resources[b].requirements.size;
+            });
+
+            memoryBlocks.clear();
+            for(RenderResource r: transients){
+                Resource& resource=resources[r];
+                stats.transientBytes+=resource.requirements.size;
+                ++stats.transientImages;
+
+                bool placed=false;
+                for(size_t b=0;b<memoryBlocks.size() && !placed;++b){
+                    MemoryBlock& block=memoryBlocks[b];
+                    if(!(block.memoryTypeBits & resource.requirements.memoryTypeBits)){
+                        continue;
+                    }
+                    bool overlaps=false;
+                    for(RenderResource other: block.occupants){
+                        if(resource.firstPass<=resources[other].lastPass && resources[other].firstPass<=resource.lastPass){
+                            overlaps=true;
+                            break;
+                        }
+                    }
+                    if(!overlaps){
+                        block.occupants.push_back(r);
+                        block.size=std::max(block.size,resource.requirements.size);
+                        block.memoryTypeBits&=resource.requirements.memoryTypeBits;
+                        resource.memoryBlock=static_cast<uint32_t>(b);
+                        placed=true;
+                    }
+                }
+                if(!placed){
+                    MemoryBlock block;
+                    block.occupants.push_back(r);
+                    block.size=resource.requirements.size;
+                    block.memoryTypeBits=resource.requirements.memoryTypeBits;
+                    resource.memoryBlock=static_cast<uint32_t>(memoryBlocks.size());
+                    memoryBlocks.push_back(std::move(block));
+                }
+            }
+
+            for(auto& block: memoryBlocks){
+                VkMemoryAllocateInfo allocateInfo{};
+                {
+                    allocateInfo.sType=VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                    allocateInfo.allocationSize=block.size;
+                    allocateInfo.memoryTypeIndex=vkutil::findMemoryType(physicalDevice,block.memoryTypeBits,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                }
+                VkDeviceMemory memory;
+                if(vkutil::allocateMemory(device,allocateInfo,MemoryCategory::Attachments,memory)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to allocate render graph memory!");
+                }
+                block.memory=vkutil::UniqueDeviceMemory(*deletionQueue,memory);
+                stats.allocatedBytes+=block.size;
+
+                for(RenderResource r: block.occupants){
+                    Resource& resource=resources[r];
+                    vkBindImageMemory(device,resource.image,block.memory,0);
+                    resource.view=vkutil::createImageView(device,resource.image,resource.format,resource.aspect,1);
+                    resource.ownedView=vkutil::UniqueImageView(*deletionQueue,resource.view);
+                }
+            }
+        }
+
+        //Simulates one execution of the graph and records, per pass, the barriers needed before it runs.
+        void planBarriers(){
+
+            std::vector<Tracker> trackers(resources.size());
+            for(size_t r=0;r<resources.size();++r){
+                const Resource& resource=resources[r];
+                Tracker& tracker=trackers[r];
+                if(!resource.transient){
+                    tracker.layout=resource.initial.layout;
+                    tracker.writeStages=resource.initial.stage;
+                    tracker.writeAccess=resource.initial.access;
+                    continue;
+                }
+                if(resource.firstPass<0){
+                    continue;
+                }
+                //The memory may still be in use by whichever image last occupied it, in this frame or in the previous one
+                //that is still in flight, so the first use waits for every access to the block.
+                for(RenderResource other: memoryBlocks[resource.memoryBlock].occupants){
+                    for(size_t p=resources[other].firstPass;p<=static_cast<size_t>(resources[other].lastPass);++p){
+                        if(passes[p].culled){
+                            continue;
+                        }
+                        for(const auto& access: passes[p].accesses){
+                            if(access.resource==other){
+                                AccessInfo info=accessInfo(access.usage);
+                                tracker.writeStages|=info.stage;
+                                tracker.writeAccess|=writeAccessMask(info.access);
+                            }
+                        }
+                    }
+                }
+                tracker.layout=VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+
+            for(auto& pass: passes){
+                pass.barriers=BarrierBatch{};
+                if(pass.culled){
+                    continue;
+                }
+                for(const auto& access: pass.accesses){
+                    AccessInfo info=accessInfo(access.usage);
+                    bool isImage=resources[access.resource].isImage;
+                    //the previous contents are discarded, no need to keep them through the transition
+                    bool discard=isImage && info.write && access.loadOp!=VK_ATTACHMENT_LOAD_OP_LOAD;
+                    transition(pass.barriers,trackers[access.resource],access.resource,info,isImage,discard);
+                }
+                countBatch(pass.barriers);
+            }
+
+            finalBarriers=BarrierBatch{};
+            for(size_t r=0;r<resources.size();++r){
+                const Resource& resource=resources[r];
+                if(resource.transient || !resource.isImage){
+                    continue;
+                }
+                Tracker& tracker=trackers[r];
+                if(tracker.layout==resource.final.layout && resource.final.stage==0){
+                    continue;
+                }
+                ImageBarrier barrier{static_cast<RenderResource>(r),tracker.layout,resource.final.layout,tracker.writeAccess,resource.final.access};
+                finalBarriers.srcStage|=tracker.writeStages | tracker.readStages;
+                finalBarriers.dstStage|=resource.final.stage ? resource.final.stage : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+                finalBarriers.images.push_back(barrier);
+            }
+            countBatch(finalBarriers);
+        }
+
+        void transition(BarrierBatch& batch, Tracker& tracker, RenderResource resource, const AccessInfo& info, bool isImage, bool discard){
+
+            bool layoutChange=isImage && tracker.layout!=info.layout;
+            VkPipelineStageFlags srcStage=0;
+            VkAccessFlags srcAccess=0;
+            bool needed=false;
+
+            if(layoutChange || info.write){
+                //read after write, write after write and write after read hazards, or a layout transition
+                srcStage=tracker.writeStages | tracker.readStages;
+                srcAccess=tracker.writeAccess;
+                needed=layoutChange || srcStage!=0;
+            }
+            else if(tracker.writeStages!=0 && ((info.stage & ~tracker.visibleStages) || (info.access & ~tracker.visibleAccess))){
+                //read after write that has not been made visible to this stage yet
+                srcStage=tracker.writeStages;
+                srcAccess=tracker.writeAccess;
+                needed=true;
+            }
+
+            if(needed){
+                batch.srcStage|=srcStage ? srcStage : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+                batch.dstStage|=info.stage;
+                if(isImage){
+                    batch.images.push_back({resource,discard ? VK_IMAGE_LAYOUT_UNDEFINED : tracker.layout,info.layout,srcAccess,info.access});
+                }
+                else{
+                    batch.buffers.push_back({resource,srcAccess,info.access});
+                }
+            }
+
+            if(info.write){
+                tracker.writeStages=info.stage;
+                tracker.writeAccess=writeAccessMask(info.access);
+                tracker.readStages=0;
+                tracker.visibleStages=info.stage;
+                tracker.visibleAccess=info.access;
+            }
+            else if(layoutChange){
+                //the transition acts like a write at this stage, later readers chain on it
+                tracker.writeStages=info.stage;
+                tracker.writeAccess=0;
+                tracker.readStages=info.stage;
+                tracker.visibleStages=info.stage;
+                tracker.visibleAccess=info.access;
+            }
+            else{
+                tracker.readStages|=info.stage;
+                if(needed){
+                    tracker.visibleStages|=info.stage;
+                    tracker.visibleAccess|=info.access;
+                }
+            }
+            if(isImage){
+                tracker.layout=info.layout;
+            }
+        }
+
+        void countBatch(const BarrierBatch& batch){
+            if(batch.images.empty() && batch.buffers.empty()){
+                return;
+            }
+            ++stats.barrierBatches;
+            stats.imageBarriers+=static_cast<uint32_t>(batch.images.size());
+            stats.bufferBarriers+=static_cast<uint32_t>(batch.buffers.size());
+        }
+
+        void emitBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch){
+            if(batch.images.empty() && batch.buffers.empty()){
+                return;
+            }
+
+            imageBarrierScratch.clear();
+            for(const auto& barrier: batch.images){
+                const Resource& resource=resources[barrier.resource];
+                VkImageMemoryBarrier imageBarrier{};
+                {
+                    imageBarrier.sType=VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    imageBarrier.oldLayout=barrier.oldLayout;
+                    imageBarrier.newLayout=barrier.newLayout;
+                    imageBarrier.srcQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED;
+                    imageBarrier.dstQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED;
+                    imageBarrier.image=resource.image;
+                    imageBarrier.subresourceRange={resource.aspect,0,VK_REMAINING_MIP_LEVELS,0,VK_REMAINING_ARRAY_LAYERS};
+                    imageBarrier.srcAccessMask=barrier.srcAccess;
+                    imageBarrier.dstAccessMask=barrier.dstAccess;
+                }
+                imageBarrierScratch.push_back(imageBarrier);
+            }
+
+            bufferBarrierScratch.clear();
+            for(const auto& barrier: batch.buffers){
+                VkBufferMemoryBarrier bufferBarrier{};
+                {
+                    bufferBarrier.sType=VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                    bufferBarrier.srcQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED;
+                    bufferBarrier.dstQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED;
+                    bufferBarrier.buffer=resources[barrier.resource].buffer;
+                    bufferBarrier.offset=0;
+                    bufferBarrier.size=VK_WHOLE_SIZE;
+                    bufferBarrier.srcAccessMask=barrier.srcAccess;
+                    bufferBarrier.dstAccessMask=barrier.dstAccess;
+                }
+                bufferBarrierScratch.push_back(bufferBarrier);
+            }
+
+            vkCmdPipelineBarrier(commandBuffer,batch.srcStage,batch.dstStage,0,0,nullptr,
+                                 static_cast<uint32_t>(bufferBarrierScratch.size()),bufferBarrierScratch.data(),
+                                 static_cast<uint32_t>(imageBarrierScratch.size()),imageBarrierScratch.data());
+        }
+
+        //Render passes are cached by their attachment description, so recompiling hands out the same handles.
+        void createRenderPasses(){
+
+            for(size_t p=0;p<passes.size();++p){
+                Pass& pass=passes[p];
+                pass.renderPass=VK_NULL_HANDLE;
+                pass.attachments.clear();
+                pass.clearValues.clear();
+                if(pass.culled || pass.type!=PassType::Graphics){
+                    continue;
+                }
+
+                std::vector<VkAttachmentDescription> attachments;
+                std::vector<VkAttachmentReference> colorReferences;
+                VkAttachmentReference depthReference{VK_ATTACHMENT_UNUSED,VK_IMAGE_LAYOUT_UNDEFINED};
+                std::string key;
+
+                for(const auto& access: pass.accesses){
+                    if(access.usage!=ResourceUsage::ColorAttachment && access.usage!=ResourceUsage::DepthAttachment && access.usage!=ResourceUsage::DepthReadOnly){
+                        continue;
+                    }
+                    const Resource& resource=resources[access.resource];
+                    AccessInfo info=accessInfo(access.usage);
+
+                    //transient contents nobody reads afterwards never have to leave the tile
+                    bool keep=!resource.transient || usedAfter(access.resource,p) || !info.write;
+
+                    VkAttachmentDescription attachment{};
+                    {
+                        attachment.format=resource.format;
+                        attachment.samples=VK_SAMPLE_COUNT_1_BIT;
+                        attachment.loadOp=access.loadOp;
+                        attachment.storeOp=keep ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                        attachment.stencilLoadOp=(resource.aspect & VK_IMAGE_ASPECT_STENCIL_BIT) ? access.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                        attachment.stencilStoreOp=(resource.aspect & VK_IMAGE_ASPECT_STENCIL_BIT) ? attachment.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                        attachment.initialLayout=info.layout; //the graph's barriers transition before the pass begins
+                        attachment.finalLayout=info.layout;
+                    }
+
+                    VkAttachmentReference reference{static_cast<uint32_t>(attachments.size()),info.layout};
+                    if(access.usage==ResourceUsage::ColorAttachment){
+                        colorReferences.push_back(reference);
+                    }
+                    else{
+                        depthReference=reference;
+                    }
+
+                    key+=std::to_string(attachment.format)+","+std::to_string(attachment.loadOp)+","+std::to_string(attachment.storeOp)+","
+                        +std::to_string(info.layout)+";";
+                    attachments.push_back(attachment);
+                    pass.attachments.push_back(access.resource);
+                    pass.clearValues.push_back(access.clearValue);
+                    pass.extent=resource.extent;
+                }
+
+                if(attachments.empty()){
+                    throw std::runtime_error("graphics pass "+pass.name+" has no attachments!");
+                }
+
+                auto cached=renderPassCache.find(key);
+                if(cached!=renderPassCache.end()){
+                    pass.renderPass=cached->second;
+                    continue;
+                }
+
+                VkSubpassDescription subpass{};
+                {
+                    subpass.pipelineBindPoint=VK_PIPELINE_BIND_POINT_GRAPHICS;
+                    subpass.colorAttachmentCount=static_cast<uint32_t>(colorReferences.size());
+                    subpass.pColorAttachments=colorReferences.data();
+                    subpass.pDepthStencilAttachment=depthReference.attachment!=VK_ATTACHMENT_UNUSED ? &depthReference : nullptr;
+                }
+
+                VkRenderPassCreateInfo renderPassCreateInfo{};
+                {
+                    renderPassCreateInfo.sType=VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+                    renderPassCreateInfo.attachmentCount=static_cast<uint32_t>(attachments.size());
+                    renderPassCreateInfo.pAttachments=attachments.data();
+                    renderPassCreateInfo.subpassCount=1;
+                    renderPassCreateInfo.pSubpasses=&subpass;
+                    renderPassCreateInfo.dependencyCount=0; //all synchronization comes from the graph's barriers
+                }
+
+                VkRenderPass renderPass;
+                if(vkCreateRenderPass(device,&renderPassCreateInfo,nullptr,&renderPass)!=VK_SUCCESS){
+                    throw std::runtime_error("failed to create render pass!");
+                }
+                renderPassCache[key]=vkutil::UniqueRenderPass(*deletionQueue,renderPass);
+                pass.renderPass=renderPass;
+            }
+        }
+
+        bool usedAfter(RenderResource resource, size_t pass) const{
+            for(size_t p=pass+1;p<passes.size();++p){
+                if(passes[p].culled){
+                    continue;
+                }
+                for(const auto& access: passes[p].accesses){
+                    if(access.resource==resource){
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        VkFramebuffer getFramebuffer(Pass& pass){
+
+            framebufferViews.clear();
+            for(RenderResource r: pass.attachments){
+                framebufferViews.push_back(resources[r].view);
+            }
+
+            auto key=std::make_pair(pass.renderPass,framebufferViews);
+            auto cached=framebuffers.find(key);
+            if(cached!=framebuffers.end()){
+                return cached->second;
+            }
+
+            VkFramebufferCreateInfo frameBufferInfo{};
+            {
+                frameBufferInfo.sType=VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+                frameBufferInfo.renderPass=pass.renderPass;
+                frameBufferInfo.attachmentCount=static_cast<uint32_t>(framebufferViews.size());
+                frameBufferInfo.pAttachments=framebufferViews.data();
+                frameBufferInfo.width=pass.extent.width;
+                frameBufferInfo.height=pass.extent.height;
+                frameBufferInfo.layers=1;
+            }
+            VkFramebuffer frameBuffer;
+            if(vkCreateFramebuffer(device,&frameBufferInfo,nullptr,&frameBuffer)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create frame buffer!");
+            }
+            framebuffers[key]=vkutil::UniqueFramebuffer(*deletionQueue,frameBuffer);
+            return frameBuffer;
+        }
+
+        VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+        VkDevice device=VK_NULL_HANDLE;
+        DeletionQueue* deletionQueue=nullptr;
+        GpuProfiler* profiler=nullptr;
+
+        std::vector<Pass> passes;
+        std::vector<Resource> resources;
+        std::vector<MemoryBlock> memoryBlocks;
+        BarrierBatch finalBarriers;
+        std::map<std::string,vkutil::UniqueRenderPass> renderPassCache;
+        std::map<std::pair<VkRenderPass,std::vector<VkImageView>>,vkutil::UniqueFramebuffer> framebuffers; //one per set of imported views, e.g. per swapchain image
+        bool compiled=false;
+        Stats stats;
+
+        std::vector<VkImageMemoryBarrier> imageBarrierScratch;
+        std::vector<VkBufferMemoryBarrier> bufferBarrierScratch;
+        std::vector<VkImageView> framebufferViews;
+};
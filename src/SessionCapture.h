@@ -0,0 +1,278 @@
+#pragma once
+
+#include<vulkan/vulkan.h>
+
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<iterator>
+#include<map>
+#include<optional>
+#include<stdexcept>
+#include<string>
+#include<vector>
+
+//Session files record what a run fed into each frame so the exact same workload can be replayed later, e.g. by
+//another build. Layout (native little endian):
+//  header   "VKSS", u32 version, u32 width, u32 height
+//  chunks   u8 type followed by its payload, the file ends with an End chunk
+//    Upload u16 name length, name, u64 size, u64 FNV-1a hash of the uploaded bytes
+//    Resize u32 width, u32 height, the swapchain extent from the next frame on
+//    Frame  f32 scene time, u8 flags, [u16 size, uniform bytes], [u16 count, draws]
+//Uniforms and draws are only stored when they differ from the previous frame (flags bit 0 and 1), which keeps a
+//session of a static camera at a few bytes per frame.
+struct SessionDraw{
+    uint32_t indexCount=0;
+    uint32_t instanceCount=0;
+    uint32_t firstIndex=0;
+    int32_t vertexOffset=0;
+    uint32_t firstInstance=0;
+
+    bool operator==(const SessionDraw& other) const{
+        return std::memcmp(this,&other,sizeof(SessionDraw))==0;
+    }
+};
+
+struct SessionFrame{
+    float time=0.0f;
+    std::vector<uint8_t> uniforms;
+    std::vector<SessionDraw> draws;
+    std::optional<VkExtent2D> resize;
+};
+
+struct SessionUpload{
+    uint64_t size=0;
+    uint64_t hash=0;
+};
+
+namespace session{
+
+    constexpr char magic[4]={'V','K','S','S'};
+    constexpr uint32_t version=1;
+
+    enum class Chunk: uint8_t{
+        Upload=1,
+        Resize=2,
+        Frame=3,
+        End=0xFF
+    };
+
+    constexpr uint8_t hasUniforms=1;
+    constexpr uint8_t hasDraws=2;
+
+    inline uint64_t hash(const void* data, size_t size){
+        uint64_t value=14695981039346656037ull;
+        const uint8_t* bytes=static_cast<const uint8_t*>(data);
+        for(size_t i=0;i<size;++i){
+            value=(value^bytes[i])*1099511628211ull;
+        }
+        return value;
+    }
+}
+
+class SessionWriter{
+
+    public:
+        void open(const std::string& path, VkExtent2D extent){
+            file.open(path,std::ios::binary);
+            if(!file.is_open()){
+                throw std::runtime_error("failed to open session file "+path+"!");
+            }
+            file.write(session::magic,sizeof(session::magic));
+            put(session::version);
+            put(extent.width);
+            put(extent.height);
+            this->extent=extent;
+            this->path=path;
+        }
+
+        bool isOpen() const{ return file.is_open(); }
+
+        void recordUpload(const std::string& name, const void* data, uint64_t size){
+            if(!isOpen()){
+                return;
+            }
+            put(session::Chunk::Upload);
+            put(static_cast<uint16_t>(name.size()));
+            file.write(name.data(),static_cast<std::streamsize>(name.size()));
+            put(size);
+            put(session::hash(data,static_cast<size_t>(size)));
+        }
+
+        void writeFrame(const SessionFrame& frame, VkExtent2D frameExtent){
+            if(!isOpen()){
+                return;
+            }
+            if(frameExtent.width!=extent.width || frameExtent.height!=extent.height){
+                put(session::Chunk::Resize);
+                put(frameExtent.width);
+                put(frameExtent.height);
+                extent=frameExtent;
+            }
+
+            uint8_t flags=0;
+            if(frames==0 || frame.uniforms!=previous.uniforms){
+                flags|=session::hasUniforms;
+            }
+            if(frames==0 || frame.draws!=previous.draws){
+                flags|=session::hasDraws;
+            }
+
+            put(session::Chunk::Frame);
+            put(frame.time);
+            put(flags);
+            if(flags & session::hasUniforms){
+                put(static_cast<uint16_t>(frame.uniforms.size()));
+                file.write(reinterpret_cast<const char*>(frame.uniforms.data()),static_cast<std::streamsize>(frame.uniforms.size()));
+            }
+            if(flags & session::hasDraws){
+                put(static_cast<uint16_t>(frame.draws.size()));
+                file.write(reinterpret_cast<const char*>(frame.draws.data()),static_cast<std::streamsize>(frame.draws.size()*sizeof(SessionDraw)));
+            }
+            previous=frame;
+            ++frames;
+        }
+
+        void close(){
+            if(!isOpen()){
+                return;
+            }
+            put(session::Chunk::End);
+            std::cout<<"session of "<<frames<<" frames recorded to "<<path<<" ("<<file.tellp()<<" bytes)"<<std::endl;
+            file.close();
+        }
+
+    private:
+        template<typename T>
+        void put(const T& value){
+            file.write(reinterpret_cast<const char*>(&value),sizeof(T));
+        }
+
+        std::ofstream file;
+        std::string path;
+        VkExtent2D extent{};
+        SessionFrame previous;
+        uint64_t frames=0;
+};
+
+//Loads a whole session up front so replaying never touches the disk.
+class SessionReader{
+
+    public:
+        void open(const std::string& path){
+            std::ifstream file(path,std::ios::binary);
+            if(!file.is_open()){
+                throw std::runtime_error("failed to open session file "+path+"!");
+            }
+            data.assign(std::istreambuf_iterator<char>(file),std::istreambuf_iterator<char>());
+            cursor=0;
+
+            char fileMagic[4];
+            get(fileMagic,sizeof(fileMagic));
+            if(std::memcmp(fileMagic,session::magic,sizeof(fileMagic))!=0 || get<uint32_t>()!=session::version){
+                throw std::runtime_error("not a session file or wrong version: "+path+"!");
+            }
+            extent.width=get<uint32_t>();
+            extent.height=get<uint32_t>();
+
+            SessionFrame current;
+            std::optional<VkExtent2D> resize;
+            while(true){
+                session::Chunk chunk=get<session::Chunk>();
+                if(chunk==session::Chunk::End){
+                    break;
+                }
+                switch(chunk){
+                    case session::Chunk::Upload:{
+                        std::string name(get<uint16_t>(),'\0');
+                        get(name.data(),name.size());
+                        SessionUpload upload;
+                        upload.size=get<uint64_t>();
+                        upload.hash=get<uint64_t>();
+                        uploads[name]=upload;
+                        break;
+                    }
+                    case session::Chunk::Resize:{
+                        VkExtent2D newExtent;
+                        newExtent.width=get<uint32_t>();
+                        newExtent.height=get<uint32_t>();
+                        resize=newExtent;
+                        break;
+                    }
+                    case session::Chunk::Frame:{
+                        current.time=get<float>();
+                        uint8_t flags=get<uint8_t>();
+                        if(flags & session::hasUniforms){
+                            current.uniforms.resize(get<uint16_t>());
+                            get(current.uniforms.data(),current.uniforms.size());
+                        }
+                        if(flags & session::hasDraws){
+                            current.draws.resize(get<uint16_t>());
+                            get(current.draws.data(),current.draws.size()*sizeof(SessionDraw));
+                        }
+                        current.resize=resize;
+                        resize.reset();
+                        frames.push_back(current);
+                        break;
+                    }
+                    default:
+                        throw std::runtime_error("corrupt session file "+path+"!");
+                }
+            }
+            data.clear();
+            data.shrink_to_fit();
+            if(frames.empty()){
+                throw std::runtime_error("session file "+path+" has no frames!");
+            }
+            next=0;
+            std::cout<<"replaying "<<frames.size()<<" frames from "<<path<<std::endl;
+        }
+
+        bool isOpen() const{ return !frames.empty(); }
+        VkExtent2D getExtent() const{ return extent; }
+        size_t frameCount() const{ return frames.size(); }
+
+        //Frame to replay next, nullptr once the session is over. It stays current until advance() so a frame whose
+        //swapchain image could not be acquired is replayed again.
+        const SessionFrame* peek() const{
+            return next<frames.size() ? &frames[next] : nullptr;
+        }
+
+        void advance(){
+            ++next;
+        }
+
+        //Warns when this build uploads something else than the recorded one, the workloads would not be comparable.
+        void checkUpload(const std::string& name, const void* bytes, uint64_t size) const{
+            auto upload=uploads.find(name);
+            if(upload==uploads.end()){
+                std::cerr<<"warning: "<<name<<" was not uploaded in the recorded session"<<std::endl;
+            }
+            else if(upload->second.size!=size || upload->second.hash!=session::hash(bytes,static_cast<size_t>(size))){
+                std::cerr<<"warning: "<<name<<" differs from the recorded session"<<std::endl;
+            }
+        }
+
+    private:
+        void get(void* destination, size_t size){
+            if(cursor+size>data.size()){
+                throw std::runtime_error("session file ends early!");
+            }
+            std::memcpy(destination,data.data()+cursor,size);
+            cursor+=size;
+        }
+
+        template<typename T>
+        T get(){
+            T value;
+            get(&value,sizeof(T));
+            return value;
+        }
+
+        std::vector<uint8_t> data;
+        size_t cursor=0;
+        VkExtent2D extent{};
+        std::map<std::string,SessionUpload> uploads;
+        std::vector<SessionFrame> frames;
+        size_t next=0;
+};
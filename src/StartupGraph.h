@@ -0,0 +1,270 @@
+#pragma once
+
+#include "Profiler.h"
+
+#include<algorithm>
+#include<chrono>
+#include<condition_variable>
+#include<deque>
+#include<exception>
+#include<fstream>
+#include<functional>
+#include<iomanip>
+#include<iostream>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
+
+//Runs the startup steps as a dependency graph. Main steps (window, Vulkan objects, anything that touches the deletion
+//queue or allocates memory) run on the calling thread in the order they were added as soon as what they depend on is
+//done. Worker steps (file reads, CPU preprocessing, pipeline compiles) run on a small pool next to them. Every step is
+//timed, the report names the critical path and the time from start() to the first presented frame.
+class StartupGraph{
+
+    public:
+        enum class Thread{
+            Main,
+            Worker
+        };
+
+        using TaskHandle=uint32_t;
+
+        //The clock of the report starts here, before anything of the startup ran.
+        void start(){
+            startTime=std::chrono::steady_clock::now();
+            started=true;
+        }
+
+        //Dependencies have to be added before the steps that wait for them, so the graph can not have cycles.
+        TaskHandle add(const std::string& name, std::function<void()> run, std::vector<TaskHandle> dependencies={}, Thread thread=Thread::Main){
+            tasks.push_back({name,std::move(run),std::move(dependencies),thread});
+            return static_cast<TaskHandle>(tasks.size()-1);
+        }
+
+        //Runs every step. When one throws no further step is started and the first exception is rethrown once the
+        //running ones are done.
+        void run(uint32_t workerCount){
+
+            if(!started){
+                start();
+            }
+            workerCount=std::max(workerCount,1u);
+            this->workerCount=workerCount;
+            runStart=now();
+
+            std::vector<size_t> waitingOn(tasks.size());
+            std::vector<std::vector<TaskHandle>> dependents(tasks.size());
+            std::deque<TaskHandle> mainReady, workerReady;
+            for(TaskHandle i=0; i<tasks.size(); ++i){
+                waitingOn[i]=tasks[i].dependencies.size();
+                for(TaskHandle dependency: tasks[i].dependencies){
+                    dependents[dependency].push_back(i);
+                }
+                if(waitingOn[i]==0){
+                    (tasks[i].thread==Thread::Main ? mainReady : workerReady).push_back(i);
+                }
+            }
+
+            std::mutex mutex;
+            std::condition_variable changed;
+            uint32_t running=0;
+            std::exception_ptr error;
+            auto idle=[&]{ return running==0 && mainReady.empty() && workerReady.empty(); };
+
+            auto execute=[&](TaskHandle handle, uint32_t thread, std::unique_lock<std::mutex>& lock){
+                ++running;
+                lock.unlock();
+                Task& task=tasks[handle];
+                task.threadIndex=thread;
+                task.start=now();
+                std::exception_ptr taskError;
+                try{
+                    task.run();
+                }catch(...){
+                    taskError=std::current_exception();
+                }
+                task.end=now();
+                lock.lock();
+                --running;
+                if(taskError && !error){
+                    error=taskError;
+                    mainReady.clear();
+                    workerReady.clear();
+                }
+                if(!error){
+                    for(TaskHandle dependent: dependents[handle]){
+                        if(--waitingOn[dependent]==0){
+                            (tasks[dependent].thread==Thread::Main ? mainReady : workerReady).push_back(dependent);
+                        }
+                    }
+                }
+                changed.notify_all();
+            };
+
+            std::vector<std::thread> workers;
+            for(uint32_t i=0; i<workerCount; ++i){
+                workers.emplace_back([&,i]{
+                    Profiler::get().setThreadName("startup worker "+std::to_string(i));
+                    std::unique_lock<std::mutex> lock(mutex);
+                    while(true){
+                        changed.wait(lock,[&]{ return !workerReady.empty() || idle(); });
+                        if(workerReady.empty()){
+                            return;
+                        }
+                        TaskHandle handle=workerReady.front();
+                        workerReady.pop_front();
+                        execute(handle,i+1,lock);
+                    }
+                });
+            }
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while(true){
+                    changed.wait(lock,[&]{ return !mainReady.empty() || idle(); });
+                    if(mainReady.empty()){
+                        break;
+                    }
+                    TaskHandle handle=mainReady.front();
+                    mainReady.pop_front();
+                    execute(handle,0,lock);
+                }
+            }
+            for(std::thread& worker: workers){
+                worker.join();
+            }
+            runEnd=now();
+            if(error){
+                std::rethrow_exception(error);
+            }
+        }
+
+        void markFirstFrame(){
+            if(firstFrame<0.0){
+                firstFrame=now();
+            }
+        }
+
+        bool hasFirstFrame() const{
+            return firstFrame>=0.0;
+        }
+
+        //Steps from the first one to the one that finished last, each time following the dependency that finished
+        //last. Shortening anything else does not make the startup faster.
+        std::vector<TaskHandle> criticalPath() const{
+            std::vector<TaskHandle> path;
+            if(tasks.empty()){
+                return path;
+            }
+            TaskHandle current=0;
+            for(TaskHandle i=1; i<tasks.size(); ++i){
+                if(tasks[i].end>tasks[current].end){
+                    current=i;
+                }
+            }
+            path.push_back(current);
+            while(!tasks[current].dependencies.empty()){
+                const std::vector<TaskHandle>& dependencies=tasks[current].dependencies;
+                current=*std::max_element(dependencies.begin(),dependencies.end(),[this](TaskHandle a, TaskHandle b){
+                    return tasks[a].end<tasks[b].end;
+                });
+                path.push_back(current);
+            }
+            std::reverse(path.begin(),path.end());
+            return path;
+        }
+
+        void printReport() const{
+            std::vector<TaskHandle> path=criticalPath();
+            std::vector<bool> critical(tasks.size(),false);
+            for(TaskHandle handle: path){
+                critical[handle]=true;
+            }
+            double work=0.0;
+            for(const Task& task: tasks){
+                work+=task.end-task.start;
+            }
+
+            std::cout<<std::fixed<<std::setprecision(1);
+            std::cout<<"startup: ";
+            if(hasFirstFrame()){
+                std::cout<<firstFrame<<" ms to the first frame, ";
+            }
+            std::cout<<runEnd-runStart<<" ms in the startup graph, "<<work<<" ms of work on the main thread and "
+                     <<workerCount<<" workers"<<std::endl;
+            std::cout<<"  start    time   thread  step (* on the critical path)"<<std::endl;
+            std::vector<TaskHandle> order(tasks.size());
+            for(TaskHandle i=0; i<order.size(); ++i){
+                order[i]=i;
+            }
+            std::sort(order.begin(),order.end(),[this](TaskHandle a, TaskHandle b){ return tasks[a].start<tasks[b].start; });
+            for(TaskHandle handle: order){
+                const Task& task=tasks[handle];
+                std::cout<<std::setw(7)<<task.start<<" "<<std::setw(7)<<task.end-task.start<<"   "
+                         <<(task.threadIndex==0 ? "main  " : "worker")<<"  "<<(critical[handle] ? "* " : "  ")<<task.name;
+                double ready=readyTime(handle);
+                if(critical[handle] && task.start-ready>0.5){
+                    std::cout<<" (waited "<<task.start-ready<<" ms for its thread)";
+                }
+                std::cout<<std::endl;
+            }
+            if(hasFirstFrame()){
+                std::cout<<std::setw(7)<<runEnd<<" "<<std::setw(7)<<firstFrame-runEnd<<"   main    * first frame"<<std::endl;
+            }
+            std::cout<<std::defaultfloat<<std::setprecision(6);
+        }
+
+        void writeReport(const std::string& path) const{
+            std::ofstream file(path);
+            if(!file.is_open()){
+                std::cerr<<"failed to write "<<path<<std::endl;
+                return;
+            }
+            std::vector<TaskHandle> critical=criticalPath();
+            file<<"{\n  \"timeToFirstFrameMs\": "<<(hasFirstFrame() ? firstFrame : -1.0)<<",\n  \"graphMs\": "<<runEnd-runStart
+                <<",\n  \"workers\": "<<workerCount<<",\n  \"criticalPath\": [";
+            for(size_t i=0;i<critical.size();++i){
+                file<<(i>0 ? ", " : "")<<"\""<<tasks[critical[i]].name<<"\"";
+            }
+            file<<"],\n  \"steps\": [\n";
+            for(size_t i=0;i<tasks.size();++i){
+                const Task& task=tasks[i];
+                file<<"    {\"name\": \""<<task.name<<"\", \"thread\": "<<task.threadIndex<<", \"startMs\": "<<task.start
+                    <<", \"durationMs\": "<<task.end-task.start<<"}"<<(i+1<tasks.size() ? ",\n" : "\n");
+            }
+            file<<"  ]\n}\n";
+            std::cout<<"startup report written to "<<path<<std::endl;
+        }
+
+    private:
+        struct Task{
+            std::string name;
+            std::function<void()> run;
+            std::vector<TaskHandle> dependencies;
+            Thread thread;
+            uint32_t threadIndex=0; //0 is the main thread
+            double start=0.0;       //milliseconds since start()
+            double end=0.0;
+        };
+
+        double now() const{
+            return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-startTime).count();
+        }
+
+        //When the last dependency of a step was done, or when the graph started.
+        double readyTime(TaskHandle handle) const{
+            double ready=runStart;
+            for(TaskHandle dependency: tasks[handle].dependencies){
+                ready=std::max(ready,tasks[dependency].end);
+            }
+            return ready;
+        }
+
+        std::vector<Task> tasks;
+        std::chrono::steady_clock::time_point startTime;
+        bool started=false;
+        uint32_t workerCount=0;
+        double runStart=0.0;
+        double runEnd=0.0;
+        double firstFrame=-1.0;
+};
@@ -0,0 +1,780 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "Ktx2.h"
+#include "Profiler.h"
+#include "VulkanUtils.h"
+
+#include<algorithm>
+#include<cmath>
+#include<condition_variable>
+#include<deque>
+#include<iostream>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+using TextureHandle=uint32_t;
+
+//Streams textures in from KTX2 files. File reads run on a worker thread, GPU uploads are fenced and polled
+//once per frame so the render loop never waits on them. Every texture first gets its small mip tail,
+//finer mips are streamed in while the texture keeps being used and dropped again once it has not been
+//seen for a while and the device memory budget is exceeded.
+class TextureStreamer{
+
+    public:
+        void init(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, uint32_t queueFamily, DeletionQueue& deletionQueue, const VkPhysicalDeviceFeatures& enabledFeatures){
+
+            this->physicalDevice=physicalDevice;
+            this->device=device;
+            this->queue=queue;
+            this->deletionQueue=&deletionQueue;
+
+            VkCommandPoolCreateInfo poolInfo{};
+            {
+                poolInfo.sType=VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags=VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                poolInfo.queueFamilyIndex=queueFamily;
+            }
+            if(vkCreateCommandPool(device,&poolInfo,nullptr,&commandPool)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create texture upload command pool!");
+            }
+
+            createSampler(enabledFeatures);
+            createPlaceholder();
+
+            //by default allow a quarter of the largest device local heap for textures
+            VkPhysicalDeviceMemoryProperties memProperties;
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice,&memProperties);
+            for(uint32_t i=0;i<memProperties.memoryHeapCount;++i){
+                if(memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT){
+                    budget=std::max(budget,memProperties.memoryHeaps[i].size/4);
+                }
+            }
+
+            worker=std::thread(&TextureStreamer::workerLoop,this);
+        }
+
+        void cleanup(){
+
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                stopWorker=true;
+            }
+            jobCondition.notify_all();
+            if(worker.joinable()){
+                worker.join();
+            }
+
+            for(auto& job: gpuJobs){
+                vkWaitForFences(device,1,&job.fence,VK_TRUE,UINT64_MAX);
+                destroyJob(job);
+            }
+
+            //the images go to the deletion queue
+            gpuJobs.clear();
+            textures.clear();
+            placeholder.view.reset();
+            placeholder.image.reset();
+            placeholder.memory.reset();
+
+            vkDestroySampler(device,sampler,nullptr);
+            vkDestroyCommandPool(device,commandPool,nullptr);
+        }
+
+        TextureHandle load(const std::string& path){
+
+            Texture texture{};
+            texture.path=path;
+            textures.push_back(std::move(texture));
+
+            TextureHandle handle=static_cast<TextureHandle>(textures.size()-1);
+            requestRead({handle,path,nullptr,0,0,true});
+            return handle;
+        }
+
+        //Tightly packed pixels of the base level, the mip chain is generated on the GPU.
+        TextureHandle loadPixels(VkFormat format, uint32_t width, uint32_t height, std::vector<char> pixels){
+
+            Texture texture{};
+            texture.source=std::make_shared<const Ktx2File>(Ktx2File::fromPixels(format,width,height,std::move(pixels)));
+            textures.push_back(std::move(texture));
+
+            TextureHandle handle=static_cast<TextureHandle>(textures.size()-1);
+            requestRead({handle,"",textures[handle].source,0,0,true});
+            return handle;
+        }
+
+        //Has to be called once per frame after the frame's fence was waited on.
+        void update(uint64_t frame){
+
+            currentFrame=frame;
+
+            collectFinishedJobs();
+            processReadResults();
+            enforceBudget();
+            requestUpgrades();
+        }
+
+        void markUsed(TextureHandle handle){
+            textures[handle].lastUsedFrame=currentFrame;
+        }
+
+        //View that currently represents the texture, the placeholder while nothing is resident yet.
+        VkImageView getView(TextureHandle handle) const{
+            const Texture& texture=textures[handle];
+            return texture.view!=VK_NULL_HANDLE ? texture.view : placeholder.view;
+        }
+
+        VkSampler getSampler() const{ return sampler; }
+
+        //Incremented every time any view returned by getView() changes, descriptor sets compare against it.
+        uint64_t getVersion() const{ return version; }
+
+        void setBudget(VkDeviceSize bytes){ budget=bytes; }
+        VkDeviceSize getBudget() const{ return budget; }
+        VkDeviceSize getResidentBytes() const{ return residentBytes; }
+        size_t getPendingUploads() const{ return gpuJobs.size(); }
+        //Reads on the worker or uploads not finished yet, the next update() may change a view.
+        bool isStreaming() const{ return readsInFlight>0 || !gpuJobs.empty(); }
+
+    private:
+        struct Texture{
+            enum class State{Loading,Resident,Failed};
+
+            std::string path;
+            std::shared_ptr<const Ktx2File> source;
+            State state=State::Loading;
+
+            uint32_t mipLevels=0;   //levels of the full GPU chain
+            uint32_t residentBase=0; //finest resident level
+            bool generateMips=false;
+
+            //declared so the view is released before the image and the image before its memory
+            vkutil::UniqueDeviceMemory memory;
+            vkutil::UniqueImage image;
+            vkutil::UniqueImageView view;
+            VkDeviceSize memorySize=0;
+
+            uint64_t lastUsedFrame=0;
+            bool busy=false;
+        };
+
+        struct ReadJob{
+            TextureHandle handle;
+            std::string path;
+            std::shared_ptr<const Ktx2File> source; //null until the header was parsed by the worker
+            uint32_t firstLevel;
+            uint32_t levelCount;
+            bool tail; //let the worker decide which levels form the mip tail
+        };
+
+        struct ReadResult{
+            TextureHandle handle;
+            std::shared_ptr<const Ktx2File> source;
+            uint32_t firstLevel=0;
+            uint32_t levelCount=0;
+            std::vector<char> data;
+            std::vector<VkDeviceSize> levelOffsets;
+            bool failed=false;
+            std::string error;
+        };
+
+        struct GpuJob{
+            TextureHandle handle;
+            uint32_t baseLevel;
+            //declared so the view is released before the image and the image before its memory
+            vkutil::UniqueDeviceMemory memory;
+            vkutil::UniqueImage image;
+            vkutil::UniqueImageView view;
+            VkDeviceSize memorySize=0;
+            VkBuffer stagingBuffer=VK_NULL_HANDLE;
+            VkDeviceMemory stagingMemory=VK_NULL_HANDLE;
+            VkCommandBuffer commandBuffer=VK_NULL_HANDLE;
+            VkFence fence=VK_NULL_HANDLE;
+        };
+
+        void workerLoop(){
+
+            Profiler::get().setThreadName("texture streamer");
+            while(true){
+                ReadJob job;
+                {
+                    std::unique_lock<std::mutex> lock(jobMutex);
+                    jobCondition.wait(lock,[this]{ return stopWorker || !tailJobs.empty() || !upgradeJobs.empty(); });
+                    if(stopWorker){
+                        return;
+                    }
+                    //mip tails of every texture go before any finer level
+                    std::deque<ReadJob>& jobs= tailJobs.empty() ? upgradeJobs : tailJobs;
+                    job=std::move(jobs.front());
+                    jobs.pop_front();
+                }
+
+                PROFILE_ZONE("read texture");
+                ReadResult result{};
+                result.handle=job.handle;
+                try{
+                    result.source= job.source ? job.source : std::make_shared<const Ktx2File>(Ktx2File::open(job.path));
+                    const Ktx2File& source=*result.source;
+
+                    result.firstLevel=job.firstLevel;
+                    result.levelCount=job.levelCount;
+                    if(job.tail){
+                        //generated chains only ever have the base level on disk
+                        result.firstLevel=0;
+                        while(!source.generateMips && result.firstLevel+1<source.levels.size() &&
+                              std::max(source.levels[result.firstLevel].width,source.levels[result.firstLevel].height)>tailSize){
+                            ++result.firstLevel;
+                        }
+                        result.levelCount=static_cast<uint32_t>(source.levels.size())-result.firstLevel;
+                    }
+
+                    VkDeviceSize totalSize=0;
+                    for(uint32_t i=0;i<result.levelCount;++i){
+                        result.levelOffsets.push_back(totalSize);
+                        //keep every level 16 byte aligned, bufferOffset has to be a multiple of the texel block size
+                        totalSize+=(source.levels[result.firstLevel+i].byteLength+15)&~VkDeviceSize(15);
+                    }
+                    result.data.resize(totalSize);
+                    for(uint32_t i=0;i<result.levelCount;++i){
+                        source.readLevel(result.firstLevel+i,result.data.data()+result.levelOffsets[i]);
+                    }
+                }catch(const std::exception& e){
+                    result.failed=true;
+                    result.error=e.what();
+                }
+
+                std::lock_guard<std::mutex> lock(resultMutex);
+                readResults.push_back(std::move(result));
+            }
+        }
+
+        void requestRead(ReadJob job){
+            ++readsInFlight;
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                if(job.tail){
+                    tailJobs.push_back(std::move(job));
+                }else{
+                    upgradeJobs.push_back(std::move(job));
+                }
+            }
+            jobCondition.notify_one();
+        }
+
+        void processReadResults(){
+
+            std::deque<ReadResult> results;
+            {
+                std::lock_guard<std::mutex> lock(resultMutex);
+                results.swap(readResults);
+            }
+
+            for(auto& result: results){
+                --readsInFlight;
+                Texture& texture=textures[result.handle];
+                if(texture.state!=Texture::State::Loading){
+                    --upgradesRequested;
+                }
+
+                if(result.failed){
+                    std::cerr<<"Texture "<<texture.path<<": "<<result.error<<std::endl;
+                    //a failed upgrade keeps whatever is resident
+                    if(texture.state==Texture::State::Loading){
+                        texture.state=Texture::State::Failed;
+                    }
+                    texture.busy=false;
+                    continue;
+                }
+
+                if(texture.state==Texture::State::Loading){
+                    texture.source=result.source;
+                    if(!isFormatSupported(result.source->format,result.source->generateMips,texture.generateMips)){
+                        std::cerr<<"Texture "<<texture.path<<": format "<<result.source->format<<" is not supported by the device"<<std::endl;
+                        texture.state=Texture::State::Failed;
+                        continue;
+                    }
+                    if(texture.generateMips){
+                        texture.mipLevels=static_cast<uint32_t>(std::floor(std::log2(std::max(result.source->width,result.source->height))))+1;
+                    }else{
+                        texture.mipLevels=static_cast<uint32_t>(result.source->levels.size());
+                    }
+                    texture.residentBase=texture.mipLevels;
+                }
+
+                submitJob(result.handle,result.firstLevel,&result);
+            }
+        }
+
+        bool isFormatSupported(VkFormat format, bool wantsGeneratedMips, bool& generateMips){
+
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice,format,&properties);
+
+            if(!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)){
+                return false;
+            }
+
+            //without linear blits the texture is used with its base level only
+            const VkFormatFeatureFlags blitFeatures=VK_FORMAT_FEATURE_BLIT_SRC_BIT|VK_FORMAT_FEATURE_BLIT_DST_BIT|VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+            generateMips= wantsGeneratedMips && !Ktx2File::isBlockCompressed(format) && (properties.optimalTilingFeatures & blitFeatures)==blitFeatures;
+            return true;
+        }
+
+        //Builds an image holding the levels [baseLevel, mipLevels) of the texture. The levels in data are uploaded
+        //from the staging buffer, everything else that is still resident gets copied over from the current image.
+        void submitJob(TextureHandle handle, uint32_t baseLevel, const ReadResult* data){
+
+            Texture& texture=textures[handle];
+            const Ktx2File& source=*texture.source;
+
+            GpuJob job{};
+            job.handle=handle;
+            job.baseLevel=baseLevel;
+
+            uint32_t levelCount=texture.mipLevels-baseLevel;
+            uint32_t width=std::max(source.width>>baseLevel,1u);
+            uint32_t height=std::max(source.height>>baseLevel,1u);
+
+            VkImageCreateInfo imageInfo{};
+            {
+                imageInfo.sType=VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType=VK_IMAGE_TYPE_2D;
+                imageInfo.format=source.format;
+                imageInfo.extent={width,height,1};
+                imageInfo.mipLevels=levelCount;
+                imageInfo.arrayLayers=1;
+                imageInfo.samples=VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.tiling=VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.usage=VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_SAMPLED_BIT;
+                imageInfo.sharingMode=VK_SHARING_MODE_EXCLUSIVE;
+                imageInfo.initialLayout=VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+            VkImage image;
+            VkDeviceMemory memory;
+            job.memorySize=vkutil::createImage(physicalDevice,device,imageInfo,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Textures,image,memory);
+            job.memory=vkutil::UniqueDeviceMemory(*deletionQueue,memory);
+            job.image=vkutil::UniqueImage(*deletionQueue,image);
+            job.view=vkutil::UniqueImageView(*deletionQueue,vkutil::createImageView(device,image,source.format,VK_IMAGE_ASPECT_COLOR_BIT,levelCount));
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            {
+                allocInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.level=VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandPool=commandPool;
+                allocInfo.commandBufferCount=1;
+            }
+            vkAllocateCommandBuffers(device,&allocInfo,&job.commandBuffer);
+
+            VkCommandBufferBeginInfo beginInfo{};
+            {
+                beginInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            }
+            vkBeginCommandBuffer(job.commandBuffer,&beginInfo);
+
+            vkutil::imageBarrier(job.commandBuffer,job.image,VK_IMAGE_ASPECT_COLOR_BIT,0,levelCount,
+                VK_IMAGE_LAYOUT_UNDEFINED,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,0,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_WRITE_BIT);
+
+            bool regenerate=false;
+            uint32_t uploadedEnd=baseLevel; //levels in [baseLevel, uploadedEnd) come from the staging buffer
+
+            if(data){
+                vkutil::createBuffer(physicalDevice,device,data->data.size(),VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,MemoryCategory::Staging,job.stagingBuffer,job.stagingMemory);
+
+                void* mapped;
+                vkMapMemory(device,job.stagingMemory,0,data->data.size(),0,&mapped);
+                memcpy(mapped,data->data.data(),data->data.size());
+                vkUnmapMemory(device,job.stagingMemory);
+
+                std::vector<VkBufferImageCopy> regions(data->levelCount);
+                for(uint32_t i=0;i<data->levelCount;++i){
+                    const Ktx2File::Level& level=source.levels[data->firstLevel+i];
+                    regions[i].bufferOffset=data->levelOffsets[i];
+                    regions[i].bufferRowLength=0;
+                    regions[i].bufferImageHeight=0;
+                    regions[i].imageSubresource.aspectMask=VK_IMAGE_ASPECT_COLOR_BIT;
+                    regions[i].imageSubresource.mipLevel=data->firstLevel+i-baseLevel;
+                    regions[i].imageSubresource.baseArrayLayer=0;
+                    regions[i].imageSubresource.layerCount=1;
+                    regions[i].imageOffset={0,0,0};
+                    regions[i].imageExtent={level.width,level.height,1};
+                }
+                vkCmdCopyBufferToImage(job.commandBuffer,job.stagingBuffer,job.image,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    static_cast<uint32_t>(regions.size()),regions.data());
+
+                uploadedEnd=data->firstLevel+data->levelCount;
+                regenerate=texture.generateMips;
+            }
+
+            //reuse whatever is already resident instead of reading it from disk again
+            if(!regenerate && texture.image!=VK_NULL_HANDLE){
+                uint32_t firstCopied=std::max(uploadedEnd,texture.residentBase);
+                if(firstCopied<texture.mipLevels){
+                    uint32_t oldLevelCount=texture.mipLevels-texture.residentBase;
+
+                    vkutil::imageBarrier(job.commandBuffer,texture.image,VK_IMAGE_ASPECT_COLOR_BIT,0,oldLevelCount,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_READ_BIT);
+
+                    std::vector<VkImageCopy> regions;
+                    for(uint32_t level=firstCopied;level<texture.mipLevels;++level){
+                        VkImageCopy region{};
+                        region.srcSubresource={VK_IMAGE_ASPECT_COLOR_BIT,level-texture.residentBase,0,1};
+                        region.dstSubresource={VK_IMAGE_ASPECT_COLOR_BIT,level-baseLevel,0,1};
+                        region.extent={std::max(source.width>>level,1u),std::max(source.height>>level,1u),1};
+                        regions.push_back(region);
+                    }
+                    vkCmdCopyImage(job.commandBuffer,texture.image,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        job.image,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,static_cast<uint32_t>(regions.size()),regions.data());
+
+                    //frames recorded before the swap still sample the old image
+                    vkutil::imageBarrier(job.commandBuffer,texture.image,VK_IMAGE_ASPECT_COLOR_BIT,0,oldLevelCount,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,0,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT);
+                }
+            }
+
+            if(regenerate){
+                generateMipChain(job.commandBuffer,job.image,width,height,levelCount);
+            }else{
+                vkutil::imageBarrier(job.commandBuffer,job.image,VK_IMAGE_ASPECT_COLOR_BIT,0,levelCount,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT);
+            }
+
+            vkEndCommandBuffer(job.commandBuffer);
+
+            VkFenceCreateInfo fenceInfo{};
+            {
+                fenceInfo.sType=VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            }
+            vkCreateFence(device,&fenceInfo,nullptr,&job.fence);
+
+            VkSubmitInfo submitInfo{};
+            {
+                submitInfo.sType=VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount=1;
+                submitInfo.pCommandBuffers=&job.commandBuffer;
+            }
+            if(vkQueueSubmit(queue,1,&submitInfo,job.fence)!=VK_SUCCESS){
+                throw std::runtime_error("failed to submit texture upload!");
+            }
+
+            texture.busy=true;
+            pendingBytes+=job.memorySize;
+            gpuJobs.push_back(std::move(job));
+        }
+
+        //Every level is filled from the previous one with a linear blit, the chain ends up in shader read layout.
+        void generateMipChain(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t levelCount){
+
+            int32_t mipWidth=static_cast<int32_t>(width);
+            int32_t mipHeight=static_cast<int32_t>(height);
+
+            for(uint32_t i=1;i<levelCount;++i){
+                vkutil::imageBarrier(commandBuffer,image,VK_IMAGE_ASPECT_COLOR_BIT,i-1,1,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_READ_BIT);
+
+                VkImageBlit blit{};
+                {
+                    blit.srcOffsets[0]={0,0,0};
+                    blit.srcOffsets[1]={mipWidth,mipHeight,1};
+                    blit.srcSubresource={VK_IMAGE_ASPECT_COLOR_BIT,i-1,0,1};
+                    blit.dstOffsets[0]={0,0,0};
+                    blit.dstOffsets[1]={mipWidth>1 ? mipWidth/2 : 1, mipHeight>1 ? mipHeight/2 : 1, 1};
+                    blit.dstSubresource={VK_IMAGE_ASPECT_COLOR_BIT,i,0,1};
+                }
+                vkCmdBlitImage(commandBuffer,image,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,image,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,1,&blit,VK_FILTER_LINEAR);
+
+                vkutil::imageBarrier(commandBuffer,image,VK_IMAGE_ASPECT_COLOR_BIT,i-1,1,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT);
+
+                if(mipWidth>1) mipWidth/=2;
+                if(mipHeight>1) mipHeight/=2;
+            }
+
+            vkutil::imageBarrier(commandBuffer,image,VK_IMAGE_ASPECT_COLOR_BIT,levelCount-1,1,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT);
+        }
+
+        void collectFinishedJobs(){
+
+            for(size_t i=0;i<gpuJobs.size();){
+                GpuJob& job=gpuJobs[i];
+                if(vkGetFenceStatus(device,job.fence)!=VK_SUCCESS){
+                    ++i;
+                    continue;
+                }
+
+                Texture& texture=textures[job.handle];
+                if(texture.image!=VK_NULL_HANDLE){
+                    residentBytes-=texture.memorySize;
+                }
+
+                //replacing the handles queues the old image for deletion, frames in flight may still reference its view
+                texture.view=std::move(job.view);
+                texture.image=std::move(job.image);
+                texture.memory=std::move(job.memory);
+                texture.memorySize=job.memorySize;
+                texture.residentBase=job.baseLevel;
+                texture.state=Texture::State::Resident;
+                texture.busy=false;
+
+                residentBytes+=job.memorySize;
+                pendingBytes-=job.memorySize;
+                ++version;
+
+                destroyJob(job);
+                gpuJobs[i]=std::move(gpuJobs.back());
+                gpuJobs.pop_back();
+            }
+        }
+
+        void destroyJob(GpuJob& job){
+            vkDestroyFence(device,job.fence,nullptr);
+            vkFreeCommandBuffers(device,commandPool,1,&job.commandBuffer);
+            if(job.stagingBuffer!=VK_NULL_HANDLE){
+                vkDestroyBuffer(device,job.stagingBuffer,nullptr);
+                vkutil::freeMemory(device,job.stagingMemory,nullptr);
+            }
+        }
+
+        uint32_t tailBase(const Texture& texture) const{
+            uint32_t base=0;
+            while(base+1<texture.mipLevels && std::max(texture.source->width>>base,texture.source->height>>base)>tailSize){
+                ++base;
+            }
+            return base;
+        }
+
+        //Rough size of the image holding [baseLevel, mipLevels), used to decide whether an upgrade fits the budget.
+        VkDeviceSize estimateSize(const Texture& texture, uint32_t baseLevel) const{
+            const Ktx2File& source=*texture.source;
+            if(texture.generateMips){
+                VkDeviceSize base=source.levels[0].byteLength>>(2*baseLevel);
+                return base+base/3;
+            }
+            VkDeviceSize size=0;
+            for(uint32_t level=baseLevel;level<texture.mipLevels;++level){
+                size+=source.levels[level].byteLength;
+            }
+            return size;
+        }
+
+        //Drops the finest resident mip of the least recently used textures while the budget is exceeded.
+        void enforceBudget(){
+
+            if(residentBytes+pendingBytes<=budget){
+                return;
+            }
+
+            std::vector<TextureHandle> candidates;
+            for(TextureHandle handle=0;handle<textures.size();++handle){
+                const Texture& texture=textures[handle];
+                if(texture.state==Texture::State::Resident && !texture.busy && texture.residentBase<tailBase(texture)){
+                    candidates.push_back(handle);
+                }
+            }
+            std::sort(candidates.begin(),candidates.end(),[this](TextureHandle a, TextureHandle b){
+                return textures[a].lastUsedFrame<textures[b].lastUsedFrame;
+            });
+
+            //least recently used first, so textures that have not been seen for a while give up their mips before visible ones
+            VkDeviceSize projected=residentBytes+pendingBytes;
+            for(TextureHandle handle: candidates){
+                if(projected<=budget || gpuJobs.size()>=maxJobsInFlight){
+                    break;
+                }
+                Texture& texture=textures[handle];
+                VkDeviceSize saved=estimateSize(texture,texture.residentBase)-estimateSize(texture,texture.residentBase+1);
+                submitJob(handle,texture.residentBase+1,nullptr);
+                projected-=std::min(projected,saved);
+            }
+        }
+
+        //Streams in one finer level for the most recently used textures that still fit into the budget.
+        void requestUpgrades(){
+
+            std::vector<TextureHandle> candidates;
+            for(TextureHandle handle=0;handle<textures.size();++handle){
+                const Texture& texture=textures[handle];
+                if(texture.state==Texture::State::Resident && !texture.busy && texture.residentBase>0 &&
+                   texture.lastUsedFrame+evictAfterFrames>currentFrame){
+                    candidates.push_back(handle);
+                }
+            }
+            std::sort(candidates.begin(),candidates.end(),[this](TextureHandle a, TextureHandle b){
+                return textures[a].lastUsedFrame>textures[b].lastUsedFrame;
+            });
+
+            VkDeviceSize projected=residentBytes+pendingBytes;
+            for(TextureHandle handle: candidates){
+                if(gpuJobs.size()+upgradesRequested>=maxJobsInFlight){
+                    break;
+                }
+                Texture& texture=textures[handle];
+
+                //generated chains are rebuilt from the base level in one go
+                uint32_t target= texture.generateMips ? 0 : texture.residentBase-1;
+                VkDeviceSize growth=estimateSize(texture,target)-estimateSize(texture,texture.residentBase);
+                if(projected+growth>budget){
+                    continue;
+                }
+                projected+=growth;
+
+                texture.busy=true;
+                ++upgradesRequested;
+                requestRead({handle,texture.path,texture.source,target,1,false});
+            }
+        }
+
+        void createSampler(const VkPhysicalDeviceFeatures& enabledFeatures){
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice,&properties);
+
+            VkSamplerCreateInfo samplerInfo{};
+            {
+                samplerInfo.sType=VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+                samplerInfo.magFilter=VK_FILTER_LINEAR;
+                samplerInfo.minFilter=VK_FILTER_LINEAR;
+                samplerInfo.mipmapMode=VK_SAMPLER_MIPMAP_MODE_LINEAR;
+                samplerInfo.addressModeU=VK_SAMPLER_ADDRESS_MODE_REPEAT;
+                samplerInfo.addressModeV=VK_SAMPLER_ADDRESS_MODE_REPEAT;
+                samplerInfo.addressModeW=VK_SAMPLER_ADDRESS_MODE_REPEAT;
+                samplerInfo.anisotropyEnable=enabledFeatures.samplerAnisotropy;
+                samplerInfo.maxAnisotropy= enabledFeatures.samplerAnisotropy ? properties.limits.maxSamplerAnisotropy : 1.0f;
+                samplerInfo.borderColor=VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+                samplerInfo.unnormalizedCoordinates=VK_FALSE;
+                samplerInfo.compareEnable=VK_FALSE;
+                samplerInfo.minLod=0.0f;
+                samplerInfo.maxLod=VK_LOD_CLAMP_NONE; //the image view limits sampling to the resident levels
+            }
+            if(vkCreateSampler(device,&samplerInfo,nullptr,&sampler)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create texture sampler!");
+            }
+        }
+
+        //1x1 white texture bound while the real one is still streaming in. Only uploaded once at init, so waiting is fine.
+        void createPlaceholder(){
+
+            VkImageCreateInfo imageInfo{};
+            {
+                imageInfo.sType=VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType=VK_IMAGE_TYPE_2D;
+                imageInfo.format=VK_FORMAT_R8G8B8A8_UNORM;
+                imageInfo.extent={1,1,1};
+                imageInfo.mipLevels=1;
+                imageInfo.arrayLayers=1;
+                imageInfo.samples=VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.tiling=VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.usage=VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_SAMPLED_BIT;
+                imageInfo.sharingMode=VK_SHARING_MODE_EXCLUSIVE;
+                imageInfo.initialLayout=VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+            VkImage image;
+            VkDeviceMemory memory;
+            vkutil::createImage(physicalDevice,device,imageInfo,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Textures,image,memory);
+            placeholder.memory=vkutil::UniqueDeviceMemory(*deletionQueue,memory);
+            placeholder.image=vkutil::UniqueImage(*deletionQueue,image);
+            placeholder.view=vkutil::UniqueImageView(*deletionQueue,vkutil::createImageView(device,image,VK_FORMAT_R8G8B8A8_UNORM,VK_IMAGE_ASPECT_COLOR_BIT,1));
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            {
+                allocInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.level=VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandPool=commandPool;
+                allocInfo.commandBufferCount=1;
+            }
+            VkCommandBuffer commandBuffer;
+            vkAllocateCommandBuffers(device,&allocInfo,&commandBuffer);
+
+            VkCommandBufferBeginInfo beginInfo{};
+            {
+                beginInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            }
+            vkBeginCommandBuffer(commandBuffer,&beginInfo);
+
+                vkutil::imageBarrier(commandBuffer,placeholder.image,VK_IMAGE_ASPECT_COLOR_BIT,0,1,
+                    VK_IMAGE_LAYOUT_UNDEFINED,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,0,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_WRITE_BIT);
+
+                VkClearColorValue white={{1.0f,1.0f,1.0f,1.0f}};
+                VkImageSubresourceRange range={VK_IMAGE_ASPECT_COLOR_BIT,0,1,0,1};
+                vkCmdClearColorImage(commandBuffer,placeholder.image,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,&white,1,&range);
+
+                vkutil::imageBarrier(commandBuffer,placeholder.image,VK_IMAGE_ASPECT_COLOR_BIT,0,1,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT);
+
+            vkEndCommandBuffer(commandBuffer);
+
+            VkSubmitInfo submitInfo{};
+            {
+                submitInfo.sType=VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount=1;
+                submitInfo.pCommandBuffers=&commandBuffer;
+            }
+            vkQueueSubmit(queue,1,&submitInfo,VK_NULL_HANDLE);
+            vkQueueWaitIdle(queue);
+
+            vkFreeCommandBuffers(device,commandPool,1,&commandBuffer);
+        }
+
+        VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+        VkDevice device=VK_NULL_HANDLE;
+        VkQueue queue=VK_NULL_HANDLE;
+        VkCommandPool commandPool=VK_NULL_HANDLE;
+        VkSampler sampler=VK_NULL_HANDLE;
+        DeletionQueue* deletionQueue=nullptr;
+
+        struct{
+            vkutil::UniqueDeviceMemory memory;
+            vkutil::UniqueImage image;
+            vkutil::UniqueImageView view;
+        } placeholder;
+
+        std::vector<Texture> textures;
+        std::vector<GpuJob> gpuJobs;
+
+        //worker thread
+        std::thread worker;
+        std::mutex jobMutex;
+        std::condition_variable jobCondition;
+        std::deque<ReadJob> tailJobs;
+        std::deque<ReadJob> upgradeJobs;
+        bool stopWorker=false;
+
+        std::mutex resultMutex;
+        std::deque<ReadResult> readResults;
+
+        uint64_t currentFrame=0;
+        uint64_t version=0;
+        VkDeviceSize budget=0;
+        VkDeviceSize residentBytes=0;
+        VkDeviceSize pendingBytes=0;
+        size_t upgradesRequested=0;
+        size_t readsInFlight=0;
+
+        const uint32_t tailSize=64;           //levels up to this size are loaded first
+        const uint64_t evictAfterFrames=240;  //textures not drawn for this many frames stop streaming in finer mips
+        const size_t maxJobsInFlight=4;       //keeps the per frame upload cost bounded
+};
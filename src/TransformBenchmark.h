@@ -0,0 +1,86 @@
+#pragma once
+
+#include "TransformHierarchy.h"
+
+#include<chrono>
+#include<cmath>
+#include<iomanip>
+#include<iostream>
+#include<random>
+#include<thread>
+#include<vector>
+
+//Measures TransformHierarchy::update() on a synthetic scene, run with --bench-transforms.
+//Reports nodes updated per millisecond for a full update and for sparse updates at every thread count.
+inline int runTransformBenchmark(){
+
+    const uint32_t rootCount=16;
+    const uint32_t branching=4;
+    const uint32_t depth=8;
+    const int iterations=50;
+
+    const float translation[3]={1.0f,0.0f,0.0f};
+    const float rotation[4]={0.0f,0.0f,0.0f,1.0f};
+    const float scale[3]={0.9f,0.9f,0.9f};
+
+    TransformHierarchy hierarchy;
+    std::vector<NodeHandle> roots,level,nextLevel;
+    for(uint32_t r=0;r<rootCount;++r){
+        roots.push_back(hierarchy.addNode(TransformHierarchy::noParent,translation,rotation,scale));
+        level.assign(1,roots.back());
+        for(uint32_t d=1;d<depth;++d){
+            nextLevel.clear();
+            for(NodeHandle parent: level){
+                for(uint32_t c=0;c<branching;++c){
+                    nextLevel.push_back(hierarchy.addNode(parent,translation,rotation,scale));
+                }
+            }
+            level.swap(nextLevel);
+        }
+    }
+    hierarchy.update();
+
+    const NodeHandle nodeCount=static_cast<NodeHandle>(hierarchy.size());
+    std::cout<<"transform hierarchy benchmark: "<<nodeCount<<" nodes, "<<rootCount<<" roots, depth "<<depth<<std::endl;
+    std::cout<<std::setw(8)<<"threads"<<std::setw(22)<<"full (nodes/ms)"<<std::setw(24)<<"1% dirty (nodes/ms)"<<std::endl;
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<NodeHandle> pickNode(0,nodeCount-1);
+
+    auto measure=[&](bool full){
+        size_t updated=0;
+        double milliseconds=0.0;
+        for(int i=0;i<iterations;++i){
+            float angle=0.01f*static_cast<float>(i);
+            if(full){
+                //every root is dirty, so the whole hierarchy is recomputed
+                for(NodeHandle root: roots){
+                    hierarchy.setRotation(root,0.0f,0.0f,std::sin(angle),std::cos(angle));
+                }
+            }
+            else{
+                for(NodeHandle n=0;n<nodeCount/100;++n){
+                    hierarchy.setRotation(pickNode(random),0.0f,0.0f,std::sin(angle),std::cos(angle));
+                }
+            }
+
+            auto start=std::chrono::high_resolution_clock::now();
+            updated+=hierarchy.update();
+            auto end=std::chrono::high_resolution_clock::now();
+            milliseconds+=std::chrono::duration<double,std::milli>(end-start).count();
+        }
+        return milliseconds>0.0 ? static_cast<double>(updated)/milliseconds : 0.0;
+    };
+
+    uint32_t maxThreads=std::max(std::thread::hardware_concurrency(),1u);
+    for(uint32_t threads=1;;threads=std::min(threads*2,maxThreads)){
+        hierarchy.setThreadCount(threads);
+        double full=measure(true);
+        double sparse=measure(false);
+        std::cout<<std::setw(8)<<threads<<std::setw(22)<<std::fixed<<std::setprecision(0)<<full<<std::setw(24)<<sparse<<std::endl;
+        if(threads==maxThreads){
+            break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,464 @@
+#pragma once
+
+#include "Profiler.h"
+
+#include<algorithm>
+#include<atomic>
+#include<condition_variable>
+#include<cstdint>
+#include<cstring>
+#include<mutex>
+#include<stdexcept>
+#include<thread>
+#include<vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=1)
+    #include<xmmintrin.h>
+    #define TRANSFORM_HIERARCHY_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include<arm_neon.h>
+    #define TRANSFORM_HIERARCHY_NEON
+#endif
+
+using NodeHandle=uint32_t;
+
+//Column major 4x4 matrix with the same memory layout as glm::mat4, world matrices can be copied straight into buffers.
+struct alignas(16) TransformMatrix{
+    float m[16];
+};
+
+//Scene graph transforms for a large number of nodes. Local translation/rotation/scale are stored as separate arrays
+//and the nodes are kept in depth first order, so a parent always comes before its children and every subtree is
+//one contiguous range. Only the subtrees below nodes that changed since the last update() are recomputed,
+//large updates are split into subtrees that are handed to worker threads.
+class TransformHierarchy{
+
+    public:
+        static constexpr NodeHandle noParent=~0u;
+        //below this many dirty nodes waking the workers costs more than it saves
+        static constexpr size_t parallelThreshold=8192;
+
+        TransformHierarchy()=default;
+        TransformHierarchy(const TransformHierarchy&)=delete;
+        TransformHierarchy& operator=(const TransformHierarchy&)=delete;
+
+        ~TransformHierarchy(){
+            stopWorkers();
+        }
+
+        //The calling thread takes part in the update, so count-1 workers are started.
+        void setThreadCount(uint32_t count){
+
+            stopWorkers();
+
+            threadCount=std::max(count,1u);
+            stop=false;
+            for(uint32_t i=1;i<threadCount;++i){
+                workers.emplace_back(&TransformHierarchy::workerLoop,this);
+            }
+        }
+
+        uint32_t getThreadCount() const{ return threadCount; }
+
+        void reserve(size_t count){
+
+            parents.reserve(count);
+            translationX.reserve(count); translationY.reserve(count); translationZ.reserve(count);
+            rotationX.reserve(count); rotationY.reserve(count); rotationZ.reserve(count); rotationW.reserve(count);
+            scaleX.reserve(count); scaleY.reserve(count); scaleZ.reserve(count);
+            dirty.reserve(count);
+            world.reserve(count);
+            handleToIndex.reserve(count);
+            indexToHandle.reserve(count);
+        }
+
+        //Rotation is a unit quaternion (x,y,z,w). The parent has to exist already.
+        NodeHandle addNode(NodeHandle parent, const float translation[3], const float rotation[4], const float scale[3]){
+
+            if(parent!=noParent && parent>=handleToIndex.size()){
+                throw std::runtime_error("transform parent does not exist!");
+            }
+
+            //appended nodes still come after their parent, the depth first order is restored on the next update
+            parents.push_back(parent==noParent ? noParent : handleToIndex[parent]);
+            translationX.push_back(translation[0]); translationY.push_back(translation[1]); translationZ.push_back(translation[2]);
+            rotationX.push_back(rotation[0]); rotationY.push_back(rotation[1]); rotationZ.push_back(rotation[2]); rotationW.push_back(rotation[3]);
+            scaleX.push_back(scale[0]); scaleY.push_back(scale[1]); scaleZ.push_back(scale[2]);
+            dirty.push_back(0);
+            world.push_back({});
+
+            NodeHandle handle=static_cast<NodeHandle>(handleToIndex.size());
+            handleToIndex.push_back(static_cast<uint32_t>(parents.size()-1));
+            indexToHandle.push_back(handle);
+
+            layoutChanged=true;
+            return handle;
+        }
+
+        void setTranslation(NodeHandle handle, float x, float y, float z){
+            uint32_t i=handleToIndex[handle];
+            translationX[i]=x; translationY[i]=y; translationZ[i]=z;
+            markDirty(i);
+        }
+
+        void setRotation(NodeHandle handle, float x, float y, float z, float w){
+            uint32_t i=handleToIndex[handle];
+            rotationX[i]=x; rotationY[i]=y; rotationZ[i]=z; rotationW[i]=w;
+            markDirty(i);
+        }
+
+        void setScale(NodeHandle handle, float x, float y, float z){
+            uint32_t i=handleToIndex[handle];
+            scaleX[i]=x; scaleY[i]=y; scaleZ[i]=z;
+            markDirty(i);
+        }
+
+        //Recomputes the world matrices of every dirty subtree. Returns the number of nodes that were recomputed.
+        size_t update(){
+
+            PROFILE_ZONE("transform update");
+            if(layoutChanged){
+                rebuildLayout();
+            }
+            if(dirtyNodes.empty()){
+                return 0;
+            }
+
+            //a dirty node inside an already collected subtree is covered by that subtree
+            std::sort(dirtyNodes.begin(),dirtyNodes.end());
+            ranges.clear();
+            size_t nodeCount=0;
+            uint32_t coveredEnd=0;
+            for(uint32_t node: dirtyNodes){
+                dirty[node]=0;
+                if(node<coveredEnd){
+                    continue;
+                }
+                ranges.push_back(node);
+                coveredEnd=subtreeEnd[node];
+                nodeCount+=subtreeEnd[node]-node;
+            }
+            dirtyNodes.clear();
+
+            if(workers.empty() || nodeCount<parallelThreshold){
+                for(uint32_t root: ranges){
+                    updateRange(root,subtreeEnd[root]);
+                }
+                return nodeCount;
+            }
+
+            splitWork(nodeCount);
+            for(uint32_t node: spine){
+                updateNode(node);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(workMutex);
+                nextItem=0;
+                busyWorkers=static_cast<uint32_t>(workers.size());
+                ++generation;
+            }
+            workCondition.notify_all();
+            runItems();
+            {
+                std::unique_lock<std::mutex> lock(workMutex);
+                doneCondition.wait(lock,[this]{ return busyWorkers==0; });
+            }
+            return nodeCount;
+        }
+
+        size_t size() const{ return parents.size(); }
+
+        const TransformMatrix& getWorld(NodeHandle handle) const{ return world[handleToIndex[handle]]; }
+
+        //World matrices in storage order (depth first), ready to be copied into an instance or uniform buffer.
+        const TransformMatrix* getWorldMatrices() const{ return world.data(); }
+
+        //Position of the node in getWorldMatrices(). Only stable until nodes are added.
+        uint32_t getIndex(NodeHandle handle) const{ return handleToIndex[handle]; }
+
+        static void multiply(const TransformMatrix& a, const TransformMatrix& b, TransformMatrix& result){
+
+            #if defined(TRANSFORM_HIERARCHY_SSE)
+                __m128 a0=_mm_load_ps(a.m);
+                __m128 a1=_mm_load_ps(a.m+4);
+                __m128 a2=_mm_load_ps(a.m+8);
+                __m128 a3=_mm_load_ps(a.m+12);
+                for(int column=0;column<4;++column){
+                    const float* b0=b.m+column*4;
+                    __m128 r=_mm_mul_ps(a0,_mm_set1_ps(b0[0]));
+                    r=_mm_add_ps(r,_mm_mul_ps(a1,_mm_set1_ps(b0[1])));
+                    r=_mm_add_ps(r,_mm_mul_ps(a2,_mm_set1_ps(b0[2])));
+                    r=_mm_add_ps(r,_mm_mul_ps(a3,_mm_set1_ps(b0[3])));
+                    _mm_store_ps(result.m+column*4,r);
+                }
+            #elif defined(TRANSFORM_HIERARCHY_NEON)
+                float32x4_t a0=vld1q_f32(a.m);
+                float32x4_t a1=vld1q_f32(a.m+4);
+                float32x4_t a2=vld1q_f32(a.m+8);
+                float32x4_t a3=vld1q_f32(a.m+12);
+                for(int column=0;column<4;++column){
+                    const float* b0=b.m+column*4;
+                    float32x4_t r=vmulq_n_f32(a0,b0[0]);
+                    r=vmlaq_n_f32(r,a1,b0[1]);
+                    r=vmlaq_n_f32(r,a2,b0[2]);
+                    r=vmlaq_n_f32(r,a3,b0[3]);
+                    vst1q_f32(result.m+column*4,r);
+                }
+            #else
+                TransformMatrix r;
+                for(int column=0;column<4;++column){
+                    for(int row=0;row<4;++row){
+                        r.m[column*4+row]=a.m[row]*b.m[column*4]+a.m[4+row]*b.m[column*4+1]+
+                                          a.m[8+row]*b.m[column*4+2]+a.m[12+row]*b.m[column*4+3];
+                    }
+                }
+                result=r;
+            #endif
+        }
+
+    private:
+        void markDirty(uint32_t index){
+            if(!dirty[index]){
+                dirty[index]=1;
+                dirtyNodes.push_back(index);
+            }
+        }
+
+        //Reorders all arrays into depth first order and recomputes the subtree ranges. Marks every root dirty.
+        void rebuildLayout(){
+
+            const uint32_t count=static_cast<uint32_t>(parents.size());
+
+            //children lists, siblings keep their relative order
+            std::vector<uint32_t> firstChild(count,noParent),nextSibling(count,noParent),lastChild(count,noParent);
+            std::vector<uint32_t> roots;
+            for(uint32_t i=0;i<count;++i){
+                uint32_t parent=parents[i];
+                if(parent==noParent){
+                    roots.push_back(i);
+                }
+                else if(firstChild[parent]==noParent){
+                    firstChild[parent]=lastChild[parent]=i;
+                }
+                else{
+                    nextSibling[lastChild[parent]]=i;
+                    lastChild[parent]=i;
+                }
+            }
+
+            std::vector<uint32_t> order;
+            order.reserve(count);
+            std::vector<uint32_t> stack;
+            for(uint32_t root: roots){
+                stack.push_back(root);
+                while(!stack.empty()){
+                    uint32_t node=stack.back();
+                    stack.pop_back();
+                    order.push_back(node);
+
+                    //pushed in reverse so the first child is visited first
+                    size_t mark=stack.size();
+                    for(uint32_t child=firstChild[node];child!=noParent;child=nextSibling[child]){
+                        stack.push_back(child);
+                    }
+                    std::reverse(stack.begin()+mark,stack.end());
+                }
+            }
+
+            std::vector<uint32_t> newIndex(count);
+            for(uint32_t i=0;i<count;++i){
+                newIndex[order[i]]=i;
+            }
+
+            std::vector<uint32_t> newParents(count);
+            for(uint32_t i=0;i<count;++i){
+                uint32_t parent=parents[order[i]];
+                newParents[i]= parent==noParent ? noParent : newIndex[parent];
+            }
+            parents.swap(newParents);
+
+            permute(translationX,order); permute(translationY,order); permute(translationZ,order);
+            permute(rotationX,order); permute(rotationY,order); permute(rotationZ,order); permute(rotationW,order);
+            permute(scaleX,order); permute(scaleY,order); permute(scaleZ,order);
+            permute(indexToHandle,order);
+            for(uint32_t i=0;i<count;++i){
+                handleToIndex[indexToHandle[i]]=i;
+            }
+
+            //walking backwards every child is finished before its parent
+            subtreeEnd.assign(count,0);
+            for(uint32_t i=count;i-->0;){
+                subtreeEnd[i]=std::max(subtreeEnd[i],i+1);
+                if(parents[i]!=noParent){
+                    subtreeEnd[parents[i]]=std::max(subtreeEnd[parents[i]],subtreeEnd[i]);
+                }
+            }
+
+            std::fill(dirty.begin(),dirty.end(),0);
+            dirtyNodes.clear();
+            for(uint32_t i=0;i<count;++i){
+                if(parents[i]==noParent){
+                    markDirty(i);
+                }
+            }
+            layoutChanged=false;
+        }
+
+        template<typename T>
+        static void permute(std::vector<T>& values, const std::vector<uint32_t>& order){
+            std::vector<T> result(values.size());
+            for(size_t i=0;i<order.size();++i){
+                result[i]=values[order[i]];
+            }
+            values.swap(result);
+        }
+
+        //Splits the dirty ranges into work items of roughly nodeCount/(threads*4) nodes. Subtrees that are too large
+        //are opened up, their root goes to the spine which is computed serially before the items.
+        void splitWork(size_t nodeCount){
+
+            const uint32_t targetSize=static_cast<uint32_t>(std::max<size_t>(nodeCount/(threadCount*4),256));
+
+            spine.clear();
+            items.clear();
+            std::vector<uint32_t>& stack=splitStack;
+            for(uint32_t root: ranges){
+                stack.push_back(root);
+                while(!stack.empty()){
+                    uint32_t node=stack.back();
+                    stack.pop_back();
+
+                    uint32_t end=subtreeEnd[node];
+                    if(end-node<=targetSize || end==node+1){
+                        items.push_back(node);
+                        continue;
+                    }
+                    spine.push_back(node);
+                    for(uint32_t child=node+1;child<end;child=subtreeEnd[child]){
+                        stack.push_back(child);
+                    }
+                }
+            }
+
+            //largest subtrees first so the threads finish at about the same time
+            std::sort(items.begin(),items.end(),[this](uint32_t a, uint32_t b){
+                return subtreeEnd[a]-a>subtreeEnd[b]-b;
+            });
+        }
+
+        void runItems(){
+            size_t item;
+            while((item=nextItem.fetch_add(1))<items.size()){
+                uint32_t root=items[item];
+                updateRange(root,subtreeEnd[root]);
+            }
+        }
+
+        void workerLoop(){
+
+            Profiler::get().setThreadName("transform worker");
+            uint64_t seenGeneration=0;
+            while(true){
+                {
+                    std::unique_lock<std::mutex> lock(workMutex);
+                    workCondition.wait(lock,[&]{ return stop || generation!=seenGeneration; });
+                    if(stop){
+                        return;
+                    }
+                    seenGeneration=generation;
+                }
+
+                {
+                    PROFILE_ZONE("transform items");
+                    runItems();
+                }
+
+                std::lock_guard<std::mutex> lock(workMutex);
+                if(--busyWorkers==0){
+                    doneCondition.notify_one();
+                }
+            }
+        }
+
+        void stopWorkers(){
+            {
+                std::lock_guard<std::mutex> lock(workMutex);
+                stop=true;
+            }
+            workCondition.notify_all();
+            for(auto& worker: workers){
+                worker.join();
+            }
+            workers.clear();
+        }
+
+        void updateRange(uint32_t begin, uint32_t end){
+            for(uint32_t i=begin;i<end;++i){
+                updateNode(i);
+            }
+        }
+
+        void updateNode(uint32_t i){
+
+            //local = translation * rotation * scale
+            float x=rotationX[i], y=rotationY[i], z=rotationZ[i], w=rotationW[i];
+            float sx=scaleX[i], sy=scaleY[i], sz=scaleZ[i];
+
+            TransformMatrix local;
+            local.m[0]=(1.0f-2.0f*(y*y+z*z))*sx;
+            local.m[1]=(2.0f*(x*y+w*z))*sx;
+            local.m[2]=(2.0f*(x*z-w*y))*sx;
+            local.m[3]=0.0f;
+            local.m[4]=(2.0f*(x*y-w*z))*sy;
+            local.m[5]=(1.0f-2.0f*(x*x+z*z))*sy;
+            local.m[6]=(2.0f*(y*z+w*x))*sy;
+            local.m[7]=0.0f;
+            local.m[8]=(2.0f*(x*z+w*y))*sz;
+            local.m[9]=(2.0f*(y*z-w*x))*sz;
+            local.m[10]=(1.0f-2.0f*(x*x+y*y))*sz;
+            local.m[11]=0.0f;
+            local.m[12]=translationX[i];
+            local.m[13]=translationY[i];
+            local.m[14]=translationZ[i];
+            local.m[15]=1.0f;
+
+            uint32_t parent=parents[i];
+            if(parent==noParent){
+                world[i]=local;
+            }
+            else{
+                multiply(world[parent],local,world[i]);
+            }
+        }
+
+        //local transforms, one array per component
+        std::vector<uint32_t> parents; //storage index of the parent, always smaller than the node's own index
+        std::vector<float> translationX,translationY,translationZ;
+        std::vector<float> rotationX,rotationY,rotationZ,rotationW;
+        std::vector<float> scaleX,scaleY,scaleZ;
+        std::vector<uint8_t> dirty;
+        std::vector<TransformMatrix> world;
+
+        std::vector<uint32_t> subtreeEnd; //one past the last node of the subtree starting at the index
+        std::vector<uint32_t> handleToIndex;
+        std::vector<uint32_t> indexToHandle;
+        bool layoutChanged=false;
+
+        std::vector<uint32_t> dirtyNodes;
+        std::vector<uint32_t> ranges; //roots of the subtrees recomputed by the current update
+        std::vector<uint32_t> spine;
+        std::vector<uint32_t> items;
+        std::vector<uint32_t> splitStack;
+
+        //worker threads
+        uint32_t threadCount=1;
+        std::vector<std::thread> workers;
+        std::mutex workMutex;
+        std::condition_variable workCondition;
+        std::condition_variable doneCondition;
+        std::atomic<size_t> nextItem{0};
+        uint32_t busyWorkers=0;
+        uint64_t generation=0;
+        bool stop=false;
+};
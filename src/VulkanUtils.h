@@ -0,0 +1,134 @@
+#pragma once
+
+#include "MemoryTracker.h"
+
+#include<vulkan/vulkan.h>
+
+#include<stdexcept>
+#include<vector>
+
+//Small helpers shared by the subsystems that live outside of HelloTriangleApplication.
+namespace vkutil{
+
+    //This function will find the memory type that is suitable for the resource corresponding to the properties and type filter
+    inline uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties){
+
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice,&memProperties);
+
+        for(uint32_t i=0; i<memProperties.memoryTypeCount; i++){
+            if(typeFilter & (1<<i) && (memProperties.memoryTypes[i].propertyFlags & properties)== properties){
+                return i;
+            }
+        }
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    //sharedFamilies: queue families that use the buffer at the same time without ownership transfers, exclusive unless
+    //there are two or more.
+    inline void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category, VkBuffer& buffer, VkDeviceMemory& bufferMemory,
+                             const std::vector<uint32_t>& sharedFamilies={}){
+
+        VkBufferCreateInfo bufferInfo{};
+        {
+            bufferInfo.sType=VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size=size;
+            bufferInfo.usage=usage;
+            bufferInfo.sharingMode=VK_SHARING_MODE_EXCLUSIVE;
+            if(sharedFamilies.size()>=2){
+                bufferInfo.sharingMode=VK_SHARING_MODE_CONCURRENT;
+                bufferInfo.queueFamilyIndexCount=static_cast<uint32_t>(sharedFamilies.size());
+                bufferInfo.pQueueFamilyIndices=sharedFamilies.data();
+            }
+        }
+        if(vkCreateBuffer(device,&bufferInfo,nullptr,&buffer)!=VK_SUCCESS){
+            throw std::runtime_error("failed to create buffer!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device,buffer,&memRequirements);
+
+        VkMemoryAllocateInfo allocateInfo{};
+        {
+            allocateInfo.sType=VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocateInfo.allocationSize=memRequirements.size;
+            allocateInfo.memoryTypeIndex=findMemoryType(physicalDevice,memRequirements.memoryTypeBits,properties);
+        }
+        if(allocateMemory(device,allocateInfo,category,bufferMemory)!=VK_SUCCESS){
+            throw std::runtime_error("failed to allocate buffer memory!");
+        }
+
+        vkBindBufferMemory(device,buffer,bufferMemory,0);
+    }
+
+    //Creates the image and binds a dedicated allocation to it. Returns the size of the allocation.
+    inline VkDeviceSize createImage(VkPhysicalDevice physicalDevice, VkDevice device, const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, MemoryCategory category, VkImage& image, VkDeviceMemory& imageMemory){
+
+        if(vkCreateImage(device,&imageInfo,nullptr,&image)!=VK_SUCCESS){
+            throw std::runtime_error("failed to create image!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device,image,&memRequirements);
+
+        VkMemoryAllocateInfo allocateInfo{};
+        {
+            allocateInfo.sType=VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocateInfo.allocationSize=memRequirements.size;
+            allocateInfo.memoryTypeIndex=findMemoryType(physicalDevice,memRequirements.memoryTypeBits,properties);
+        }
+        if(allocateMemory(device,allocateInfo,category,imageMemory)!=VK_SUCCESS){
+            throw std::runtime_error("failed to allocate image memory!");
+        }
+
+        vkBindImageMemory(device,image,imageMemory,0);
+        return memRequirements.size;
+    }
+
+    inline VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectMask, uint32_t mipLevels){
+
+        VkImageViewCreateInfo createInfo{};
+        {
+            createInfo.sType=VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            createInfo.image=image;
+            createInfo.viewType=VK_IMAGE_VIEW_TYPE_2D;
+            createInfo.format=format;
+            createInfo.components={VK_COMPONENT_SWIZZLE_IDENTITY,VK_COMPONENT_SWIZZLE_IDENTITY,VK_COMPONENT_SWIZZLE_IDENTITY,VK_COMPONENT_SWIZZLE_IDENTITY};
+            createInfo.subresourceRange.aspectMask=aspectMask;
+            createInfo.subresourceRange.baseMipLevel=0;
+            createInfo.subresourceRange.levelCount=mipLevels;
+            createInfo.subresourceRange.baseArrayLayer=0;
+            createInfo.subresourceRange.layerCount=1;
+        }
+
+        VkImageView imageView;
+        if(vkCreateImageView(device,&createInfo,nullptr,&imageView)!=VK_SUCCESS){
+            throw std::runtime_error("failed to create image view!");
+        }
+        return imageView;
+    }
+
+    inline void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectMask, uint32_t baseMipLevel, uint32_t levelCount,
+                             VkImageLayout oldLayout, VkImageLayout newLayout,
+                             VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                             VkPipelineStageFlags dstStage, VkAccessFlags dstAccess){
+
+        VkImageMemoryBarrier barrier{};
+        {
+            barrier.sType=VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout=oldLayout;
+            barrier.newLayout=newLayout;
+            barrier.srcQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED;
+            barrier.image=image;
+            barrier.subresourceRange.aspectMask=aspectMask;
+            barrier.subresourceRange.baseMipLevel=baseMipLevel;
+            barrier.subresourceRange.levelCount=levelCount;
+            barrier.subresourceRange.baseArrayLayer=0;
+            barrier.subresourceRange.layerCount=1;
+            barrier.srcAccessMask=srcAccess;
+            barrier.dstAccessMask=dstAccess;
+        }
+        vkCmdPipelineBarrier(commandBuffer,srcStage,dstStage,0,0,nullptr,0,nullptr,1,&barrier);
+    }
+}
@@ -0,0 +1,612 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "Profiler.h"
+#include "VulkanUtils.h"
+
+#include<vulkan/vulkan.h>
+
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<condition_variable>
+#include<cstring>
+#include<functional>
+#include<iostream>
+#include<mutex>
+#include<stdexcept>
+#include<thread>
+#include<unordered_map>
+#include<vector>
+
+//Geometry of one world cell as the chunk source produces it, vertices in world space.
+struct WorldChunkData{
+    std::vector<char> vertices;
+    std::vector<uint16_t> indices;
+};
+
+//Streams a world that does not fit into device memory in cells of a square grid. Every frame the cells within the
+//load radius around the camera are wanted; the ones that are not resident are queued for the worker threads, which
+//produce their geometry through the chunk source (reading and decoding files, or generating it). The queue is
+//reprioritized every frame by distance, with cells ahead of the camera first, and loses the cells that went out of
+//range. Finished chunks are uploaded with fenced copies that are polled once per frame, a few per frame at most, so
+//drawFrame() never waits. The least recently wanted chunks are evicted to stay within the memory budget.
+class WorldStreamer{
+
+    public:
+        using ChunkSource=std::function<WorldChunkData(int32_t x, int32_t y)>;
+
+        struct Settings{
+            int32_t cells=64;             //the world is cells x cells
+            float cellSize=1.0f;          //world units, the grid is centered on the origin
+            float loadRadius=6.0f;        //in world units
+            VkDeviceSize budget=64ull<<20;
+            VkDeviceSize uploadBytesPerFrame=4ull<<20;
+            uint32_t workers=2;
+        };
+
+        struct Stats{
+            uint64_t loaded=0;
+            uint64_t evicted=0;
+            uint64_t cancelled=0;
+            uint64_t overBudgetFrames=0; //frames where the wanted chunks alone exceeded the budget
+            uint64_t blocked=0;          //loaded chunks that did not fit into the budget and were dropped
+            VkDeviceSize peakResident=0;
+            double maxUpdateMs=0.0;
+            double updateMs=0.0;
+            uint64_t updates=0;
+        };
+
+        void init(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, uint32_t queueFamily, DeletionQueue& deletionQueue,
+                  const Settings& settings, ChunkSource source){
+
+            PROFILE_ZONE("WorldStreamer::init");
+
+            this->physicalDevice=physicalDevice;
+            this->device=device;
+            this->queue=queue;
+            this->deletionQueue=&deletionQueue;
+            this->settings=settings;
+            this->source=std::move(source);
+
+            VkCommandPoolCreateInfo poolInfo{};
+            {
+                poolInfo.sType=VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags=VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                poolInfo.queueFamilyIndex=queueFamily;
+            }
+            if(vkCreateCommandPool(device,&poolInfo,nullptr,&commandPool)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create world upload command pool!");
+            }
+
+            for(uint32_t i=0;i<std::max(settings.workers,1u);++i){
+                workers.emplace_back(&WorldStreamer::workerLoop,this);
+            }
+        }
+
+        //Only valid once the device is idle.
+        void cleanup(){
+            if(device==VK_NULL_HANDLE){
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                stopWorkers=true;
+            }
+            jobCondition.notify_all();
+            for(std::thread& worker: workers){
+                worker.join();
+            }
+            workers.clear();
+
+            if(stats.updates>0){
+                std::cout<<"world streaming: "<<stats.loaded<<" chunks loaded, "<<stats.evicted<<" evicted, "<<stats.cancelled
+                         <<" cancelled, peak "<<stats.peakResident/(1024*1024)<<" of "<<settings.budget/(1024*1024)<<" MiB, update "
+                         <<stats.updateMs/stats.updates<<" ms average and "<<stats.maxUpdateMs<<" ms at most";
+                if(stats.overBudgetFrames>0){
+                    std::cout<<", "<<stats.overBudgetFrames<<" frames wanted more than the budget";
+                }
+                if(stats.blocked>0){
+                    std::cout<<", "<<stats.blocked<<" chunks did not fit";
+                }
+                std::cout<<std::endl;
+            }
+
+            for(Upload& upload: uploads){
+                vkWaitForFences(device,1,&upload.fence,VK_TRUE,UINT64_MAX);
+                destroyUpload(upload);
+            }
+            uploads.clear();
+            chunks.clear(); //the buffers go to the deletion queue
+            vkDestroyCommandPool(device,commandPool,nullptr);
+            device=VK_NULL_HANDLE;
+        }
+
+        //Once per frame after the frame's fence was waited on. forward does not need to be normalized.
+        void update(uint64_t frame, const float camera[3], const float forward[3]){
+
+            PROFILE_ZONE("WorldStreamer::update");
+            auto start=std::chrono::high_resolution_clock::now();
+
+            currentFrame=frame;
+            std::copy(camera,camera+3,cameraPosition);
+            float length=std::sqrt(forward[0]*forward[0]+forward[1]*forward[1]);
+            cameraForward[0]= length>0.0f ? forward[0]/length : 0.0f;
+            cameraForward[1]= length>0.0f ? forward[1]/length : 0.0f;
+
+            collectUploads();
+            //marks this frame's wanted chunks first, so making room for uploads never evicts them
+            requestChunks();
+            submitUploads();
+
+            double ms=std::chrono::duration<double,std::milli>(std::chrono::high_resolution_clock::now()-start).count();
+            ++stats.updates;
+            stats.updateMs+=ms;
+            stats.maxUpdateMs=std::max(stats.maxUpdateMs,ms);
+        }
+
+        //Draws every resident chunk with the pipeline, descriptor sets and instance buffer (binding 1) that are bound.
+        //The chunks are in world space, instance has to hold an identity matrix.
+        void draw(VkCommandBuffer commandBuffer, uint32_t instance) const{
+            for(const auto& entry: chunks){
+                const Chunk& chunk=entry.second;
+                if(chunk.state!=Chunk::State::Resident){
+                    continue;
+                }
+                VkBuffer buffer=chunk.buffer;
+                VkDeviceSize offset=0;
+                vkCmdBindVertexBuffers(commandBuffer,0,1,&buffer,&offset);
+                vkCmdBindIndexBuffer(commandBuffer,buffer,chunk.indexOffset,VK_INDEX_TYPE_UINT16);
+                vkCmdDrawIndexed(commandBuffer,chunk.indexCount,1,0,0,instance);
+            }
+        }
+
+        VkDeviceSize getResidentBytes() const{ return residentBytes; }
+        size_t getResidentChunks() const{ return residentChunks; }
+        //Chunks on their way to the GPU: uploads in flight and loaded chunks waiting for their turn.
+        size_t getPendingUploads() const{ return uploads.size()+loaded.size(); }
+
+        //Chunks being generated or uploaded. A job a worker took and has not finished is missed, its result is seen later.
+        //Chunks that did not fit into the budget wait for the wanted set or the resident chunks to change and do not count.
+        bool isStreaming() const{
+            if(!uploads.empty() || !loaded.empty()){
+                return true;
+            }
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                if(!jobs.empty()){
+                    return true;
+                }
+            }
+            std::lock_guard<std::mutex> lock(resultMutex);
+            return !results.empty();
+        }
+        //Changes whenever the set of chunks draw() records changes.
+        uint64_t getResidentVersion() const{ return residentVersion; }
+        Stats getStats() const{ return stats; }
+
+    private:
+        struct Chunk{
+            //Empty: nothing to draw or the source failed. Blocked: did not fit into the budget, its data was dropped and
+            //it is loaded again once the wanted set or the resident chunks changed.
+            enum class State{Queued,Loaded,Uploading,Resident,Empty,Blocked};
+
+            int32_t x=0;
+            int32_t y=0;
+            State state=State::Queued;
+            uint64_t lastWantedFrame=0;
+            uint64_t blockedVersion=0; //budgetVersion when it was blocked
+
+            vkutil::UniqueDeviceMemory memory;
+            vkutil::UniqueBuffer buffer; //vertices, then indices at indexOffset
+            VkDeviceSize size=0;
+            VkDeviceSize indexOffset=0;
+            uint32_t indexCount=0;
+        };
+
+        struct Job{
+            int32_t x;
+            int32_t y;
+            float priority; //smaller loads first
+        };
+
+        struct Result{
+            int32_t x;
+            int32_t y;
+            WorldChunkData data;
+        };
+
+        struct Upload{
+            uint64_t key;
+            vkutil::UniqueDeviceMemory memory;
+            vkutil::UniqueBuffer buffer;
+            VkBuffer stagingBuffer=VK_NULL_HANDLE;
+            VkDeviceMemory stagingMemory=VK_NULL_HANDLE;
+            VkCommandBuffer commandBuffer=VK_NULL_HANDLE;
+            VkFence fence=VK_NULL_HANDLE;
+        };
+
+        static uint64_t makeKey(int32_t x, int32_t y){
+            return (static_cast<uint64_t>(static_cast<uint32_t>(x))<<32) | static_cast<uint32_t>(y);
+        }
+
+        void cellCenter(int32_t x, int32_t y, float& centerX, float& centerY) const{
+            centerX=(x-settings.cells*0.5f+0.5f)*settings.cellSize;
+            centerY=(y-settings.cells*0.5f+0.5f)*settings.cellSize;
+        }
+
+        //Distance to the camera, up to halved for cells straight ahead and up to 1.5 times for the ones behind it.
+        float priority(int32_t x, int32_t y) const{
+            float centerX,centerY;
+            cellCenter(x,y,centerX,centerY);
+            float dx=centerX-cameraPosition[0];
+            float dy=centerY-cameraPosition[1];
+            float distance=std::sqrt(dx*dx+dy*dy);
+            if(distance<=settings.cellSize){
+                return 0.0f;
+            }
+            float alignment=(dx*cameraForward[0]+dy*cameraForward[1])/distance;
+            return distance*(1.0f-0.5f*alignment);
+        }
+
+        void workerLoop(){
+
+            Profiler::get().setThreadName("world streamer");
+            while(true){
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(jobMutex);
+                    jobCondition.wait(lock,[this]{ return stopWorkers || !jobs.empty(); });
+                    if(stopWorkers){
+                        return;
+                    }
+                    auto next=std::min_element(jobs.begin(),jobs.end(),[](const Job& a, const Job& b){ return a.priority<b.priority; });
+                    job=*next;
+                    *next=jobs.back();
+                    jobs.pop_back();
+                }
+
+                PROFILE_ZONE("load world chunk");
+                Result result{job.x,job.y,{}};
+                try{
+                    result.data=source(job.x,job.y);
+                }catch(const std::exception& e){
+                    std::cerr<<"world chunk "<<job.x<<","<<job.y<<": "<<e.what()<<std::endl;
+                }
+
+                std::lock_guard<std::mutex> lock(resultMutex);
+                results.push_back(std::move(result));
+            }
+        }
+
+        //Marks the wanted cells, queues the missing ones in priority order and drops queued cells that are no longer wanted.
+        void requestChunks(){
+
+            int32_t radiusCells=static_cast<int32_t>(std::ceil(settings.loadRadius/settings.cellSize));
+            int32_t cameraX=static_cast<int32_t>(std::floor(cameraPosition[0]/settings.cellSize+settings.cells*0.5f));
+            int32_t cameraY=static_cast<int32_t>(std::floor(cameraPosition[1]/settings.cellSize+settings.cells*0.5f));
+
+            VkDeviceSize wantedBytes=0;
+            std::vector<Job> missing;
+            std::vector<uint64_t> blocked;
+            uint64_t wantedHash=0;
+            for(int32_t y=std::max(cameraY-radiusCells,0);y<=std::min(cameraY+radiusCells,settings.cells-1);++y){
+                for(int32_t x=std::max(cameraX-radiusCells,0);x<=std::min(cameraX+radiusCells,settings.cells-1);++x){
+                    float centerX,centerY;
+                    cellCenter(x,y,centerX,centerY);
+                    float dx=centerX-cameraPosition[0];
+                    float dy=centerY-cameraPosition[1];
+                    if(dx*dx+dy*dy>settings.loadRadius*settings.loadRadius){
+                        continue;
+                    }
+                    uint64_t key=makeKey(x,y);
+                    wantedHash+=(key+1)*0x9E3779B97F4A7C15ull;
+                    auto found=chunks.find(key);
+                    if(found==chunks.end()){
+                        missing.push_back({x,y,priority(x,y)});
+                        continue;
+                    }
+                    found->second.lastWantedFrame=currentFrame;
+                    wantedBytes+=found->second.size;
+                    if(found->second.state==Chunk::State::Blocked){
+                        blocked.push_back(key);
+                    }
+                }
+            }
+            if(wantedBytes>settings.budget){
+                ++stats.overBudgetFrames;
+            }
+
+            //blocked chunks only get another try when something changed that could make room for them
+            if(wantedHash!=lastWantedHash || residentBytes!=lastResidentBytes){
+                lastWantedHash=wantedHash;
+                lastResidentBytes=residentBytes;
+                ++budgetVersion;
+            }
+            //the ones out of range are forgotten like queued ones
+            for(auto entry=chunks.begin();blockedChunks>blocked.size() && entry!=chunks.end();){
+                if(entry->second.state==Chunk::State::Blocked && entry->second.lastWantedFrame!=currentFrame){
+                    entry=chunks.erase(entry);
+                    --blockedChunks;
+                    continue;
+                }
+                ++entry;
+            }
+            for(uint64_t key: blocked){
+                Chunk& chunk=chunks[key];
+                if(chunk.blockedVersion!=budgetVersion){
+                    chunk.state=Chunk::State::Queued;
+                    --blockedChunks;
+                    missing.push_back({chunk.x,chunk.y,priority(chunk.x,chunk.y)});
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(jobMutex);
+            //queued cells that went out of range are forgotten before a worker spends time on them
+            for(size_t i=0;i<jobs.size();){
+                auto found=chunks.find(makeKey(jobs[i].x,jobs[i].y));
+                if(found->second.lastWantedFrame!=currentFrame){
+                    chunks.erase(found);
+                    jobs[i]=jobs.back();
+                    jobs.pop_back();
+                    ++stats.cancelled;
+                    continue;
+                }
+                jobs[i].priority=priority(jobs[i].x,jobs[i].y);
+                ++i;
+            }
+            for(const Job& job: missing){
+                Chunk chunk{};
+                chunk.x=job.x;
+                chunk.y=job.y;
+                chunk.lastWantedFrame=currentFrame;
+                chunks.emplace(makeKey(job.x,job.y),std::move(chunk)); //keeps a retried blocked chunk as it is
+                jobs.push_back(job);
+            }
+            if(!missing.empty()){
+                jobCondition.notify_all();
+            }
+        }
+
+        //Starts uploads of loaded chunks, closest first, within the per frame upload limit. Makes room in the budget
+        //by evicting chunks that were wanted least recently, never ones wanted this frame; chunks that still do not fit
+        //are blocked and their data dropped.
+        void submitUploads(){
+
+            {
+                std::lock_guard<std::mutex> lock(resultMutex);
+                for(Result& result: results){
+                    loaded.push_back(std::move(result));
+                }
+                results.clear();
+            }
+            for(const Result& result: loaded){
+                auto found=chunks.find(makeKey(result.x,result.y));
+                if(found!=chunks.end() && found->second.state==Chunk::State::Queued){
+                    found->second.state=Chunk::State::Loaded;
+                }
+            }
+            std::sort(loaded.begin(),loaded.end(),[this](const Result& a, const Result& b){ return priority(a.x,a.y)<priority(b.x,b.y); });
+
+            VkDeviceSize uploadedBytes=0;
+            for(size_t i=0;i<loaded.size();){
+                Result& result=loaded[i];
+                auto found=chunks.find(makeKey(result.x,result.y));
+                //went out of range while it was loading
+                if(found==chunks.end() || found->second.lastWantedFrame+evictAfterFrames<currentFrame){
+                    if(found!=chunks.end()){
+                        chunks.erase(found);
+                        ++stats.cancelled;
+                    }
+                    loaded.erase(loaded.begin()+i);
+                    continue;
+                }
+                //remembered, so the cell is not requested again
+                if(result.data.indices.empty()){
+                    found->second.state=Chunk::State::Empty;
+                    loaded.erase(loaded.begin()+i);
+                    continue;
+                }
+                VkDeviceSize size=chunkSize(result.data);
+                if(uploadedBytes>0 && uploadedBytes+size>settings.uploadBytesPerFrame){
+                    break; //the rest waits for the next frames
+                }
+                if(residentBytes+pendingBytes+size>settings.budget && !evict(residentBytes+pendingBytes+size-settings.budget)){
+                    found->second.state=Chunk::State::Blocked;
+                    found->second.blockedVersion=budgetVersion;
+                    found->second.size=size; //counts towards the wanted bytes
+                    ++blockedChunks;
+                    ++stats.blocked;
+                    loaded.erase(loaded.begin()+i);
+                    continue;
+                }
+                upload(found->first,found->second,result.data);
+                uploadedBytes+=size;
+                loaded.erase(loaded.begin()+i);
+            }
+        }
+
+        static VkDeviceSize chunkSize(const WorldChunkData& data){
+            VkDeviceSize indexOffset=(data.vertices.size()+3)&~VkDeviceSize(3);
+            return indexOffset+data.indices.size()*sizeof(uint16_t);
+        }
+
+        //Evicts resident chunks not wanted this frame, least recently wanted first, until bytes are freed. Evicts nothing
+        //and returns false when that many bytes cannot be freed.
+        bool evict(VkDeviceSize bytes){
+
+            std::vector<uint64_t> candidates;
+            for(const auto& entry: chunks){
+                if(entry.second.state==Chunk::State::Resident && entry.second.lastWantedFrame<currentFrame){
+                    candidates.push_back(entry.first);
+                }
+            }
+            //nothing is evicted if all of them would not be enough
+            VkDeviceSize available=0;
+            for(uint64_t key: candidates){
+                available+=chunks[key].size;
+            }
+            if(available<bytes){
+                return false;
+            }
+            std::sort(candidates.begin(),candidates.end(),[this](uint64_t a, uint64_t b){
+                return chunks[a].lastWantedFrame<chunks[b].lastWantedFrame;
+            });
+
+            VkDeviceSize freed=0;
+            for(uint64_t key: candidates){
+                if(freed>=bytes){
+                    break;
+                }
+                //releasing the buffer queues it for deletion, frames in flight may still draw it
+                Chunk& chunk=chunks[key];
+                freed+=chunk.size;
+                residentBytes-=chunk.size;
+                --residentChunks;
+                ++residentVersion;
+                chunks.erase(key);
+                ++stats.evicted;
+            }
+            return true;
+        }
+
+        void upload(uint64_t key, Chunk& chunk, const WorldChunkData& data){
+
+            VkDeviceSize indexOffset=(data.vertices.size()+3)&~VkDeviceSize(3);
+            VkDeviceSize size=chunkSize(data);
+
+            Upload job{};
+            job.key=key;
+            vkutil::createBuffer(physicalDevice,device,size,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 MemoryCategory::Staging,job.stagingBuffer,job.stagingMemory);
+            char* mapped;
+            vkMapMemory(device,job.stagingMemory,0,size,0,reinterpret_cast<void**>(&mapped));
+            memcpy(mapped,data.vertices.data(),data.vertices.size());
+            memcpy(mapped+indexOffset,data.indices.data(),data.indices.size()*sizeof(uint16_t));
+            vkUnmapMemory(device,job.stagingMemory);
+
+            VkBuffer buffer;
+            VkDeviceMemory memory;
+            vkutil::createBuffer(physicalDevice,device,size,VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Geometry,buffer,memory);
+            job.memory=vkutil::UniqueDeviceMemory(*deletionQueue,memory);
+            job.buffer=vkutil::UniqueBuffer(*deletionQueue,buffer);
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            {
+                allocInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.level=VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandPool=commandPool;
+                allocInfo.commandBufferCount=1;
+            }
+            if(vkAllocateCommandBuffers(device,&allocInfo,&job.commandBuffer)!=VK_SUCCESS){
+                destroyUpload(job);
+                throw std::runtime_error("failed to allocate world upload command buffer!");
+            }
+
+            VkCommandBufferBeginInfo beginInfo{};
+            {
+                beginInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            }
+            vkBeginCommandBuffer(job.commandBuffer,&beginInfo);
+                VkBufferCopy region{0,0,size};
+                vkCmdCopyBuffer(job.commandBuffer,job.stagingBuffer,job.buffer,1,&region);
+            vkEndCommandBuffer(job.commandBuffer);
+
+            VkFenceCreateInfo fenceInfo{};
+            {
+                fenceInfo.sType=VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            }
+            if(vkCreateFence(device,&fenceInfo,nullptr,&job.fence)!=VK_SUCCESS){
+                destroyUpload(job);
+                throw std::runtime_error("failed to create world upload fence!");
+            }
+
+            //frames submitted after the fence signaled see the copy, the fence is only polled before they are recorded
+            VkSubmitInfo submitInfo{};
+            {
+                submitInfo.sType=VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount=1;
+                submitInfo.pCommandBuffers=&job.commandBuffer;
+            }
+            if(vkQueueSubmit(queue,1,&submitInfo,job.fence)!=VK_SUCCESS){
+                throw std::runtime_error("failed to submit world chunk upload!");
+            }
+
+            chunk.state=Chunk::State::Uploading;
+            chunk.size=size;
+            chunk.indexOffset=indexOffset;
+            chunk.indexCount=static_cast<uint32_t>(data.indices.size());
+            pendingBytes+=size;
+            uploads.push_back(std::move(job));
+        }
+
+        void collectUploads(){
+
+            for(size_t i=0;i<uploads.size();){
+                Upload& job=uploads[i];
+                if(vkGetFenceStatus(device,job.fence)!=VK_SUCCESS){
+                    ++i;
+                    continue;
+                }
+                Chunk& chunk=chunks[job.key];
+                chunk.memory=std::move(job.memory);
+                chunk.buffer=std::move(job.buffer);
+                chunk.state=Chunk::State::Resident;
+                pendingBytes-=chunk.size;
+                residentBytes+=chunk.size;
+                ++residentChunks;
+                ++residentVersion;
+                ++stats.loaded;
+                stats.peakResident=std::max(stats.peakResident,residentBytes);
+
+                destroyUpload(job);
+                uploads[i]=std::move(uploads.back());
+                uploads.pop_back();
+            }
+        }
+
+        void destroyUpload(Upload& job){
+            vkDestroyFence(device,job.fence,nullptr);
+            vkFreeCommandBuffers(device,commandPool,1,&job.commandBuffer);
+            vkDestroyBuffer(device,job.stagingBuffer,nullptr);
+            vkutil::freeMemory(device,job.stagingMemory,nullptr);
+        }
+
+        //a loaded chunk that has not been wanted for this many frames is not uploaded any more
+        static constexpr uint64_t evictAfterFrames=60;
+
+        VkPhysicalDevice physicalDevice=VK_NULL_HANDLE;
+        VkDevice device=VK_NULL_HANDLE;
+        VkQueue queue=VK_NULL_HANDLE;
+        VkCommandPool commandPool=VK_NULL_HANDLE;
+        DeletionQueue* deletionQueue=nullptr;
+        Settings settings;
+        ChunkSource source;
+
+        std::unordered_map<uint64_t,Chunk> chunks;
+        std::vector<Upload> uploads;
+        std::vector<Result> loaded; //produced by the workers, waiting for room in the budget or the upload limit
+        VkDeviceSize residentBytes=0;
+        VkDeviceSize pendingBytes=0;
+        size_t residentChunks=0;
+        uint64_t residentVersion=0;
+        uint64_t budgetVersion=0; //changes with the wanted set and the resident bytes, see requestChunks()
+        size_t blockedChunks=0;
+        uint64_t lastWantedHash=0;
+        VkDeviceSize lastResidentBytes=0;
+
+        uint64_t currentFrame=0;
+        float cameraPosition[3]={0.0f,0.0f,0.0f};
+        float cameraForward[2]={1.0f,0.0f};
+        Stats stats;
+
+        std::vector<std::thread> workers;
+        mutable std::mutex jobMutex;
+        std::condition_variable jobCondition;
+        std::vector<Job> jobs;
+        bool stopWorkers=false;
+        mutable std::mutex resultMutex;
+        std::vector<Result> results;
+};
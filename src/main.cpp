@@ -4,6 +4,32 @@
 #include<glm/glm.hpp>
 #include<glm/gtc/matrix_transform.hpp>
 
+#include "AssetPack.h"
+#include "AsyncCompute.h"
+#include "BatchRenderer.h"
+#include "ClusteredLighting.h"
+#include "CommandBufferCache.h"
+#include "DebugDraw.h"
+#include "DeletionQueue.h"
+#include "DepthPyramid.h"
+#include "DeviceInfo.h"
+#include "DynamicResolution.h"
+#include "FrameLatency.h"
+#include "FrameCapture.h"
+#include "FrameScheduler.h"
+#include "GpuProfiler.h"
+#include "Meshlets.h"
+#include "Particles.h"
+#include "PerfHud.h"
+#include "Profiler.h"
+#include "RenderGraph.h"
+#include "SessionCapture.h"
+#include "StartupGraph.h"
+#include "TextureStreamer.h"
+#include "TransformHierarchy.h"
+#include "TransformBenchmark.h"
+#include "WorldStreamer.h"
+
 #include<chrono>
 
 #include <iostream>
@@ -13,46 +39,226 @@
 #include<vector>
 #include<optional>
 #include<set>
+#include<map>
 #include<limits>
 #include<fstream>
 #include<filesystem>
 #include<array>
+#include<random>
+#include<algorithm>
+
+//set by the build, the fallback is relative to build/<config>
+#ifndef ASSET_DIR
+#define ASSET_DIR "../../assets"
+#endif
 
 class HelloTriangleApplication{
 
     public:
+        //Records a timeline of the run and writes it to path as a Chrome trace on exit.
+        void setTracePath(const std::string& path){
+            tracePath=path;
+        }
+
+        //Device index or part of its name, overrides the automatic device selection.
+        void setPreferredDevice(const std::string& device){
+            preferredDevice=device;
+        }
+
+        //Writes every rendered frame into directory from the first frame on, C toggles the capture at runtime.
+        void setCapture(const std::string& directory){
+            captureDirectory=directory;
+            captureOnStart=true;
+        }
+
+        void setCaptureFormat(CaptureFormat format){
+            captureFormat=format;
+        }
+
+        //Renders jobCount offline jobs with a hidden window instead of running interactively. Images are written
+        //into outputDirectory unless it is empty.
+        void setBatch(uint64_t jobCount, const std::string& outputDirectory, const BatchRenderer::Settings& settings){
+            batchJobCount=jobCount;
+            batchOutput=outputDirectory;
+            batchSettings=settings;
+        }
+
+        //Writes the inputs of every frame (uniforms, draws, scene time) and the hashes of all uploads into path.
+        void setRecordPath(const std::string& path){
+            recordPath=path;
+        }
+
+        //Replays a recorded session as fast as the GPU allows and quits at its end. Frame times are printed and
+        //written into reportPath as JSON unless it is empty, so two builds can be compared frame by frame.
+        void setReplay(const std::string& path, const std::string& reportPath){
+            replayPath=path;
+            replayReportPath=reportPath;
+        }
+
+        //Writes what the meshlet and occlusion culling kept and dropped in every frame into path as JSON.
+        void setCullReport(const std::string& path){
+            cullReportPath=path;
+        }
+
+        //Advances the scene by step seconds per frame instead of following the clock.
+        void setFixedTimestep(float step){
+            fixedTimestep=step;
+        }
+
+        //Renders the scene below the window's resolution whenever the GPU takes longer than budgetMs per frame and
+        //upscales it, bilinear or with sharpening.
+        void setResolutionBudget(float budgetMs, bool sharpen){
+            resolutionBudgetMs=budgetMs;
+            upscaleSharpen=sharpen;
+        }
+
+        //Flies the camera over a generated terrain of cells x cells chunks that is streamed in around it, keeping at
+        //most budgetMiB of it on the GPU.
+        void setWorld(int32_t cells, uint32_t budgetMiB){
+            worldCells=cells;
+            worldBudgetMiB=budgetMiB;
+        }
+
+        //Simulates and draws up to count GPU particles on top of the scene, 0 leaves them out.
+        void setParticleCount(uint32_t count){
+            particleCount=count;
+        }
+
+        //Lights the scene with count moving point and spot lights through clustered forward shading, 0 leaves it unlit.
+        void setLightCount(uint32_t count){
+            lightCount=count;
+        }
+
+        //Draws the bounds and indices of the scene nodes as debug lines and text over the scene.
+        void setDebugDraw(bool enabled){
+            debugDrawScene=enabled;
+        }
+
+        //Adds count animated debug lines, boxes and spheres every frame, to see what debug drawing costs at scale.
+        void setDebugDrawStress(uint32_t count){
+            debugDrawStress=count;
+        }
+
+        //Shows the performance overlay from the start, H toggles it either way.
+        void setHud(bool visible){
+            perfHud.setVisible(visible);
+        }
+
+        //Draws the first mesh of a pack written by the cook tool (tools/cook) instead of the built in quad.
+        void setAssetPack(const std::string& path){
+            assetPackPath=path;
+        }
+
+        //Writes the startup steps, their timing and the critical path into path as JSON once the first frame is shown.
+        void setStartupReport(const std::string& path){
+            startupReportPath=path;
+        }
+
+        //Records the frame's command buffer every frame instead of submitting the previous recording again when nothing changed.
+        void setRecordEveryFrame(bool enabled){
+            recordEveryFrame=enabled;
+        }
+
+        //Starts every frame just early enough to make the next refresh instead of as soon as a swapchain image is free.
+        //Needs display times from VK_KHR_present_wait or VK_GOOGLE_display_timing.
+        void setLowLatency(bool enabled){
+            lowLatency=enabled;
+        }
+
+        //Only draws when input, a resize, a running animation or streamed data changed the frame and otherwise waits for
+        //events, see FrameScheduler. The scene's animation starts paused, Space runs it. Ignored when replaying and in batch mode.
+        void setOnDemand(bool enabled){
+            onDemand=enabled;
+        }
+
         void run(){
-            initWindow();
+            startup.start();
+            if(!replayPath.empty() && batchJobCount==0){
+                sessionReader.open(replayPath);
+            }
+            frameScheduler.init(onDemand && replayPath.empty() && batchJobCount==0,MAX_FRAMES_IN_FLIGHT);
+            animationPaused=frameScheduler.isEnabled(); //otherwise the spinning scene asks for every frame and it never idles
             initVulkan();
-            mainLoop();
+            if(batchJobCount>0){
+                reportStartup();
+                runBatch();
+            }
+            else{
+                mainLoop();
+            }
             cleanup();
         }
 
     private:
+        //raw handles a worker compiles for installGraphicsPipeline()
+        struct CompiledPipeline{
+            VkPipelineLayout layout=VK_NULL_HANDLE;
+            VkPipeline pipeline=VK_NULL_HANDLE;
+        };
+
+        //Startup as a dependency graph, see StartupGraph. Reading shaders and the mesh, building the scene and the
+        //meshlets and compiling the scene pipeline happen on workers while the main thread creates the window, device,
+        //swapchain and buffers. Uploads only record into one command buffer that is submitted at the end.
         void initVulkan(){
 
-            createInstance();
-            createSurface();
-            pickPhysicalDevice();
-            createLogicalDevice();
-            createSwapChain();
-            createImageViews();
-            createRenderPass();
-            createDescripterSetLayout();
-            createGraphicsPipeline();
-            createFrameBuffers();
-            createCommandPool();
-            createVertexBuffer();
-            createIndexBuffer();
-            createUniformBuffers();
-            createDescripterPool();
-            createDescriptorSets();
-            createCommandBuffers();
-            createSyncObjects();
+            using Thread=StartupGraph::Thread;
+            auto shaders=startup.add("readShaders",[this]{ readShaders(); },{},Thread::Worker);
+            auto mesh=startup.add("loadMesh",[this]{ loadMesh(); },{},Thread::Worker);
+            auto sceneNodes=startup.add("createScene",[this]{ createScene(); },{},Thread::Worker);
+
+            auto window=startup.add("initWindow",[this]{ initWindow(); });
+            auto instance=startup.add("createInstance",[this]{ createInstance(); },{window});
+            auto surface=startup.add("createSurface",[this]{ createSurface(); },{instance});
+            auto physicalDevice=startup.add("pickPhysicalDevice",[this]{ pickPhysicalDevice(); },{surface});
+            auto logicalDevice=startup.add("createLogicalDevice",[this]{ createLogicalDevice(); },{physicalDevice});
+            auto meshletList=startup.add("buildMeshlets",[this]{ buildMeshlets(); },{logicalDevice,mesh},Thread::Worker);
+            auto swapChain=startup.add("createSwapChain",[this]{ createSwapChain(); },{logicalDevice});
+            auto imageViews=startup.add("createImageViews",[this]{ createImageViews(); },{swapChain});
+            auto sessionCapture=startup.add("createSessionCapture",[this]{ createSessionCapture(); },{swapChain});
+            auto capture=startup.add("createFrameCapture",[this]{ createFrameCapture(); },{swapChain});
+            auto setLayout=startup.add("createDescripterSetLayout",[this]{ createDescripterSetLayout(); },{logicalDevice});
+            auto pool=startup.add("createCommandPool",[this]{ createCommandPool(); },{logicalDevice});
+            auto uploads=startup.add("beginUploadBatch",[this]{ beginUploadBatch(); },{pool});
+            auto profiler=startup.add("createGpuProfiler",[this]{ createGpuProfiler(); },{pool});
+            auto textures=startup.add("createTextures",[this]{ createTextures(); },{pool,sessionCapture});
+            auto vertexUpload=startup.add("createVertexBuffer",[this]{ createVertexBuffer(); },{uploads,mesh,sessionCapture});
+            auto indexUpload=startup.add("createIndexBuffer",[this]{ createIndexBuffer(); },{uploads,mesh,sessionCapture});
+            auto uniforms=startup.add("createUniformBuffers",[this]{ createUniformBuffers(); },{logicalDevice});
+            auto instances=startup.add("createInstanceBuffers",[this]{ createInstanceBuffers(); },{logicalDevice,sceneNodes});
+            auto descriptorPool=startup.add("createDescripterPool",[this]{ createDescripterPool(); },{logicalDevice});
+            startup.add("createDescriptorSets",[this]{ createDescriptorSets(); },{descriptorPool,setLayout,uniforms,textures});
+            auto culler=startup.add("createMeshletCuller",[this]{ createMeshletCuller(); },{uploads,uniforms,instances,meshletList,shaders,swapChain});
+            auto particles=startup.add("createParticleSystem",[this]{ createParticleSystem(); },{uploads,uniforms,shaders});
+            auto resolution=startup.add("createDynamicResolution",[this]{ createDynamicResolution(); },{logicalDevice,shaders});
+            auto lighting=startup.add("createClusteredLighting",[this]{ createClusteredLighting(); },{logicalDevice,shaders});
+            auto debugDrawing=startup.add("createDebugDraw",[this]{ createDebugDraw(); },{logicalDevice,uniforms,mesh,shaders});
+            startup.add("createPerfHud",[this]{ createPerfHud(); },{logicalDevice});
+            //built once everything that adds passes exists, the scene pipeline needs its render pass
+            auto graph=startup.add("createRenderGraph",[this]{ createRenderGraph(); },{imageViews,capture,profiler,culler,particles,resolution,debugDrawing});
+            auto pipelineCompile=startup.add("compileGraphicsPipeline",[this]{ startupPipeline=compileGraphicsPipeline(); },{graph,setLayout,lighting,shaders},Thread::Worker);
+            startup.add("installGraphicsPipeline",[this]{ installGraphicsPipeline(startupPipeline); },{pipelineCompile});
+            startup.add("createWorldStreamer",[this]{ createWorldStreamer(); },{logicalDevice});
+            startup.add("createCommandBuffers",[this]{ createCommandBuffers(); },{pool,swapChain});
+            startup.add("createSyncObjects",[this]{ createSyncObjects(); },{logicalDevice});
+            startup.add("createAsyncCompute",[this]{ createAsyncCompute(); },{logicalDevice});
+            startup.add("submitUploadBatch",[this]{ submitUploadBatch(); },{vertexUpload,indexUpload,culler,particles});
+
+            startup.run(std::min(std::max(std::thread::hardware_concurrency(),2u)-1,3u));
+
+            renderGraph.printReport();
+        }
+
+        void reportStartup(){
+            startup.printReport();
+            if(!startupReportPath.empty()){
+                startup.writeReport(startupReportPath);
+            }
         }
 
         void createInstance(){
 
+            PROFILE_ZONE("createInstance");
+
             if(enableValidationLayers&&!checkValidationLayerSupport()){
                 throw std::runtime_error("validation layer requested, but not available!");
             }
@@ -83,10 +289,19 @@ class HelloTriangleApplication{
                 requiredExtensions.emplace_back(glfwExtensions[i]);
             }
 
-            requiredExtensions.emplace_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
             requiredExtensions.emplace_back("VK_KHR_get_physical_device_properties2");
 
-            createInfo.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+            //portability drivers (MoltenVK) are only listed when enumeration asks for them, other loaders may not know the extension
+            uint32_t instanceExtensionCount=0;
+            vkEnumerateInstanceExtensionProperties(nullptr,&instanceExtensionCount,nullptr);
+            std::vector<VkExtensionProperties> instanceExtensions(instanceExtensionCount);
+            vkEnumerateInstanceExtensionProperties(nullptr,&instanceExtensionCount,instanceExtensions.data());
+            for(const auto& extension: instanceExtensions){
+                if(strcmp(extension.extensionName,VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME)==0){
+                    requiredExtensions.emplace_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+                    createInfo.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+                }
+            }
 
             createInfo.enabledExtensionCount = (uint32_t) requiredExtensions.size();
             createInfo.ppEnabledExtensionNames = requiredExtensions.data();
@@ -98,6 +313,8 @@ class HelloTriangleApplication{
 
         void createSurface(){
 
+            PROFILE_ZONE("createSurface");
+
             if(glfwCreateWindowSurface(instance,window,nullptr,&surface)!=VK_SUCCESS){
 
                 throw std::runtime_error("failed to create window surface!");
@@ -105,111 +322,24 @@ class HelloTriangleApplication{
 
         }
 
+        //Scores every device and takes the best one unless a device was requested with --gpu. The capability
+        //queries are kept in deviceInfo so the other create functions do not ask the driver again.
         void pickPhysicalDevice(){
 
-            uint32_t deviceCount;
-            vkEnumeratePhysicalDevices(instance,&deviceCount,nullptr);
-
-            if(deviceCount==0){
-                throw std::runtime_error("No GPU found with Vulkan support!");
-            }
-
-            std::vector<VkPhysicalDevice> devices(deviceCount);
-            vkEnumeratePhysicalDevices(instance,&deviceCount,devices.data());
-
-            for(const auto& device:devices){
-
-                if(isDeviceSuitable(device)){
-                    physicalDevice=device;  
-                    break;
-                }
-            }
-            if(physicalDevice==VK_NULL_HANDLE){
-
-                throw std::runtime_error("failed to find suitable GPU!");
-            }        
-        }
-
-        struct QueueFamilyIndices{
-            std::optional<uint32_t> graphicsFamily;
-            std::optional<uint32_t> presentFamily;
-
-            bool isComplete(){
-
-                return graphicsFamily.has_value()&& presentFamily.has_value();
-            }
-        };
-
-        bool isDeviceSuitable(VkPhysicalDevice device){
-
-            QueueFamilyIndices indices= findQueueFamily(device);
-            bool extensionSupport= checkExtensionSupport(device);
-            bool swapChainAdequet=false;
-
-            if(extensionSupport){
-                SwapChainSupportDetails swapChainSupport=querySwapChainSupport(device);
-                swapChainAdequet= !swapChainSupport.formats.empty()&&!swapChainSupport.presentModes.empty();
-            }
-
-            return indices.isComplete()&&extensionSupport&&swapChainAdequet;
-
-        }
-
-        bool checkExtensionSupport(VkPhysicalDevice device){
-            uint32_t extensionCount=0;
-            vkEnumerateDeviceExtensionProperties(device,nullptr,&extensionCount,nullptr);
-
-            std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-            vkEnumerateDeviceExtensionProperties(device,nullptr,&extensionCount,availableExtensions.data());
-
-            std::set<std::string> requiredExtensions(deviceExtensions.begin(),deviceExtensions.end());
-            for(const auto& extension: availableExtensions ){
-                requiredExtensions.erase(extension.extensionName);
-            }
-
-            return requiredExtensions.empty();
-
-        }
-
-        QueueFamilyIndices findQueueFamily(VkPhysicalDevice device){
-
-            QueueFamilyIndices indices;
-            uint32_t queFamilyCount=0;
-            vkGetPhysicalDeviceQueueFamilyProperties(device,&queFamilyCount,nullptr);
-
-            std::vector<VkQueueFamilyProperties> queueFamilies(queFamilyCount);
-            vkGetPhysicalDeviceQueueFamilyProperties(device,&queFamilyCount,queueFamilies.data());
-
-            int i=0;
-
-
-            for(const auto& queueFamily: queueFamilies){
-                
-                VkBool32 presentSupport=false;
-                vkGetPhysicalDeviceSurfaceSupportKHR(device,i,surface,&presentSupport);
-
-                if(presentSupport){
-                    indices.presentFamily=i;
-                }
+            PROFILE_ZONE("pickPhysicalDevice");
 
-                if(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT){
-                    indices.graphicsFamily=i;
-                }
-                
-                if(indices.isComplete()){
-                    break;
-                }
-                ++i;
-            }
-            return indices;
+            deviceInfo=vkutil::selectPhysicalDevice(instance,surface,deviceExtensions,preferredDevice);
+            physicalDevice=deviceInfo.physicalDevice;
         }
     
         void createLogicalDevice(){
 
-            QueueFamilyIndices indices= findQueueFamily(physicalDevice);
+            PROFILE_ZONE("createLogicalDevice");
+
+            const QueueFamilyIndices& indices= deviceInfo.queueFamilies;
 
             std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-            std::set<uint32_t> uniqueQueueFamilies={indices.graphicsFamily.value(),indices.presentFamily.value()};
+            std::set<uint32_t> uniqueQueueFamilies={indices.graphicsFamily.value(),indices.presentFamily.value(),indices.computeFamily.value()};
             float queuePriority=1.0;
 
             for(uint32_t queueFamily: uniqueQueueFamilies){
@@ -223,13 +353,71 @@ class HelloTriangleApplication{
             }
 
 
-            VkPhysicalDeviceFeatures deviceFeatures{}; //for now left blank due to no necessary device feeature needed.
+            //only enable the optional features the device actually has
+            const VkPhysicalDeviceFeatures& supportedFeatures=deviceInfo.features;
+
+            VkPhysicalDeviceFeatures deviceFeatures{};
+            {
+                deviceFeatures.samplerAnisotropy=supportedFeatures.samplerAnisotropy;
+                deviceFeatures.textureCompressionBC=supportedFeatures.textureCompressionBC;
+                deviceFeatures.textureCompressionETC2=supportedFeatures.textureCompressionETC2;
+                deviceFeatures.multiDrawIndirect=supportedFeatures.multiDrawIndirect; //meshlet culling
+                deviceFeatures.drawIndirectFirstInstance=supportedFeatures.drawIndirectFirstInstance;
+            }
+            enabledFeatures=deviceFeatures;
+
+            //optional extensions are only enabled when the device has them
+            std::vector<const char*> enabledExtensions(deviceExtensions.begin(),deviceExtensions.end());
+            if(deviceInfo.hasExtension("VK_KHR_portability_subset")){
+                enabledExtensions.push_back("VK_KHR_portability_subset"); //has to be enabled when the device exposes it (MoltenVK)
+            }
+            bool memoryBudgetSupported=deviceInfo.hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            if(memoryBudgetSupported){
+                enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            }
+            drawIndirectCountEnabled=deviceInfo.hasExtension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            if(drawIndirectCountEnabled){
+                enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            }
+            calibratedTimestampsEnabled=Profiler::isEnabled() && deviceInfo.hasExtension(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+            if(calibratedTimestampsEnabled){
+                enabledExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+            }
+
+            //display times of the presented frames: present wait where the features are there, display timing otherwise
+            VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+            presentIdFeatures.sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+            VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+            presentWaitFeatures.sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+            FrameLatency::Source latencySource=FrameLatency::Source::None;
+            auto getFeatures2=reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance,"vkGetPhysicalDeviceFeatures2KHR"));
+            if(getFeatures2 && deviceInfo.hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) && deviceInfo.hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)){
+                presentIdFeatures.pNext=&presentWaitFeatures;
+                VkPhysicalDeviceFeatures2 features2{};
+                features2.sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+                features2.pNext=&presentIdFeatures;
+                getFeatures2(physicalDevice,&features2);
+                presentIdFeatures.pNext=nullptr;
+                if(presentIdFeatures.presentId && presentWaitFeatures.presentWait){
+                    enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+                    enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+                    presentIdFeatures.pNext=&presentWaitFeatures;
+                    latencySource=FrameLatency::Source::PresentWait;
+                }
+            }
+            if(latencySource==FrameLatency::Source::None && deviceInfo.hasExtension(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME)){
+                enabledExtensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+                latencySource=FrameLatency::Source::DisplayTiming;
+            }
 
             VkDeviceCreateInfo createInfo{};
             createInfo.sType=VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+            if(latencySource==FrameLatency::Source::PresentWait){
+                createInfo.pNext=&presentIdFeatures;
+            }
 
-            createInfo.enabledExtensionCount=static_cast<uint32_t>(deviceExtensions.size());
-            createInfo.ppEnabledExtensionNames=deviceExtensions.data();
+            createInfo.enabledExtensionCount=static_cast<uint32_t>(enabledExtensions.size());
+            createInfo.ppEnabledExtensionNames=enabledExtensions.data();
 
             createInfo.queueCreateInfoCount=static_cast<uint32_t>(queueCreateInfos.size());
             createInfo.pQueueCreateInfos=queueCreateInfos.data();
@@ -250,35 +438,14 @@ class HelloTriangleApplication{
 
             vkGetDeviceQueue(device,indices.graphicsFamily.value(),0,&graphicsQueue);
             vkGetDeviceQueue(device,indices.presentFamily.value(),0,&presentQueue);
-        }
-        
-        struct SwapChainSupportDetails{
-            VkSurfaceCapabilitiesKHR capabilities;
-            std::vector<VkSurfaceFormatKHR> formats;
-            std::vector<VkPresentModeKHR> presentModes;
-        };
+            vkGetDeviceQueue(device,indices.computeFamily.value(),0,&computeQueue);
 
-        SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device){
-            SwapChainSupportDetails details;
-            
-            vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device,surface,&details.capabilities);
-            
-            uint32_t formatCount;
-            vkGetPhysicalDeviceSurfaceFormatsKHR(device,surface,&formatCount,nullptr);
-            if(formatCount!=0){
-                details.formats.resize(formatCount);
-                vkGetPhysicalDeviceSurfaceFormatsKHR(device,surface,&formatCount,details.formats.data());
-            }
-
-            uint32_t presentModeCount;
-            vkGetPhysicalDeviceSurfacePresentModesKHR(device,surface,&presentModeCount,nullptr);
-            if(presentModeCount!=0){
-                details.presentModes.resize(presentModeCount);
-                vkGetPhysicalDeviceSurfacePresentModesKHR(device,surface,&presentModeCount,details.presentModes.data());
-            }
-            return details;
+            vkutil::memoryTracker().init(instance,physicalDevice,memoryBudgetSupported);
+            deletionQueue.init(device);
+            renderGraph.init(physicalDevice,device,deletionQueue);
+            frameLatency.init(device,latencySource,lowLatency);
         }
-
+        
         VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR> availableFormats){
 
             for(const auto& availableFormat: availableFormats){
@@ -301,6 +468,14 @@ class HelloTriangleApplication{
                 }
 
             }
+            //a replay is paced by the GPU alone, mailbox still keeps it from tearing
+            if(sessionReader.isOpen()){
+                for(const auto& presentMode:availablePresentModes){
+                    if(presentMode == VK_PRESENT_MODE_IMMEDIATE_KHR){
+                        return presentMode;
+                    }
+                }
+            }
             return VK_PRESENT_MODE_FIFO_KHR;
         }
 
@@ -331,7 +506,10 @@ class HelloTriangleApplication{
 
         void createSwapChain(){
 
-            SwapChainSupportDetails swapChainSupport= querySwapChainSupport(physicalDevice);
+            PROFILE_ZONE("createSwapChain");
+
+            deviceInfo.refreshSurfaceCapabilities(surface);
+            const SwapChainSupportDetails& swapChainSupport= deviceInfo.swapChainSupport;
             VkSurfaceFormatKHR surfaceFormat= chooseSwapSurfaceFormat(swapChainSupport.formats); 
             VkPresentModeKHR presentMode= choosePresentMode(swapChainSupport.presentModes);
             VkExtent2D extent= chooseSwapExtent(swapChainSupport.capabilities);
@@ -353,8 +531,11 @@ class HelloTriangleApplication{
             createInfo.imageExtent=extent;
             createInfo.imageArrayLayers=1;
             createInfo.imageUsage= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            if(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT){
+                createInfo.imageUsage|= VK_IMAGE_USAGE_TRANSFER_SRC_BIT; //frame capture copies out of the swapchain images
+            }
 
-            QueueFamilyIndices indices= findQueueFamily(physicalDevice);
+            const QueueFamilyIndices& indices= deviceInfo.queueFamilies;
 
             uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(),indices.presentFamily.value()};
             
@@ -379,11 +560,13 @@ class HelloTriangleApplication{
             createInfo.compositeAlpha= VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
             createInfo.presentMode=presentMode;
             createInfo.clipped=VK_TRUE;
-            createInfo.oldSwapchain=VK_NULL_HANDLE;
+            createInfo.oldSwapchain=swapChain; //lets presentation of the old swapchain finish while it is being replaced
 
-            if(vkCreateSwapchainKHR(device,&createInfo,nullptr,&swapChain)!=VK_SUCCESS){
+            VkSwapchainKHR newSwapChain;
+            if(vkCreateSwapchainKHR(device,&createInfo,nullptr,&newSwapChain)!=VK_SUCCESS){
                 throw std::runtime_error("failed to create swapchain!");
             }
+            swapChain=vkutil::UniqueSwapchain(deletionQueue,newSwapChain); //the retired swapchain goes to the deletion queue
 
             vkGetSwapchainImagesKHR(device,swapChain,&imageCount,nullptr);
             swapChainImages.resize(imageCount);
@@ -391,42 +574,43 @@ class HelloTriangleApplication{
             
             swapChainImageFormat=surfaceFormat.format;
             swapChainExtent=extent;
+            frameLatency.setSwapchain(swapChain);
          }
 
+        //Queues the image views for deletion. The swapchain itself stays alive so it can be
+        //passed as oldSwapchain when it is recreated.
         void cleanUpSwapChain(){
-             for (auto framebuffer : swapChainFrameBuffers) {
-                vkDestroyFramebuffer(device, framebuffer, nullptr);
-            }
-
-            for(auto imageView: swapChainImageViews){
-                vkDestroyImageView(device,imageView,nullptr);
-            }
-
-            vkDestroySwapchainKHR(device,swapChain,nullptr);
-
+            swapChainImageViews.clear();
         }
 
         // In case of window resize the swapchain is becoming incompatible so it needs to be recreated.
         void recreateSwapChain(){
+            PROFILE_ZONE("recreateSwapChain");
             int width = 0, height = 0;
             glfwGetFramebufferSize(window, &width, &height);
             while (width == 0 || height == 0) {
                 glfwGetFramebufferSize(window, &width, &height);
                 glfwWaitEvents();
             }
-            vkDeviceWaitIdle(device);
 
+            //no need to wait for the device, frames in flight keep the old objects alive through the deletion queue
             cleanUpSwapChain();
             createSwapChain();
             createImageViews();
-            createFrameBuffers();
+            commandBufferCache.resize(static_cast<uint32_t>(swapChainImages.size()));
 
+            VkRenderPass previousRenderPass=renderGraph.getRenderPass(scenePass);
+            createRenderGraph();
+            if(renderGraph.getRenderPass(scenePass)!=previousRenderPass){
+                createGraphicsPipeline(); //the attachment formats changed, so the pipeline is no longer compatible
+            }
         }
 
          void createImageViews(){
+            PROFILE_ZONE("createImageViews");
             swapChainImageViews.resize(swapChainImages.size());
 
-            for(size_t i=0;i<swapChainImageViews.size(); ++i){
+            for(size_t i=0;i<swapChainImages.size(); ++i){
                 VkImageViewCreateInfo createInfo{};
 
                 createInfo.sType=VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -445,13 +629,50 @@ class HelloTriangleApplication{
                 createInfo.subresourceRange.layerCount=1;
                 createInfo.subresourceRange.levelCount=1; 
 
-                if(vkCreateImageView(device,&createInfo,nullptr,&swapChainImageViews[i])!=VK_SUCCESS){
+                VkImageView imageView;
+                if(vkCreateImageView(device,&createInfo,nullptr,&imageView)!=VK_SUCCESS){
                     throw std::runtime_error("failed to create image views!");
                 }
+                swapChainImageViews[i]=vkutil::UniqueImageView(deletionQueue,imageView);
             
             }
          }
 
+        //Reads every shader this configuration uses ahead of the steps that create the pipelines.
+        void readShaders(){
+
+            PROFILE_ZONE("readShaders");
+
+            std::vector<std::string> names={"vert","frag","meshlet_cull","depth_pyramid"};
+            if(particleCount>0){
+                names.insert(names.end(),{"particle_emit","particle_simulate","particle_compact","particle_vert","particle_frag"});
+            }
+            if(resolutionBudgetMs>0.0f){
+                names.insert(names.end(),{"upscale_vert","upscale_frag"});
+            }
+            if(lightCount>0){
+                names.push_back("light_cluster");
+            }
+            //the overlay can be switched on at any time for the hud
+            names.insert(names.end(),{"debug_line_vert","debug_line_frag","debug_overlay_vert","debug_overlay_frag"});
+            for(const std::string& name: names){
+                shaderCache[name]=readFile(shaderPath(name));
+            }
+        }
+
+        //Compiled shader by name, read from disk unless readShaders() already did.
+        const std::vector<char>& loadShader(const std::string& name){
+            auto found=shaderCache.find(name);
+            if(found==shaderCache.end()){
+                found=shaderCache.emplace(name,readFile(shaderPath(name))).first;
+            }
+            return found->second;
+        }
+
+        static std::string shaderPath(const std::string& name){
+            return std::string(ASSET_DIR)+"/shaders/"+name+".spv";
+        }
+
         static std::vector<char> readFile(const std::string& fileName){
             std::ifstream file(fileName, std::ios::ate | std::ios::binary);
 
@@ -472,6 +693,8 @@ class HelloTriangleApplication{
 
         void createDescripterSetLayout(){
 
+            PROFILE_ZONE("createDescripterSetLayout");
+
             VkDescriptorSetLayoutBinding uboLayoutBinding{};
             {
                 uboLayoutBinding.binding = 0;
@@ -481,11 +704,22 @@ class HelloTriangleApplication{
                 uboLayoutBinding.pImmutableSamplers=nullptr;
             }
 
+            VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+            {
+                samplerLayoutBinding.binding = 1;
+                samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                samplerLayoutBinding.descriptorCount = 1;
+                samplerLayoutBinding.stageFlags=VK_SHADER_STAGE_FRAGMENT_BIT;
+                samplerLayoutBinding.pImmutableSamplers=nullptr;
+            }
+
+            std::array<VkDescriptorSetLayoutBinding,2> bindings={uboLayoutBinding,samplerLayoutBinding};
+
             VkDescriptorSetLayoutCreateInfo layoutInfo{};
             {   
                 layoutInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-                layoutInfo.bindingCount=1;
-                layoutInfo.pBindings=&uboLayoutBinding;
+                layoutInfo.bindingCount=static_cast<uint32_t>(bindings.size());
+                layoutInfo.pBindings=bindings.data();
                 layoutInfo.flags=0;
 
             }
@@ -496,12 +730,25 @@ class HelloTriangleApplication{
 
         }
 
-         void createGraphicsPipeline(){
+        void createGraphicsPipeline(){
+            installGraphicsPipeline(compileGraphicsPipeline());
+        }
+
+        //Takes over the compiled handles, on the main thread since they are released through the deletion queue.
+        void installGraphicsPipeline(const CompiledPipeline& compiled){
+            ++pipelineGeneration;
+            pipelineLayout=vkutil::UniquePipelineLayout(deletionQueue,compiled.layout);
+            graphicsPipeline=vkutil::UniquePipeline(deletionQueue,compiled.pipeline);
+        }
+
+        //Only creates Vulkan objects and touches no state of the app, so the startup runs it on a worker.
+        CompiledPipeline compileGraphicsPipeline(){
+            PROFILE_ZONE("compileGraphicsPipeline");
             namespace fs = std::filesystem;
 
-            //read compiled shader code
-            auto vertShaderCode = readFile("../../assets/shaders/vert.spv"); //TODO: Instead give the assets path to the cmake
-            auto fragShaderCode = readFile("../../assets/shaders/frag.spv"); //TODO: Instead give the assets path to the cmake
+            //compiled shader code, read by the startup
+            const std::vector<char>& vertShaderCode = loadShader("vert");
+            const std::vector<char>& fragShaderCode = loadShader("frag");
 
             //wrap shader code with shader modules
             VkShaderModule vertShaderModule= createShaderModule(vertShaderCode);
@@ -539,17 +786,23 @@ class HelloTriangleApplication{
                 dynamicState.pDynamicStates=dynamicStates.data();
             }
 
-            //Specify the vertex shader input data
-            VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-            {   
-                auto bindingDescription=Vertex::getBindingDescription();
-                auto attributeDescriptions=Vertex::getAttributeDescriptions();
+            //Specify the vertex shader input data, per vertex attributes followed by the per instance world matrix
+            std::array<VkVertexInputBindingDescription,2> bindingDescriptions={Vertex::getBindingDescription(),Instance::getBindingDescription()};
+            std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+            for(const auto& attribute: Vertex::getAttributeDescriptions()){
+                attributeDescriptions.push_back(attribute);
+            }
+            for(const auto& attribute: Instance::getAttributeDescriptions()){
+                attributeDescriptions.push_back(attribute);
+            }
 
+            VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+            {
                 vertexInputInfo.sType=VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-                vertexInputInfo.vertexBindingDescriptionCount=1;
-                vertexInputInfo.vertexAttributeDescriptionCount=attributeDescriptions.size();
+                vertexInputInfo.vertexBindingDescriptionCount=static_cast<uint32_t>(bindingDescriptions.size());
+                vertexInputInfo.vertexAttributeDescriptionCount=static_cast<uint32_t>(attributeDescriptions.size());
                 vertexInputInfo.pVertexAttributeDescriptions=attributeDescriptions.data();
-                vertexInputInfo.pVertexBindingDescriptions=&bindingDescription;
+                vertexInputInfo.pVertexBindingDescriptions=bindingDescriptions.data();
             }
 
             //Specify how to draw the primitives
@@ -588,7 +841,15 @@ class HelloTriangleApplication{
                 multisampling.rasterizationSamples=VK_SAMPLE_COUNT_1_BIT;
             }
 
-            //VkPipelineDepthStencilStateCreateInfo deptstencil{};
+            VkPipelineDepthStencilStateCreateInfo depthStencil{};
+            {
+                depthStencil.sType=VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+                depthStencil.depthTestEnable=VK_TRUE;
+                depthStencil.depthWriteEnable=VK_TRUE;
+                depthStencil.depthCompareOp=VK_COMPARE_OP_LESS;
+                depthStencil.depthBoundsTestEnable=VK_FALSE;
+                depthStencil.stencilTestEnable=VK_FALSE;
+            }
 
             VkPipelineColorBlendAttachmentState colorBlendAttachment{};
             {
@@ -604,14 +865,17 @@ class HelloTriangleApplication{
                 colorBlending.pAttachments=&colorBlendAttachment;
             }
 
+            //set 1 holds the lights and cluster lists of clustered_lighting.glsl
+            VkDescriptorSetLayout setLayouts[2]={descriptorSetLayout,clusteredLighting.getDescriptorSetLayout()};
             VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
             {
                 pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-                pipelineLayoutInfo.setLayoutCount = 1;
-                pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+                pipelineLayoutInfo.setLayoutCount = 2;
+                pipelineLayoutInfo.pSetLayouts = setLayouts;
             }
 
-            if(vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,&pipelineLayout)!=VK_SUCCESS){
+            CompiledPipeline compiled{};
+            if(vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,&compiled.layout)!=VK_SUCCESS){
                 throw std::runtime_error("failed to create pipeline layout!");
             }
 
@@ -625,75 +889,253 @@ class HelloTriangleApplication{
                 pipelineInfo.pViewportState=&viewportState;
                 pipelineInfo.pRasterizationState=&rasterizer;
                 pipelineInfo.pMultisampleState=&multisampling;
-                pipelineInfo.pDepthStencilState=nullptr;
+                pipelineInfo.pDepthStencilState=&depthStencil;
                 pipelineInfo.pColorBlendState=&colorBlending;
                 pipelineInfo.pDynamicState=&dynamicState;
-                pipelineInfo.layout=pipelineLayout;
-                pipelineInfo.renderPass=renderPass;
+                pipelineInfo.layout=compiled.layout;
+                pipelineInfo.renderPass=renderGraph.getRenderPass(scenePass);
                 pipelineInfo.subpass=0; //describes the index of the subpass where this graphics pipeline will be used
 
                 pipelineInfo.basePipelineHandle=VK_NULL_HANDLE; //not inherited from a base pipeline
             }
 
-            if(vkCreateGraphicsPipelines(device,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&graphicsPipeline)!=VK_SUCCESS){
+            VkResult result=vkCreateGraphicsPipelines(device,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&compiled.pipeline);
+            vkDestroyShaderModule(device,vertShaderModule,nullptr);
+            vkDestroyShaderModule(device,fragShaderModule,nullptr);
+            if(result!=VK_SUCCESS){
+                vkDestroyPipelineLayout(device,compiled.layout,nullptr);
                 throw std::runtime_error("failed to create graphics pipeline!");
             }
+            return compiled;
+        }
 
-            vkDestroyShaderModule(device,vertShaderModule,nullptr);
-            vkDestroyShaderModule(device,fragShaderModule,nullptr);
-         }
+        VkFormat findDepthFormat(){
 
-        void createRenderPass(){
+            for(VkFormat format: {VK_FORMAT_D32_SFLOAT,VK_FORMAT_D32_SFLOAT_S8_UINT,VK_FORMAT_D24_UNORM_S8_UINT}){
+                VkFormatProperties properties;
+                vkGetPhysicalDeviceFormatProperties(physicalDevice,format,&properties);
+                if(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT){
+                    return format;
+                }
+            }
+            throw std::runtime_error("failed to find a depth format!");
+        }
 
-            VkAttachmentDescription colorAttachment{};
-            {
-                colorAttachment.format= swapChainImageFormat;
-                colorAttachment.samples=VK_SAMPLE_COUNT_1_BIT;
-                colorAttachment.loadOp=VK_ATTACHMENT_LOAD_OP_CLEAR; //Clear the framebuffer before drawing
-                colorAttachment.storeOp=VK_ATTACHMENT_STORE_OP_STORE; //We will show the colors on the screen
-                colorAttachment.stencilLoadOp=VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-                colorAttachment.stencilStoreOp=VK_ATTACHMENT_STORE_OP_DONT_CARE;
-                colorAttachment.initialLayout=VK_IMAGE_LAYOUT_UNDEFINED;
-                colorAttachment.finalLayout=VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-            }
-            VkAttachmentReference colorAttachmentReference{};
-            {
-                colorAttachmentReference.attachment=0;//idx of the attachment colorAttachment array
-                colorAttachmentReference.layout=VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        //Declares the frame: the scene pass draws into the swapchain image with a transient depth buffer.
+        //Rebuilt whenever the swapchain is, the graph works out the layout transitions and barriers.
+        void createRenderGraph(){
+
+            PROFILE_ZONE("createRenderGraph");
+
+            renderGraph.clear();
+            ++renderGraphGeneration;
+
+            //the acquire semaphore is waited on at the color attachment stage, the first barrier chains onto it
+            backbuffer=renderGraph.importImage("backbuffer",swapChainImageFormat,swapChainExtent,
+                                               {VK_IMAGE_LAYOUT_UNDEFINED,VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,0},
+                                               {VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,0});
+            depthBuffer=renderGraph.createImage("depth",findDepthFormat(),swapChainExtent);
+
+            //with dynamic resolution the scene goes into a target of the swapchain's size and format, of which every
+            //frame only uses its render extent, and is upscaled into the backbuffer at the end
+            dynamicResolutionInGraph=resolutionBudgetMs>0.0f;
+            RenderResource sceneTarget=backbuffer;
+            if(dynamicResolutionInGraph){
+                sceneColor=renderGraph.createImage("scene color",swapChainImageFormat,swapChainExtent);
+                sceneTarget=sceneColor;
+            }
+
+            //culls the meshlets of every instance and leaves the surviving draws for the scene pass
+            meshletCullingInGraph=meshletCulling;
+            occlusionCullingInGraph=meshletCulling && occlusionCulling;
+            if(meshletCullingInGraph){
+                depthPyramid.resize(swapChainExtent);
+                meshletDraws=renderGraph.importBuffer("meshlet draws");
+                meshletDrawCount=renderGraph.importBuffer("meshlet draw count");
+                RenderPassHandle cullPass=renderGraph.addPass("meshlet cull",RenderGraph::PassType::Compute,[this](VkCommandBuffer commandBuffer){
+                    //nothing to test against until a frame has built the pyramid
+                    bool occlusion=occlusionCullingInGraph && depthPyramid.isValid();
+                    meshletCuller.cull(commandBuffer,currentFrame,static_cast<uint32_t>(scene.size()),occlusion ? depthPyramid.getContentExtent() : VkExtent2D{});
+                });
+                renderGraph.write(cullPass,meshletDraws,ResourceUsage::StorageBufferWrite);
+                renderGraph.write(cullPass,meshletDrawCount,ResourceUsage::StorageBufferWrite);
+                if(occlusionCullingInGraph){
+                    //left by the previous frame's pyramid build, which is the first access to wait for
+                    depthPyramidImage=renderGraph.importImage("depth pyramid",DepthPyramid::format,depthPyramid.getExtent(),
+                                                              {VK_IMAGE_LAYOUT_GENERAL,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_WRITE_BIT},
+                                                              {VK_IMAGE_LAYOUT_GENERAL,0,0});
+                    meshletVisibility=renderGraph.importBuffer("meshlet visibility");
+                    renderGraph.read(cullPass,depthPyramidImage,ResourceUsage::StorageImageRead);
+                    renderGraph.write(cullPass,meshletVisibility,ResourceUsage::StorageBufferWrite);
+                }
             }
-            VkSubpassDescription subpass{};
-            {
-                subpass.pipelineBindPoint=VK_PIPELINE_BIND_POINT_GRAPHICS;
-                subpass.colorAttachmentCount=1;
-                subpass.pColorAttachments=&colorAttachmentReference;
+
+            //the lights are binned into the clusters the scene's fragments look them up in on the compute queue, see
+            //binLights(), the frame acquires the lists before its first pass
+            lightingInGraph=lightCount>0;
+            if(lightingInGraph){
+                lightClusters=renderGraph.importBuffer("light clusters");
+                viewLights=renderGraph.importBuffer("view lights");
             }
 
-            VkSubpassDependency dependency{};
-            {
-                dependency.srcSubpass=VK_SUBPASS_EXTERNAL;
-                dependency.dstSubpass=0;
-                dependency.srcStageMask=VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-                dependency.srcAccessMask=0;
-                dependency.dstStageMask=VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-                dependency.dstAccessMask=VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            scenePass=renderGraph.addPass("scene",RenderGraph::PassType::Graphics,[this](VkCommandBuffer commandBuffer){
+                drawScene(commandBuffer,currentFrame,renderExtent,frameDraws,meshletCullingInGraph);
+                if(worldStreaming){
+                    worldStreamer.draw(commandBuffer,static_cast<uint32_t>(scene.size()));
+                }
+            });
+            if(meshletCullingInGraph){
+                renderGraph.read(scenePass,meshletDraws,ResourceUsage::IndirectBuffer);
+                renderGraph.read(scenePass,meshletDrawCount,ResourceUsage::IndirectBuffer);
+            }
+            if(lightingInGraph){
+                renderGraph.read(scenePass,lightClusters,ResourceUsage::StorageBufferReadGraphics);
+                renderGraph.read(scenePass,viewLights,ResourceUsage::StorageBufferReadGraphics);
+            }
+            renderGraph.writeColor(scenePass,sceneTarget,VK_ATTACHMENT_LOAD_OP_CLEAR,{{0.0f,0.0f,0.0f,1.0f}});
+            renderGraph.writeDepth(scenePass,depthBuffer,VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+            //second phase: the pyramid is rebuilt from the depth of what was just drawn, which the next frame starts from,
+            //and the clusters the old pyramid hid are tested again so whatever came into view is drawn this frame
+            if(occlusionCullingInGraph){
+                RenderPassHandle pyramidPass=renderGraph.addPass("depth pyramid",RenderGraph::PassType::Compute,[this](VkCommandBuffer commandBuffer){
+                    depthPyramid.build(commandBuffer,currentFrame,renderExtent);
+                });
+                renderGraph.read(pyramidPass,depthBuffer,ResourceUsage::SampledCompute);
+                renderGraph.write(pyramidPass,depthPyramidImage,ResourceUsage::StorageImageWrite);
+
+                RenderPassHandle lateCullPass=renderGraph.addPass("meshlet cull late",RenderGraph::PassType::Compute,[this](VkCommandBuffer commandBuffer){
+                    meshletCuller.cullLate(commandBuffer,currentFrame,depthPyramid.getContentExtent());
+                });
+                renderGraph.read(lateCullPass,depthPyramidImage,ResourceUsage::StorageImageRead);
+                renderGraph.read(lateCullPass,meshletVisibility,ResourceUsage::StorageBufferRead);
+                renderGraph.write(lateCullPass,meshletDraws,ResourceUsage::StorageBufferWrite);
+                renderGraph.write(lateCullPass,meshletDrawCount,ResourceUsage::StorageBufferWrite);
+
+                RenderPassHandle lateScenePass=renderGraph.addPass("scene late",RenderGraph::PassType::Graphics,[this](VkCommandBuffer commandBuffer){
+                    drawScene(commandBuffer,currentFrame,renderExtent,frameDraws,true,true);
+                });
+                renderGraph.read(lateScenePass,meshletDraws,ResourceUsage::IndirectBuffer);
+                renderGraph.read(lateScenePass,meshletDrawCount,ResourceUsage::IndirectBuffer);
+                if(lightingInGraph){
+                    renderGraph.read(lateScenePass,lightClusters,ResourceUsage::StorageBufferReadGraphics);
+                    renderGraph.read(lateScenePass,viewLights,ResourceUsage::StorageBufferReadGraphics);
+                }
+                renderGraph.writeColor(lateScenePass,sceneTarget,VK_ATTACHMENT_LOAD_OP_LOAD);
+                renderGraph.writeDepth(lateScenePass,depthBuffer,VK_ATTACHMENT_LOAD_OP_LOAD);
+            }
+
+            //emit, simulate and compact on the GPU, then one indirect draw of the alive particles over the scene
+            particlesInGraph=particleCount>0;
+            if(particlesInGraph){
+                //the previous frame's draw and statistics copy still use the buffers the simulation rewrites
+                ResourceState previousFrame{VK_IMAGE_LAYOUT_UNDEFINED,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_SHADER_WRITE_BIT};
+                particleBuffer=renderGraph.importBuffer("particles",previousFrame);
+                particleLists=renderGraph.importBuffer("particle lists",previousFrame);
+                particleCounters=renderGraph.importBuffer("particle counters",previousFrame);
+                RenderPassHandle simulationPass=renderGraph.addPass("particle simulation",RenderGraph::PassType::Compute,[this](VkCommandBuffer commandBuffer){
+                    particleSystem.simulate(commandBuffer,currentFrame);
+                });
+                renderGraph.write(simulationPass,particleBuffer,ResourceUsage::StorageBufferWrite);
+                renderGraph.write(simulationPass,particleLists,ResourceUsage::StorageBufferWrite);
+                renderGraph.write(simulationPass,particleCounters,ResourceUsage::StorageBufferWrite);
+
+                particlePass=renderGraph.addPass("particles",RenderGraph::PassType::Graphics,[this](VkCommandBuffer commandBuffer){
+                    particleSystem.draw(commandBuffer,currentFrame,renderExtent);
+                });
+                renderGraph.read(particlePass,particleBuffer,ResourceUsage::StorageBufferReadGraphics);
+                renderGraph.read(particlePass,particleLists,ResourceUsage::StorageBufferReadGraphics);
+                renderGraph.read(particlePass,particleCounters,ResourceUsage::IndirectBuffer);
+                renderGraph.writeColor(particlePass,sceneTarget,VK_ATTACHMENT_LOAD_OP_LOAD);
+                renderGraph.readDepth(particlePass,depthBuffer);
+            }
+
+            //everything debug drawn this frame: one draw of the world space lines against the scene's depth here, one of the
+            //text and the hud on top of the final image below
+            hudInGraph=perfHud.isVisible();
+            gpuTimingInGraph=hudInGraph || frameScheduler.isEnabled(); //the on demand report needs the GPU time too
+            debugDrawInGraph=debugDrawUsed();
+            if(debugDrawInGraph){
+                debugLinePass=renderGraph.addPass("debug lines",RenderGraph::PassType::Graphics,[this](VkCommandBuffer commandBuffer){
+                    debugDraw.drawLines(commandBuffer,currentFrame,renderExtent);
+                });
+                renderGraph.writeColor(debugLinePass,sceneTarget,VK_ATTACHMENT_LOAD_OP_LOAD);
+                renderGraph.readDepth(debugLinePass,depthBuffer);
+            }
+
+            if(dynamicResolutionInGraph){
+                upscalePass=renderGraph.addPass("upscale",RenderGraph::PassType::Graphics,[this](VkCommandBuffer commandBuffer){
+                    dynamicResolution.upscale(commandBuffer,currentFrame,renderGraph.getImageView(sceneColor));
+                });
+                renderGraph.read(upscalePass,sceneColor,ResourceUsage::SampledFragment);
+                renderGraph.writeColor(upscalePass,backbuffer,VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+            }
+
+            if(debugDrawInGraph){
+                debugOverlayPass=renderGraph.addPass("debug overlay",RenderGraph::PassType::Graphics,[this](VkCommandBuffer commandBuffer){
+                    debugDraw.drawOverlay(commandBuffer,currentFrame,swapChainExtent);
+                });
+                renderGraph.writeColor(debugOverlayPass,backbuffer,VK_ATTACHMENT_LOAD_OP_LOAD);
+            }
+
+            //copies the finished image into the capture ring, the readback buffer changes every frame
+            captureInGraph=frameCapture.isCapturing();
+            if(captureInGraph){
+                captureBuffer=renderGraph.importBuffer("capture readback");
+                RenderPassHandle capturePass=renderGraph.addPass("capture",RenderGraph::PassType::Compute,[this](VkCommandBuffer commandBuffer){
+                    frameCapture.recordCopy(commandBuffer,renderGraph.getImage(backbuffer));
+                });
+                renderGraph.read(capturePass,backbuffer,ResourceUsage::TransferSrc);
+                renderGraph.write(capturePass,captureBuffer,ResourceUsage::TransferDst);
+            }
+
+            renderGraph.compile();
+            if(particlesInGraph){
+                particleSystem.setRenderPass(renderGraph.getRenderPass(particlePass));
+            }
+            if(debugDrawInGraph){
+                debugDraw.setLineRenderPass(renderGraph.getRenderPass(debugLinePass));
+                debugDraw.setOverlayRenderPass(renderGraph.getRenderPass(debugOverlayPass));
+            }
+            renderExtent=swapChainExtent;
+            if(dynamicResolutionInGraph){
+                dynamicResolution.setOutputExtent(swapChainExtent);
+                dynamicResolution.setRenderPass(renderGraph.getRenderPass(upscalePass));
+                renderExtent=dynamicResolution.getRenderExtent();
             }
+        }
 
-            VkRenderPassCreateInfo renderPassCreateInfo{};
-            {
-                renderPassCreateInfo.sType=VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-                renderPassCreateInfo.attachmentCount=1;
-                renderPassCreateInfo.subpassCount=1;
-                renderPassCreateInfo.pAttachments=&colorAttachment;
-                renderPassCreateInfo.pSubpasses=&subpass;
-                renderPassCreateInfo.dependencyCount=1;
-                renderPassCreateInfo.pDependencies=&dependency;
+        void createFrameCapture(){
+
+            PROFILE_ZONE("createFrameCapture");
+
+            frameCapture.init(deviceInfo,device,deletionQueue);
+            if(captureOnStart){
+                startCapture();
             }
-            
-            if(vkCreateRenderPass(device,&renderPassCreateInfo,nullptr,&renderPass)!=VK_SUCCESS){
+        }
 
-                throw std::runtime_error("failed to create render pass!");
+        void startCapture(){
+            if(!(deviceInfo.swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) ||
+               !imageio::supportsFormat(swapChainImageFormat)){
+                std::cerr<<"frame capture is not supported for this swapchain"<<std::endl;
+                return;
             }
+            frameCapture.start(captureDirectory,captureFormat);
+        }
 
+        //Starts or stops the capture between frames, the capture pass is added to or removed from the graph.
+        void toggleCapture(){
+            if(frameCapture.isCapturing()){
+                frameCapture.stop();
+            }
+            else{
+                startCapture();
+            }
+            if(frameCapture.isCapturing()!=captureInGraph){
+                createRenderGraph();
+            }
         }
 
         VkShaderModule createShaderModule(const std::vector<char>& code){
@@ -715,35 +1157,11 @@ class HelloTriangleApplication{
 
         }
 
-        void createFrameBuffers(){
-            swapChainFrameBuffers.resize(swapChainImageViews.size());
-
-            for(size_t i=0;i<swapChainImageViews.size();++i ){
-
-                VkImageView attachments[]={
-                    swapChainImageViews[i]
-                };
-
-                VkFramebufferCreateInfo frameBufferInfo{};
-                {
-                    frameBufferInfo.sType=VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-                    frameBufferInfo.renderPass=renderPass;
-                    frameBufferInfo.attachmentCount=1;
-                    frameBufferInfo.pAttachments= attachments;
-                    frameBufferInfo.width=swapChainExtent.width;
-                    frameBufferInfo.height=swapChainExtent.height;
-                    frameBufferInfo.layers=1; //number of layers in image arrays
-                }
-                if(vkCreateFramebuffer(device,&frameBufferInfo,nullptr,&swapChainFrameBuffers[i])!=VK_SUCCESS){
-
-                    throw std::runtime_error("failed to create frame buffer!");
-                }
-            }
-        }
-
         void createCommandPool(){
 
-                QueueFamilyIndices queueFamilyIndices= findQueueFamily(physicalDevice);
+                PROFILE_ZONE("createCommandPool");
+
+                const QueueFamilyIndices& queueFamilyIndices= deviceInfo.queueFamilies;
                 
                 VkCommandPoolCreateInfo poolInfo{};
                 {
@@ -757,7 +1175,12 @@ class HelloTriangleApplication{
                 }
         }
 
-        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size){
+        //Between these two copyBuffer() only records into one command buffer, so the startup uploads share a single
+        //submission and wait instead of waiting for the queue after each of them. Staging buffers are released through
+        //the deletion queue, which keeps them alive until the batch has been submitted.
+        void beginUploadBatch(){
+
+            PROFILE_ZONE("beginUploadBatch");
 
             VkCommandBufferAllocateInfo allocInfo{};
             {
@@ -766,43 +1189,76 @@ class HelloTriangleApplication{
                 allocInfo.commandPool=commandPool;
                 allocInfo.commandBufferCount=1;
             }
-
-            VkCommandBuffer commandBuffer;
-            vkAllocateCommandBuffers(device,&allocInfo,&commandBuffer);
+            if(vkAllocateCommandBuffers(device,&allocInfo,&uploadCommandBuffer)!=VK_SUCCESS){
+                throw std::runtime_error("failed to allocate upload command buffer!");
+            }
 
             VkCommandBufferBeginInfo beginInfo{};
             {
                 beginInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
                 beginInfo.flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
             }
+            vkBeginCommandBuffer(uploadCommandBuffer,&beginInfo);
+            uploadCopyCount=0;
+        }
 
-            vkBeginCommandBuffer(commandBuffer,&beginInfo);
+        void submitUploadBatch(){
 
-                VkBufferCopy copyRegion{};
-                {
-                    copyRegion.srcOffset=0;
-                    copyRegion.dstOffset=0;
-                    copyRegion.size=size;
-                }
-                vkCmdCopyBuffer(commandBuffer,srcBuffer,dstBuffer,1,&copyRegion);
+            PROFILE_ZONE("submitUploadBatch");
+
+            //whatever reads the uploaded buffers later sees the copies
+            VkMemoryBarrier barrier{};
+            {
+                barrier.sType=VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                barrier.srcAccessMask=VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask=VK_ACCESS_MEMORY_READ_BIT;
+            }
+            vkCmdPipelineBarrier(uploadCommandBuffer,VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,0,1,&barrier,0,nullptr,0,nullptr);
+            vkEndCommandBuffer(uploadCommandBuffer);
 
-            vkEndCommandBuffer(commandBuffer);
+            VkFenceCreateInfo fenceInfo{};
+            {
+                fenceInfo.sType=VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            }
+            VkFence fence;
+            if(vkCreateFence(device,&fenceInfo,nullptr,&fence)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create upload fence!");
+            }
 
             VkSubmitInfo submitInfo{};
             {
                 submitInfo.sType=VK_STRUCTURE_TYPE_SUBMIT_INFO;
                 submitInfo.commandBufferCount=1;
-                submitInfo.pCommandBuffers=&commandBuffer;
+                submitInfo.pCommandBuffers=&uploadCommandBuffer;
+            }
+            if(vkQueueSubmit(graphicsQueue,1,&submitInfo,fence)!=VK_SUCCESS){
+                throw std::runtime_error("failed to submit uploads!");
             }
+            //the first frame releases the staging buffers, so they have to be done by then
+            vkWaitForFences(device,1,&fence,VK_TRUE,UINT64_MAX);
+            vkDestroyFence(device,fence,nullptr);
+            vkFreeCommandBuffers(device,commandPool,1,&uploadCommandBuffer);
+            uploadCommandBuffer=VK_NULL_HANDLE;
+            std::cout<<"startup uploads: "<<uploadCopyCount<<" copies in one submission"<<std::endl;
+        }
 
-            vkQueueSubmit(graphicsQueue,1,&submitInfo,VK_NULL_HANDLE);
-            vkQueueWaitIdle(graphicsQueue); //@TODO: Add fence for copying
+        //Only records into the upload batch, every buffer upload happens during the startup.
+        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size){
 
-            vkFreeCommandBuffers(device,commandPool,1,&commandBuffer);
+            PROFILE_ZONE("copyBuffer");
 
+            if(uploadCommandBuffer==VK_NULL_HANDLE){
+                throw std::runtime_error("failed to copy buffer, no upload batch is open!");
+            }
+            VkBufferCopy copyRegion{};
+            {
+                copyRegion.size=size;
+            }
+            vkCmdCopyBuffer(uploadCommandBuffer,srcBuffer,dstBuffer,1,&copyRegion);
+            ++uploadCopyCount;
         }
 
-        void createBuffer(VkDeviceSize size,VkBufferUsageFlags usage,VkMemoryPropertyFlags properties,VkBuffer& buffer,VkDeviceMemory& bufferMemory){
+        void createBuffer(VkDeviceSize size,VkBufferUsageFlags usage,VkMemoryPropertyFlags properties,MemoryCategory category,vkutil::UniqueBuffer& buffer,vkutil::UniqueDeviceMemory& bufferMemory){
 
             VkBufferCreateInfo bufferInfo{};
             {   
@@ -812,9 +1268,11 @@ class HelloTriangleApplication{
                 bufferInfo.sharingMode=VK_SHARING_MODE_EXCLUSIVE; //owned by a single queue family at a time and ownership must be explicitly transfered before using it in another queue family
                 bufferInfo.flags=0;
             }
-            if(vkCreateBuffer(device,&bufferInfo,nullptr,&buffer)!=VK_SUCCESS){
+            VkBuffer newBuffer;
+            if(vkCreateBuffer(device,&bufferInfo,nullptr,&newBuffer)!=VK_SUCCESS){
                 throw std::runtime_error("failed to create vertex buffer!");
             }
+            buffer=vkutil::UniqueBuffer(deletionQueue,newBuffer);
 
             VkMemoryRequirements memRequirements;
             vkGetBufferMemoryRequirements(device,buffer,&memRequirements);
@@ -826,107 +1284,459 @@ class HelloTriangleApplication{
                 allocateInfo.memoryTypeIndex=findMemoryType(memRequirements.memoryTypeBits, properties); // @TODO: Test if cached is faster
             }
 
-            if(vkAllocateMemory(device,&allocateInfo,nullptr,&bufferMemory)!=VK_SUCCESS){
+            VkDeviceMemory memory;
+            if(vkutil::allocateMemory(device,allocateInfo,category,memory)!=VK_SUCCESS){
                 throw std::runtime_error("failed to allocate vertex buffer memory!");
             }
+            bufferMemory=vkutil::UniqueDeviceMemory(deletionQueue,memory);
 
             vkBindBufferMemory(device,buffer,bufferMemory,0);
 
         }
 
+        //Points the mesh at the built in quad or at the pack's data, which is uploaded straight from the mapping.
+        void loadMesh(){
+
+            PROFILE_ZONE("loadMesh");
+
+            meshVertices=vertices.data();
+            meshVertexCount=vertices.size();
+            meshIndices=indices.data();
+            meshIndexCount=indices.size();
+            if(assetPackPath.empty()){
+                return;
+            }
+
+            static_assert(sizeof(Vertex)==sizeof(pack::Vertex) && offsetof(Vertex,color)==offsetof(pack::Vertex,color) &&
+                          offsetof(Vertex,texCoord)==offsetof(pack::Vertex,texCoord),"the pack vertex layout differs from Vertex");
+            assetPack.open(assetPackPath);
+            const pack::Entry* vertexEntry=nullptr;
+            for(const pack::Entry& entry: assetPack.getEntries()){
+                if(entry.type==pack::EntryType::Vertices){
+                    vertexEntry=&entry;
+                    break;
+                }
+            }
+            if(!vertexEntry){
+                throw std::runtime_error("asset pack "+assetPackPath+" has no mesh!");
+            }
+            std::string name=vertexEntry->name;
+            std::string mesh=name.substr(0,name.rfind('/'));
+            meshVertices=assetPack.get<Vertex>(name,pack::EntryType::Vertices,meshVertexCount);
+            meshIndices=assetPack.get<uint16_t>(mesh+"/indices",pack::EntryType::Indices,meshIndexCount);
+            if(meshVertexCount==0 || meshIndexCount==0){
+                throw std::runtime_error("asset pack mesh "+mesh+" is empty!");
+            }
+
+            const AssetPack::Stats& stats=assetPack.getStats();
+            std::cout<<"asset pack "<<assetPackPath<<": mesh "<<mesh<<" with "<<meshVertexCount<<" vertices and "
+                     <<meshIndexCount/3<<" triangles, opened in "<<stats.openMs<<" ms";
+            if(stats.decompressedBytes>0){
+                std::cout<<", "<<stats.decompressedBytes/1024<<" KiB decompressed in "<<stats.decompressMs<<" ms";
+            }
+            std::cout<<std::endl;
+        }
+
         void createVertexBuffer(){
 
-            VkDeviceSize bufferSize= sizeof(vertices[0])*vertices.size();
+            PROFILE_ZONE("createVertexBuffer");
+
+            VkDeviceSize bufferSize= sizeof(Vertex)*meshVertexCount;
                 
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingBufferMemory;
+            vkutil::UniqueBuffer stagingBuffer;
+            vkutil::UniqueDeviceMemory stagingBufferMemory;
            
-            createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,stagingBuffer,stagingBufferMemory);          
+            createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,MemoryCategory::Staging,stagingBuffer,stagingBufferMemory);          
 
             void* data;
             vkMapMemory(device,stagingBufferMemory,0,bufferSize,0,&data);
-            memcpy(data,vertices.data(),(size_t)bufferSize);
+            memcpy(data,meshVertices,(size_t)bufferSize);
             vkUnmapMemory(device,stagingBufferMemory);
+            traceUpload("vertices",meshVertices,bufferSize);
 
-            createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,vertexBuffer,vertexBufferMemory);
+            createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Geometry,vertexBuffer,vertexBufferMemory);
             copyBuffer(stagingBuffer,vertexBuffer,bufferSize);
 
-            vkDestroyBuffer(device,stagingBuffer,nullptr);
-            vkFreeMemory(device,stagingBufferMemory,nullptr);
-
         }
 
         void createIndexBuffer(){
 
-            VkDeviceSize bufferSize= sizeof(indices[0])*indices.size();
+            PROFILE_ZONE("createIndexBuffer");
+
+            VkDeviceSize bufferSize= sizeof(uint16_t)*meshIndexCount;
 
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingBufferMemory;
+            vkutil::UniqueBuffer stagingBuffer;
+            vkutil::UniqueDeviceMemory stagingBufferMemory;
 
-            createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,stagingBuffer,stagingBufferMemory);
+            createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,MemoryCategory::Staging,stagingBuffer,stagingBufferMemory);
 
             void* data;
             vkMapMemory(device,stagingBufferMemory,0,bufferSize,0,&data);
-            memcpy(data,indices.data(),(size_t)bufferSize);
+            memcpy(data,meshIndices,(size_t)bufferSize);
             vkUnmapMemory(device,stagingBufferMemory);
+            traceUpload("indices",meshIndices,bufferSize);
 
-            createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,indexBuffer,indexBufferMemory);
+            createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,MemoryCategory::Geometry,indexBuffer,indexBufferMemory);
             copyBuffer(stagingBuffer,indexBuffer,bufferSize);
 
-            vkDestroyBuffer(device,stagingBuffer,nullptr);
-            vkFreeMemory(device,stagingBufferMemory,nullptr);
-
         }
 
         void createUniformBuffers(){
 
+            PROFILE_ZONE("createUniformBuffers");
+
        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
-            uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-            uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-            uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+            uniformBuffers.resize(sceneSlotCount());
+            uniformBuffersMemory.resize(sceneSlotCount());
+            uniformBuffersMapped.resize(sceneSlotCount());
 
-            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-                createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
+            for (size_t i = 0; i < sceneSlotCount(); i++) {
+                createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Uniforms, uniformBuffers[i], uniformBuffersMemory[i]);
                 vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
             }
 
         }
 
-        void createDescripterPool(){
+        //Small demo hierarchy: the spinning quad with four orbiting children, each of them carrying four more.
+        //Every node is drawn as one instance of the quad.
+        void createScene(){
 
-            VkDescriptorPoolSize poolSize{};
-            {
-                poolSize.type=VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                poolSize.descriptorCount=static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-            }
+            PROFILE_ZONE("createScene");
 
-            VkDescriptorPoolCreateInfo poolInfo{};
-            {
-                poolInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-                poolInfo.poolSizeCount=1;
-                poolInfo.pPoolSizes=&poolSize;
-                poolInfo.maxSets=static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-            }
+            const float identityRotation[4]={0.0f,0.0f,0.0f,1.0f};
+            const float noTranslation[3]={0.0f,0.0f,0.0f};
+            const float unitScale[3]={1.0f,1.0f,1.0f};
+            const float childScale[3]={0.35f,0.35f,0.35f};
+            const float offsets[4][3]={{1.0f,0.0f,0.0f},{-1.0f,0.0f,0.0f},{0.0f,1.0f,0.0f},{0.0f,-1.0f,0.0f}};
 
-            if(vkCreateDescriptorPool(device,&poolInfo,nullptr,&descriptorPool)!=VK_SUCCESS){
-                throw std::runtime_error("failed to create descriptor pool!");
+            sceneRoot=scene.addNode(TransformHierarchy::noParent,noTranslation,identityRotation,unitScale);
+            for(const auto& offset: offsets){
+                NodeHandle child=scene.addNode(sceneRoot,offset,identityRotation,childScale);
+                sceneSpinners.push_back(child);
+                for(const auto& childOffset: offsets){
+                    scene.addNode(child,childOffset,identityRotation,childScale);
+                }
             }
-            
+            //a scene this small never reaches the parallel threshold, workers would only sit idle
+            if(scene.size()>=TransformHierarchy::parallelThreshold){
+                scene.setThreadCount(std::max(std::thread::hardware_concurrency()/2,1u));
+            }
+            scene.update();
+        }
+
+        //Per frame host visible buffers the world matrices are copied into, bound as a per instance vertex buffer.
+        void createInstanceBuffers(){
+
+            PROFILE_ZONE("createInstanceBuffers");
+
+            //one more instance after the scene's, an identity matrix for geometry that is already in world space
+            VkDeviceSize bufferSize=sizeof(TransformMatrix)*(scene.size()+1);
+            TransformMatrix identity{{1.0f,0.0f,0.0f,0.0f, 0.0f,1.0f,0.0f,0.0f, 0.0f,0.0f,1.0f,0.0f, 0.0f,0.0f,0.0f,1.0f}};
+
+            instanceBuffers.resize(sceneSlotCount());
+            instanceBuffersMemory.resize(sceneSlotCount());
+            instanceBuffersMapped.resize(sceneSlotCount());
+
+            for(size_t i=0; i<sceneSlotCount(); i++){
+                //also read by the meshlet culling dispatch
+                createBuffer(bufferSize,VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             MemoryCategory::Geometry,instanceBuffers[i],instanceBuffersMemory[i]);
+                vkMapMemory(device,instanceBuffersMemory[i],0,bufferSize,0,&instanceBuffersMapped[i]);
+                memcpy(static_cast<TransformMatrix*>(instanceBuffersMapped[i])+scene.size(),&identity,sizeof(identity));
+            }
+        }
+
+        //Splits the geometry into meshlets and culls them on the GPU every frame, G switches back to plain draws
+        //and O turns the occlusion culling against the depth pyramid on and off.
+        void createMeshletCuller(){
+
+            PROFILE_ZONE("createMeshletCuller");
+
+            if(!MeshletCuller::isSupported(enabledFeatures)){
+                std::cout<<"meshlet culling needs multiDrawIndirect and drawIndirectFirstInstance, drawing without it"<<std::endl;
+                return;
+            }
+
+            meshletCuller.init(deviceInfo,device,deletionQueue,sceneMeshlets,sceneSlotCount(),static_cast<uint32_t>(scene.size()),loadShader("meshlet_cull"),
+                               drawIndirectCountEnabled,[this](VkBuffer src, VkBuffer dst, VkDeviceSize size){ copyBuffer(src,dst,size); });
+            //the culling always binds a pyramid, occlusion culling only fills it when the depth buffer can be sampled
+            depthPyramid.init(deviceInfo,device,deletionQueue,sceneSlotCount(),loadShader("depth_pyramid"));
+            depthPyramid.resize(swapChainExtent);
+            for(uint32_t i=0;i<sceneSlotCount();++i){
+                meshletCuller.bindSlot(i,uniformBuffers[i],sizeof(UniformBufferObject),instanceBuffers[i],sizeof(TransformMatrix)*scene.size());
+                meshletCuller.bindDepthPyramid(i,depthPyramid.getView(),depthPyramid.getSampler());
+            }
+            occlusionCullingSupported=DepthPyramid::supportsDepthFormat(physicalDevice,findDepthFormat());
+            if(!occlusionCullingSupported){
+                std::cout<<"the depth format can not be sampled, occlusion culling is off"<<std::endl;
+            }
+
+            meshletCullingSupported=true;
+            meshletCulling=true;
+            occlusionCulling=occlusionCullingSupported;
+            sceneMeshlets.clear();
+        }
+
+        //Splits the mesh into meshlets for the culling, plain CPU work that runs next to the device setup.
+        void buildMeshlets(){
+
+            PROFILE_ZONE("buildMeshlets");
+
+            if(MeshletCuller::isSupported(enabledFeatures)){
+                sceneMeshlets=meshlets::build(meshIndices,meshIndexCount,&meshVertices[0].pos,sizeof(Vertex));
+            }
+        }
+
+        //Fountain of GPU particles at the origin, only with --particles <count>. Their cost is reported per million
+        //particles when the app quits.
+        void createParticleSystem(){
+
+            PROFILE_ZONE("createParticleSystem");
+
+            if(particleCount==0){
+                return;
+            }
+            std::vector<std::vector<char>> shaderCode;
+            for(const char* name: {"particle_emit","particle_simulate","particle_compact","particle_vert","particle_frag"}){
+                shaderCode.push_back(loadShader(name));
+            }
+            ParticleSystem::Settings settings;
+            settings.capacity=particleCount;
+            particleSystem.init(deviceInfo,device,deletionQueue,settings,sceneSlotCount(),shaderCode,
+                                [this](VkBuffer src, VkBuffer dst, VkDeviceSize size){ copyBuffer(src,dst,size); });
+            for(uint32_t i=0;i<sceneSlotCount();++i){
+                particleSystem.bindSlot(i,uniformBuffers[i],sizeof(UniformBufferObject));
+            }
+        }
+
+        //Point and spot lights with --lights <count>, orbiting in a box around the scene. Their ranges shrink with the count
+        //so every point is reached by a handful of them, which keeps the cluster lists short however many there are.
+        void createClusteredLighting(){
+
+            PROFILE_ZONE("createClusteredLighting");
+
+            std::vector<char> shaderCode;
+            if(lightCount>0){
+                shaderCode=loadShader("light_cluster");
+            }
+            const QueueFamilyIndices& queueFamilyIndices= deviceInfo.queueFamilies;
+            clusteredLighting.init(physicalDevice,device,deletionQueue,lightCount,sceneSlotCount(),shaderCode,
+                                   {queueFamilyIndices.graphicsFamily.value(),queueFamilyIndices.computeFamily.value()});
+
+            const float halfWidth=1.6f, halfHeight=0.6f;
+            const float volume=(2.0f*halfWidth)*(2.0f*halfWidth)*(2.0f*halfHeight);
+            const float lightsPerPoint=4.0f;
+            float range=std::cbrt(3.0f*lightsPerPoint*volume/(glm::radians(720.0f)*std::max(lightCount,1u)));
+            std::mt19937 random(7);
+            std::uniform_real_distribution<float> unit(0.0f,1.0f);
+            lightOrbits.resize(lightCount);
+            for(uint32_t i=0;i<lightCount;++i){
+                LightOrbit& orbit=lightOrbits[i];
+                orbit.radius=halfWidth*std::sqrt(unit(random));
+                orbit.angle=unit(random)*glm::radians(360.0f);
+                orbit.spot=i%4==3;
+                //spot lights hang above the quads and look down on them
+                orbit.height= orbit.spot ? halfHeight*unit(random) : halfHeight*(unit(random)*2.0f-1.0f);
+                orbit.speed=(unit(random)-0.5f)*2.0f;
+                orbit.range= orbit.spot ? range*1.5f : range;
+                //saturated color of a random hue
+                float hue=unit(random)*6.0f;
+                const float hueOffsets[3]={0.0f,4.0f,2.0f};
+                for(int c=0;c<3;++c){
+                    orbit.color[c]=std::clamp(std::abs(std::fmod(hue+hueOffsets[c],6.0f)-3.0f)-1.0f,0.0f,1.0f);
+                }
+            }
+        }
+
+        //Debug lines and text with --debug-draw or --debug-draw-stress <count>, always created since the hud draws with it.
+        //The mesh bounds are what the boxes around the scene nodes are made of, the stress primitives are scattered over
+        //the same box the lights orbit in.
+        void createDebugDraw(){
+
+            PROFILE_ZONE("createDebugDraw");
+
+            std::vector<std::vector<char>> shaderCode;
+            for(const char* name: {"debug_line_vert","debug_line_frag","debug_overlay_vert","debug_overlay_frag"}){
+                shaderCode.push_back(loadShader(name));
+            }
+            debugDraw.init(physicalDevice,device,deletionQueue,sceneSlotCount(),shaderCode);
+            for(uint32_t i=0;i<sceneSlotCount();++i){
+                debugDraw.bindSlot(i,uniformBuffers[i],sizeof(UniformBufferObject));
+            }
+
+            for(int c=0;c<3;++c){
+                meshBounds[0][c]=meshBounds[1][c]=meshVertexCount>0 ? meshVertices[0].pos[c] : 0.0f;
+            }
+            for(size_t i=0;i<meshVertexCount;++i){
+                for(int c=0;c<3;++c){
+                    meshBounds[0][c]=std::min(meshBounds[0][c],meshVertices[i].pos[c]);
+                    meshBounds[1][c]=std::max(meshBounds[1][c],meshVertices[i].pos[c]);
+                }
+            }
+
+            std::mt19937 random(11);
+            std::uniform_real_distribution<float> unit(0.0f,1.0f);
+            stressPrimitives.resize(static_cast<size_t>(debugDrawStress)*4);
+            for(uint32_t i=0;i<debugDrawStress;++i){
+                float* primitive=&stressPrimitives[static_cast<size_t>(i)*4];
+                primitive[0]=(unit(random)*2.0f-1.0f)*1.6f;
+                primitive[1]=(unit(random)*2.0f-1.0f)*1.6f;
+                primitive[2]=(unit(random)*2.0f-1.0f)*0.6f;
+                primitive[3]=0.005f+unit(random)*0.025f;
+            }
+        }
+
+        void createPerfHud(){
+
+            PROFILE_ZONE("createPerfHud");
+
+            perfHud.init(deviceInfo,device,MAX_FRAMES_IN_FLIGHT);
+        }
+
+        //Scales the scene's resolution to keep the GPU time of a frame within --resolution-budget <ms>.
+        void createDynamicResolution(){
+
+            PROFILE_ZONE("createDynamicResolution");
+
+            if(resolutionBudgetMs<=0.0f){
+                return;
+            }
+            const std::vector<char>& vertShaderCode=loadShader("upscale_vert");
+            const std::vector<char>& fragShaderCode=loadShader("upscale_frag");
+            DynamicResolution::Settings settings;
+            settings.budgetMs=resolutionBudgetMs;
+            settings.sharpness= upscaleSharpen ? 0.5f : 0.0f;
+            dynamicResolution.init(deviceInfo,device,deletionQueue,settings,sceneSlotCount(),vertShaderCode,fragShaderCode);
+        }
+
+        //Terrain of --world <cells> chunks, generated on the streamer's worker threads as if read from disk.
+        void createWorldStreamer(){
+
+            PROFILE_ZONE("createWorldStreamer");
+
+            if(worldCells<=0){
+                return;
+            }
+            WorldStreamer::Settings settings;
+            settings.cells=worldCells;
+            settings.budget=static_cast<VkDeviceSize>(worldBudgetMiB)<<20;
+            worldStreamer.init(physicalDevice,device,graphicsQueue,deviceInfo.queueFamilies.graphicsFamily.value(),deletionQueue,settings,
+                               [settings](int32_t x, int32_t y){ return buildTerrainChunk(x,y,settings); });
+            worldStreaming=true;
+        }
+
+        //Height in [0,1] of the terrain at a world position, a few octaves of value noise. Neighbouring chunks
+        //sample the same positions along their shared edge, so there are no seams.
+        static float terrainHeight(float x, float y){
+            auto hash=[](int32_t x, int32_t y){
+                uint32_t h=static_cast<uint32_t>(x)*0x8da6b343u ^ static_cast<uint32_t>(y)*0xd8163841u;
+                h=(h^(h>>13))*0x5bd1e995u;
+                return static_cast<float>((h^(h>>15)) & 0xFFFFu)/65535.0f;
+            };
+            float height=0.0f;
+            float amplitude=0.5f;
+            float frequency=0.5f;
+            for(int octave=0;octave<4;++octave){
+                float fx=x*frequency, fy=y*frequency;
+                int32_t ix=static_cast<int32_t>(std::floor(fx)), iy=static_cast<int32_t>(std::floor(fy));
+                float tx=fx-ix, ty=fy-iy;
+                tx=tx*tx*(3.0f-2.0f*tx);
+                ty=ty*ty*(3.0f-2.0f*ty);
+                float bottom=hash(ix,iy)+(hash(ix+1,iy)-hash(ix,iy))*tx;
+                float top=hash(ix,iy+1)+(hash(ix+1,iy+1)-hash(ix,iy+1))*tx;
+                height+=amplitude*(bottom+(top-bottom)*ty);
+                amplitude*=0.5f;
+                frequency*=2.0f;
+            }
+            return height/0.9375f;
+        }
+
+        //Grid of terrainResolution x terrainResolution quads covering one cell, below the scene's quads.
+        static WorldChunkData buildTerrainChunk(int32_t cellX, int32_t cellY, const WorldStreamer::Settings& settings){
+
+            constexpr uint32_t terrainResolution=64;
+            float originX=(cellX-settings.cells*0.5f)*settings.cellSize;
+            float originY=(cellY-settings.cells*0.5f)*settings.cellSize;
+            float step=settings.cellSize/terrainResolution;
+
+            std::vector<Vertex> vertices;
+            vertices.reserve((terrainResolution+1)*(terrainResolution+1));
+            for(uint32_t y=0;y<=terrainResolution;++y){
+                for(uint32_t x=0;x<=terrainResolution;++x){
+                    float worldX=originX+x*step;
+                    float worldY=originY+y*step;
+                    float height=terrainHeight(worldX,worldY);
+                    //green valleys, brown slopes, white peaks
+                    glm::vec3 color= height<0.45f ? glm::vec3(0.2f,0.5f,0.2f) : height<0.7f ? glm::vec3(0.5f,0.4f,0.3f) : glm::vec3(0.9f,0.9f,0.9f);
+                    vertices.push_back({{worldX,worldY,-1.0f+height*0.6f},color,{static_cast<float>(x)/terrainResolution,static_cast<float>(y)/terrainResolution}});
+                }
+            }
+
+            WorldChunkData chunk;
+            chunk.indices.reserve(terrainResolution*terrainResolution*6);
+            for(uint32_t y=0;y<terrainResolution;++y){
+                for(uint32_t x=0;x<terrainResolution;++x){
+                    uint16_t corner=static_cast<uint16_t>(y*(terrainResolution+1)+x);
+                    uint16_t above=static_cast<uint16_t>(corner+terrainResolution+1);
+                    chunk.indices.insert(chunk.indices.end(),{corner,static_cast<uint16_t>(corner+1),static_cast<uint16_t>(above+1),
+                                                              static_cast<uint16_t>(above+1),above,corner});
+                }
+            }
+            const char* bytes=reinterpret_cast<const char*>(vertices.data());
+            chunk.vertices.assign(bytes,bytes+vertices.size()*sizeof(Vertex));
+            return chunk;
+        }
+
+        //Camera of the streamed world: a circle over the terrain, looking ahead and down.
+        void worldCamera(float time, glm::vec3& eye, glm::vec3& target) const{
+            float radius=worldCells*0.3f;
+            float angle=time*2.0f/radius; //2 units per second
+            glm::vec3 forward(-std::sin(angle),std::cos(angle),0.0f);
+            eye=glm::vec3(radius*std::cos(angle),radius*std::sin(angle),0.5f);
+            target=eye+forward*3.0f+glm::vec3(0.0f,0.0f,-1.2f);
+        }
+
+        void createDescripterPool(){
+
+            PROFILE_ZONE("createDescripterPool");
+
+            std::array<VkDescriptorPoolSize,2> poolSizes{};
+            {
+                poolSizes[0].type=VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                poolSizes[0].descriptorCount=sceneSlotCount();
+                poolSizes[1].type=VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                poolSizes[1].descriptorCount=sceneSlotCount();
+            }
+
+            VkDescriptorPoolCreateInfo poolInfo{};
+            {
+                poolInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+                poolInfo.poolSizeCount=static_cast<uint32_t>(poolSizes.size());
+                poolInfo.pPoolSizes=poolSizes.data();
+                poolInfo.maxSets=sceneSlotCount();
+            }
+
+            if(vkCreateDescriptorPool(device,&poolInfo,nullptr,&descriptorPool)!=VK_SUCCESS){
+                throw std::runtime_error("failed to create descriptor pool!");
+            }
+            
         }
 
         void createDescriptorSets(){
 
-            std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+            PROFILE_ZONE("createDescriptorSets");
+
+            std::vector<VkDescriptorSetLayout> layouts(sceneSlotCount(), descriptorSetLayout);
             VkDescriptorSetAllocateInfo allocInfo{};
            {
                 allocInfo.sType=VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-                allocInfo.descriptorSetCount=static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+                allocInfo.descriptorSetCount=sceneSlotCount();
                 allocInfo.descriptorPool=descriptorPool;
                 allocInfo.pSetLayouts=layouts.data();
            } 
 
-            descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+            descriptorSets.resize(sceneSlotCount());
 
 
             if(vkAllocateDescriptorSets(device,&allocInfo,descriptorSets.data())){
@@ -935,7 +1745,7 @@ class HelloTriangleApplication{
 
             }
 
-            for(uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; ++i){
+            for(uint32_t i=0; i<sceneSlotCount(); ++i){
 
                     VkDescriptorBufferInfo bufferInfo{};
                     {
@@ -956,40 +1766,177 @@ class HelloTriangleApplication{
                     }
 
                     vkUpdateDescriptorSets(device,1,&descriptorWrite,0,nullptr);
+                    updateTextureDescriptor(i);
             }
         }
 
-        //This function will find the memory type that is suitable for the buffer corresponding to the properties and type filter
-        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties){
+        //Points the frame's sampler binding at whatever the streamer currently has resident for the texture.
+        //Only called for a frame whose fence was waited on, so the set is not in use by the GPU.
+        void updateTextureDescriptor(uint32_t frame){
 
-            VkPhysicalDeviceMemoryProperties memProperties;
-            vkGetPhysicalDeviceMemoryProperties(physicalDevice,&memProperties);
+            VkDescriptorImageInfo imageInfo{};
+            {
+                imageInfo.imageLayout=VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                imageInfo.imageView=textureStreamer.getView(texture);
+                imageInfo.sampler=textureStreamer.getSampler();
+            }
 
-            for(uint32_t i=0; i<memProperties.memoryTypeCount; i++){
-                if(typeFilter & (1<<i) && (memProperties.memoryTypes[i].propertyFlags & properties)== properties){
-                    return i;
+            VkWriteDescriptorSet descriptorWrite{};
+            {
+                descriptorWrite.sType=VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrite.dstSet=descriptorSets[frame];
+                descriptorWrite.dstBinding=1;
+                descriptorWrite.dstArrayElement=0;
+                descriptorWrite.descriptorType=VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptorWrite.descriptorCount=1;
+                descriptorWrite.pImageInfo=&imageInfo;
+            }
+
+            vkUpdateDescriptorSets(device,1,&descriptorWrite,0,nullptr);
+            descriptorTextureVersions[frame]=textureStreamer.getVersion();
+        }
+
+        void createTextures(){
+
+            PROFILE_ZONE("createTextures");
+
+            const QueueFamilyIndices& queueFamilyIndices= deviceInfo.queueFamilies;
+            textureStreamer.init(physicalDevice,device,graphicsQueue,queueFamilyIndices.graphicsFamily.value(),deletionQueue,enabledFeatures);
+            descriptorTextureVersions.assign(sceneSlotCount(),0);
+
+            const std::string texturePath=std::string(ASSET_DIR)+"/textures/texture.ktx2"; //optional, not part of the repo
+            if(std::filesystem::exists(texturePath)){
+                if(sessionWriter.isOpen() || sessionReader.isOpen()){
+                    std::vector<char> file=readFile(texturePath);
+                    traceUpload(texturePath,file.data(),file.size());
                 }
+                texture=textureStreamer.load(texturePath);
+                return;
             }
-            throw std::runtime_error("failed to find suitable memory type!");
+
+            //no texture shipped, fall back to a checkerboard so the sampling path is still exercised
+            const uint32_t size=256;
+            std::vector<char> pixels(size*size*4);
+            for(uint32_t y=0;y<size;++y){
+                for(uint32_t x=0;x<size;++x){
+                    char value= ((x/32)+(y/32))%2 ? char(255) : char(64);
+                    char* pixel=&pixels[(y*size+x)*4];
+                    pixel[0]=value;
+                    pixel[1]=value;
+                    pixel[2]=value;
+                    pixel[3]=char(255);
+                }
+            }
+            traceUpload("checkerboard",pixels.data(),pixels.size());
+            texture=textureStreamer.loadPixels(VK_FORMAT_R8G8B8A8_UNORM,size,size,std::move(pixels));
+        }
+
+        void createSessionCapture(){
+
+            PROFILE_ZONE("createSessionCapture");
+
+            if(!recordPath.empty() && batchJobCount==0){
+                sessionWriter.open(recordPath,swapChainExtent);
+            }
+        }
+
+        //Uploads go into a recording as hashes only, a replay warns when this build uploads different data.
+        void traceUpload(const std::string& name, const void* data, uint64_t size){
+            sessionWriter.recordUpload(name,data,size);
+            if(sessionReader.isOpen()){
+                sessionReader.checkUpload(name,data,size);
+            }
+        }
+
+        //The draws of the scene unless a replay dictates them.
+        std::vector<SessionDraw> sceneDraws() const{
+            SessionDraw draw;
+            draw.indexCount=static_cast<uint32_t>(meshIndexCount);
+            draw.instanceCount=static_cast<uint32_t>(scene.size());
+            return {draw};
+        }
+        //This function will find the memory type that is suitable for the buffer corresponding to the properties and type filter
+        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties){
+
+            return deviceInfo.findMemoryType(typeFilter,properties);
         }
 
         void createCommandBuffers(){
-            commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-            
-            VkCommandBufferAllocateInfo allocInfo{};
-            {
-                allocInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-                allocInfo.commandPool=commandPool;
-                allocInfo.level=VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-                allocInfo.commandBufferCount=commandBuffers.size();
+            PROFILE_ZONE("createCommandBuffers");
+            //one per frame in flight and swapchain image, see recordingKey()
+            commandBufferCache.init(device,commandPool,deletionQueue,MAX_FRAMES_IN_FLIGHT);
+            commandBufferCache.resize(static_cast<uint32_t>(swapChainImages.size()));
+        }
+
+        //Everything recordCommanbuffer() bakes into the recording besides the frame slot and the swapchain image. Uniforms,
+        //instance matrices and culling results are written into the slot's buffers every frame, the recording only points at them.
+        uint64_t recordingKey() const{
+            CommandBufferCache::Key key;
+            key.add(renderGraphGeneration).add(pipelineGeneration).add(descriptorTextureVersions[currentFrame]);
+            key.add(renderExtent).add(scene.size());
+            if(occlusionCullingInGraph){
+                //the first recording moves the pyramid out of its initial layout, the cull tests against it once it is valid
+                key.add(depthPyramid.isInitialized()).add(depthPyramid.isValid()).add(depthPyramid.getContentExtent());
+            }
+            if(worldStreaming){
+                key.add(worldStreamer.getResidentVersion());
+            }
+            if(debugDrawInGraph){
+                key.add(debugDraw.getVersion());
+            }
+            key.add(frameDraws.size());
+            if(!frameDraws.empty()){
+                key.add(frameDraws.data(),frameDraws.size()*sizeof(SessionDraw));
+            }
+            return key.get();
+        }
+
+        //Frames that record something new every frame: timestamps of the profiler, the capture copy into this frame's
+        //readback buffer, the particle time step in push constants, the acquire half of compute transfers.
+        bool recordingCacheable() const{
+            return !recordEveryFrame && !gpuProfiler.isActive() && !captureInGraph && !particlesInGraph && !asyncCompute.hasTransfers(currentFrame);
+        }
+
+        //CPU side of what a recording does, for frames that submit an earlier one again.
+        void resubmitRecording(){
+            if(meshletCullingInGraph){
+                meshletCuller.resubmitted(currentFrame);
+            }
+            if(dynamicResolutionInGraph){
+                dynamicResolution.resubmitted(currentFrame);
+            }
+            if(gpuTimingInGraph){
+                perfHud.resubmitted(currentFrame);
+            }
+            textureStreamer.markUsed(texture);
+        }
+
+        //What the hud shows besides timings. Meshlet culling decides on the GPU what is drawn, its counts are a frame old.
+        PerfHud::Counters hudCounters() const{
+            PerfHud::Counters counters;
+            if(meshletCullingInGraph){
+                MeshletCuller::Stats lastFrame=meshletCuller.getLastFrame();
+                counters.meshletsDrawn=static_cast<uint32_t>(lastFrame.drawn);
+                counters.meshlets=static_cast<uint32_t>(lastFrame.clusters);
+            }
+            else{
+                for(const SessionDraw& draw: frameDraws){
+                    ++counters.draws;
+                    counters.triangles+=static_cast<uint64_t>(draw.indexCount/3)*draw.instanceCount;
+                }
             }
-            if(vkAllocateCommandBuffers(device,&allocInfo,commandBuffers.data())!=VK_SUCCESS){
-                throw std::runtime_error("failed to allocate command buffer!");
+            if(worldStreaming){
+                counters.draws+=static_cast<uint32_t>(worldStreamer.getResidentChunks());
+                counters.chunkUploads=worldStreamer.getPendingUploads();
             }
+            counters.textureUploads=textureStreamer.getPendingUploads();
+            return counters;
         }
 
         void recordCommanbuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex){
 
+            PROFILE_ZONE("recordCommanbuffer");
+
             VkCommandBufferBeginInfo beginInfo{};
             {
                 beginInfo.sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -1001,47 +1948,51 @@ class HelloTriangleApplication{
                 throw std::runtime_error("failed to begin recording command buffer!");
             }
 
-            VkClearValue clearColor={{{0.0f, 0.0f, 0.0f, 1.0f}}};
-
-            VkRenderPassBeginInfo renderPassInfo{};
+            gpuProfiler.beginFrame(commandBuffer,currentFrame);
+            if(gpuTimingInGraph){
+                perfHud.beginFrame(commandBuffer,currentFrame);
+            }
             {
-                renderPassInfo.sType=VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-                renderPassInfo.renderPass=renderPass;
-                renderPassInfo.framebuffer=swapChainFrameBuffers[imageIndex];
-                renderPassInfo.renderArea.offset={0,0};
-                renderPassInfo.renderArea.extent=swapChainExtent;
-                renderPassInfo.clearValueCount=1;
-                renderPassInfo.pClearValues=&clearColor;
-            }
-
-            vkCmdBeginRenderPass(commandBuffer,&renderPassInfo,VK_SUBPASS_CONTENTS_INLINE);
-                vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,graphicsPipeline);
-
-                VkBuffer vertexBuffers[]= {vertexBuffer};
-                VkDeviceSize offsets[]={0};
-                vkCmdBindVertexBuffers(commandBuffer,0,1,vertexBuffers,offsets);
-                vkCmdBindIndexBuffer(commandBuffer,indexBuffer,0,VK_INDEX_TYPE_UINT16);
-                
-                VkViewport viewport{};
-                {
-                    viewport.x=0.0f;
-                    viewport.y=0.0f;
-                    viewport.height= static_cast<float>(swapChainExtent.height);
-                    viewport.width=static_cast<float>(swapChainExtent.width);
-                    viewport.minDepth=0.0f;
-                    viewport.maxDepth=1.0f;
+                GpuProfileZone frameZone(gpuProfiler,commandBuffer,"frame");
+
+                //buffers and images the compute queue handed over this frame
+                asyncCompute.recordAcquires(commandBuffer,currentFrame);
+
+                renderGraph.setImportedImage(backbuffer,swapChainImages[imageIndex],swapChainImageViews[imageIndex]);
+                if(meshletCullingInGraph){
+                    renderGraph.setImportedBuffer(meshletDraws,meshletCuller.getDrawBuffer(currentFrame));
+                    renderGraph.setImportedBuffer(meshletDrawCount,meshletCuller.getCountBuffer(currentFrame));
+                    meshletCuller.bindDepthPyramid(currentFrame,depthPyramid.getView(),depthPyramid.getSampler());
+                }
+                if(occlusionCullingInGraph){
+                    depthPyramid.prepare(commandBuffer,currentFrame,renderGraph.getImageView(depthBuffer));
+                    renderGraph.setImportedImage(depthPyramidImage,depthPyramid.getImage(),depthPyramid.getView());
+                    renderGraph.setImportedBuffer(meshletVisibility,meshletCuller.getVisibilityBuffer(currentFrame));
+                }
+                if(lightingInGraph){
+                    renderGraph.setImportedBuffer(lightClusters,clusteredLighting.getClusterBuffer(currentFrame));
+                    renderGraph.setImportedBuffer(viewLights,clusteredLighting.getViewLightBuffer(currentFrame));
+                }
+                if(particlesInGraph){
+                    renderGraph.setImportedBuffer(particleBuffer,particleSystem.getParticleBuffer());
+                    renderGraph.setImportedBuffer(particleLists,particleSystem.getListBuffer());
+                    renderGraph.setImportedBuffer(particleCounters,particleSystem.getCounterBuffer());
+                }
+                if(captureInGraph){
+                    renderGraph.setImportedBuffer(captureBuffer,frameCapture.acquire(frameCounter,swapChainExtent,swapChainImageFormat));
+                }
+                if(dynamicResolutionInGraph){
+                    dynamicResolution.beginFrame(commandBuffer,currentFrame);
+                }
+                renderGraph.execute(commandBuffer);
+                if(dynamicResolutionInGraph){
+                    dynamicResolution.endFrame(commandBuffer,currentFrame);
                 }
-                vkCmdSetViewport(commandBuffer,0,1,&viewport);
+            }
+            if(gpuTimingInGraph){
+                perfHud.endFrame(commandBuffer,currentFrame);
+            }
 
-                VkRect2D scissor{
-                    .extent=swapChainExtent,
-                    .offset={0,0}
-                };
-                vkCmdSetScissor(commandBuffer,0,1,&scissor);
-                vkCmdBindDescriptorSets(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,pipelineLayout,0,1,&descriptorSets[currentFrame],0,nullptr);
-                vkCmdDrawIndexed(commandBuffer,static_cast<uint32_t>(indices.size()),1,0,0,0);
-            vkCmdEndRenderPass(commandBuffer);
-            
             if(vkEndCommandBuffer(commandBuffer)!=VK_SUCCESS){
 
                 throw std::runtime_error("failed to record command buffer!");
@@ -1049,11 +2000,63 @@ class HelloTriangleApplication{
 
         }
        
+        //Records the scene with the uniforms and instances of slot (frame in flight or batch target), the render pass has already begun.
+        //With gpuCulled the draws come from the meshlet culling, lateDraws picks the ones its second phase found.
+        void drawScene(VkCommandBuffer commandBuffer, uint32_t slot, VkExtent2D extent, const std::vector<SessionDraw>& draws, bool gpuCulled, bool lateDraws=false){
+
+            vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,graphicsPipeline);
+
+            VkBuffer vertexBuffers[]= {vertexBuffer,instanceBuffers[slot]};
+            VkDeviceSize offsets[]={0,0};
+            vkCmdBindVertexBuffers(commandBuffer,0,2,vertexBuffers,offsets);
+            vkCmdBindIndexBuffer(commandBuffer,indexBuffer,0,VK_INDEX_TYPE_UINT16);
+
+            VkViewport viewport{};
+            {
+                viewport.x=0.0f;
+                viewport.y=0.0f;
+                viewport.height= static_cast<float>(extent.height);
+                viewport.width=static_cast<float>(extent.width);
+                viewport.minDepth=0.0f;
+                viewport.maxDepth=1.0f;
+            }
+            vkCmdSetViewport(commandBuffer,0,1,&viewport);
+
+            VkRect2D scissor{
+                .extent=extent,
+                .offset={0,0}
+            };
+            vkCmdSetScissor(commandBuffer,0,1,&scissor);
+            VkDescriptorSet sets[2]={descriptorSets[slot],clusteredLighting.getDescriptorSet(slot)};
+            vkCmdBindDescriptorSets(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,pipelineLayout,0,2,sets,0,nullptr);
+            if(gpuCulled){
+                if(lateDraws){
+                    meshletCuller.drawLate(commandBuffer,slot);
+                }
+                else{
+                    meshletCuller.draw(commandBuffer,slot);
+                }
+                textureStreamer.markUsed(texture);
+                return;
+            }
+            for(const SessionDraw& draw: draws){
+                //a session recorded by another build may draw more than this one has
+                if(draw.firstIndex+draw.indexCount>meshIndexCount || draw.firstInstance+draw.instanceCount>scene.size()){
+                    continue;
+                }
+                vkCmdDrawIndexed(commandBuffer,draw.indexCount,draw.instanceCount,draw.firstIndex,draw.vertexOffset,draw.firstInstance);
+            }
+            textureStreamer.markUsed(texture);
+        }
+
         void createSyncObjects(){
 
+            PROFILE_ZONE("createSyncObjects");
+
             imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
             renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
             inFlightfences.resize(MAX_FRAMES_IN_FLIGHT);
+            submittedFrames.assign(MAX_FRAMES_IN_FLIGHT,0);
 
             VkSemaphoreCreateInfo semaphoreInfo{};
             {
@@ -1075,6 +2078,25 @@ class HelloTriangleApplication{
 
         }
 
+        //GPU zones are only recorded while a trace is being captured.
+        void createGpuProfiler(){
+
+            PROFILE_ZONE("createGpuProfiler");
+
+            const QueueFamilyIndices& queueFamilyIndices= deviceInfo.queueFamilies;
+            gpuProfiler.init(instance,physicalDevice,device,graphicsQueue,queueFamilyIndices.graphicsFamily.value(),queueFamilyIndices.computeFamily.value(),
+                             commandPool,MAX_FRAMES_IN_FLIGHT,calibratedTimestampsEnabled);
+            renderGraph.setProfiler(&gpuProfiler);
+        }
+
+        void createAsyncCompute(){
+
+            PROFILE_ZONE("createAsyncCompute");
+
+            const QueueFamilyIndices& queueFamilyIndices= deviceInfo.queueFamilies;
+            asyncCompute.init(device,computeQueue,queueFamilyIndices.computeFamily.value(),queueFamilyIndices.graphicsFamily.value(),MAX_FRAMES_IN_FLIGHT);
+        }
+
         static void errorCallback(int error, const char* description){
             std::cerr << "GLFW Error: " << description << std::endl;
         }
@@ -1089,17 +2111,63 @@ class HelloTriangleApplication{
                 return;
             }
             glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+            if(batchJobCount>0){
+                glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE); //only needed for the surface the device is picked with
+            }
 
-            window= glfwCreateWindow(WIDTH,HEIGHT,"Vulkan",nullptr,nullptr);
+            int width=WIDTH, height=HEIGHT;
+            if(sessionReader.isOpen()){
+                width=static_cast<int>(sessionReader.getExtent().width);
+                height=static_cast<int>(sessionReader.getExtent().height);
+            }
+
+            window= glfwCreateWindow(width,height,"Vulkan",nullptr,nullptr);
             glfwSetWindowUserPointer(window,this); // idk why
             glfwSetFramebufferSizeCallback(window,frameBufferResizeCallback);
             glfwSetWindowCloseCallback(window,windowCloseCallback);
+            glfwSetKeyCallback(window,keyCallback);
+            glfwSetWindowRefreshCallback(window,windowRefreshCallback);
 
         }
 
         static void frameBufferResizeCallback(GLFWwindow* window, int width,int height){
             auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
             app->frameBufferResized = true;
+            app->frameScheduler.request(FrameScheduler::Reason::Window);
+        }
+
+        //the window was uncovered or needs its contents again
+        static void windowRefreshCallback(GLFWwindow* window){
+            auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+            app->frameScheduler.request(FrameScheduler::Reason::Window);
+        }
+
+        static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods){
+            if(action!=GLFW_PRESS){
+                return;
+            }
+            auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+            app->frameScheduler.request(FrameScheduler::Reason::Input);
+            switch(key){
+                case GLFW_KEY_M:
+                    vkutil::memoryTracker().dumpJson("memory.json"); //per heap usage and budget, bytes per category
+                    break;
+                case GLFW_KEY_C:
+                    app->captureToggleRequested=true; //handled between frames
+                    break;
+                case GLFW_KEY_G:
+                    app->meshletCullingToggleRequested=true;
+                    break;
+                case GLFW_KEY_O:
+                    app->occlusionCullingToggleRequested=true;
+                    break;
+                case GLFW_KEY_H:
+                    app->hudToggleRequested=true;
+                    break;
+                case GLFW_KEY_SPACE:
+                    app->animationToggleRequested=true;
+                    break;
+            }
         }
 
         static void windowCloseCallback(GLFWwindow* window)
@@ -1109,46 +2177,322 @@ class HelloTriangleApplication{
         }
 
         void mainLoop(){
+            frameScheduler.start();
             while(!glfwWindowShouldClose(window)){
-                drawFrame();
+                if(frameScheduler.isEnabled()){
+                    glfwPollEvents();
+                    requestActiveFrames();
+                    if(!frameScheduler.waitForFrame()){
+                        continue;
+                    }
+                }
+                //the low latency mode sleeps first, so the frame renders with the newest input
+                frameLatency.waitForFrameStart();
                 glfwPollEvents();
+                frameLatency.beginFrame();
+                drawFrame();
             }
              vkDeviceWaitIdle(device);
+             sessionWriter.close();
+             if(sessionReader.isOpen()){
+                 reportReplay();
+             }
+             writeCullReport();
+             commandBufferCache.printReport();
+             frameLatency.printReport();
+             frameScheduler.printReport(perfHud.getStats().gpuMs);
+        }
+
+        //What changes without an event asks for a frame every time the loop comes around, until it stops changing.
+        void requestActiveFrames(){
+            if(!animationPaused){
+                frameScheduler.request(FrameScheduler::Reason::Animation); //the scene spins, particles and lights move
+            }
+            if(textureStreamer.isStreaming() || (worldStreaming && worldStreamer.isStreaming())){
+                frameScheduler.request(FrameScheduler::Reason::Streaming);
+            }
+        }
+
+        void writeCullReport(){
+            if(cullReportPath.empty()){
+                return;
+            }
+            std::ofstream file(cullReportPath);
+            if(!file.is_open()){
+                std::cerr<<"failed to write "<<cullReportPath<<std::endl;
+                return;
+            }
+            file<<"{\n  \"device\": \""<<deviceInfo.properties.deviceName<<"\",\n  \"frames\": [\n";
+            for(size_t i=0;i<cullReportFrames.size();++i){
+                const MeshletCuller::Stats& frame=cullReportFrames[i];
+                file<<"    {\"clusters\": "<<frame.clusters<<", \"drawn\": "<<frame.drawn<<", \"lateDrawn\": "<<frame.lateDrawn
+                    <<", \"frustumCulled\": "<<frame.frustumCulled<<", \"backfaceCulled\": "<<frame.backfaceCulled
+                    <<", \"occlusionCulled\": "<<frame.occlusionCulled<<"}"<<(i+1<cullReportFrames.size() ? ",\n" : "\n");
+            }
+            file<<"  ]\n}\n";
+            std::cout<<"culling report written to "<<cullReportPath<<std::endl;
+        }
+
+        void reportReplay(){
+            if(replayFrameTimes.empty()){
+                return;
+            }
+            std::vector<double> sorted=replayFrameTimes;
+            std::sort(sorted.begin(),sorted.end());
+            double total=0.0;
+            for(double milliseconds: sorted){
+                total+=milliseconds;
+            }
+            auto percentile=[&sorted](double p){
+                return sorted[std::min(sorted.size()-1,static_cast<size_t>(p*(sorted.size()-1)+0.5))];
+            };
+            double average=total/sorted.size();
+            std::cout<<"replay: "<<sorted.size()<<" frames in "<<total/1000.0<<" s, avg "<<average<<" ms, p50 "<<percentile(0.5)
+                     <<" ms, p95 "<<percentile(0.95)<<" ms, p99 "<<percentile(0.99)<<" ms, max "<<sorted.back()<<" ms"<<std::endl;
+
+            if(replayReportPath.empty()){
+                return;
+            }
+            std::ofstream file(replayReportPath);
+            if(!file.is_open()){
+                std::cerr<<"failed to write "<<replayReportPath<<std::endl;
+                return;
+            }
+            file<<"{\n  \"session\": \""<<replayPath<<"\",\n  \"device\": \""<<deviceInfo.properties.deviceName<<"\",\n";
+            file<<"  \"frames\": "<<sorted.size()<<",\n  \"averageMs\": "<<average<<",\n  \"p50Ms\": "<<percentile(0.5)
+                <<",\n  \"p95Ms\": "<<percentile(0.95)<<",\n  \"p99Ms\": "<<percentile(0.99)<<",\n  \"maxMs\": "<<sorted.back()<<",\n";
+            file<<"  \"frameMs\": [";
+            for(size_t i=0;i<replayFrameTimes.size();++i){
+                file<<(i ? "," : "")<<replayFrameTimes[i];
+            }
+            file<<"]\n}\n";
+            std::cout<<"replay report written to "<<replayReportPath<<std::endl;
+        }
+
+        //Offline mode: a producer thread feeds a turntable of the scene into the bounded job queue, the batch
+        //renderer keeps its targets busy and reports the throughput once the queue is drained.
+        void runBatch(){
+
+            PROFILE_ZONE("runBatch");
+
+            batchRenderer.init(deviceInfo,device,graphicsQueue,deviceInfo.queueFamilies.graphicsFamily.value(),swapChainImageFormat,
+                               findDepthFormat(),batchSettings,deletionQueue);
+            if(!batchOutput.empty()){
+                std::filesystem::create_directories(batchOutput);
+            }
+
+            BoundedQueue<BatchJob> jobs(batchSettings.queueCapacity);
+            std::thread producer([this,&jobs]{
+                Profiler::get().setThreadName("batch producer");
+                for(uint64_t i=0;i<batchJobCount;++i){
+                    BatchJob job;
+                    job.id=i;
+                    float angle=i*0.05f;
+                    job.eye=glm::vec3(2.8f*std::cos(angle),2.8f*std::sin(angle),2.0f);
+                    job.time=i/30.0f;
+                    if(!batchOutput.empty()){
+                        char name[32];
+                        std::snprintf(name,sizeof(name),"job_%06llu.png",static_cast<unsigned long long>(i));
+                        job.output=(std::filesystem::path(batchOutput)/name).string();
+                    }
+                    jobs.push(std::move(job));
+                }
+                jobs.close();
+            });
+
+            BatchRenderer::Report report=batchRenderer.run(jobs,[this](VkCommandBuffer commandBuffer, uint32_t target, const BatchJob& job){
+                renderBatchJob(commandBuffer,target,job);
+            });
+            producer.join();
+            vkDeviceWaitIdle(device);
+
+            VkExtent2D extent=batchRenderer.getExtent();
+            std::cout<<"batch: "<<report.jobs<<" jobs in "<<report.seconds<<" s, "<<report.jobsPerSecond<<" jobs/s ("
+                     <<batchRenderer.getTargetCount()<<" targets, "<<extent.width<<"x"<<extent.height<<", queue of "<<jobs.getCapacity()<<")"<<std::endl;
+            std::cout<<"batch latency: avg "<<report.averageLatency<<" ms, p50 "<<report.medianLatency<<" ms, p95 "<<report.p95Latency
+                     <<" ms, max "<<report.maxLatency<<" ms"<<std::endl;
+        }
+
+        void renderBatchJob(VkCommandBuffer commandBuffer, uint32_t target, const BatchJob& job){
+
+            //submissions stand in for frames, the deletion queue and the texture streamer count in them
+            frameCounter=batchRenderer.getSubmittedCount();
+            deletionQueue.flush(batchRenderer.getCompletedCount());
+            deletionQueue.beginFrame(frameCounter);
+            textureStreamer.update(frameCounter);
+            if(descriptorTextureVersions[target]!=textureStreamer.getVersion()){
+                updateTextureDescriptor(target);
+            }
+
+            VkExtent2D extent=batchRenderer.getExtent();
+            writeUniformBuffer(target,job.eye,job.target,extent);
+            animateScene(job.time);
+            memcpy(instanceBuffersMapped[target],scene.getWorldMatrices(),sizeof(TransformMatrix)*scene.size());
+            drawScene(commandBuffer,target,extent,sceneDraws(),false);
         }
 
         void drawFrame(){
 
-            vkWaitForFences(device,1,&inFlightfences[currentFrame],VK_TRUE,UINT64_MAX); // wait for the previous frame
+            PROFILE_ZONE("drawFrame");
+
+            auto frameStart=std::chrono::steady_clock::now();
+            const SessionFrame* replayFrame=nullptr;
+            if(sessionReader.isOpen()){
+                replayFrame=sessionReader.peek();
+                if(replayFrame==nullptr){
+                    glfwSetWindowShouldClose(window,GLFW_TRUE);
+                    return;
+                }
+                if(replayFrame->resize){
+                    glfwSetWindowSize(window,static_cast<int>(replayFrame->resize->width),static_cast<int>(replayFrame->resize->height));
+                    frameBufferResized=true;
+                }
+            }
+
+            {
+                PROFILE_ZONE("wait for frame fence");
+                vkWaitForFences(device,1,&inFlightfences[currentFrame],VK_TRUE,UINT64_MAX); // wait for the previous frame
+            }
+            auto waited=std::chrono::steady_clock::now();
+            gpuProfiler.collect(currentFrame);
+
+            //everything up to the frame that last used this slot is done on the GPU
+            deletionQueue.flush(submittedFrames[currentFrame]);
+            ++frameCounter;
+            deletionQueue.beginFrame(frameCounter);
+
+            //finished readbacks go to the writer thread
+            frameCapture.collect(submittedFrames[currentFrame]);
+            if(captureToggleRequested){
+                captureToggleRequested=false;
+                toggleCapture();
+            }
+            if(hudToggleRequested){
+                hudToggleRequested=false;
+                perfHud.setVisible(!perfHud.isVisible());
+                createRenderGraph(); //the overlay pass and the hud's timestamps come and go with it
+            }
+            if(animationToggleRequested){
+                animationToggleRequested=false;
+                if(animationPaused){
+                    pausedSceneDuration=sceneClock()-pausedSceneTime;
+                }
+                else{
+                    pausedSceneTime=sceneTime(nullptr);
+                }
+                animationPaused=!animationPaused;
+                std::cout<<"animation "<<(animationPaused ? "paused" : "running")<<std::endl;
+            }
+            if(gpuTimingInGraph){
+                perfHud.collect(currentFrame);
+            }
+            if(meshletCullingSupported){
+                if(meshletCuller.collect(currentFrame) && !cullReportPath.empty()){
+                    cullReportFrames.push_back(meshletCuller.getLastFrame());
+                }
+                if(meshletCullingToggleRequested){
+                    meshletCulling=!meshletCulling;
+                    std::cout<<"meshlet culling "<<(meshletCulling ? "on" : "off")<<std::endl;
+                    createRenderGraph();
+                }
+                if(occlusionCullingToggleRequested && occlusionCullingSupported){
+                    occlusionCulling=!occlusionCulling;
+                    std::cout<<"occlusion culling "<<(occlusionCulling ? "on" : "off")<<std::endl;
+                    depthPyramid.invalidate(); //whatever it holds is from before the camera last moved
+                    createRenderGraph();
+                }
+            }
+            meshletCullingToggleRequested=false;
+            occlusionCullingToggleRequested=false;
+            if(particlesInGraph){
+                particleSystem.collect(currentFrame);
+            }
+            if(lightingInGraph){
+                clusteredLighting.collect(currentFrame);
+            }
+            if(dynamicResolutionInGraph){
+                //the scale only changes between frames, every pass of a frame renders at the same extent
+                dynamicResolution.collect(currentFrame);
+                renderExtent=dynamicResolution.getRenderExtent();
+            }
+
+            textureStreamer.update(frameCounter);
+            vkutil::memoryTracker().update(frameCounter);
+            if(descriptorTextureVersions[currentFrame]!=textureStreamer.getVersion()){
+                updateTextureDescriptor(currentFrame);
+            }
 
             uint32_t imageIdx;
             VkResult result = vkAcquireNextImageKHR(device,swapChain,UINT64_MAX,imageAvailableSemaphores[currentFrame],VK_NULL_HANDLE,&imageIdx);
 
             if(result==VK_ERROR_OUT_OF_DATE_KHR){
                 recreateSwapChain();
+                return;
             }
             else if(result!=VK_SUCCESS && result!=VK_SUBOPTIMAL_KHR){
                 throw std::runtime_error("failed to acquire swapchain image!");
             }
 
-            updateUniformBuffers(currentFrame);
+            float time=sceneTime(replayFrame);
+            if(worldStreaming){
+                worldCamera(time,worldEye,worldTarget);
+                glm::vec3 forward=worldTarget-worldEye;
+                worldStreamer.update(frameCounter,&worldEye.x,&forward.x);
+            }
+            if(particlesInGraph){
+                particleSystem.update(time,time-previousSceneTime);
+            }
+            previousSceneTime=time;
+            updateUniformBuffers(currentFrame,replayFrame);
+            updateScene(currentFrame,time);
+            if(lightingInGraph){
+                updateLights(currentFrame,time);
+                binLights();
+            }
+            frameDraws= replayFrame ? replayFrame->draws : sceneDraws();
+            if(debugDrawInGraph){
+                drawDebug(currentFrame,time);
+                if(hudInGraph){
+                    perfHud.setCounters(hudCounters());
+                    perfHud.draw(debugDraw,swapChainExtent);
+                }
+                debugDraw.upload(currentFrame);
+            }
             // Only reset the fence if we are submitting work
             vkResetFences(device, 1, &inFlightfences[currentFrame]);
 
-            vkResetCommandBuffer(commandBuffers[currentFrame],0);// to bring the commandbuffer to the initial state. If command buffer is in the pending command buffer cannot be recorded.
-            recordCommanbuffer(commandBuffers[currentFrame],imageIdx);
-            VkSemaphore waitSemaphores[]={imageAvailableSemaphores[currentFrame]};
-            VkPipelineStageFlags waitFlags[]={VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+            //the slot's fence was waited on, so none of its recordings is pending and the chosen one can be reset or reused
+            auto updated=std::chrono::steady_clock::now();
+            VkCommandBuffer commandBuffer;
+            if(commandBufferCache.acquire(currentFrame,imageIdx,recordingKey(),recordingCacheable(),commandBuffer)){
+                resubmitRecording();
+            }
+            else{
+                recordCommanbuffer(commandBuffer,imageIdx);
+            }
+            auto recorded=std::chrono::steady_clock::now();
+
+            //compute work recorded for this frame goes first, graphics only waits for it where the results are consumed
+            VkSemaphore waitSemaphores[2]={imageAvailableSemaphores[currentFrame]};
+            VkPipelineStageFlags waitFlags[2]={VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+            uint32_t waitCount=1;
+            VkSemaphore computeFinished=asyncCompute.submit(currentFrame);
+            if(computeFinished!=VK_NULL_HANDLE){
+                waitSemaphores[waitCount]=computeFinished;
+                waitFlags[waitCount]=asyncCompute.getWaitStages(currentFrame);
+                ++waitCount;
+            }
 
             VkSemaphore signalSemaphores[]={renderFinishedSemaphores[currentFrame]};
         
             VkSubmitInfo submitInfo{};
             {
                 submitInfo.sType=VK_STRUCTURE_TYPE_SUBMIT_INFO;
-                submitInfo.waitSemaphoreCount=1;
+                submitInfo.waitSemaphoreCount=waitCount;
                 submitInfo.pWaitSemaphores=waitSemaphores; //which semaphore
                 submitInfo.pWaitDstStageMask=waitFlags;    //which stage to wait
                 submitInfo.commandBufferCount=1;
-                submitInfo.pCommandBuffers=&commandBuffers[currentFrame];
+                submitInfo.pCommandBuffers=&commandBuffer;
                 submitInfo.signalSemaphoreCount=1;
                 submitInfo.pSignalSemaphores=signalSemaphores;
             }
@@ -1156,6 +2500,16 @@ class HelloTriangleApplication{
             if(vkQueueSubmit(graphicsQueue,1,&submitInfo,inFlightfences[currentFrame])!=VK_SUCCESS){
                 throw std::runtime_error("failed to submit draw command buffer!");
             }
+            submittedFrames[currentFrame]=frameCounter;
+            asyncCompute.endFrame(currentFrame);
+            frameLatency.markSubmit();
+
+            if(sessionWriter.isOpen()){
+                sessionFrame.time=time;
+                sessionFrame.draws=frameDraws;
+                sessionWriter.writeFrame(sessionFrame,swapChainExtent);
+            }
+            ++sceneFrameIndex;
 
             VkSwapchainKHR swapChains[]={swapChain}; 
 
@@ -1169,8 +2523,14 @@ class HelloTriangleApplication{
                 presentInfo.pImageIndices=&imageIdx;
                 presentInfo.pResults=nullptr;
             }
+            frameLatency.chainPresentInfo(presentInfo);
 
             result = vkQueuePresentKHR(graphicsQueue,&presentInfo);
+            frameLatency.markPresent(result);
+            if(!startup.hasFirstFrame()){
+                startup.markFirstFrame();
+                reportStartup();
+            }
 
             if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || frameBufferResized) {
                 frameBufferResized=false;
@@ -1180,42 +2540,242 @@ class HelloTriangleApplication{
             }
             currentFrame=(currentFrame+1)%MAX_FRAMES_IN_FLIGHT;
 
+            auto presented=std::chrono::steady_clock::now();
+            auto milliseconds=[](std::chrono::steady_clock::duration duration){ return std::chrono::duration<float,std::milli>(duration).count(); };
+            const float phases[static_cast<size_t>(PerfHud::Phase::Count)]={
+                milliseconds(waited-frameStart),milliseconds(updated-waited),milliseconds(recorded-updated),milliseconds(presented-recorded)
+            };
+            perfHud.addFrame(phases,previousFrameStart.time_since_epoch().count()>0 ? milliseconds(frameStart-previousFrameStart) : 0.0f);
+            previousFrameStart=frameStart;
+
+            if(replayFrame){
+                sessionReader.advance();
+                replayFrameTimes.push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-frameStart).count());
+            }
         }
 
-        void updateUniformBuffers(uint32_t currentImage){
+        //Scene time of the frame: recorded when replaying, otherwise the fixed timestep or the clock without the time
+        //the animation was paused.
+        float sceneTime(const SessionFrame* replayFrame){
+            if(replayFrame){
+                return replayFrame->time;
+            }
+            if(animationPaused){
+                return pausedSceneTime;
+            }
+            return sceneClock()-pausedSceneDuration;
+        }
 
+        float sceneClock(){
+            if(fixedTimestep>0.0f){
+                return sceneFrameIndex*fixedTimestep;
+            }
             static auto startTime=std::chrono::high_resolution_clock::now();
-            
             auto currentTime=std::chrono::high_resolution_clock::now();
-            float time=std::chrono::duration<float,std::chrono::seconds::period>(currentTime-startTime).count();
+            return std::chrono::duration<float,std::chrono::seconds::period>(currentTime-startTime).count();
+        }
+
+        void updateUniformBuffers(uint32_t currentImage, const SessionFrame* replayFrame){
+
+            PROFILE_ZONE("updateUniformBuffers");
+
+            if(replayFrame && replayFrame->uniforms.size()==sizeof(UniformBufferObject)){
+                memcpy(uniformBuffersMapped[currentImage],replayFrame->uniforms.data(),sizeof(UniformBufferObject));
+            }
+            else{
+                writeUniformBuffer(currentImage,worldStreaming ? worldEye : glm::vec3(2.0f,2.0f,2.0f),worldStreaming ? worldTarget : glm::vec3(0.0f,0.0f,0.0f),swapChainExtent);
+            }
+
+            if(sessionWriter.isOpen()){
+                //a few bytes read back from mapped memory, only while recording
+                const uint8_t* bytes=static_cast<const uint8_t*>(uniformBuffersMapped[currentImage]);
+                sessionFrame.uniforms.assign(bytes,bytes+sizeof(UniformBufferObject));
+            }
+        }
+
+        void writeUniformBuffer(uint32_t slot, glm::vec3 eye, glm::vec3 target, VkExtent2D extent){
 
             UniformBufferObject ubo{};
-            ubo.model=glm::rotate(glm::mat4(1.0f),time*glm::radians(90.0f),glm::vec3(0.0f,0.0f,1.0f));
-            ubo.view=glm::lookAt(glm::vec3(2.0f,2.0f,2.0f),glm::vec3(0.0f,0.0f,0.0f),glm::vec3(0.0f,0.0f,1.0f));
-            ubo.proj=glm::perspective(glm::radians(45.0f),swapChainExtent.width/(float)swapChainExtent.height,0.1f,10.0f);
+            ubo.model=glm::mat4(1.0f); //the quads are placed by the instance matrices of the scene
+            ubo.view=glm::lookAt(eye,target,glm::vec3(0.0f,0.0f,1.0f));
+            ubo.proj=glm::perspective(glm::radians(45.0f),extent.width/(float)extent.height,cameraNear,cameraFar);
 
             ubo.proj[1][1]*=-1; // to flip the y axis
 
-            memcpy(uniformBuffersMapped[currentImage],&ubo,sizeof(ubo));
+            memcpy(uniformBuffersMapped[slot],&ubo,sizeof(ubo));
+        }
+
+        //Animates the scene and writes the world matrices into this frame's instance buffer.
+        void updateScene(uint32_t currentImage, float time){
 
+            PROFILE_ZONE("updateScene");
+
+            animateScene(time);
+            memcpy(instanceBuffersMapped[currentImage],scene.getWorldMatrices(),sizeof(TransformMatrix)*scene.size());
+        }
+
+        //Moves the lights to where they are at time seconds and writes them with this frame's camera for the binning.
+        //Records the binning into the frame's async compute work. It runs next to the graphics work in front of the scene
+        //pass (the previous frame's tail, meshlet culling, the vertices of the scene) and only the scene's fragments wait
+        //for it. The lists are rewritten from scratch every frame, so they are only handed to the graphics queue and
+        //never back.
+        void binLights(){
+            VkCommandBuffer commandBuffer=asyncCompute.record(currentFrame);
+            gpuProfiler.beginFrame(commandBuffer,currentFrame,GpuProfiler::Queue::Compute);
+            {
+                GpuProfileZone binZone(gpuProfiler,commandBuffer,"light binning",GpuProfiler::Queue::Compute);
+                clusteredLighting.bin(commandBuffer,currentFrame);
+            }
+            for(VkBuffer buffer: {clusteredLighting.getClusterBuffer(currentFrame),clusteredLighting.getViewLightBuffer(currentFrame)}){
+                asyncCompute.releaseBuffer(currentFrame,buffer,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_WRITE_BIT,
+                                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT);
+            }
+        }
+
+        void updateLights(uint32_t currentImage, float time){
+
+            PROFILE_ZONE("updateLights");
+
+            //the camera as the uniforms have it, recorded ones included
+            UniformBufferObject ubo;
+            memcpy(&ubo,uniformBuffersMapped[currentImage],sizeof(ubo));
+            ClusteredLighting::Light* lights=clusteredLighting.update(currentImage,&ubo.view[0][0],&ubo.proj[0][0],cameraNear,cameraFar,renderExtent,lightCount);
+            const float cosOuter=std::cos(glm::radians(35.0f)), cosInner=std::cos(glm::radians(25.0f));
+            for(uint32_t i=0;i<lightCount;++i){
+                const LightOrbit& orbit=lightOrbits[i];
+                float angle=orbit.angle+orbit.speed*time;
+                ClusteredLighting::Light light{
+                    {orbit.radius*std::cos(angle),orbit.radius*std::sin(angle),orbit.height,orbit.range},
+                    {orbit.color[0],orbit.color[1],orbit.color[2],2.0f},
+                    {0.0f,0.0f,-1.0f,orbit.spot ? cosOuter : ClusteredLighting::pointLight},
+                    {cosInner,0.0f,0.0f,0.0f}
+                };
+                lights[i]=light;
+            }
+        }
+
+        //What --debug-draw and --debug-draw-stress show this frame, posed at time seconds.
+        void drawDebug(uint32_t currentImage, float time){
+
+            PROFILE_ZONE("drawDebug");
+
+            UniformBufferObject ubo;
+            memcpy(&ubo,uniformBuffersMapped[currentImage],sizeof(ubo));
+            glm::mat4 viewProjection=ubo.proj*ubo.view;
+            debugDraw.setCamera(&viewProjection[0][0],swapChainExtent);
+
+            if(debugDrawScene){
+                const float origin[3]={0.0f,0.0f,0.0f};
+                const float axes[3][3]={{0.5f,0.0f,0.0f},{0.0f,0.5f,0.0f},{0.0f,0.0f,0.5f}};
+                for(int axis=0;axis<3;++axis){
+                    debugDraw.line(origin,axes[axis],DebugDraw::rgba(axis==0,axis==1,axis==2));
+                }
+
+                //world bounds of every node's mesh: the box around its eight transformed corners
+                const TransformMatrix* world=scene.getWorldMatrices();
+                const uint32_t boundsColor=DebugDraw::rgba(1.0f,1.0f,0.0f);
+                const uint32_t labelColor=DebugDraw::rgba(1.0f,1.0f,1.0f);
+                for(size_t node=0;node<scene.size();++node){
+                    const float* m=world[node].m;
+                    float min[3]={m[12],m[13],m[14]}, max[3]={m[12],m[13],m[14]};
+                    for(int row=0;row<3;++row){
+                        for(int column=0;column<3;++column){
+                            float a=m[column*4+row]*meshBounds[0][column], b=m[column*4+row]*meshBounds[1][column];
+                            min[row]+=std::min(a,b);
+                            max[row]+=std::max(a,b);
+                        }
+                    }
+                    debugDraw.aabb(min,max,boundsColor);
+                    debugDraw.text(&m[12],std::to_string(node),labelColor);
+                }
+
+                //a probe camera turning above the scene, with a projection that has depth from 0 to 1 as frustum() expects
+                const float probeNear=0.1f, probeFar=0.8f, focal=1.0f/std::tan(glm::radians(20.0f));
+                glm::mat4 probeProjection(0.0f);
+                probeProjection[0][0]=focal;
+                probeProjection[1][1]=focal;
+                probeProjection[2][2]=probeFar/(probeNear-probeFar);
+                probeProjection[2][3]=-1.0f;
+                probeProjection[3][2]=probeNear*probeFar/(probeNear-probeFar);
+                glm::vec3 probeEye(0.0f,0.0f,1.0f);
+                glm::vec3 probeTarget(std::cos(time*0.5f),std::sin(time*0.5f),0.0f);
+                glm::mat4 inverseProbe=glm::inverse(probeProjection*glm::lookAt(probeEye,probeTarget,glm::vec3(0.0f,0.0f,1.0f)));
+                debugDraw.frustum(&inverseProbe[0][0],DebugDraw::rgba(0.0f,1.0f,1.0f));
+                debugDraw.sphere(&probeEye.x,0.05f,DebugDraw::rgba(0.0f,1.0f,1.0f));
+            }
+
+            //mostly lines and boxes, every sixteenth a sphere, all turning around the z axis together
+            const float c=std::cos(time*0.25f), s=std::sin(time*0.25f);
+            const uint32_t stressColors[3]={DebugDraw::rgba(1.0f,0.3f,0.3f,0.8f),DebugDraw::rgba(0.3f,1.0f,0.3f,0.8f),DebugDraw::rgba(0.3f,0.5f,1.0f,0.8f)};
+            for(uint32_t i=0;i<debugDrawStress;++i){
+                const float* primitive=&stressPrimitives[static_cast<size_t>(i)*4];
+                float center[3]={c*primitive[0]-s*primitive[1],s*primitive[0]+c*primitive[1],primitive[2]};
+                float size=primitive[3];
+                if(i%16==15){
+                    debugDraw.sphere(center,size,stressColors[2]);
+                }
+                else if(i%2==0){
+                    float end[3]={center[0]+c*size*2.0f,center[1]+s*size*2.0f,center[2]+size};
+                    debugDraw.line(center,end,stressColors[0]);
+                }
+                else{
+                    float min[3]={center[0]-size,center[1]-size,center[2]-size};
+                    float max[3]={center[0]+size,center[1]+size,center[2]+size};
+                    debugDraw.aabb(min,max,stressColors[1]);
+                }
+            }
+        }
+
+        //Poses the scene at time seconds.
+        void animateScene(float time){
+
+            //rotations around z as quaternions, half angle
+            float rootAngle=time*glm::radians(90.0f)*0.5f;
+            scene.setRotation(sceneRoot,0.0f,0.0f,std::sin(rootAngle),std::cos(rootAngle));
+            float spinAngle=-time*glm::radians(180.0f)*0.5f;
+            for(NodeHandle spinner: sceneSpinners){
+                scene.setRotation(spinner,0.0f,0.0f,std::sin(spinAngle),std::cos(spinAngle));
+            }
+            scene.update();
         }
 
         void cleanup(){
 
             cleanUpSwapChain();
 
-         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-                vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-                vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-            }
+            swapChain.reset();
+
+            uniformBuffers.clear();
+            uniformBuffersMemory.clear();
+            instanceBuffers.clear();
+            instanceBuffersMemory.clear();
+
+            textureStreamer.cleanup();
+            worldStreamer.cleanup();
+            frameCapture.cleanup();
+            batchRenderer.cleanup();
+            meshletCuller.cleanup();
+            depthPyramid.cleanup();
+            particleSystem.cleanup();
+            clusteredLighting.cleanup();
+            debugDraw.cleanup();
+            perfHud.cleanup();
+            dynamicResolution.cleanup();
 
             vkDestroyDescriptorPool(device,descriptorPool,nullptr);
             vkDestroyDescriptorSetLayout(device,descriptorSetLayout,nullptr);
-            vkDestroyBuffer(device, indexBuffer, nullptr);
-            vkFreeMemory(device, indexBufferMemory, nullptr);
+            indexBuffer.reset();
+            indexBufferMemory.reset();
 
-            vkDestroyBuffer(device,vertexBuffer,nullptr);
-            vkFreeMemory(device,vertexBufferMemory,nullptr);
+            vertexBuffer.reset();
+            vertexBufferMemory.reset();
+
+            graphicsPipeline.reset();
+            pipelineLayout.reset();
+            renderGraph.cleanup();
+
+            //the device is idle after the main loop, so everything queued can go now
+            deletionQueue.flushAll();
 
             for(size_t i=0; i<MAX_FRAMES_IN_FLIGHT;++i){
                 vkDestroySemaphore(device,imageAvailableSemaphores[i],nullptr);
@@ -1223,15 +2783,19 @@ class HelloTriangleApplication{
                 vkDestroyFence(device,inFlightfences[i],nullptr);
             }
             vkDestroyCommandPool(device,commandPool,nullptr);
-            vkDestroyPipeline(device,graphicsPipeline,nullptr);
-            vkDestroyPipelineLayout(device,pipelineLayout,nullptr);
-            vkDestroyRenderPass(device,renderPass,nullptr);
+            asyncCompute.cleanup();
+            gpuProfiler.cleanup();
+            frameLatency.cleanup();
             vkDestroyDevice(device,nullptr);
             vkDestroySurfaceKHR(instance,surface,nullptr);
             vkDestroyInstance(instance,nullptr);
 
             glfwDestroyWindow(window);
             glfwTerminate();
+
+            if(!tracePath.empty()){
+                Profiler::get().write(tracePath);
+            }
         }
 
         bool checkValidationLayerSupport(){
@@ -1267,49 +2831,203 @@ class HelloTriangleApplication{
         VkInstance instance;
         VkSurfaceKHR surface;
         VkPhysicalDevice physicalDevice= VK_NULL_HANDLE;
+        DeviceInfo deviceInfo;
+        std::string preferredDevice;
+        VkPhysicalDeviceFeatures enabledFeatures{};
+        bool calibratedTimestampsEnabled=false;
+        FrameLatency frameLatency;
+        bool lowLatency=false;
         VkDevice device;
         VkQueue graphicsQueue;
         VkQueue presentQueue;
-        VkSwapchainKHR swapChain;
+        VkQueue computeQueue;
+        DeletionQueue deletionQueue;
+        vkutil::UniqueSwapchain swapChain;
         std::vector<VkImage> swapChainImages;
         VkFormat swapChainImageFormat;
         VkExtent2D swapChainExtent;
 
-        VkRenderPass renderPass;
+        RenderGraph renderGraph;
+        RenderResource backbuffer;
+        RenderPassHandle scenePass;
+
+        BatchRenderer batchRenderer;
+        BatchRenderer::Settings batchSettings;
+        uint64_t batchJobCount=0;
+        std::string batchOutput;
+
+        FrameCapture frameCapture;
+        RenderResource captureBuffer;
+        bool captureInGraph=false;
+        bool captureOnStart=false;
+        bool captureToggleRequested=false;
+
+        MeshletCuller meshletCuller;
+        RenderResource meshletDraws;
+        RenderResource meshletDrawCount;
+        bool meshletCullingSupported=false;
+        bool meshletCulling=false;
+        bool meshletCullingInGraph=false;
+        bool meshletCullingToggleRequested=false;
+        bool drawIndirectCountEnabled=false;
+
+        DepthPyramid depthPyramid;
+        RenderResource depthBuffer;
+        RenderResource depthPyramidImage;
+        RenderResource meshletVisibility;
+        bool occlusionCullingSupported=false;
+        bool occlusionCulling=false;
+        bool occlusionCullingInGraph=false;
+        bool occlusionCullingToggleRequested=false;
+        std::string cullReportPath;
+
+        DynamicResolution dynamicResolution;
+        float resolutionBudgetMs=0.0f;
+        bool upscaleSharpen=false;
+        bool dynamicResolutionInGraph=false;
+        VkExtent2D renderExtent{};
+        RenderResource sceneColor;
+        RenderPassHandle upscalePass;
+
+        ParticleSystem particleSystem;
+        uint32_t particleCount=0;
+        bool particlesInGraph=false;
+        RenderPassHandle particlePass;
+        RenderResource particleBuffer;
+        RenderResource particleLists;
+        RenderResource particleCounters;
+
+        //A light circling the z axis, placed by createClusteredLighting().
+        struct LightOrbit{
+            float radius;
+            float angle;
+            float height;
+            float speed; //radians per second
+            float range;
+            float color[3];
+            bool spot;
+        };
+
+        ClusteredLighting clusteredLighting;
+        uint32_t lightCount=0;
+        bool lightingInGraph=false;
+        RenderResource lightClusters;
+        RenderResource viewLights;
+        std::vector<LightOrbit> lightOrbits;
+
+        DebugDraw debugDraw;
+        bool debugDrawScene=false;
+        uint32_t debugDrawStress=0;
+        bool debugDrawInGraph=false;
+        RenderPassHandle debugLinePass;
+        RenderPassHandle debugOverlayPass;
+        float meshBounds[2][3]={};
+        std::vector<float> stressPrimitives; //x, y, z, size per primitive
+
+        PerfHud perfHud;
+        bool hudInGraph=false;
+        bool hudToggleRequested=false;
+        bool gpuTimingInGraph=false; //the hud's timestamps are recorded for the hud or the on demand report
+
+        FrameScheduler frameScheduler;
+        bool onDemand=false;
+        bool animationPaused=false;
+        bool animationToggleRequested=false;
+        float pausedSceneTime=0.0f;     //scene time the animation stopped at
+        float pausedSceneDuration=0.0f; //summed length of the pauses
+        std::chrono::steady_clock::time_point previousFrameStart;
+        std::vector<MeshletCuller::Stats> cullReportFrames;
+        std::string captureDirectory="capture";
+        CaptureFormat captureFormat=CaptureFormat::Png;
+
+        SessionWriter sessionWriter;
+        SessionReader sessionReader;
+        SessionFrame sessionFrame; //inputs of the frame being recorded
+        std::vector<SessionDraw> frameDraws; //what the scene pass of the current frame draws
+        std::string recordPath;
+        std::string replayPath;
+        std::string replayReportPath;
+        std::vector<double> replayFrameTimes;
+        float fixedTimestep=0.0f;
+        float previousSceneTime=0.0f;
+        uint64_t sceneFrameIndex=0;
+
         VkDescriptorSetLayout descriptorSetLayout;
         VkDescriptorPool descriptorPool;
-        VkPipelineLayout pipelineLayout;
+        vkutil::UniquePipelineLayout pipelineLayout;
         std::vector<VkDescriptorSet> descriptorSets;
 
-        VkPipeline graphicsPipeline;
+        vkutil::UniquePipeline graphicsPipeline;
+        CompiledPipeline startupPipeline; //handed from the startup compile to the install on main
 
-        std::vector<VkImageView> swapChainImageViews;
-        std::vector<VkFramebuffer> swapChainFrameBuffers;
+        std::vector<vkutil::UniqueImageView> swapChainImageViews;
 
-        VkBuffer vertexBuffer;
-        VkDeviceMemory vertexBufferMemory;
-        VkBuffer indexBuffer;
-        VkDeviceMemory indexBufferMemory;
+        vkutil::UniqueBuffer vertexBuffer;
+        vkutil::UniqueDeviceMemory vertexBufferMemory;
+        vkutil::UniqueBuffer indexBuffer;
+        vkutil::UniqueDeviceMemory indexBufferMemory;
 
-        std::vector<VkBuffer> uniformBuffers;
-        std::vector<VkDeviceMemory> uniformBuffersMemory;
+        std::vector<vkutil::UniqueBuffer> uniformBuffers;
+        std::vector<vkutil::UniqueDeviceMemory> uniformBuffersMemory;
         std::vector<void*> uniformBuffersMapped;
 
+        TransformHierarchy scene;
+        NodeHandle sceneRoot;
+        std::vector<NodeHandle> sceneSpinners;
+        std::vector<vkutil::UniqueBuffer> instanceBuffers;
+        std::vector<vkutil::UniqueDeviceMemory> instanceBuffersMemory;
+        std::vector<void*> instanceBuffersMapped;
+
+        TextureStreamer textureStreamer;
+
+        WorldStreamer worldStreamer;
+        int32_t worldCells=0;
+        uint32_t worldBudgetMiB=32;
+        bool worldStreaming=false;
+        glm::vec3 worldEye{2.0f,2.0f,2.0f};
+        glm::vec3 worldTarget{0.0f,0.0f,0.0f};
+        TextureHandle texture;
+        std::vector<uint64_t> descriptorTextureVersions;
+
         VkCommandPool commandPool;
-        std::vector<VkCommandBuffer> commandBuffers;
+        CommandBufferCache commandBufferCache;
+        bool recordEveryFrame=false;
+        uint64_t renderGraphGeneration=0; //bumped by every rebuild, recordings of an older graph are stale
+        uint64_t pipelineGeneration=0;
+        VkCommandBuffer uploadCommandBuffer=VK_NULL_HANDLE; //open during the startup, see beginUploadBatch()
+        uint32_t uploadCopyCount=0;
+        StartupGraph startup;
+        std::string startupReportPath;
+        std::map<std::string,std::vector<char>> shaderCache;
+        std::vector<Meshlet> sceneMeshlets; //built during the startup, handed to the culling
+        AsyncCompute asyncCompute;
+        GpuProfiler gpuProfiler;
+        std::string tracePath;
 
         //Synchronization objects
         std::vector<VkSemaphore> imageAvailableSemaphores;
         std::vector<VkSemaphore> renderFinishedSemaphores;
         std::vector<VkFence> inFlightfences;
+        std::vector<uint64_t> submittedFrames; //frameCounter value last submitted with each fence
         
         bool frameBufferResized=false;
         const int MAX_FRAMES_IN_FLIGHT = 2;
+        static constexpr float cameraNear=0.1f;
+        static constexpr float cameraFar=10.0f;
+
+        //Uniform buffers, instance buffers and descriptor sets exist once per slot: a frame in flight or a batch target.
+        uint32_t sceneSlotCount() const{
+            return std::max<uint32_t>(MAX_FRAMES_IN_FLIGHT,batchJobCount>0 ? batchSettings.targets : 0);
+        }
+
+        bool debugDrawUsed() const{
+            return debugDrawScene || debugDrawStress>0 || perfHud.isVisible();
+        }
         uint32_t currentFrame = 0;
+        uint64_t frameCounter = 0;
 
         const std::vector<const char*> deviceExtensions={
-            VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-            "VK_KHR_portability_subset"
+            VK_KHR_SWAPCHAIN_EXTENSION_NAME
         };
 
         const std::vector<const char*> validationLayers = {
@@ -1325,6 +3043,7 @@ class HelloTriangleApplication{
         struct Vertex{
             glm::vec3 pos;
             glm::vec3 color;
+            glm::vec2 texCoord;
 
             static VkVertexInputBindingDescription getBindingDescription(){
                 VkVertexInputBindingDescription bindingDescription{};
@@ -1335,8 +3054,8 @@ class HelloTriangleApplication{
                 return bindingDescription;
             }
 
-            static std::array<VkVertexInputAttributeDescription,2> getAttributeDescriptions(){
-            std::array<VkVertexInputAttributeDescription,2> attributeDescriptions{};
+            static std::array<VkVertexInputAttributeDescription,3> getAttributeDescriptions(){
+            std::array<VkVertexInputAttributeDescription,3> attributeDescriptions{};
 
             attributeDescriptions[0].binding=0;
             attributeDescriptions[0].location=0;
@@ -1348,22 +3067,60 @@ class HelloTriangleApplication{
             attributeDescriptions[1].format=VK_FORMAT_R32G32B32_SFLOAT;
             attributeDescriptions[1].offset=offsetof(Vertex,color);
 
+            attributeDescriptions[2].binding=0;
+            attributeDescriptions[2].location=2;
+            attributeDescriptions[2].format=VK_FORMAT_R32G32_SFLOAT;
+            attributeDescriptions[2].offset=offsetof(Vertex,texCoord);
+
+            return attributeDescriptions;
+            }
+        };
+
+        //per instance data, the world matrix of a scene node as four vec4 columns
+        struct Instance{
+
+            static VkVertexInputBindingDescription getBindingDescription(){
+                VkVertexInputBindingDescription bindingDescription{};
+                bindingDescription.binding=1;
+                bindingDescription.stride=sizeof(TransformMatrix);
+                bindingDescription.inputRate=VK_VERTEX_INPUT_RATE_INSTANCE;
+
+                return bindingDescription;
+            }
+
+            static std::array<VkVertexInputAttributeDescription,4> getAttributeDescriptions(){
+            std::array<VkVertexInputAttributeDescription,4> attributeDescriptions{};
+
+            for(uint32_t i=0; i<4; ++i){
+                attributeDescriptions[i].binding=1;
+                attributeDescriptions[i].location=3+i;
+                attributeDescriptions[i].format=VK_FORMAT_R32G32B32A32_SFLOAT;
+                attributeDescriptions[i].offset=sizeof(float)*4*i;
+            }
+
             return attributeDescriptions;
             }
         };
 
         //define vertex buffer
         const std::vector<Vertex> vertices={
-            {{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}},
-            {{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}},
-            {{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}},
-            {{-0.5f, 0.5f,0.0f}, {1.0f, 1.0f, 1.0f}}
+            {{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
+            {{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
+            {{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
+            {{-0.5f, 0.5f,0.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f}}
         };
         
         const std::vector<uint16_t> indices={
             0,1,2,2,3,0
         };
 
+        std::string assetPackPath;
+        AssetPack assetPack; //stays mapped, the mesh points into it
+        const Vertex* meshVertices=nullptr;
+        size_t meshVertexCount=0;
+        const uint16_t* meshIndices=nullptr;
+        size_t meshIndexCount=0;
+
         struct UniformBufferObject {
             glm::mat4 model;
             glm::mat4 view;
@@ -1373,8 +3130,124 @@ class HelloTriangleApplication{
 };
 
 
-int main() {
+int main(int argc, char** argv) {
+
+    Profiler::get().setThreadName("main");
+
     HelloTriangleApplication app;
+    BatchRenderer::Settings batchSettings;
+    uint64_t batchJobs=0;
+    std::string batchOutput;
+    std::string replayPath;
+    std::string replayReport;
+    float resolutionBudget=0.0f;
+    bool upscaleSharpen=false;
+    int32_t worldCells=0;
+    uint32_t worldBudget=32;
+
+    for(int i=1; i<argc; ++i){
+        if(strcmp(argv[i],"--bench-transforms")==0){
+            return runTransformBenchmark();
+        }
+        else if(strcmp(argv[i],"--trace")==0 && i+1<argc){
+            app.setTracePath(argv[++i]);
+            Profiler::get().start();
+        }
+        else if(strcmp(argv[i],"--gpu")==0 && i+1<argc){
+            app.setPreferredDevice(argv[++i]);
+        }
+        else if(strcmp(argv[i],"--capture")==0 && i+1<argc){
+            app.setCapture(argv[++i]);
+        }
+        else if(strcmp(argv[i],"--capture-raw")==0){
+            app.setCaptureFormat(CaptureFormat::Raw);
+        }
+        else if(strcmp(argv[i],"--record")==0 && i+1<argc){
+            app.setRecordPath(argv[++i]);
+        }
+        else if(strcmp(argv[i],"--replay")==0 && i+1<argc){
+            replayPath=argv[++i];
+        }
+        else if(strcmp(argv[i],"--replay-report")==0 && i+1<argc){
+            replayReport=argv[++i];
+        }
+        else if(strcmp(argv[i],"--cull-report")==0 && i+1<argc){
+            app.setCullReport(argv[++i]);
+        }
+        else if(strcmp(argv[i],"--resolution-budget")==0 && i+1<argc){
+            resolutionBudget=static_cast<float>(std::atof(argv[++i]));
+        }
+        else if(strcmp(argv[i],"--upscale")==0 && i+1<argc){
+            upscaleSharpen=strcmp(argv[++i],"sharpen")==0;
+        }
+        else if(strcmp(argv[i],"--world")==0 && i+1<argc){
+            worldCells=std::atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i],"--world-budget")==0 && i+1<argc){
+            worldBudget=static_cast<uint32_t>(std::strtoul(argv[++i],nullptr,10));
+        }
+        else if(strcmp(argv[i],"--startup-report")==0 && i+1<argc){
+            app.setStartupReport(argv[++i]);
+        }
+        else if(strcmp(argv[i],"--low-latency")==0){
+            app.setLowLatency(true);
+        }
+        else if(strcmp(argv[i],"--record-every-frame")==0){
+            app.setRecordEveryFrame(true);
+        }
+        else if(strcmp(argv[i],"--pack")==0 && i+1<argc){
+            app.setAssetPack(argv[++i]);
+        }
+        else if(strcmp(argv[i],"--particles")==0 && i+1<argc){
+            app.setParticleCount(static_cast<uint32_t>(std::strtoul(argv[++i],nullptr,10)));
+        }
+        else if(strcmp(argv[i],"--lights")==0 && i+1<argc){
+            app.setLightCount(static_cast<uint32_t>(std::strtoul(argv[++i],nullptr,10)));
+        }
+        else if(strcmp(argv[i],"--hud")==0){
+            app.setHud(true);
+        }
+        else if(strcmp(argv[i],"--on-demand")==0){
+            app.setOnDemand(true);
+        }
+        else if(strcmp(argv[i],"--debug-draw")==0){
+            app.setDebugDraw(true);
+        }
+        else if(strcmp(argv[i],"--debug-draw-stress")==0 && i+1<argc){
+            app.setDebugDrawStress(static_cast<uint32_t>(std::strtoul(argv[++i],nullptr,10)));
+        }
+        else if(strcmp(argv[i],"--fixed-step")==0 && i+1<argc){
+            app.setFixedTimestep(static_cast<float>(std::atof(argv[++i]))/1000.0f);
+        }
+        else if(strcmp(argv[i],"--batch")==0 && i+1<argc){
+            batchJobs=std::strtoull(argv[++i],nullptr,10);
+        }
+        else if(strcmp(argv[i],"--batch-out")==0 && i+1<argc){
+            batchOutput=argv[++i];
+        }
+        else if(strcmp(argv[i],"--batch-targets")==0 && i+1<argc){
+            batchSettings.targets=std::max(1,std::atoi(argv[++i]));
+            batchSettings.queueCapacity=batchSettings.targets*4;
+        }
+        else if(strcmp(argv[i],"--batch-size")==0 && i+1<argc){
+            unsigned width=0, height=0;
+            if(std::sscanf(argv[++i],"%ux%u",&width,&height)==2 && width>0 && height>0){
+                batchSettings.extent={width,height};
+            }
+        }
+    }
+    if(batchJobs>0){
+        app.setBatch(batchJobs,batchOutput,batchSettings);
+    }
+    if(!replayPath.empty()){
+        app.setReplay(replayPath,replayReport);
+    }
+    if(resolutionBudget>0.0f){
+        app.setResolutionBudget(resolutionBudget,upscaleSharpen);
+    }
+    if(worldCells>0){
+        app.setWorld(worldCells,worldBudget);
+    }
 
     try{
         app.run();
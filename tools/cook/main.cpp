@@ -0,0 +1,439 @@
+#include "AssetPack.h"
+
+#include<algorithm>
+#include<array>
+#include<cmath>
+#include<cstdlib>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<iomanip>
+#include<iostream>
+#include<sstream>
+#include<string>
+#include<unordered_map>
+#include<vector>
+
+//Turns source meshes into an asset pack the renderer maps at startup (see src/AssetPack.h for the layout). Everything
+//that would otherwise happen at load time is done here: parsing, triangulation, vertex deduplication, ordering for the
+//post-transform cache and for vertex fetch, narrowing the indices to 16 bit and laying the data out aligned.
+
+struct CookedMesh{
+    std::string name;
+    std::vector<pack::Vertex> vertices;
+    std::vector<uint16_t> indices;
+};
+
+//Positions with an optional rgb color (v x y z r g b), texture coordinates and faces of any size, which are split
+//into a fan. Normals are ignored, the renderer has no use for them yet.
+static bool loadObj(const std::string& path, std::vector<pack::Vertex>& vertices, std::vector<uint32_t>& indices){
+
+    std::ifstream file(path);
+    if(!file.is_open()){
+        std::cerr<<"failed to open "<<path<<std::endl;
+        return false;
+    }
+
+    struct Position{
+        float position[3];
+        float color[3];
+    };
+    std::vector<Position> positions;
+    std::vector<std::array<float,2>> texCoords;
+    std::unordered_map<uint64_t,uint32_t> uniqueVertices;
+
+    std::string line;
+    size_t lineNumber=0;
+    while(std::getline(file,line)){
+        ++lineNumber;
+        std::istringstream stream(line);
+        std::string keyword;
+        stream>>keyword;
+        if(keyword=="v"){
+            Position position{{0.0f,0.0f,0.0f},{1.0f,1.0f,1.0f}};
+            stream>>position.position[0]>>position.position[1]>>position.position[2];
+            float r, g, b;
+            if(stream>>r>>g>>b){
+                position.color[0]=r;
+                position.color[1]=g;
+                position.color[2]=b;
+            }
+            positions.push_back(position);
+        }
+        else if(keyword=="vt"){
+            float u=0.0f, v=0.0f;
+            stream>>u>>v;
+            texCoords.push_back({u,1.0f-v}); //OBJ has v going up, the renderer samples with v going down
+        }
+        else if(keyword=="f"){
+            std::vector<uint32_t> face;
+            std::string corner;
+            while(stream>>corner){
+                long positionIndex=0, texCoordIndex=0;
+                char* next=nullptr;
+                positionIndex=std::strtol(corner.c_str(),&next,10);
+                if(*next=='/' && next[1]!='/'){
+                    texCoordIndex=std::strtol(next+1,nullptr,10);
+                }
+                //negative indices count back from the latest element
+                if(positionIndex<0){
+                    positionIndex+=static_cast<long>(positions.size())+1;
+                }
+                if(texCoordIndex<0){
+                    texCoordIndex+=static_cast<long>(texCoords.size())+1;
+                }
+                if(positionIndex<1 || positionIndex>static_cast<long>(positions.size()) || texCoordIndex>static_cast<long>(texCoords.size())){
+                    std::cerr<<path<<":"<<lineNumber<<": face refers to a missing vertex"<<std::endl;
+                    return false;
+                }
+
+                uint64_t key=(static_cast<uint64_t>(positionIndex)<<32) | static_cast<uint64_t>(texCoordIndex);
+                auto found=uniqueVertices.find(key);
+                if(found==uniqueVertices.end()){
+                    const Position& position=positions[positionIndex-1];
+                    pack::Vertex vertex{};
+                    memcpy(vertex.position,position.position,sizeof(vertex.position));
+                    memcpy(vertex.color,position.color,sizeof(vertex.color));
+                    if(texCoordIndex>0){
+                        vertex.texCoord[0]=texCoords[texCoordIndex-1][0];
+                        vertex.texCoord[1]=texCoords[texCoordIndex-1][1];
+                    }
+                    found=uniqueVertices.emplace(key,static_cast<uint32_t>(vertices.size())).first;
+                    vertices.push_back(vertex);
+                }
+                face.push_back(found->second);
+            }
+            for(size_t i=2;i<face.size();++i){
+                indices.insert(indices.end(),{face[0],face[i-1],face[i]});
+            }
+        }
+    }
+    return true;
+}
+
+//Average cache miss ratio, transformed vertices per triangle for a FIFO post-transform cache of cacheSize entries.
+static double averageCacheMissRatio(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize=16){
+    if(indices.empty()){
+        return 0.0;
+    }
+    std::vector<uint64_t> insertedAt(vertexCount,0);
+    uint64_t time=cacheSize+1; //a vertex is cached while it was inserted less than cacheSize misses ago
+    uint64_t misses=0;
+    for(uint32_t index: indices){
+        if(time-insertedAt[index]>cacheSize){
+            insertedAt[index]=time++;
+            ++misses;
+        }
+    }
+    return static_cast<double>(misses)/(indices.size()/3);
+}
+
+//Reorders the triangles for the post-transform cache with Tom Forsyth's linear-speed algorithm: every vertex scores
+//by its position in a simulated LRU cache and by how few triangles still use it, the next triangle is the one with the
+//highest score of its vertices, looked for among the triangles of the cached vertices first.
+static void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount){
+
+    constexpr int cacheSize=32;
+    constexpr float cacheDecayPower=1.5f;
+    constexpr float lastTriangleScore=0.75f;
+    constexpr float valenceBoostScale=2.0f;
+    constexpr float valenceBoostPower=0.5f;
+
+    auto vertexScore=[&](int cachePosition, uint32_t remaining){
+        if(remaining==0){
+            return -1.0f; //no triangle left to add
+        }
+        float score=0.0f;
+        if(cachePosition>=0){
+            if(cachePosition<3){
+                score=lastTriangleScore; //fixed, so the last triangle's vertices do not win over the rest of the cache by too much
+            }
+            else{
+                float scale=1.0f/(cacheSize-3);
+                score=std::pow(1.0f-(cachePosition-3)*scale,cacheDecayPower);
+            }
+        }
+        return score+valenceBoostScale*std::pow(static_cast<float>(remaining),-valenceBoostPower);
+    };
+
+    size_t triangleCount=indices.size()/3;
+    std::vector<uint32_t> remaining(vertexCount,0);
+    for(uint32_t index: indices){
+        ++remaining[index];
+    }
+    std::vector<uint32_t> firstTriangle(vertexCount+1,0);
+    for(size_t i=0;i<vertexCount;++i){
+        firstTriangle[i+1]=firstTriangle[i]+remaining[i];
+    }
+    std::vector<uint32_t> vertexTriangles(indices.size());
+    std::vector<uint32_t> filled(firstTriangle.begin(),firstTriangle.end()-1);
+    for(size_t i=0;i<indices.size();++i){
+        vertexTriangles[filled[indices[i]]++]=static_cast<uint32_t>(i/3);
+    }
+
+    std::vector<int> cachePosition(vertexCount,-1);
+    std::vector<float> score(vertexCount);
+    for(size_t i=0;i<vertexCount;++i){
+        score[i]=vertexScore(-1,remaining[i]);
+    }
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> added(triangleCount,false);
+    for(size_t t=0;t<triangleCount;++t){
+        triangleScore[t]=score[indices[t*3]]+score[indices[t*3+1]]+score[indices[t*3+2]];
+    }
+
+    std::vector<uint32_t> cache, nextCache;
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    size_t scanStart=0;
+    int64_t best=-1;
+
+    for(size_t emitted=0;emitted<triangleCount;++emitted){
+        if(best<0){
+            //nothing in the cache has triangles left, take the best of the rest
+            float bestScore=-1.0f;
+            while(scanStart<triangleCount && added[scanStart]){
+                ++scanStart;
+            }
+            for(size_t t=scanStart;t<triangleCount;++t){
+                if(!added[t] && triangleScore[t]>bestScore){
+                    bestScore=triangleScore[t];
+                    best=static_cast<int64_t>(t);
+                }
+            }
+        }
+
+        size_t triangle=static_cast<size_t>(best);
+        added[triangle]=true;
+        nextCache.clear();
+        for(int corner=0;corner<3;++corner){
+            uint32_t vertex=indices[triangle*3+corner];
+            result.push_back(vertex);
+            nextCache.push_back(vertex);
+            //remove the triangle from the vertex's list of triangles left
+            uint32_t begin=firstTriangle[vertex];
+            uint32_t end=begin+remaining[vertex];
+            for(uint32_t i=begin;i<end;++i){
+                if(vertexTriangles[i]==triangle){
+                    std::swap(vertexTriangles[i],vertexTriangles[end-1]);
+                    break;
+                }
+            }
+            --remaining[vertex];
+        }
+        for(uint32_t vertex: cache){
+            if(nextCache.size()>=cacheSize+3){
+                break;
+            }
+            if(vertex!=nextCache[0] && vertex!=nextCache[1] && vertex!=nextCache[2]){
+                nextCache.push_back(vertex);
+            }
+        }
+        //vertices pushed past the cache size were evicted and score as uncached again
+        for(size_t i=0;i<nextCache.size();++i){
+            cachePosition[nextCache[i]]= i<cacheSize ? static_cast<int>(i) : -1;
+        }
+        std::swap(cache,nextCache);
+
+        best=-1;
+        float bestScore=-1.0f;
+        for(uint32_t vertex: cache){
+            float newScore=vertexScore(cachePosition[vertex],remaining[vertex]);
+            float delta=newScore-score[vertex];
+            score[vertex]=newScore;
+            uint32_t begin=firstTriangle[vertex];
+            for(uint32_t i=begin;i<begin+remaining[vertex];++i){
+                uint32_t t=vertexTriangles[i];
+                triangleScore[t]+=delta;
+                if(triangleScore[t]>bestScore){
+                    bestScore=triangleScore[t];
+                    best=t;
+                }
+            }
+        }
+        if(cache.size()>cacheSize){
+            cache.resize(cacheSize);
+        }
+    }
+    indices.swap(result);
+}
+
+//Renumbers the vertices in the order the indices first use them, so vertex fetch walks the buffer forward.
+static void optimizeVertexFetch(std::vector<pack::Vertex>& vertices, std::vector<uint32_t>& indices){
+    std::vector<uint32_t> remap(vertices.size(),UINT32_MAX);
+    std::vector<pack::Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for(uint32_t& index: indices){
+        if(remap[index]==UINT32_MAX){
+            remap[index]=static_cast<uint32_t>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index=remap[index];
+    }
+    vertices.swap(ordered); //drops vertices no triangle uses
+}
+
+static bool cookMesh(const std::string& path, CookedMesh& mesh){
+
+    std::vector<uint32_t> indices;
+    if(!loadObj(path,mesh.vertices,indices)){
+        return false;
+    }
+    if(indices.empty()){
+        std::cerr<<path<<" has no triangles"<<std::endl;
+        return false;
+    }
+    double before=averageCacheMissRatio(indices,mesh.vertices.size());
+    optimizeVertexCache(indices,mesh.vertices.size());
+    optimizeVertexFetch(mesh.vertices,indices);
+    double after=averageCacheMissRatio(indices,mesh.vertices.size());
+
+    //the renderer draws with 16 bit indices
+    if(mesh.vertices.size()>65536){
+        std::cerr<<path<<" has "<<mesh.vertices.size()<<" vertices, at most 65536 fit 16 bit indices"<<std::endl;
+        return false;
+    }
+    mesh.indices.assign(indices.begin(),indices.end());
+    mesh.name=std::filesystem::path(path).stem().string();
+
+    std::cout<<mesh.name<<": "<<mesh.vertices.size()<<" vertices, "<<mesh.indices.size()/3<<" triangles, ACMR "
+             <<std::fixed<<std::setprecision(3)<<before<<" -> "<<after<<std::endl;
+    return true;
+}
+
+class PackWriter{
+
+    public:
+        PackWriter(bool compress, uint32_t chunkSize): compress(compress), chunkSize(chunkSize){
+            bytes.resize(sizeof(pack::Header),0);
+        }
+
+        bool add(const std::string& name, pack::EntryType type, const void* data, uint32_t elementSize, uint64_t elementCount){
+            pack::Entry entry{};
+            if(name.size()>=sizeof(entry.name)){
+                std::cerr<<"entry name "<<name<<" is too long"<<std::endl;
+                return false;
+            }
+            memcpy(entry.name,name.c_str(),name.size());
+            entry.type=type;
+            entry.elementSize=elementSize;
+            entry.elementCount=elementCount;
+            entry.size=elementCount*elementSize;
+            entry.offset=pad();
+
+            const uint8_t* source=static_cast<const uint8_t*>(data);
+            if(!compress){
+                entry.compression=pack::Compression::None;
+                entry.storedSize=entry.size;
+                bytes.insert(bytes.end(),source,source+entry.size);
+            }
+            else{
+                entry.compression=pack::Compression::LZ4;
+                entry.chunkSize=chunkSize;
+                std::vector<pack::Chunk> chunks;
+                std::vector<uint8_t> compressed;
+                for(uint64_t offset=0;offset<entry.size;offset+=chunkSize){
+                    uint32_t size=static_cast<uint32_t>(std::min<uint64_t>(chunkSize,entry.size-offset));
+                    lz4::compress(source+offset,size,compressed);
+                    chunks.push_back({bytes.size(),static_cast<uint32_t>(compressed.size()),size});
+                    bytes.insert(bytes.end(),compressed.begin(),compressed.end());
+                }
+                entry.storedSize=bytes.size()-entry.offset;
+                entry.chunkCount=static_cast<uint32_t>(chunks.size());
+                entry.chunkTableOffset=pad();
+                const uint8_t* table=reinterpret_cast<const uint8_t*>(chunks.data());
+                bytes.insert(bytes.end(),table,table+chunks.size()*sizeof(pack::Chunk));
+            }
+            entries.push_back(entry);
+            return true;
+        }
+
+        bool write(const std::string& path){
+            pack::Header header{};
+            memcpy(header.magic,pack::magic,sizeof(header.magic));
+            header.version=pack::version;
+            header.entryCount=static_cast<uint32_t>(entries.size());
+            header.tocOffset=pad();
+            const uint8_t* toc=reinterpret_cast<const uint8_t*>(entries.data());
+            bytes.insert(bytes.end(),toc,toc+entries.size()*sizeof(pack::Entry));
+            header.fileSize=bytes.size();
+            header.checksum=pack::checksum(bytes.data()+sizeof(pack::Header),bytes.size()-sizeof(pack::Header));
+            memcpy(bytes.data(),&header,sizeof(header));
+
+            std::ofstream file(path,std::ios::binary);
+            file.write(reinterpret_cast<const char*>(bytes.data()),static_cast<std::streamsize>(bytes.size()));
+            if(!file){
+                std::cerr<<"failed to write "<<path<<std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        uint64_t getSize() const{
+            return bytes.size();
+        }
+
+    private:
+        uint64_t pad(){
+            bytes.resize(pack::alignUp(bytes.size()),0);
+            return bytes.size();
+        }
+
+        bool compress;
+        uint32_t chunkSize;
+        std::vector<uint8_t> bytes;
+        std::vector<pack::Entry> entries;
+};
+
+static void printUsage(){
+    std::cout<<"usage: VulkanCook [--lz4] [--chunk-size KiB] -o pack.bin mesh.obj...\n"
+               "  every mesh becomes the entries <name>/vertices and <name>/indices, named after its file"<<std::endl;
+}
+
+int main(int argc, char** argv){
+
+    std::string output;
+    std::vector<std::string> inputs;
+    bool compress=false;
+    uint32_t chunkSize=256*1024;
+
+    for(int i=1; i<argc; ++i){
+        if(strcmp(argv[i],"-o")==0 && i+1<argc){
+            output=argv[++i];
+        }
+        else if(strcmp(argv[i],"--lz4")==0){
+            compress=true;
+        }
+        else if(strcmp(argv[i],"--chunk-size")==0 && i+1<argc){
+            chunkSize=std::max(1u,static_cast<uint32_t>(std::strtoul(argv[++i],nullptr,10)))*1024;
+        }
+        else if(argv[i][0]=='-'){
+            printUsage();
+            return EXIT_FAILURE;
+        }
+        else{
+            inputs.push_back(argv[i]);
+        }
+    }
+    if(output.empty() || inputs.empty()){
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    PackWriter writer(compress,chunkSize);
+    uint64_t rawBytes=0;
+    for(const std::string& input: inputs){
+        CookedMesh mesh;
+        if(!cookMesh(input,mesh) ||
+           !writer.add(mesh.name+"/vertices",pack::EntryType::Vertices,mesh.vertices.data(),sizeof(pack::Vertex),mesh.vertices.size()) ||
+           !writer.add(mesh.name+"/indices",pack::EntryType::Indices,mesh.indices.data(),sizeof(uint16_t),mesh.indices.size())){
+            return EXIT_FAILURE;
+        }
+        rawBytes+=mesh.vertices.size()*sizeof(pack::Vertex)+mesh.indices.size()*sizeof(uint16_t);
+    }
+    if(!writer.write(output)){
+        return EXIT_FAILURE;
+    }
+    std::cout<<"wrote "<<output<<": "<<writer.getSize()<<" bytes for "<<rawBytes<<" bytes of mesh data"<<std::endl;
+    return EXIT_SUCCESS;
+}